@@ -0,0 +1,40 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2015 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "libde265/x86/sse-convert.h"
+#include "libde265/x86/avx2-convert.h"
+#include "convert.h"
+
+
+DSPFunc_ReduceBitDepth      reduce_sse("ReduceBitDepth-SSE", reduce_bit_depth_row_sse4,
+                                       &reduce_scalar);
+DSPFunc_InterleaveChroma_8  interleave_sse_8("InterleaveChroma-SSE-8",
+                                             interleave_chroma_row_8_sse4, &interleave_scalar_8);
+DSPFunc_InterleaveChroma_16 interleave_sse_16("InterleaveChroma-SSE-16",
+                                              interleave_chroma_row_16_sse4, &interleave_scalar_16);
+DSPFunc_ShiftRow_16         shift_sse_16("ShiftRow-SSE-16", shift_row_16_sse4, &shift_scalar_16);
+DSPFunc_YUVToRGBA           rgba_sse("YUVToRGBA-SSE", yuv_to_rgba_row_sse4, &rgba_scalar);
+
+#if HAVE_AVX2
+DSPFunc_ReduceBitDepth      reduce_avx2("ReduceBitDepth-AVX2", reduce_bit_depth_row_avx2,
+                                        &reduce_scalar);
+DSPFunc_YUVToRGBA           rgba_avx2("YUVToRGBA-AVX2", yuv_to_rgba_row_avx2, &rgba_scalar);
+#endif
@@ -0,0 +1,139 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2015 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "convert.h"
+#include "libde265/fallback-convert.h"
+
+
+static const int bitDepths[3] = { 10,12,16 };
+
+static const int16_t yuv2rgb_matrices[4][6] = {
+  { 16, 298, 409, -100, -208, 516 },  // BT.601, limited range
+  {  0, 256, 359,  -88, -183, 454 },  // BT.601, full range
+  { 16, 298, 459,  -55, -136, 541 },  // BT.709, limited range
+  {  0, 256, 403,  -48, -120, 475 }   // BT.709, full range
+};
+
+
+DSPFunc_Convert_Base::DSPFunc_Convert_Base(const char* name, DSPFunc* ref)
+{
+  funcName = name;
+  refImpl = ref;
+  frameCnt = 0;
+  for (int i=0;i<3;i++) {
+    src16[i][0] = src16[i][1] = NULL;
+  }
+  stride16 = 0;
+}
+
+
+DSPFunc_Convert_Base::Params DSPFunc_Convert_Base::getParams(int x,int y) const
+{
+  static const int widths[8] = { 1,7,8,15,16,31,33,64 };
+
+  // some pseudo-random parameters that are the same for the reference implementation
+
+  unsigned int h = (x*31 + y*17 + frameCnt*7) * 2654435761u;
+
+  Params p;
+  p.width    = widths[(h>>4) % 8];
+  p.bitDepth = bitDepths[(h>>7) % 3];
+  p.matrix   = yuv2rgb_matrices[(h>>9) % 4];
+
+  for (int i=0;i<8;i++) {
+    p.dither[i] = ((((h>>(i*3+11)) ^ (h>>i)) & 63) << (p.bitDepth-8)) >> 6;
+  }
+
+  return p;
+}
+
+
+const uint16_t* DSPFunc_Convert_Base::plane16(const Params& p, int x,int y, int plane) const
+{
+  int idx = (p.bitDepth==10 ? 0 : p.bitDepth==12 ? 1 : 2);
+  return src16[idx][plane] + x + y*stride16;
+}
+
+
+bool DSPFunc_Convert_Base::compareToReferenceImplementation()
+{
+  DSPFunc_Convert_Base* ref = dynamic_cast<DSPFunc_Convert_Base*>(referenceImplementation());
+
+  return (memcmp(out8,  ref->out8,  sizeof(out8))==0 &&
+          memcmp(out16, ref->out16, sizeof(out16))==0);
+}
+
+
+bool DSPFunc_Convert_Base::prepareNextImage(std::shared_ptr<const de265_image> img)
+{
+  if (!curr_image) {
+    curr_image = img;
+    return false;
+  }
+
+  prev_image = curr_image;
+  curr_image = img;
+  frameCnt++;
+
+  memset(out8, 0,sizeof(out8));
+  memset(out16,0,sizeof(out16));
+
+  int w = curr_image->get_width(0);
+  int h = curr_image->get_height(0);
+
+  if (src16[0][0]==NULL) {
+    stride16 = w;
+    for (int i=0;i<3;i++)
+      for (int k=0;k<2;k++) {
+        src16[i][k] = new uint16_t[stride16*h];
+      }
+  }
+
+  int cstride = curr_image->get_luma_stride();
+  int pstride = prev_image->get_luma_stride();
+  const uint8_t* curr = curr_image->get_image_plane_at_pos(0,0,0);
+  const uint8_t* prev = prev_image->get_image_plane_at_pos(0,0,0);
+
+  // The second frame fills the lower bits such that all sample bits are used.
+
+  for (int y=0;y<h;y++)
+    for (int x=0;x<w;x++) {
+      int c = curr[y*cstride+x];
+      int p = prev[y*pstride+x];
+
+      for (int i=0;i<3;i++) {
+        int bd = bitDepths[i];
+        src16[i][0][x+y*stride16] = (c<<(bd-8)) | (p>>(16-bd));
+        src16[i][1][x+y*stride16] = (p<<(bd-8)) | (c>>(16-bd));
+      }
+    }
+
+  return true;
+}
+
+
+DSPFunc_ReduceBitDepth      reduce_scalar("ReduceBitDepth-Scalar", reduce_bit_depth_row_fallback);
+DSPFunc_InterleaveChroma_8  interleave_scalar_8("InterleaveChroma-Scalar-8",
+                                                interleave_chroma_row_8_fallback);
+DSPFunc_InterleaveChroma_16 interleave_scalar_16("InterleaveChroma-Scalar-16",
+                                                 interleave_chroma_row_16_fallback);
+DSPFunc_ShiftRow_16         shift_scalar_16("ShiftRow-Scalar-16", shift_row_16_fallback);
+DSPFunc_YUVToRGBA           rgba_scalar("YUVToRGBA-Scalar", yuv_to_rgba_row_fallback);
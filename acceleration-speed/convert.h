@@ -0,0 +1,178 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2015 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACCELERATION_SPEED_CONVERT_H
+#define ACCELERATION_SPEED_CONVERT_H
+
+#include "acceleration-speed.h"
+
+
+/* Row functions of the output format conversion (de265_convert_image).
+   Each block is one image row segment. The 8 bit input is taken from the luma planes
+   of two consecutive frames, the 16 bit input combines both frames into 10, 12 or 16 bits
+   (a second plane swaps the frames to serve as Cr input).
+   Row width, bit depth, dither pattern and color matrix change from block to block.
+ */
+class DSPFunc_Convert_Base : public DSPFunc
+{
+public:
+  DSPFunc_Convert_Base(const char* name, DSPFunc* ref);
+
+  virtual const char* name() const { return funcName; }
+
+  virtual int getBlkWidth()  const { return 64; }
+  virtual int getBlkHeight() const { return 1; }
+
+  virtual DSPFunc* referenceImplementation() const { return refImpl; }
+
+  virtual bool compareToReferenceImplementation();
+  virtual bool prepareNextImage(std::shared_ptr<const de265_image> img);
+
+  struct Params {
+    int width;
+    int bitDepth;
+    uint16_t dither[8];
+    const int16_t* matrix;  // YCbCr to RGB, see fallback-convert.h
+  };
+
+  Params getParams(int x,int y) const;
+
+private:
+  std::shared_ptr<const de265_image> prev_image;
+  std::shared_ptr<const de265_image> curr_image;
+
+  const char* funcName;
+  DSPFunc* refImpl;
+  int frameCnt;
+
+  uint16_t* src16[3][2];  // two planes per bit depth
+  int       stride16;
+
+protected:
+  const uint8_t* curr8(int x,int y) const { return curr_image->get_image_plane_at_pos(0,x,y); }
+  const uint8_t* prev8(int x,int y) const { return prev_image->get_image_plane_at_pos(0,x,y); }
+  const uint16_t* plane16(const Params& p, int x,int y, int plane) const;
+
+  uint8_t  out8[64*4];
+  uint16_t out16[64*2];
+};
+
+
+class DSPFunc_ReduceBitDepth : public DSPFunc_Convert_Base
+{
+public:
+  typedef void (*func_t)(uint8_t* dst, const uint16_t* src, int width, int bit_depth,
+                         const uint16_t* dither);
+
+  DSPFunc_ReduceBitDepth(const char* name, func_t f, DSPFunc* ref=NULL)
+    : DSPFunc_Convert_Base(name,ref), func(f) { }
+
+  virtual void runOnBlock(int x,int y) {
+    Params p = getParams(x,y);
+    func(out8, plane16(p,x,y,0), p.width, p.bitDepth, p.dither);
+  }
+
+private:
+  func_t func;
+};
+
+
+class DSPFunc_InterleaveChroma_8 : public DSPFunc_Convert_Base
+{
+public:
+  typedef void (*func_t)(uint8_t* dst, const uint8_t* cb, const uint8_t* cr, int width);
+
+  DSPFunc_InterleaveChroma_8(const char* name, func_t f, DSPFunc* ref=NULL)
+    : DSPFunc_Convert_Base(name,ref), func(f) { }
+
+  virtual void runOnBlock(int x,int y) {
+    Params p = getParams(x,y);
+    func(out8, curr8(x,y), prev8(x,y), p.width);
+  }
+
+private:
+  func_t func;
+};
+
+
+class DSPFunc_InterleaveChroma_16 : public DSPFunc_Convert_Base
+{
+public:
+  typedef void (*func_t)(uint16_t* dst, const uint16_t* cb, const uint16_t* cr,
+                         int width, int shift);
+
+  DSPFunc_InterleaveChroma_16(const char* name, func_t f, DSPFunc* ref=NULL)
+    : DSPFunc_Convert_Base(name,ref), func(f) { }
+
+  virtual void runOnBlock(int x,int y) {
+    Params p = getParams(x,y);
+    func(out16, plane16(p,x,y,0), plane16(p,x,y,1), p.width, 16-p.bitDepth);
+  }
+
+private:
+  func_t func;
+};
+
+
+class DSPFunc_ShiftRow_16 : public DSPFunc_Convert_Base
+{
+public:
+  typedef void (*func_t)(uint16_t* dst, const uint16_t* src, int width, int shift);
+
+  DSPFunc_ShiftRow_16(const char* name, func_t f, DSPFunc* ref=NULL)
+    : DSPFunc_Convert_Base(name,ref), func(f) { }
+
+  virtual void runOnBlock(int x,int y) {
+    Params p = getParams(x,y);
+    func(out16, plane16(p,x,y,0), p.width, 16-p.bitDepth);
+  }
+
+private:
+  func_t func;
+};
+
+
+class DSPFunc_YUVToRGBA : public DSPFunc_Convert_Base
+{
+public:
+  typedef void (*func_t)(uint8_t* dst, const uint8_t* y,
+                         const uint8_t* cb, const uint8_t* cr, int width,
+                         const int16_t* matrix);
+
+  DSPFunc_YUVToRGBA(const char* name, func_t f, DSPFunc* ref=NULL)
+    : DSPFunc_Convert_Base(name,ref), func(f) { }
+
+  virtual void runOnBlock(int x,int y) {
+    Params p = getParams(x,y);
+    func(out8, curr8(x,y), prev8(x,y), prev8(x,y)+32, p.width, p.matrix);
+  }
+
+private:
+  func_t func;
+};
+
+
+extern DSPFunc_ReduceBitDepth      reduce_scalar;
+extern DSPFunc_InterleaveChroma_8  interleave_scalar_8;
+extern DSPFunc_InterleaveChroma_16 interleave_scalar_16;
+extern DSPFunc_ShiftRow_16         shift_scalar_16;
+extern DSPFunc_YUVToRGBA           rgba_scalar;
+
+#endif
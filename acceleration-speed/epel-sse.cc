@@ -0,0 +1,28 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2015 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "libde265/x86/sse-motion.h"
+#include "epel.h"
+
+
+DSPFunc_EPel_16 epel_sse_16("EPel-SSE-16", put_epel_16_sse4, false,false, &epel_scalar_16);
+DSPFunc_EPel_16 epel_h_sse_16("EPel-H-SSE-16", put_epel_h_16_sse4, true,false, &epel_h_scalar_16);
+DSPFunc_EPel_16 epel_v_sse_16("EPel-V-SSE-16", put_epel_v_16_sse4, false,true, &epel_v_scalar_16);
+DSPFunc_EPel_16 epel_hv_sse_16("EPel-HV-SSE-16", put_epel_hv_16_sse4, true,true, &epel_hv_scalar_16);
@@ -0,0 +1,131 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2015 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "epel.h"
+#include "libde265/fallback-motion.h"
+
+
+static const int bitDepths[3] = { 10,12,16 };
+
+
+DSPFunc_EPel_16::DSPFunc_EPel_16(const char* name, func_t f, bool fx, bool fy, DSPFunc* ref)
+{
+  funcName = name;
+  func = f;
+  fracX = fx;
+  fracY = fy;
+  refImpl = ref;
+  frameCnt = 0;
+  src[0] = src[1] = src[2] = NULL;
+  stride = 0;
+}
+
+
+DSPFunc_EPel_16::Params DSPFunc_EPel_16::getParams(int x,int y) const
+{
+  static const int widths[10] = { 2,4,6,8,12,16,24,32,48,64 };
+  static const int heights[4] = { 2,4,6,8 };
+
+  // some pseudo-random parameters that are the same for the reference implementation
+
+  unsigned int h = (x*31 + y*17 + frameCnt*7) * 2654435761u;
+
+  Params p;
+  p.width  = widths[(h>>4) % 10];
+  p.height = heights[(h>>8) % 4];
+  p.mx = (fracX ? 1 + (h>>11) % 7 : 0);
+  p.my = (fracY ? 1 + (h>>15) % 7 : 0);
+  p.bitDepthIdx = (h>>19) % 3;
+
+  return p;
+}
+
+
+void DSPFunc_EPel_16::runOnBlock(int x,int y)
+{
+  Params p = getParams(x,y);
+
+  const uint16_t* s = src[p.bitDepthIdx] + (x+Border) + (y+Border)*stride;
+
+  func(out,64, s,stride, p.width,p.height, p.mx,p.my, mcbuffer, bitDepths[p.bitDepthIdx]);
+}
+
+
+bool DSPFunc_EPel_16::compareToReferenceImplementation()
+{
+  DSPFunc_EPel_16* ref = dynamic_cast<DSPFunc_EPel_16*>(referenceImplementation());
+
+  return memcmp(out, ref->out, sizeof(out))==0;
+}
+
+
+bool DSPFunc_EPel_16::prepareNextImage(std::shared_ptr<const de265_image> img)
+{
+  if (!curr_image) {
+    curr_image = img;
+    return false;
+  }
+
+  prev_image = curr_image;
+  curr_image = img;
+  frameCnt++;
+
+  memset(out,0,sizeof(out));
+
+  int w = curr_image->get_width(0);
+  int h = curr_image->get_height(0);
+
+  if (src[0]==NULL) {
+    stride = w + 2*Border;
+    for (int i=0;i<3;i++) {
+      src[i] = new uint16_t[stride*(h+2*Border)];
+    }
+  }
+
+  int cstride = curr_image->get_luma_stride();
+  int pstride = prev_image->get_luma_stride();
+  const uint8_t* curr = curr_image->get_image_plane_at_pos(0,0,0);
+  const uint8_t* prev = prev_image->get_image_plane_at_pos(0,0,0);
+
+  // The previous frame fills the lower bits such that all sample bits are used.
+  // The border repeats the image edge samples.
+
+  for (int y=-Border;y<h+Border;y++)
+    for (int x=-Border;x<w+Border;x++) {
+      int xc = Clip3(0,w-1,x);
+      int yc = Clip3(0,h-1,y);
+
+      int c = curr[yc*cstride+xc];
+      int p = prev[yc*pstride+xc];
+
+      for (int i=0;i<3;i++) {
+        int bd = bitDepths[i];
+        src[i][(x+Border) + (y+Border)*stride] = (c<<(bd-8)) | (p>>(16-bd));
+      }
+    }
+
+  return true;
+}
+
+
+DSPFunc_EPel_16 epel_scalar_16("EPel-Scalar-16", put_epel_16_fallback, false,false);
+DSPFunc_EPel_16 epel_h_scalar_16("EPel-H-Scalar-16", put_epel_hv_fallback<uint16_t>, true,false);
+DSPFunc_EPel_16 epel_v_scalar_16("EPel-V-Scalar-16", put_epel_hv_fallback<uint16_t>, false,true);
+DSPFunc_EPel_16 epel_hv_scalar_16("EPel-HV-Scalar-16", put_epel_hv_fallback<uint16_t>, true,true);
@@ -0,0 +1,87 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2015 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACCELERATION_SPEED_EPEL_H
+#define ACCELERATION_SPEED_EPEL_H
+
+#include "acceleration-speed.h"
+
+
+/* Chroma sample interpolation for more than 8 bits per sample.
+   The input planes are built from the luma planes of two consecutive frames
+   with 10, 12 and 16 bits per sample. Block size, bit depth and the fractional
+   motion vector change from block to block.
+ */
+class DSPFunc_EPel_16 : public DSPFunc
+{
+public:
+  typedef void (*func_t)(int16_t *dst, ptrdiff_t dststride,
+                         const uint16_t *src, ptrdiff_t srcstride, int width, int height,
+                         int mx, int my, int16_t* mcbuffer, int bit_depth);
+
+  // 'fracX'/'fracY': whether the function interpolates horizontally/vertically
+  DSPFunc_EPel_16(const char* name, func_t f, bool fracX, bool fracY, DSPFunc* ref=NULL);
+
+  virtual const char* name() const { return funcName; }
+
+  virtual int getBlkWidth()  const { return 64; }
+  virtual int getBlkHeight() const { return 8; }
+
+  virtual DSPFunc* referenceImplementation() const { return refImpl; }
+
+  virtual void runOnBlock(int x,int y);
+
+  virtual bool compareToReferenceImplementation();
+  virtual bool prepareNextImage(std::shared_ptr<const de265_image> img);
+
+  struct Params {
+    int width, height;
+    int mx, my;
+    int bitDepthIdx;
+  };
+
+  Params getParams(int x,int y) const;
+
+private:
+  std::shared_ptr<const de265_image> prev_image;
+  std::shared_ptr<const de265_image> curr_image;
+
+  const char* funcName;
+  func_t func;
+  bool fracX, fracY;
+  DSPFunc* refImpl;
+  int frameCnt;
+
+  static const int Border = 4;
+
+  uint16_t* src[3];  // one plane per bit depth, with a border of 'Border' samples
+  int       stride;
+
+  int16_t  mcbuffer[64*(64+8)];
+  int16_t  out[64*8];
+};
+
+
+extern DSPFunc_EPel_16 epel_scalar_16;
+extern DSPFunc_EPel_16 epel_h_scalar_16;
+extern DSPFunc_EPel_16 epel_v_scalar_16;
+extern DSPFunc_EPel_16 epel_hv_scalar_16;
+
+#endif
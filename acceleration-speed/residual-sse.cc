@@ -0,0 +1,33 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2015 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "libde265/x86/sse-dct.h"
+#include "residual.h"
+
+
+DSPFunc_ResidualShift  tsresidual_sse("TransformSkipResidual-SSE", transform_skip_residual_sse4, &tsresidual_scalar);
+DSPFunc_ResidualShift  rdpcm_v_sse("RDPCM-V-SSE", rdpcm_v_sse4, &rdpcm_v_scalar);
+DSPFunc_ResidualShift  rdpcm_h_sse("RDPCM-H-SSE", rdpcm_h_sse4, &rdpcm_h_scalar);
+DSPFunc_ResidualBypass bypass_sse("TransformBypass-SSE", transform_bypass_sse4, &bypass_scalar);
+DSPFunc_ResidualBypass bypass_rdpcm_v_sse("TransformBypassRDPCM-V-SSE", transform_bypass_rdpcm_v_sse4, &bypass_rdpcm_v_scalar);
+DSPFunc_ResidualBypass bypass_rdpcm_h_sse("TransformBypassRDPCM-H-SSE", transform_bypass_rdpcm_h_sse4, &bypass_rdpcm_h_scalar);
+DSPFunc_CrossCompPred  crosscomp_sse("CrossCompPred-SSE", cross_comp_pred_sse4, &crosscomp_scalar);
+DSPFunc_AddResidual_8  addresidual_sse_8("AddResidual-SSE-8", add_residual_8_sse4, &addresidual_scalar_8);
+DSPFunc_AddResidual_16 addresidual_sse_16("AddResidual-SSE-16", add_residual_16_sse4, &addresidual_scalar_16);
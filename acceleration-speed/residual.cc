@@ -0,0 +1,147 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2015 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "residual.h"
+#include "libde265/fallback-dct.h"
+
+
+DSPFunc_Residual_Base::DSPFunc_Residual_Base(const char* name, DSPFunc* ref)
+{
+  funcName = name;
+  refImpl = ref;
+  frameCnt = 0;
+  coeffBlocks = NULL;
+  lumaResidualBlocks = NULL;
+  widthBlks = 0;
+}
+
+
+DSPFunc_Residual_Base::Params DSPFunc_Residual_Base::getParams(int x,int y) const
+{
+  static const int bitDepths[3] = { 8,10,12 };
+  static const int scales[9] = { -8,-4,-2,-1,0,1,2,4,8 };
+
+  // some pseudo-random parameters that are the same for the reference implementation
+
+  unsigned int h = (x*31 + y*17 + frameCnt*7) * 2654435761u;
+
+  Params p;
+
+  int log2nT = 2 + (h>>4) % 4;
+  p.nT = 1<<log2nT;
+
+  p.bitDepthC = bitDepths[(h>>8) % 3];
+  p.bitDepthY = ((h>>12) & 1) ? p.bitDepthC : bitDepths[(h>>14) % 3];
+
+  p.tsShift = 5 + log2nT;
+  p.bdShift = 20 - p.bitDepthC;
+
+  p.resScaleVal = scales[(h>>18) % 9];
+
+  return p;
+}
+
+
+bool DSPFunc_Residual_Base::compareToReferenceImplementation()
+{
+  DSPFunc_Residual_Base* ref = dynamic_cast<DSPFunc_Residual_Base*>(referenceImplementation());
+
+  return (memcmp(residual, ref->residual, sizeof(residual))==0 &&
+          memcmp(out8,     ref->out8,     sizeof(out8))==0 &&
+          memcmp(out16,    ref->out16,    sizeof(out16))==0);
+}
+
+
+void DSPFunc_Residual_Base::initPixels8(int x,int y, int nT)
+{
+  int stride = curr_image->get_luma_stride();
+  const uint8_t* curr = curr_image->get_image_plane_at_pos(0,x,y);
+
+  for (int r=0;r<nT;r++) {
+    memcpy(out8+r*32, curr+r*stride, nT);
+  }
+}
+
+
+void DSPFunc_Residual_Base::initPixels16(int x,int y, int nT, int bitDepth)
+{
+  int stride = curr_image->get_luma_stride();
+  const uint8_t* curr = curr_image->get_image_plane_at_pos(0,x,y);
+
+  for (int r=0;r<nT;r++)
+    for (int c=0;c<nT;c++) {
+      out16[r*32+c] = curr[r*stride+c] << (bitDepth-8);
+    }
+}
+
+
+bool DSPFunc_Residual_Base::prepareNextImage(std::shared_ptr<const de265_image> img)
+{
+  if (!curr_image) {
+    curr_image = img;
+    return false;
+  }
+
+  prev_image = curr_image;
+  curr_image = img;
+  frameCnt++;
+
+  memset(residual,0,sizeof(residual));
+  memset(out8,    0,sizeof(out8));
+  memset(out16,   0,sizeof(out16));
+
+  int w = curr_image->get_width(0)  & ~31;
+  int h = curr_image->get_height(0) & ~31;
+
+  if (coeffBlocks==NULL) {
+    widthBlks = w/32;
+    coeffBlocks        = new int16_t[w*h];
+    lumaResidualBlocks = new int32_t[w*h];
+  }
+
+  int cstride = curr_image->get_luma_stride();
+  int pstride = prev_image->get_luma_stride();
+  const uint8_t* curr = curr_image->get_image_plane_at_pos(0,0,0);
+  const uint8_t* prev = prev_image->get_image_plane_at_pos(0,0,0);
+
+  for (int y=0;y<h;y++)
+    for (int x=0;x<w;x++) {
+      int c = curr[y*cstride+x];
+      int p = prev[y*pstride+x];
+
+      int idx = blockOffset(x,y) + (x%32) + (y%32)*32;
+
+      coeffBlocks[idx]        = (c-p)*16 + (c&15) - 8;
+      lumaResidualBlocks[idx] = (c-p)*4 + (p&3);
+    }
+
+  return true;
+}
+
+
+DSPFunc_ResidualShift  tsresidual_scalar("TransformSkipResidual-Scalar", transform_skip_residual_fallback);
+DSPFunc_ResidualShift  rdpcm_v_scalar("RDPCM-V-Scalar", rdpcm_v_fallback);
+DSPFunc_ResidualShift  rdpcm_h_scalar("RDPCM-H-Scalar", rdpcm_h_fallback);
+DSPFunc_ResidualBypass bypass_scalar("TransformBypass-Scalar", transform_bypass_fallback);
+DSPFunc_ResidualBypass bypass_rdpcm_v_scalar("TransformBypassRDPCM-V-Scalar", transform_bypass_rdpcm_v_fallback);
+DSPFunc_ResidualBypass bypass_rdpcm_h_scalar("TransformBypassRDPCM-H-Scalar", transform_bypass_rdpcm_h_fallback);
+DSPFunc_CrossCompPred  crosscomp_scalar("CrossCompPred-Scalar", cross_comp_pred_fallback);
+DSPFunc_AddResidual_8  addresidual_scalar_8("AddResidual-Scalar-8", add_residual_fallback<uint8_t>);
+DSPFunc_AddResidual_16 addresidual_scalar_16("AddResidual-Scalar-16", add_residual_fallback<uint16_t>);
@@ -0,0 +1,194 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2015 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACCELERATION_SPEED_RESIDUAL_H
+#define ACCELERATION_SPEED_RESIDUAL_H
+
+#include "acceleration-speed.h"
+
+
+/* Residual tools of the range extensions (transform skip, transform bypass, RDPCM,
+   cross-component prediction) and adding the residual to the prediction.
+   The coefficients are derived from the luma difference of two consecutive frames.
+   Each 32x32 image block is coded as one TB whose size, bit depth and
+   cross-component scale change from block to block.
+ */
+class DSPFunc_Residual_Base : public DSPFunc
+{
+public:
+  DSPFunc_Residual_Base(const char* name, DSPFunc* ref);
+
+  virtual const char* name() const { return funcName; }
+
+  virtual int getBlkWidth()  const { return 32; }
+  virtual int getBlkHeight() const { return 32; }
+
+  virtual DSPFunc* referenceImplementation() const { return refImpl; }
+
+  virtual bool compareToReferenceImplementation();
+  virtual bool prepareNextImage(std::shared_ptr<const de265_image> img);
+
+  struct Params {
+    int nT;
+    int tsShift, bdShift;
+    int bitDepthY, bitDepthC;
+    int resScaleVal;
+  };
+
+  Params getParams(int x,int y) const;
+
+private:
+  std::shared_ptr<const de265_image> prev_image;
+  std::shared_ptr<const de265_image> curr_image;
+
+  const char* funcName;
+  DSPFunc* refImpl;
+  int frameCnt;
+
+  // coefficients and luma residual, stored as one contiguous 32x32 block per image block
+  int16_t* coeffBlocks;
+  int32_t* lumaResidualBlocks;
+
+protected:
+  const int16_t* getCoeffs(int x,int y) const { return coeffBlocks + blockOffset(x,y); }
+  const int32_t* getLumaResidual(int x,int y) const { return lumaResidualBlocks + blockOffset(x,y); }
+  int blockOffset(int x,int y) const { return (x/32 + (y/32)*widthBlks) * 32*32; }
+
+  void initPixels8 (int x,int y, int nT);
+  void initPixels16(int x,int y, int nT, int bitDepth);
+
+  int widthBlks;
+
+  int32_t  residual[32*32];
+  uint8_t  out8[32*32];
+  uint16_t out16[32*32];
+};
+
+
+class DSPFunc_ResidualShift : public DSPFunc_Residual_Base
+{
+public:
+  typedef void (*func_t)(int32_t* residual, const int16_t* coeffs, int nT,
+                         int tsShift,int bdShift);
+
+  DSPFunc_ResidualShift(const char* name, func_t f, DSPFunc* ref=NULL)
+    : DSPFunc_Residual_Base(name,ref), func(f) { }
+
+  virtual void runOnBlock(int x,int y) {
+    Params p = getParams(x,y);
+    func(residual, getCoeffs(x,y), p.nT, p.tsShift, p.bdShift);
+  }
+
+private:
+  func_t func;
+};
+
+
+class DSPFunc_ResidualBypass : public DSPFunc_Residual_Base
+{
+public:
+  typedef void (*func_t)(int32_t* residual, const int16_t* coeffs, int nT);
+
+  DSPFunc_ResidualBypass(const char* name, func_t f, DSPFunc* ref=NULL)
+    : DSPFunc_Residual_Base(name,ref), func(f) { }
+
+  virtual void runOnBlock(int x,int y) {
+    Params p = getParams(x,y);
+    func(residual, getCoeffs(x,y), p.nT);
+  }
+
+private:
+  func_t func;
+};
+
+
+class DSPFunc_CrossCompPred : public DSPFunc_Residual_Base
+{
+public:
+  typedef void (*func_t)(int32_t* residual, const int32_t* residual_luma, int nT,
+                         int resScaleVal, int bitDepthC, int bitDepthY);
+
+  DSPFunc_CrossCompPred(const char* name, func_t f, DSPFunc* ref=NULL)
+    : DSPFunc_Residual_Base(name,ref), func(f) { }
+
+  virtual void runOnBlock(int x,int y) {
+    Params p = getParams(x,y);
+    const int16_t* coeffs = getCoeffs(x,y);
+    for (int i=0;i<p.nT*p.nT;i++) { residual[i] = coeffs[i]; }
+
+    func(residual, getLumaResidual(x,y), p.nT, p.resScaleVal, p.bitDepthC, p.bitDepthY);
+  }
+
+private:
+  func_t func;
+};
+
+
+class DSPFunc_AddResidual_8 : public DSPFunc_Residual_Base
+{
+public:
+  typedef void (*func_t)(uint8_t *dst, ptrdiff_t stride,
+                         const int32_t* r, int nT, int bit_depth);
+
+  DSPFunc_AddResidual_8(const char* name, func_t f, DSPFunc* ref=NULL)
+    : DSPFunc_Residual_Base(name,ref), func(f) { }
+
+  virtual void runOnBlock(int x,int y) {
+    Params p = getParams(x,y);
+    initPixels8(x,y, p.nT);
+    func(out8,32, getLumaResidual(x,y), p.nT, 8);
+  }
+
+private:
+  func_t func;
+};
+
+
+class DSPFunc_AddResidual_16 : public DSPFunc_Residual_Base
+{
+public:
+  typedef void (*func_t)(uint16_t *dst, ptrdiff_t stride,
+                         const int32_t* r, int nT, int bit_depth);
+
+  DSPFunc_AddResidual_16(const char* name, func_t f, DSPFunc* ref=NULL)
+    : DSPFunc_Residual_Base(name,ref), func(f) { }
+
+  virtual void runOnBlock(int x,int y) {
+    Params p = getParams(x,y);
+    initPixels16(x,y, p.nT, p.bitDepthC);
+    func(out16,32, getLumaResidual(x,y), p.nT, p.bitDepthC);
+  }
+
+private:
+  func_t func;
+};
+
+
+extern DSPFunc_ResidualShift  tsresidual_scalar;
+extern DSPFunc_ResidualShift  rdpcm_v_scalar;
+extern DSPFunc_ResidualShift  rdpcm_h_scalar;
+extern DSPFunc_ResidualBypass bypass_scalar;
+extern DSPFunc_ResidualBypass bypass_rdpcm_v_scalar;
+extern DSPFunc_ResidualBypass bypass_rdpcm_h_scalar;
+extern DSPFunc_CrossCompPred  crosscomp_scalar;
+extern DSPFunc_AddResidual_8  addresidual_scalar_8;
+extern DSPFunc_AddResidual_16 addresidual_scalar_16;
+
+#endif
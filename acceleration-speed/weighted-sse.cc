@@ -0,0 +1,40 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2015 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "libde265/x86/sse-motion.h"
+#include "libde265/x86/avx2-motion.h"
+#include "weighted.h"
+
+
+DSPFunc_WeightedPred_8     wp_sse_8("WeightedPred-SSE-8", put_weighted_pred_8_sse4, &wp_scalar_8);
+DSPFunc_WeightedBiPred_8   wpbi_sse_8("WeightedBiPred-SSE-8", put_weighted_bipred_8_sse4, &wpbi_scalar_8);
+DSPFunc_UnweightedPred_16  unweighted_sse_16("UnweightedPred-SSE-16", put_unweighted_pred_16_sse4, &unweighted_scalar_16);
+DSPFunc_WeightedPredAvg_16 avg_sse_16("WeightedPredAvg-SSE-16", put_weighted_pred_avg_16_sse4, &avg_scalar_16);
+DSPFunc_WeightedPred_16    wp_sse_16("WeightedPred-SSE-16", put_weighted_pred_16_sse4, &wp_scalar_16);
+DSPFunc_WeightedBiPred_16  wpbi_sse_16("WeightedBiPred-SSE-16", put_weighted_bipred_16_sse4, &wpbi_scalar_16);
+
+#if HAVE_AVX2
+DSPFunc_WeightedPred_8     wp_avx2_8("WeightedPred-AVX2-8", put_weighted_pred_8_avx2, &wp_scalar_8);
+DSPFunc_WeightedBiPred_8   wpbi_avx2_8("WeightedBiPred-AVX2-8", put_weighted_bipred_8_avx2, &wpbi_scalar_8);
+DSPFunc_UnweightedPred_16  unweighted_avx2_16("UnweightedPred-AVX2-16", put_unweighted_pred_16_avx2, &unweighted_scalar_16);
+DSPFunc_WeightedPredAvg_16 avg_avx2_16("WeightedPredAvg-AVX2-16", put_weighted_pred_avg_16_avx2, &avg_scalar_16);
+DSPFunc_WeightedPred_16    wp_avx2_16("WeightedPred-AVX2-16", put_weighted_pred_16_avx2, &wp_scalar_16);
+DSPFunc_WeightedBiPred_16  wpbi_avx2_16("WeightedBiPred-AVX2-16", put_weighted_bipred_16_avx2, &wpbi_scalar_16);
+#endif
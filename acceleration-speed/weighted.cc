@@ -0,0 +1,116 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2015 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "weighted.h"
+#include "libde265/fallback-motion.h"
+
+
+DSPFunc_WeightedPred_Base::DSPFunc_WeightedPred_Base(const char* name, int bd, DSPFunc* ref)
+{
+  funcName = name;
+  refImpl = ref;
+  bitDepth = bd;
+  frameCnt = 0;
+  src1 = src2 = NULL;
+  stride = 0;
+}
+
+
+DSPFunc_WeightedPred_Base::Params DSPFunc_WeightedPred_Base::getParams(int x,int y) const
+{
+  static const int widths[10] = { 2,4,6,8,12,16,24,32,48,64 };
+
+  // some pseudo-random parameters that are the same for the reference implementation
+
+  unsigned int h = (x*31 + y*17 + frameCnt*7) * 2654435761u;
+
+  Params p;
+  p.width = widths[(h>>4) % 10];
+
+  int denom = (h>>8) % 8;
+  p.log2WD = denom + 14 - bitDepth;
+  p.w1 = (1<<denom) + (int)((h>>11) % 256) - 128;
+  p.w2 = (1<<denom) + (int)((h>>19) % 256) - 128;
+  p.o1 = ((int)((h>>3)  % 256) - 128) << (bitDepth-8);
+  p.o2 = ((int)((h>>13) % 256) - 128) << (bitDepth-8);
+
+  return p;
+}
+
+
+bool DSPFunc_WeightedPred_Base::compareToReferenceImplementation()
+{
+  DSPFunc_WeightedPred_Base* ref = dynamic_cast<DSPFunc_WeightedPred_Base*>(referenceImplementation());
+
+  return (memcmp(out8,  ref->out8,  sizeof(out8))==0 &&
+          memcmp(out16, ref->out16, sizeof(out16))==0);
+}
+
+
+bool DSPFunc_WeightedPred_Base::prepareNextImage(std::shared_ptr<const de265_image> img)
+{
+  if (!curr_image) {
+    curr_image = img;
+    return false;
+  }
+
+  prev_image = curr_image;
+  curr_image = img;
+  frameCnt++;
+
+  memset(out8, 0,sizeof(out8));
+  memset(out16,0,sizeof(out16));
+
+  int w = curr_image->get_width(0);
+  int h = curr_image->get_height(0);
+
+  if (src1==NULL) {
+    stride = w;
+    src1 = new int16_t[stride*h];
+    src2 = new int16_t[stride*h];
+  }
+
+  int cstride = curr_image->get_luma_stride();
+  int pstride = prev_image->get_luma_stride();
+  const uint8_t* curr = curr_image->get_image_plane_at_pos(0,0,0);
+  const uint8_t* prev = prev_image->get_image_plane_at_pos(0,0,0);
+
+  // Intermediate prediction values have 14 bits precision. Add the frame difference
+  // to simulate the over- and undershoots of the interpolation filters.
+
+  for (int y=0;y<h;y++)
+    for (int x=0;x<w;x++) {
+      int c = curr[y*cstride+x];
+      int p = prev[y*pstride+x];
+
+      src1[y*stride+x] = (c<<6) + (c-p)*8;
+      src2[y*stride+x] = (p<<6) + (p-c)*8;
+    }
+
+  return true;
+}
+
+
+DSPFunc_WeightedPred_8     wp_scalar_8("WeightedPred-Scalar-8", put_weighted_pred_8_fallback);
+DSPFunc_WeightedBiPred_8   wpbi_scalar_8("WeightedBiPred-Scalar-8", put_weighted_bipred_8_fallback);
+DSPFunc_UnweightedPred_16  unweighted_scalar_16("UnweightedPred-Scalar-16", put_unweighted_pred_16_fallback);
+DSPFunc_WeightedPredAvg_16 avg_scalar_16("WeightedPredAvg-Scalar-16", put_weighted_pred_avg_16_fallback);
+DSPFunc_WeightedPred_16    wp_scalar_16("WeightedPred-Scalar-16", put_weighted_pred_16_fallback);
+DSPFunc_WeightedBiPred_16  wpbi_scalar_16("WeightedBiPred-Scalar-16", put_weighted_bipred_16_fallback);
@@ -0,0 +1,209 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2015 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACCELERATION_SPEED_WEIGHTED_H
+#define ACCELERATION_SPEED_WEIGHTED_H
+
+#include "acceleration-speed.h"
+
+
+/* Weighted sample prediction. The input are two 14 bit intermediate prediction
+   signals derived from the luma planes of two consecutive frames.
+   The block width changes from block to block such that all partial-vector
+   code paths are exercised. Weights and offsets change as well.
+ */
+class DSPFunc_WeightedPred_Base : public DSPFunc
+{
+public:
+  DSPFunc_WeightedPred_Base(const char* name, int bitDepth, DSPFunc* ref);
+
+  virtual const char* name() const { return funcName; }
+
+  virtual int getBlkWidth()  const { return 64; }
+  virtual int getBlkHeight() const { return 8; }
+
+  virtual DSPFunc* referenceImplementation() const { return refImpl; }
+
+  virtual bool compareToReferenceImplementation();
+  virtual bool prepareNextImage(std::shared_ptr<const de265_image> img);
+
+  struct Params {
+    int width;
+    int w1,o1, w2,o2;
+    int log2WD;
+  };
+
+  Params getParams(int x,int y) const;
+
+private:
+  std::shared_ptr<const de265_image> prev_image;
+  std::shared_ptr<const de265_image> curr_image;
+
+  const char* funcName;
+  DSPFunc* refImpl;
+  int frameCnt;
+
+protected:
+  int bitDepth;
+
+  int16_t* src1;
+  int16_t* src2;
+  int      stride;
+
+  uint8_t  out8[64*8];
+  uint16_t out16[64*8];
+};
+
+
+class DSPFunc_WeightedPred_8 : public DSPFunc_WeightedPred_Base
+{
+public:
+  typedef void (*func_t)(uint8_t *dst, ptrdiff_t dststride,
+                         const int16_t *src, ptrdiff_t srcstride,
+                         int width, int height,
+                         int w,int o,int log2WD);
+
+  DSPFunc_WeightedPred_8(const char* name, func_t f, DSPFunc* ref=NULL)
+    : DSPFunc_WeightedPred_Base(name,8,ref), func(f) { }
+
+  virtual void runOnBlock(int x,int y) {
+    Params p = getParams(x,y);
+    func(out8,64, src1+x+y*stride,stride, p.width,8, p.w1,p.o1,p.log2WD);
+  }
+
+private:
+  func_t func;
+};
+
+
+class DSPFunc_WeightedBiPred_8 : public DSPFunc_WeightedPred_Base
+{
+public:
+  typedef void (*func_t)(uint8_t *dst, ptrdiff_t dststride,
+                         const int16_t *src1, const int16_t *src2, ptrdiff_t srcstride,
+                         int width, int height,
+                         int w1,int o1, int w2,int o2, int log2WD);
+
+  DSPFunc_WeightedBiPred_8(const char* name, func_t f, DSPFunc* ref=NULL)
+    : DSPFunc_WeightedPred_Base(name,8,ref), func(f) { }
+
+  virtual void runOnBlock(int x,int y) {
+    Params p = getParams(x,y);
+    func(out8,64, src1+x+y*stride,src2+x+y*stride,stride, p.width,8,
+         p.w1,p.o1,p.w2,p.o2,p.log2WD);
+  }
+
+private:
+  func_t func;
+};
+
+
+class DSPFunc_UnweightedPred_16 : public DSPFunc_WeightedPred_Base
+{
+public:
+  typedef void (*func_t)(uint16_t *dst, ptrdiff_t dststride,
+                         const int16_t *src, ptrdiff_t srcstride,
+                         int width, int height, int bit_depth);
+
+  DSPFunc_UnweightedPred_16(const char* name, func_t f, DSPFunc* ref=NULL)
+    : DSPFunc_WeightedPred_Base(name,10,ref), func(f) { }
+
+  virtual void runOnBlock(int x,int y) {
+    Params p = getParams(x,y);
+    func(out16,64, src1+x+y*stride,stride, p.width,8, bitDepth);
+  }
+
+private:
+  func_t func;
+};
+
+
+class DSPFunc_WeightedPredAvg_16 : public DSPFunc_WeightedPred_Base
+{
+public:
+  typedef void (*func_t)(uint16_t *dst, ptrdiff_t dststride,
+                         const int16_t *src1, const int16_t *src2,
+                         ptrdiff_t srcstride, int width,
+                         int height, int bit_depth);
+
+  DSPFunc_WeightedPredAvg_16(const char* name, func_t f, DSPFunc* ref=NULL)
+    : DSPFunc_WeightedPred_Base(name,10,ref), func(f) { }
+
+  virtual void runOnBlock(int x,int y) {
+    Params p = getParams(x,y);
+    func(out16,64, src1+x+y*stride,src2+x+y*stride,stride, p.width,8, bitDepth);
+  }
+
+private:
+  func_t func;
+};
+
+
+class DSPFunc_WeightedPred_16 : public DSPFunc_WeightedPred_Base
+{
+public:
+  typedef void (*func_t)(uint16_t *dst, ptrdiff_t dststride,
+                         const int16_t *src, ptrdiff_t srcstride,
+                         int width, int height,
+                         int w,int o,int log2WD, int bit_depth);
+
+  DSPFunc_WeightedPred_16(const char* name, func_t f, DSPFunc* ref=NULL)
+    : DSPFunc_WeightedPred_Base(name,10,ref), func(f) { }
+
+  virtual void runOnBlock(int x,int y) {
+    Params p = getParams(x,y);
+    func(out16,64, src1+x+y*stride,stride, p.width,8, p.w1,p.o1,p.log2WD, bitDepth);
+  }
+
+private:
+  func_t func;
+};
+
+
+class DSPFunc_WeightedBiPred_16 : public DSPFunc_WeightedPred_Base
+{
+public:
+  typedef void (*func_t)(uint16_t *dst, ptrdiff_t dststride,
+                         const int16_t *src1, const int16_t *src2, ptrdiff_t srcstride,
+                         int width, int height,
+                         int w1,int o1, int w2,int o2, int log2WD, int bit_depth);
+
+  DSPFunc_WeightedBiPred_16(const char* name, func_t f, DSPFunc* ref=NULL)
+    : DSPFunc_WeightedPred_Base(name,10,ref), func(f) { }
+
+  virtual void runOnBlock(int x,int y) {
+    Params p = getParams(x,y);
+    func(out16,64, src1+x+y*stride,src2+x+y*stride,stride, p.width,8,
+         p.w1,p.o1,p.w2,p.o2,p.log2WD, bitDepth);
+  }
+
+private:
+  func_t func;
+};
+
+
+extern DSPFunc_WeightedPred_8     wp_scalar_8;
+extern DSPFunc_WeightedBiPred_8   wpbi_scalar_8;
+extern DSPFunc_UnweightedPred_16  unweighted_scalar_16;
+extern DSPFunc_WeightedPredAvg_16 avg_scalar_16;
+extern DSPFunc_WeightedPred_16    wp_scalar_16;
+extern DSPFunc_WeightedBiPred_16  wpbi_scalar_16;
+
+#endif
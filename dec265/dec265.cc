@@ -32,7 +32,9 @@
 #endif
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <limits>
+#include <vector>
 #include <getopt.h>
 #ifdef HAVE_MALLOC_H
 #include <malloc.h>
@@ -55,6 +57,8 @@ using namespace videogfx;
 #include "sdl.hh"
 #endif
 
+#include "yuvwriter.hh"
+
 
 #define BUFFER_SIZE 40960
 #define NUM_THREADS 4
@@ -70,6 +74,8 @@ bool output_with_videogfx=false;
 bool logging=true;
 bool no_acceleration=false;
 const char *output_filename = "out.yuv";
+YUVWriter::Mode output_mode = YUVWriter::Mode_Buffered;
+int output_queue_length = 4;
 uint32_t max_frames=UINT32_MAX;
 bool write_bytestream=false;
 const char *bytestream_filename;
@@ -83,6 +89,11 @@ int verbosity=0;
 int disable_deblocking=0;
 int disable_sao=0;
 
+enum {
+  OPTION_OUTPUT_MODE = 1000,
+  OPTION_OUTPUT_QUEUE
+};
+
 static struct option long_options[] = {
   {"quiet",      no_argument,       0, 'q' },
   {"threads",    required_argument, 0, 't' },
@@ -90,6 +101,8 @@ static struct option long_options[] = {
   {"profile",    no_argument,       0, 'p' },
   {"frames",     required_argument, 0, 'f' },
   {"output",     required_argument, 0, 'o' },
+  {"output-mode", required_argument, 0, OPTION_OUTPUT_MODE },
+  {"output-queue", required_argument, 0, OPTION_OUTPUT_QUEUE },
   {"dump",       no_argument,       0, 'd' },
   {"nal",        no_argument,       0, 'n' },
   {"videogfx",   no_argument,       0, 'V' },
@@ -109,52 +122,7 @@ static struct option long_options[] = {
 
 
 
-static void write_picture(const de265_image* img)
-{
-  static FILE* fh = NULL;
-  if (fh==NULL) { fh = fopen(output_filename, "wb"); }
-
-
-
-  for (int c=0;c<3;c++) {
-    int stride;
-    const uint8_t* p = de265_get_image_plane(img, c, &stride);
-
-    int width = de265_get_image_width(img,c);
-
-    if (de265_get_bits_per_pixel(img,c)<=8) {
-      // --- save 8 bit YUV ---
-
-      for (int y=0;y<de265_get_image_height(img,c);y++) {
-        fwrite(p + y*stride, width, 1, fh);
-      }
-    }
-    else {
-      // --- save 16 bit YUV ---
-
-      int bpp = (de265_get_bits_per_pixel(img,c)+7)/8;
-      int pixelsPerLine = stride/bpp;
-
-      uint8_t* buf = new uint8_t[width*2];
-      uint16_t* p16 = (uint16_t*)p;
-
-      for (int y=0;y<de265_get_image_height(img,c);y++) {
-        for (int x=0;x<width;x++) {
-          uint16_t pixel_value = (p16+y*pixelsPerLine)[x];
-          buf[2*x+0] = pixel_value & 0xFF;
-          buf[2*x+1] = pixel_value >> 8;
-        }
-
-        fwrite(buf, width*2, 1, fh);
-      }
-
-      delete[] buf;
-    }
-  }
-
-  fflush(fh);
-}
-
+static YUVWriter yuv_writer;
 
 
 #if HAVE_VIDEOGFX
@@ -227,21 +195,6 @@ void display_image(const struct de265_image* img)
 }
 #endif
 
-static uint8_t* convert_to_8bit(const uint8_t* data, int width, int height,
-                                int pixelsPerLine, int bit_depth)
-{
-  const uint16_t* data16 = (const uint16_t*)data;
-  uint8_t* out = new uint8_t[pixelsPerLine*height];
-
-  for (int y=0;y<height;y++) {
-    for (int x=0;x<width;x++) {
-      out[y*pixelsPerLine + x] = *(data16 + y*pixelsPerLine +x) >> (bit_depth-8);
-    }
-  }
-
-  return out;
-}
-
 
 #if HAVE_SDL
 SDL_YUV_Display sdlWin;
@@ -275,34 +228,31 @@ bool display_sdl(const struct de265_image* img)
   const uint8_t* cb =de265_get_image_plane(img,1,&chroma_stride);
   const uint8_t* cr =de265_get_image_plane(img,2,NULL);
 
-  int bpp_y = (de265_get_bits_per_pixel(img,0)+7)/8;
-  int bpp_c = (de265_get_bits_per_pixel(img,1)+7)/8;
-  int ppl_y = stride/bpp_y;
-  int ppl_c = chroma_stride/bpp_c;
+  // reduce samples with more than 8 bits for display
 
-  uint8_t* y16  = NULL;
-  uint8_t* cb16 = NULL;
-  uint8_t* cr16 = NULL;
-  int bd;
+  std::vector<uint8_t> image8;
 
-  if ((bd=de265_get_bits_per_pixel(img, 0)) > 8) {
-    y16  = convert_to_8bit(y,  width,height,ppl_y,bd); y=y16;
-  }
+  if (de265_get_bits_per_pixel(img,0) > 8 ||
+      (chroma != de265_chroma_mono && (de265_get_bits_per_pixel(img,1) > 8 ||
+                                       de265_get_bits_per_pixel(img,2) > 8))) {
+    int size_y = width*height;
+    int size_c = chroma_width*chroma_height;
 
-  if (chroma != de265_chroma_mono) {
-    if ((bd=de265_get_bits_per_pixel(img, 1)) > 8) {
-      cb16 = convert_to_8bit(cb, chroma_width,chroma_height,ppl_c,bd); cb=cb16;
-    }
-    if ((bd=de265_get_bits_per_pixel(img, 2)) > 8) {
-      cr16 = convert_to_8bit(cr, chroma_width,chroma_height,ppl_c,bd); cr=cr16;
-    }
-  }
+    image8.resize(size_y + 2*size_c);
 
-  sdlWin.display(y,cb,cr, ppl_y, ppl_c);
+    uint8_t* planes[3] = { image8.data(), image8.data()+size_y, image8.data()+size_y+size_c };
+    int strides[3] = { width, chroma_width, chroma_width };
 
-  delete[] y16;
-  delete[] cb16;
-  delete[] cr16;
+    de265_convert_image(img, de265_output_format_planar_8, planes, strides);
+
+    y  = planes[0];
+    cb = planes[1];
+    cr = planes[2];
+    stride = width;
+    chroma_stride = chroma_width;
+  }
+
+  sdlWin.display(y,cb,cr, stride, chroma_stride);
 
   return sdlWin.doQuit();
 }
@@ -347,7 +297,7 @@ bool output_image(const de265_image* img)
 #endif
   }
   if (write_yuv) {
-    write_picture(img);
+    yuv_writer.write(img);
   }
 
   if ((framecnt%100)==0) {
@@ -585,6 +535,16 @@ int main(int argc, char** argv)
     case 'e': show_psnr_map=true; break;
     case 'T': highestTID=atoi(optarg); break;
     case 'v': verbosity++; break;
+    case OPTION_OUTPUT_MODE:
+      if      (strcmp(optarg,"buffered")==0) output_mode = YUVWriter::Mode_Buffered;
+      else if (strcmp(optarg,"direct")==0)   output_mode = YUVWriter::Mode_Direct;
+      else if (strcmp(optarg,"mmap")==0)     output_mode = YUVWriter::Mode_MMap;
+      else {
+        fprintf(stderr,"unknown output mode: %s\n", optarg);
+        show_help=true;
+      }
+      break;
+    case OPTION_OUTPUT_QUEUE: output_queue_length=atoi(optarg); break;
     }
   }
 
@@ -601,6 +561,8 @@ int main(int argc, char** argv)
     fprintf(stderr,"  -n, --nal         input is a stream with 4-byte length prefixed NAL units\n");
     fprintf(stderr,"  -f, --frames N    set number of frames to process\n");
     fprintf(stderr,"  -o, --output      write YUV reconstruction\n");
+    fprintf(stderr,"      --output-mode MODE     buffered (default), direct (O_DIRECT) or mmap\n");
+    fprintf(stderr,"      --output-queue N       number of frames queued for writing (default: 4)\n");
     fprintf(stderr,"  -d, --dump        dump headers\n");
 #if HAVE_VIDEOGFX && HAVE_SDL
     fprintf(stderr,"  -V, --videogfx    output with videogfx instead of SDL\n");
@@ -671,6 +633,13 @@ int main(int argc, char** argv)
     exit(10);
   }
 
+  if (write_yuv) {
+    if (!yuv_writer.open(output_filename, output_mode, output_queue_length)) {
+      fprintf(stderr,"cannot open output file %s!\n", output_filename);
+      exit(10);
+    }
+  }
+
   FILE* bytestream_fh = NULL;
 
   if (write_bytestream) {
@@ -804,6 +773,11 @@ int main(int argc, char** argv)
 
   de265_free_decoder(ctx);
 
+  bool output_error = false;
+  if (write_yuv) {
+    output_error = !yuv_writer.close();
+  }
+
   struct timeval tv_end;
   gettimeofday(&tv_end, NULL);
 
@@ -818,5 +792,5 @@ int main(int argc, char** argv)
                         width,height,framecnt/secs);
 
 
-  return err==DE265_OK ? 0 : 10;
+  return (err==DE265_OK && !output_error) ? 0 : 10;
 }
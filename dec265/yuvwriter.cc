@@ -0,0 +1,490 @@
+/*
+  This file is part of dec265, an example application using libde265.
+
+  MIT License
+
+  Copyright (c) 2013-2014 struktur AG, Dirk Farin <farin@struktur.de>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+ */
+
+#include "yuvwriter.hh"
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+
+// O_DIRECT requires the buffer address, the transfer size and the file offset to be
+// multiples of the logical block size. 4096 covers all common devices.
+static const size_t DIRECT_ALIGNMENT = 4096;
+
+
+YUVWriter::YUVWriter()
+  : mOpen(false),
+    mMode(Mode_Buffered),
+    mNumFrames(0),
+    mMaxFrames(0),
+    mClosing(false),
+    mFailed(false),
+    mOffset(0)
+{
+#ifdef _WIN32
+  mFile = NULL;
+#else
+  mFd = -1;
+  mDirectBuf = NULL;
+  mDirectFill = 0;
+  mDirectCapacity = 0;
+  mFileSize = 0;
+#endif
+}
+
+
+YUVWriter::~YUVWriter()
+{
+  close();
+}
+
+
+bool YUVWriter::open(const char* filename, Mode mode, int queue_length)
+{
+  mMode = mode;
+  mMaxFrames = (queue_length < 1 ? 1 : queue_length);
+  mOffset = 0;
+  mFailed = false;
+  mClosing = false;
+
+#ifdef _WIN32
+  if (mode != Mode_Buffered) {
+    fprintf(stderr,"direct and mmap output are not supported on this platform, using buffered output\n");
+    mMode = Mode_Buffered;
+  }
+
+  mFile = fopen(filename, "wb");
+  if (mFile==NULL) {
+    return false;
+  }
+#else
+  int flags = O_WRONLY | O_CREAT | O_TRUNC;
+  if (mode == Mode_MMap) {
+    flags = O_RDWR | O_CREAT | O_TRUNC;  // MAP_SHARED needs a readable descriptor
+  }
+
+  if (mode == Mode_Direct) {
+#ifdef O_DIRECT
+    mFd = ::open(filename, flags | O_DIRECT, 0644);
+    if (mFd<0 && errno==EINVAL) {
+      fprintf(stderr,"file system does not support O_DIRECT, using buffered output\n");
+    }
+#else
+    fprintf(stderr,"O_DIRECT is not supported on this platform, using buffered output\n");
+#endif
+  }
+
+  if (mFd<0) {
+    mFd = ::open(filename, flags, 0644);
+  }
+
+  if (mFd<0) {
+    return false;
+  }
+
+  mFileSize = 0;
+#endif
+
+  mThread = std::thread(&YUVWriter::writerMain, this);
+  mOpen = true;
+
+  return true;
+}
+
+
+void YUVWriter::write(const de265_image* img)
+{
+  Frame* frame;
+
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    while (mFreeFrames.empty() && mNumFrames >= mMaxFrames) {
+      mFrameFree.wait(lock);
+    }
+
+    if (!mFreeFrames.empty()) {
+      frame = mFreeFrames.back();
+      mFreeFrames.pop_back();
+    }
+    else {
+      frame = new Frame;
+      mNumFrames++;
+    }
+  }
+
+  pack(frame, img);
+
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mQueue.push_back(frame);
+  }
+
+  mFrameQueued.notify_one();
+}
+
+
+bool YUVWriter::close()
+{
+  if (!mOpen) {
+    return true;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mClosing = true;
+  }
+
+  mFrameQueued.notify_one();
+  mThread.join();
+
+  // the writer thread has returned all frames to the free list
+
+  for (size_t i=0;i<mFreeFrames.size();i++) {
+    delete mFreeFrames[i];
+  }
+  mFreeFrames.clear();
+  mNumFrames = 0;
+
+#ifdef _WIN32
+  if (fclose(mFile) != 0) { mFailed = true; }
+  mFile = NULL;
+#else
+  if (::close(mFd) != 0) { mFailed = true; }
+  mFd = -1;
+
+  free(mDirectBuf);
+  mDirectBuf = NULL;
+  mDirectFill = 0;
+  mDirectCapacity = 0;
+#endif
+
+  mOpen = false;
+
+  return !mFailed;
+}
+
+
+void YUVWriter::pack(Frame* frame, const de265_image* img)
+{
+  size_t size = 0;
+  for (int c=0;c<3;c++) {
+    int bytesPerPixel = (de265_get_bits_per_pixel(img,c)<=8 ? 1 : 2);
+    size += (size_t)de265_get_image_width(img,c) * de265_get_image_height(img,c) * bytesPerPixel;
+  }
+
+  if (frame->data.size() < size) {
+    frame->data.resize(size);
+  }
+  frame->size = size;
+
+  // planes with more than 8 bits are written as 16 bit little endian samples
+
+  uint8_t* planes[3];
+  int strides[3];
+
+  uint8_t* out = frame->data.data();
+
+  for (int c=0;c<3;c++) {
+    int bytesPerPixel = (de265_get_bits_per_pixel(img,c)<=8 ? 1 : 2);
+
+    planes[c]  = out;
+    strides[c] = de265_get_image_width(img,c) * bytesPerPixel;
+
+    out += (size_t)strides[c] * de265_get_image_height(img,c);
+  }
+
+  de265_convert_image(img, de265_output_format_planar, planes, strides);
+}
+
+
+void YUVWriter::writerMain()
+{
+  for (;;) {
+    Frame* frame;
+
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+
+      while (mQueue.empty() && !mClosing) {
+        mFrameQueued.wait(lock);
+      }
+
+      if (mQueue.empty()) {
+        break;
+      }
+
+      frame = mQueue.front();
+      mQueue.pop_front();
+    }
+
+    if (!mFailed && !store(frame->data.data(), frame->size)) {
+      fprintf(stderr,"error writing output file: %s\n", strerror(errno));
+      mFailed = true;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mFreeFrames.push_back(frame);
+    }
+
+    mFrameFree.notify_one();
+  }
+
+  if (!mFailed && !finish()) {
+    fprintf(stderr,"error writing output file: %s\n", strerror(errno));
+    mFailed = true;
+  }
+}
+
+
+bool YUVWriter::store(const uint8_t* data, size_t size)
+{
+#ifdef _WIN32
+  if (size && fwrite(data, size, 1, mFile) != 1) {
+    return false;
+  }
+
+  mOffset += size;
+  return true;
+#else
+  switch (mMode) {
+  case Mode_Direct:
+    return storeDirect(data, size);
+
+  case Mode_MMap:
+    return storeMMap(data, size);
+
+  default:
+    if (!writeAll(data, size, mOffset)) {
+      return false;
+    }
+
+    mOffset += size;
+    return true;
+  }
+#endif
+}
+
+
+bool YUVWriter::finish()
+{
+#ifdef _WIN32
+  return true;
+#else
+  if (mMode == Mode_Direct && mDirectFill > 0) {
+    // write the remaining partial block zero-padded, then cut the file back to its real size
+
+    size_t padded = (mDirectFill + DIRECT_ALIGNMENT-1) & ~(DIRECT_ALIGNMENT-1);
+    memset(mDirectBuf + mDirectFill, 0, padded - mDirectFill);
+
+    if (!writeAll(mDirectBuf, padded, mOffset)) {
+      return false;
+    }
+
+    mOffset += mDirectFill;
+    mDirectFill = 0;
+  }
+
+  if (mMode != Mode_Buffered) {
+    if (ftruncate(mFd, mOffset) != 0) {
+      return false;
+    }
+  }
+
+  return true;
+#endif
+}
+
+
+#ifndef _WIN32
+bool YUVWriter::writeAll(const uint8_t* data, size_t size, uint64_t offset)
+{
+  while (size > 0) {
+    ssize_t n = pwrite(mFd, data, size, offset);
+
+    if (n<0) {
+      int err = errno;
+      if (err==EINTR) {
+        continue;
+      }
+
+#ifdef O_DIRECT
+      // Some file systems accept O_DIRECT in open() but reject the actual transfer.
+      // Continue without it. The blocks we write stay aligned, so nothing else changes.
+
+      int flags = fcntl(mFd, F_GETFL);
+      if (err==EINVAL && flags>=0 && (flags & O_DIRECT)) {
+        if (fcntl(mFd, F_SETFL, flags & ~O_DIRECT) == 0) {
+          continue;
+        }
+      }
+#endif
+
+      errno = err;
+      return false;
+    }
+
+    data   += n;
+    size   -= n;
+    offset += n;
+  }
+
+  return true;
+}
+
+
+bool YUVWriter::storeDirect(const uint8_t* data, size_t size)
+{
+  // Append the frame to the staging buffer and write out all complete blocks.
+  // The incomplete last block is kept and written together with the next frame.
+
+  size_t total = mDirectFill + size;
+
+  if (total + DIRECT_ALIGNMENT > mDirectCapacity) {
+    size_t capacity = (total + 2*DIRECT_ALIGNMENT-1) & ~(DIRECT_ALIGNMENT-1);
+
+    void* buf;
+    if (posix_memalign(&buf, DIRECT_ALIGNMENT, capacity) != 0) {
+      errno = ENOMEM;
+      return false;
+    }
+
+    if (mDirectFill) {
+      memcpy(buf, mDirectBuf, mDirectFill);
+    }
+
+    free(mDirectBuf);
+    mDirectBuf = (uint8_t*)buf;
+    mDirectCapacity = capacity;
+  }
+
+  memcpy(mDirectBuf + mDirectFill, data, size);
+
+  size_t n = total & ~(DIRECT_ALIGNMENT-1);
+  if (n) {
+    if (!writeAll(mDirectBuf, n, mOffset)) {
+      return false;
+    }
+
+    mOffset += n;
+    memmove(mDirectBuf, mDirectBuf + n, total - n);
+  }
+
+  mDirectFill = total - n;
+
+  return true;
+}
+
+
+bool YUVWriter::allocate(uint64_t offset, uint64_t size)
+{
+  // Reserve real disk blocks for the range. A sparse extension (ftruncate) would make
+  // the page faults in storeMMap() allocate the blocks one by one, and a full disk
+  // would only show up as SIGBUS when writing to the mapping.
+
+#ifdef HAVE_POSIX_FALLOCATE
+  int err = posix_fallocate(mFd, offset, size);
+  if (err==0) {
+    return true;
+  }
+
+  if (err!=EINVAL && err!=EOPNOTSUPP) {
+    errno = err;
+    return false;
+  }
+#endif
+
+  // not supported by the file system: write zeros instead
+
+  static const uint8_t zeros[64*1024] = { 0 };
+
+  while (size > 0) {
+    size_t n = (size < sizeof(zeros) ? size : sizeof(zeros));
+
+    if (!writeAll(zeros, n, offset)) {
+      return false;
+    }
+
+    offset += n;
+    size   -= n;
+  }
+
+  return true;
+}
+
+
+bool YUVWriter::storeMMap(const uint8_t* data, size_t size)
+{
+  if (size==0) {
+    return true;
+  }
+
+  uint64_t end = mOffset + size;
+
+  // extend the file in large steps, it is cut back to its real size in finish()
+
+  if (end > mFileSize) {
+    uint64_t newSize = mFileSize + 16*(uint64_t)size;
+    if (newSize < end) { newSize = end; }
+
+    if (!allocate(mFileSize, newSize - mFileSize)) {
+      return false;
+    }
+
+    mFileSize = newSize;
+  }
+
+  uint64_t pageSize = sysconf(_SC_PAGESIZE);
+  uint64_t mapStart = mOffset & ~(pageSize-1);
+  size_t   mapSize  = end - mapStart;
+
+  void* mem = mmap(NULL, mapSize, PROT_WRITE, MAP_SHARED, mFd, mapStart);
+  if (mem == MAP_FAILED) {
+    return false;
+  }
+
+  memcpy((uint8_t*)mem + (mOffset - mapStart), data, size);
+
+  // the kernel writes the dirty pages back asynchronously
+  munmap(mem, mapSize);
+
+  mOffset = end;
+
+  return true;
+}
+#endif
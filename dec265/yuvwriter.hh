@@ -0,0 +1,121 @@
+/*
+  This file is part of dec265, an example application using libde265.
+
+  MIT License
+
+  Copyright (c) 2013-2014 struktur AG, Dirk Farin <farin@struktur.de>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+ */
+
+#ifndef DEC265_YUVWRITER_HH
+#define DEC265_YUVWRITER_HH
+
+#include "libde265/de265.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+
+/* Writes the decoded pictures to a raw YUV file from a separate thread.
+
+   write() packs the cropped picture into one contiguous frame buffer and queues it.
+   The writer thread stores each frame with a single write call, so that disk I/O
+   overlaps with decoding. At most 'queue_length' frames are in flight; write() blocks
+   when all of them are still waiting to be written.
+ */
+class YUVWriter
+{
+public:
+  enum Mode {
+    Mode_Buffered, // pwrite() through the page cache
+    Mode_Direct,   // O_DIRECT, bypassing the page cache
+    Mode_MMap      // copy into a shared mapping of the output file
+  };
+
+  YUVWriter();
+  ~YUVWriter();
+
+  bool open(const char* filename, Mode mode, int queue_length);
+  void write(const de265_image* img);
+
+  // Writes all queued frames and closes the file. Returns false if an I/O error occurred.
+  bool close();
+
+  bool isOpen() const { return mOpen; }
+
+private:
+  struct Frame {
+    std::vector<uint8_t> data;
+    size_t size;
+  };
+
+  bool mOpen;
+  Mode mMode;
+
+  // --- queue, shared with the writer thread ---
+
+  std::thread mThread;
+  std::mutex  mMutex;
+  std::condition_variable mFrameQueued;
+  std::condition_variable mFrameFree;
+
+  std::deque<Frame*>  mQueue;
+  std::vector<Frame*> mFreeFrames;
+  int  mNumFrames;
+  int  mMaxFrames;
+  bool mClosing;
+
+  // --- output file, only accessed by the writer thread ---
+
+  bool     mFailed;
+  uint64_t mOffset;
+
+#ifdef _WIN32
+  FILE* mFile;
+#else
+  int mFd;
+
+  uint8_t* mDirectBuf;  // aligned staging buffer for O_DIRECT
+  size_t   mDirectFill;
+  size_t   mDirectCapacity;
+
+  uint64_t mFileSize;   // size the file was extended to for mmap output
+#endif
+
+  static void pack(Frame* frame, const de265_image* img);
+
+  void writerMain();
+  bool store(const uint8_t* data, size_t size);
+  bool finish();
+
+#ifndef _WIN32
+  bool writeAll(const uint8_t* data, size_t size, uint64_t offset);
+  bool storeDirect(const uint8_t* data, size_t size);
+  bool storeMMap(const uint8_t* data, size_t size);
+  bool allocate(uint64_t offset, uint64_t size);
+#endif
+};
+
+#endif
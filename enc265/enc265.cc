@@ -348,6 +348,24 @@ int main(int argc, char** argv)
     }
 
 
+  // flush images still queued in the encoder (e.g. in the lookahead)
+
+  if (!eof) {
+    en265_push_eof(ectx);
+    en265_encode(ectx);
+
+    for (;;) {
+      en265_packet* pck = en265_get_packet(ectx,0);
+      if (pck==NULL)
+        break;
+
+      packet_sink.send_packet(pck->data, pck->length);
+
+      en265_free_packet(ectx,pck);
+    }
+  }
+
+
   // --- print statistics ---
 
   en265_print_logging((encoder_context*)ectx, "tb-split", NULL);
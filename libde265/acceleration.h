@@ -151,12 +151,19 @@ struct acceleration_functions
   void (*transform_skip_rdpcm_h_8)(uint8_t *_dst, const int16_t *coeffs, int nT, ptrdiff_t _stride);
   void (*transform_4x4_dst_add_8)(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride); // iDST
   void (*transform_add_8[4])(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride); // iDCT
+  void (*transform_dc_add_8[4])(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride); // iDCT, DC only
+
+  /* iDCT when all non-zero coefficients are within the top-left 4x4 [0] or 8x8 [1] block.
+     Entries that do not restrict the block size are the full transform_add_8 functions. */
+  void (*transform_sparse_add_8[4][2])(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride);
 
   // 9-16 bit
 
   void (*transform_skip_16)(uint16_t *_dst, const int16_t *coeffs, ptrdiff_t _stride, int bit_depth); // no transform
   void (*transform_4x4_dst_add_16)(uint16_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth); // iDST
   void (*transform_add_16[4])(uint16_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth); // iDCT
+  void (*transform_dc_add_16[4])(uint16_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth); // iDCT, DC only
+  void (*transform_sparse_add_16[4][2])(uint16_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth);
 
 
   void (*rotate_coefficients)(int16_t *coeff, int nT);
@@ -178,12 +185,18 @@ struct acceleration_functions
   void (*transform_skip_residual)(int32_t *residual, const int16_t *coeffs, int nT,
                                   int tsShift,int bdShift);
 
+  // cross-component prediction of the chroma residual from the luma residual (7.3.8.12)
+  void (*cross_comp_pred)(int32_t* residual, const int32_t* residual_luma, int nT,
+                          int resScaleVal, int bitDepthC, int bitDepthY);
+
 
   template <class pixel_t> void transform_skip(pixel_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth) const;
   template <class pixel_t> void transform_skip_rdpcm_v(pixel_t *dst, const int16_t *coeffs, int nT, ptrdiff_t stride, int bit_depth) const;
   template <class pixel_t> void transform_skip_rdpcm_h(pixel_t *dst, const int16_t *coeffs, int nT, ptrdiff_t stride, int bit_depth) const;
   template <class pixel_t> void transform_4x4_dst_add(pixel_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth) const;
   template <class pixel_t> void transform_add(int sizeIdx, pixel_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth) const;
+  template <class pixel_t> void transform_dc_add(int sizeIdx, pixel_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth) const;
+  template <class pixel_t> void transform_sparse_add(int sizeIdx, int extentIdx, pixel_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth) const;
 
 
 
@@ -195,9 +208,50 @@ struct acceleration_functions
   void (*fwd_transform_8[4])     (int16_t *coeffs, const int16_t *src, ptrdiff_t stride); // fDCT
 
 
+  // Scalar quantization: level = (|coeff| * scale + offset) >> shift, with the sign of coeff.
+  // Returns the number of non-zero levels.
+  int (*quant_coefficients)(int16_t* out_coeff, const int16_t* in_coeff, int nCoeff,
+                            int scale, int offset, int shift);
+
+
   // forward Hadamard transform (without scaling factor)
   // (4x4,8x8,16x16,32x32) indexed with (log2TbSize-2)
   void (*hadamard_transform_8[4])     (int16_t *coeffs, const int16_t *src, ptrdiff_t stride);
+
+
+  // --- distortion measures ---
+
+  uint32_t (*sad_8)(const uint8_t* img, ptrdiff_t imgStride,
+                    const uint8_t* ref, ptrdiff_t refStride, int width, int height);
+  uint32_t (*ssd_8)(const uint8_t* img, ptrdiff_t imgStride,
+                    const uint8_t* ref, ptrdiff_t refStride, int width, int height);
+
+  // sum of absolute Hadamard-transformed differences (without scaling factor)
+  // (4x4,8x8) indexed with (log2BlkSize-2)
+  uint32_t (*satd_8[2])(const uint8_t* img, ptrdiff_t imgStride,
+                        const uint8_t* ref, ptrdiff_t refStride);
+
+  // SATD of a larger block, computed from 8x8 sub-blocks (4x4 for 4x4 blocks)
+  uint32_t satd_8_block(const uint8_t* img, ptrdiff_t imgStride,
+                        const uint8_t* ref, ptrdiff_t refStride, int log2BlkSize) const;
+
+
+  // --- output format conversion (de265_convert_image) ---
+
+  // dst[x] = min(255, (src[x] + dither[x%8]) >> (bit_depth-8))
+  void (*reduce_bit_depth_row)(uint8_t* dst, const uint16_t* src, int width, int bit_depth,
+                               const uint16_t* dither);
+
+  // dst[2x] = cb[x], dst[2x+1] = cr[x]  (for the 16 bit version, samples are shifted left)
+  void (*interleave_chroma_row_8)(uint8_t* dst, const uint8_t* cb, const uint8_t* cr, int width);
+  void (*interleave_chroma_row_16)(uint16_t* dst, const uint16_t* cb, const uint16_t* cr,
+                                   int width, int shift);
+
+  void (*shift_row_16)(uint16_t* dst, const uint16_t* src, int width, int shift);
+
+  // YCbCr with horizontally subsampled chroma to RGBA, see fallback-convert.h for 'matrix'
+  void (*yuv_to_rgba_row)(uint8_t* dst, const uint8_t* y, const uint8_t* cb, const uint8_t* cr,
+                          int width, const int16_t* matrix);
 };
 
 
@@ -353,7 +407,33 @@ template <> inline void acceleration_functions::transform_4x4_dst_add<uint16_t>(
 template <> inline void acceleration_functions::transform_add<uint8_t>(int sizeIdx, uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth) const { transform_add_8[sizeIdx](dst,coeffs,stride); }
 template <> inline void acceleration_functions::transform_add<uint16_t>(int sizeIdx, uint16_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth) const { transform_add_16[sizeIdx](dst,coeffs,stride,bit_depth); }
 
+template <> inline void acceleration_functions::transform_dc_add<uint8_t>(int sizeIdx, uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth) const { transform_dc_add_8[sizeIdx](dst,coeffs,stride); }
+template <> inline void acceleration_functions::transform_dc_add<uint16_t>(int sizeIdx, uint16_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth) const { transform_dc_add_16[sizeIdx](dst,coeffs,stride,bit_depth); }
+
+template <> inline void acceleration_functions::transform_sparse_add<uint8_t>(int sizeIdx, int extentIdx, uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth) const { transform_sparse_add_8[sizeIdx][extentIdx](dst,coeffs,stride); }
+template <> inline void acceleration_functions::transform_sparse_add<uint16_t>(int sizeIdx, int extentIdx, uint16_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth) const { transform_sparse_add_16[sizeIdx][extentIdx](dst,coeffs,stride,bit_depth); }
+
 template <> inline void acceleration_functions::add_residual(uint8_t *dst,  ptrdiff_t stride, const int32_t* r, int nT, int bit_depth) const { add_residual_8(dst,stride,r,nT,bit_depth); }
 template <> inline void acceleration_functions::add_residual(uint16_t *dst, ptrdiff_t stride, const int32_t* r, int nT, int bit_depth) const { add_residual_16(dst,stride,r,nT,bit_depth); }
 
+inline uint32_t acceleration_functions::satd_8_block(const uint8_t* img, ptrdiff_t imgStride,
+                                                     const uint8_t* ref, ptrdiff_t refStride,
+                                                     int log2BlkSize) const
+{
+  if (log2BlkSize==2) {
+    return satd_8[0](img,imgStride, ref,refStride);
+  }
+
+  int blkSize = 1<<log2BlkSize;
+  uint32_t sum=0;
+
+  for (int y=0;y<blkSize;y+=8)
+    for (int x=0;x<blkSize;x+=8) {
+      sum += satd_8[1](img + x + y*imgStride, imgStride,
+                       ref + x + y*refStride, refStride);
+    }
+
+  return sum;
+}
+
 #endif
@@ -37,6 +37,9 @@ alloc_pool::alloc_pool(size_t objSize, int poolSize, bool grow)
   m_memBlocks.reserve(8);
 
   add_memory_block();
+
+  mCurrentBlock = 0;
+  mNextInBlock  = 0;
 }
 
 
@@ -44,11 +47,6 @@ void alloc_pool::add_memory_block()
 {
   uint8_t* p = new uint8_t[mObjSize * mPoolSize];
   m_memBlocks.push_back(p);
-
-  for (int i=0;i<mPoolSize;i++)
-    {
-      m_freeList.push_back(p + (mPoolSize-1-i) * mObjSize);
-    }
 }
 
 alloc_pool::~alloc_pool()
@@ -65,35 +63,45 @@ void* alloc_pool::new_obj(const size_t size)
     return ::operator new(size);
   }
 
-  if (m_freeList.size()==0) {
-    if (mGrow) {
+  if (!m_freeList.empty()) {
+    void* p = m_freeList.back();
+    m_freeList.pop_back();
+    return p;
+  }
+
+  if (mNextInBlock == mPoolSize) {
+    if (mCurrentBlock+1 == m_memBlocks.size()) {
+      if (!mGrow) {
+        return NULL;
+      }
+
       add_memory_block();
       if (DEBUG_MEMORY) { fprintf(stderr,"additional block allocated in memory pool\n"); }
     }
-    else {
-      return NULL;
-    }
+
+    mCurrentBlock++;
+    mNextInBlock = 0;
   }
 
-  assert(!m_freeList.empty());
+  return m_memBlocks[mCurrentBlock] + mObjSize * mNextInBlock++;
+}
+
 
-  void* p = m_freeList.back();
-  m_freeList.pop_back();
+void  alloc_pool::delete_obj(void* obj, const size_t size)
+{
+  if (size != mObjSize) {
+    ::operator delete(obj);
+    return;
+  }
 
-  return p;
+  m_freeList.push_back(obj);
 }
 
 
-void  alloc_pool::delete_obj(void* obj)
+void alloc_pool::reset()
 {
-  int memBlockSize = mObjSize * mPoolSize;
-
-  FOR_LOOP(uint8_t*, memBlk, m_memBlocks) {
-    if (memBlk <= obj && obj < memBlk + memBlockSize) {
-      m_freeList.push_back(obj);
-      return;
-    }
-  }
+  m_freeList.clear();
 
-  ::operator delete(obj);
+  mCurrentBlock = 0;
+  mNextInBlock  = 0;
 }
@@ -37,6 +37,10 @@
 #endif
 
 
+/* Memory pool for objects of a fixed size. Objects are taken from the free-list
+   or, when that is empty, bump-allocated from the memory blocks. The pool is not
+   thread-safe. Objects of other sizes are passed through to the global new/delete.
+ */
 class alloc_pool
 {
  public:
@@ -44,8 +48,11 @@ class alloc_pool
   ~alloc_pool();
 
   void* new_obj(const size_t size);
-  void  delete_obj(void*);
-  void  purge();
+  void  delete_obj(void*, const size_t size);
+
+  /* Release all objects at once. The memory blocks are kept for reuse.
+     No object of this pool may be accessed anymore after this. */
+  void  reset();
 
  private:
   size_t mObjSize;
@@ -55,6 +62,9 @@ class alloc_pool
   std::vector<uint8_t*> m_memBlocks;
   std::vector<void*>    m_freeList;
 
+  size_t mCurrentBlock;  // block that we are currently bump-allocating from
+  int    mNextInBlock;   // index of the next unused object in that block
+
   void add_memory_block();
 };
 
@@ -938,28 +938,32 @@ const uint32_t entropy_table_theory[128] =
   };
 
 
-void CABAC_encoder_estim::write_CABAC_bit(int modelIdx, int bit)
-{
-  context_model* model = &(*mCtxModels)[modelIdx];
-  //printf("[%d] state=%d, bin=%d\n", encBinCnt, model->state,bit);
-  //encBinCnt++;
-
-  int idx = model->state<<1;
+static CABAC_estim_transition estim_table[64*4];
 
-  if (bit==model->MPSbit) {
-    model->state = next_state_MPS[model->state];
-  }
-  else {
-    idx++;
-    if (model->state==0) { model->MPSbit = 1-model->MPSbit; }
-    model->state = next_state_LPS[model->state];
-  }
+static const CABAC_estim_transition* fill_estim_table()
+{
+  for (int state=0;state<64;state++)
+    for (int MPSbit=0;MPSbit<2;MPSbit++)
+      for (int bit=0;bit<2;bit++) {
+        CABAC_estim_transition& t = estim_table[(state<<2) | (MPSbit<<1) | bit];
 
-  mFracBits += entropy_table[idx];
+        if (bit==MPSbit) {
+          t.fracBits   = entropy_table[state<<1];
+          t.nextState  = next_state_MPS[state];
+          t.nextMPSbit = MPSbit;
+        }
+        else {
+          t.fracBits   = entropy_table[(state<<1)+1];
+          t.nextState  = next_state_LPS[state];
+          t.nextMPSbit = (state==0 ? 1-MPSbit : MPSbit);
+        }
+      }
 
-  //printf("-> %08lx %f\n",entropy_table[idx], entropy_table[idx] / float(1<<15));
+  return estim_table;
 }
 
+const CABAC_estim_transition* const CABAC_estim_table = fill_estim_table();
+
 
 float CABAC_encoder::RDBits_for_CABAC_bin(int modelIdx, int bit)
 {
@@ -992,20 +996,6 @@ void CABAC_encoder::write_CABAC_EGk(int val, int k)
 
 
 
-void CABAC_encoder_estim_constant::write_CABAC_bit(int modelIdx, int bit)
-{
-  context_model* model = &(*mCtxModels)[modelIdx];
-  int idx = model->state<<1;
-
-  if (bit!=model->MPSbit) {
-    idx++;
-  }
-
-  mFracBits += entropy_table[idx];
-}
-
-
-
 #if 0
 void printtab(int idx,int s)
 {
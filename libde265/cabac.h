@@ -162,10 +162,23 @@ private:
 };
 
 
+/* Rate and context-state transition for coding one bin. The table is indexed with
+   (state<<2) | (MPSbit<<1) | bin and covers all 64 states of both MPS values.
+ */
+struct CABAC_estim_transition
+{
+  uint32_t fracBits;  // cost of the bin in 1/(1<<15) bits
+  uint8_t  nextState;
+  uint8_t  nextMPSbit;
+};
+
+extern const CABAC_estim_transition* const CABAC_estim_table;
+
+
 class CABAC_encoder_estim : public CABAC_encoder
 {
 public:
-  CABAC_encoder_estim() : mFracBits(0) { }
+  CABAC_encoder_estim() : mFracBits(0), mModifyContext(true) { }
 
   virtual void reset() { mFracBits=0; }
 
@@ -184,28 +197,48 @@ public:
 
   // --- CABAC ---
 
-  virtual void write_CABAC_bit(int modelIdx, int bit);
+  virtual void write_CABAC_bit(int modelIdx, int bit) { estim_CABAC_bit(modelIdx,bit); }
   virtual void write_CABAC_bypass(int bit) {
     mFracBits += 0x8000;
   }
+  virtual void write_CABAC_TU_bypass(int value, int cMax) {
+    estim_CABAC_bypass_bits(value + (value<cMax));
+  }
   virtual void write_CABAC_FL_bypass(int value, int nBits) {
     mFracBits += nBits<<15;
   }
   virtual void write_CABAC_term_bit(int bit) { /* not implemented (not needed) */ }
 
-  virtual bool modifies_context() const { return true; }
+  virtual bool modifies_context() const { return mModifyContext; }
+
+
+  /* Non-virtual versions of the above for code that knows statically that it
+     only estimates the rate (see encode_transform_unit() for CABAC_encoder_estim).
+   */
+  inline void estim_CABAC_bit(int modelIdx, int bit) {
+    context_model& model = (*mCtxModels)[modelIdx];
+    const CABAC_estim_transition& t = CABAC_estim_table[(model.state<<2) | (model.MPSbit<<1) | bit];
+
+    mFracBits += t.fracBits;
+
+    if (mModifyContext) {
+      model.state  = t.nextState;
+      model.MPSbit = t.nextMPSbit;
+    }
+  }
+
+  inline void estim_CABAC_bypass_bits(int nBits) { mFracBits += nBits<<15; }
 
  protected:
   uint64_t mFracBits;
+  bool     mModifyContext;
 };
 
 
 class CABAC_encoder_estim_constant : public CABAC_encoder_estim
 {
  public:
-  void write_CABAC_bit(int modelIdx, int bit);
-
-  virtual bool modifies_context() const { return false; }
+  CABAC_encoder_estim_constant() { mModifyContext=false; }
 };
 
 #endif
@@ -20,6 +20,7 @@
 
 #include "slice.h"
 #include <assert.h>
+#include <string.h>
 #include <iomanip>
 #include <sstream>
 
@@ -298,9 +299,9 @@ static void init_context_const(int SliceQPY,
   set_initValue(SliceQPY, model, initValue, len);
 }
 
-void initialize_CABAC_models(context_model context_model_table[CONTEXT_MODEL_TABLE_LENGTH],
-                      int initType,
-                      int QPY)
+static void compute_CABAC_models(context_model context_model_table[CONTEXT_MODEL_TABLE_LENGTH],
+                                 int initType,
+                                 int QPY)
 {
   context_model* cm = context_model_table; // just an abbreviation
 
@@ -345,3 +346,38 @@ void initialize_CABAC_models(context_model context_model_table[CONTEXT_MODEL_TAB
   init_context_const(QPY, cm+CONTEXT_MODEL_CU_CHROMA_QP_OFFSET_FLAG, 154, 1);
   init_context_const(QPY, cm+CONTEXT_MODEL_CU_CHROMA_QP_OFFSET_IDX,  154, 1);
 }
+
+
+/* The initialized context models only depend on initType and on the slice QP
+   (clipped to 0..51 in set_initValue()). We compute all 3x52 tables once, on first
+   use, such that a slice start or a WPP row start only has to copy the table.
+   Contexts that are not used for an initType (the inter contexts for I slices)
+   are zero in the cache.
+ */
+struct CABAC_init_cache
+{
+  CABAC_init_cache() {
+    memset(tables, 0, sizeof(tables));
+
+    for (int initType=0;initType<3;initType++)
+      for (int QPY=0;QPY<52;QPY++) {
+        compute_CABAC_models(tables[initType][QPY], initType, QPY);
+      }
+  }
+
+  context_model tables[3][52][CONTEXT_MODEL_TABLE_LENGTH];
+};
+
+
+void initialize_CABAC_models(context_model context_model_table[CONTEXT_MODEL_TABLE_LENGTH],
+                             int initType,
+                             int QPY)
+{
+  // thread-safe initialization on first call (C++11 static local variable)
+  static const CABAC_init_cache cache;
+
+  assert(initType>=0 && initType<3);
+
+  memcpy(context_model_table, cache.tables[initType][Clip3(0,51,QPY)],
+         sizeof(context_model)*CONTEXT_MODEL_TABLE_LENGTH);
+}
@@ -26,6 +26,8 @@
 #include "util.h"
 #include "scan.h"
 #include "image.h"
+#include "image-convert.h"
+#include "fallback.h"
 #include "sei.h"
 
 #include <assert.h>
@@ -102,6 +104,8 @@ LIBDE265_API const char* de265_get_error_text(de265_error err)
     return "premature end of slice data";
   case DE265_ERROR_UNSPECIFIED_DECODING_ERROR:
     return "unspecified decoding error";
+  case DE265_ERROR_INVALID_PARAMETER:
+    return "invalid function parameter";
 
   case DE265_WARNING_NO_WPP_CANNOT_USE_MULTITHREADING:
     return "Cannot run decoder multi-threaded because stream does not support WPP";
@@ -238,6 +242,7 @@ LIBDE265_API de265_error de265_free_decoder(de265_decoder_context* de265ctx)
 {
   decoder_context* ctx = (decoder_context*)de265ctx;
 
+  ctx->stop_async_decoding();
   ctx->stop_thread_pool();
 
   delete ctx;
@@ -267,6 +272,67 @@ LIBDE265_API de265_error de265_start_worker_threads(de265_decoder_context* de265
 }
 
 
+LIBDE265_API de265_thread_pool* de265_new_thread_pool(int number_of_threads)
+{
+  if (number_of_threads > MAX_THREADS) {
+    number_of_threads = MAX_THREADS;
+  }
+
+  if (number_of_threads <= 0) {
+    return NULL;
+  }
+
+  thread_pool* pool = new thread_pool;
+
+  de265_error err = start_thread_pool(pool, number_of_threads);
+  if (!de265_isOK(err)) {
+    stop_thread_pool(pool);
+    delete pool;
+    return NULL;
+  }
+
+  return (de265_thread_pool*)pool;
+}
+
+
+LIBDE265_API de265_error de265_free_thread_pool(de265_thread_pool* de265pool)
+{
+  thread_pool* pool = (thread_pool*)de265pool;
+
+  // if decoders are still attached, the last one to detach frees the pool
+
+  if (release_thread_pool(pool)) {
+    stop_thread_pool(pool);
+    delete pool;
+  }
+
+  return DE265_OK;
+}
+
+
+LIBDE265_API de265_error de265_attach_thread_pool(de265_decoder_context* de265ctx,
+                                                  de265_thread_pool* de265pool)
+{
+  decoder_context* ctx = (decoder_context*)de265ctx;
+  thread_pool* pool = (thread_pool*)de265pool;
+
+  if (pool==NULL) {
+    ctx->stop_thread_pool();
+    return DE265_OK;
+  }
+
+  return ctx->attach_thread_pool(pool);
+}
+
+
+LIBDE265_API void de265_set_thread_pool_priority(de265_decoder_context* de265ctx, int priority)
+{
+  decoder_context* ctx = (decoder_context*)de265ctx;
+
+  ctx->set_thread_pool_priority(priority);
+}
+
+
 #ifndef LIBDE265_DISABLE_DEPRECATED
 LIBDE265_API de265_error de265_decode_data(de265_decoder_context* de265ctx,
                                            const void* data8, int len)
@@ -311,6 +377,20 @@ static void dumpdata(const void* data, int len)
 }
 
 
+static void push_async_input(decoder_context* ctx, async_input::input_type type,
+                             const uint8_t* data=NULL, int len=0,
+                             de265_PTS pts=0, void* user_data=NULL)
+{
+  async_input* input = new async_input;
+  input->type = type;
+  input->data.assign(data, data+len);
+  input->pts = pts;
+  input->user_data = user_data;
+
+  ctx->push_async_input(input);
+}
+
+
 LIBDE265_API de265_error de265_push_data(de265_decoder_context* de265ctx,
                                          const void* data8, int len,
                                          de265_PTS pts, void* user_data)
@@ -321,6 +401,11 @@ LIBDE265_API de265_error de265_push_data(de265_decoder_context* de265ctx,
   //printf("push data (size %d)\n",len);
   //dumpdata(data8,16);
 
+  if (ctx->is_async_decoding()) {
+    push_async_input(ctx, async_input::Data, data,len,pts,user_data);
+    return DE265_OK;
+  }
+
   return ctx->nal_parser.push_data(data,len,pts,user_data);
 }
 
@@ -335,6 +420,11 @@ LIBDE265_API de265_error de265_push_NAL(de265_decoder_context* de265ctx,
   //printf("push NAL (size %d)\n",len);
   //dumpdata(data8,16);
 
+  if (ctx->is_async_decoding()) {
+    push_async_input(ctx, async_input::NAL, data,len,pts,user_data);
+    return DE265_OK;
+  }
+
   return ctx->nal_parser.push_NAL(data,len,pts,user_data);
 }
 
@@ -343,6 +433,12 @@ LIBDE265_API de265_error de265_decode(de265_decoder_context* de265ctx, int* more
 {
   decoder_context* ctx = (decoder_context*)de265ctx;
 
+  if (ctx->is_async_decoding()) {
+    // decoding is driven by the dispatcher thread
+    if (more) { *more=0; }
+    return DE265_OK;
+  }
+
   return ctx->decode(more);
 }
 
@@ -351,25 +447,41 @@ LIBDE265_API void        de265_push_end_of_NAL(de265_decoder_context* de265ctx)
 {
   decoder_context* ctx = (decoder_context*)de265ctx;
 
+  if (ctx->is_async_decoding()) {
+    push_async_input(ctx, async_input::EndOfNAL);
+    return;
+  }
+
   ctx->nal_parser.flush_data();
 }
 
 
 LIBDE265_API void        de265_push_end_of_frame(de265_decoder_context* de265ctx)
 {
+  decoder_context* ctx = (decoder_context*)de265ctx;
+
+  if (ctx->is_async_decoding()) {
+    push_async_input(ctx, async_input::EndOfFrame);
+    return;
+  }
+
   de265_push_end_of_NAL(de265ctx);
 
-  decoder_context* ctx = (decoder_context*)de265ctx;
   ctx->nal_parser.mark_end_of_frame();
 }
 
 
 LIBDE265_API de265_error de265_flush_data(de265_decoder_context* de265ctx)
 {
-  de265_push_end_of_NAL(de265ctx);
-
   decoder_context* ctx = (decoder_context*)de265ctx;
 
+  if (ctx->is_async_decoding()) {
+    push_async_input(ctx, async_input::EndOfStream);
+    return DE265_OK;
+  }
+
+  de265_push_end_of_NAL(de265ctx);
+
   ctx->nal_parser.flush_data();
   ctx->nal_parser.mark_end_of_stream();
 
@@ -383,6 +495,11 @@ LIBDE265_API void de265_reset(de265_decoder_context* de265ctx)
 
   //printf("--- reset ---\n");
 
+  if (ctx->is_async_decoding()) {
+    push_async_input(ctx, async_input::Reset);
+    return;
+  }
+
   ctx->reset();
 }
 
@@ -402,6 +519,10 @@ LIBDE265_API const struct de265_image* de265_peek_next_picture(de265_decoder_con
 {
   decoder_context* ctx = (decoder_context*)de265ctx;
 
+  if (ctx->is_async_decoding()) {
+    return NULL; // pictures are delivered through the callback
+  }
+
   if (ctx->num_pictures_in_output_queue()>0) {
     de265_image* img = ctx->get_next_picture_in_output_queue();
     return img;
@@ -416,6 +537,10 @@ LIBDE265_API void de265_release_next_picture(de265_decoder_context* de265ctx)
 {
   decoder_context* ctx = (decoder_context*)de265ctx;
 
+  if (ctx->is_async_decoding()) {
+    return;
+  }
+
   // no active output picture -> ignore release request
 
   if (ctx->num_pictures_in_output_queue()==0) { return; }
@@ -587,6 +712,10 @@ LIBDE265_API int de265_get_number_of_input_bytes_pending(de265_decoder_context*
 {
   decoder_context* ctx = (decoder_context*)de265ctx;
 
+  if (ctx->is_async_decoding()) {
+    return ctx->num_async_input_bytes_pending();
+  }
+
   return ctx->nal_parser.bytes_in_input_queue();
 }
 
@@ -595,6 +724,10 @@ LIBDE265_API int de265_get_number_of_NAL_units_pending(de265_decoder_context* de
 {
   decoder_context* ctx = (decoder_context*)de265ctx;
 
+  if (ctx->is_async_decoding()) {
+    return ctx->num_async_inputs_pending();
+  }
+
   return ctx->nal_parser.number_of_NAL_units_pending();
 }
 
@@ -668,6 +801,31 @@ LIBDE265_API void de265_set_image_plane(de265_image* img, int cIdx, void* mem, i
   img->set_image_plane(cIdx, (uint8_t*)mem, stride, userdata);
 }
 
+LIBDE265_API de265_error de265_start_async_decoding(de265_decoder_context* de265ctx,
+                                                    de265_picture_callback callback,
+                                                    void* userdata)
+{
+  decoder_context* ctx = (decoder_context*)de265ctx;
+
+  if (callback==NULL) {
+    return DE265_ERROR_INVALID_PARAMETER;
+  }
+
+  return ctx->start_async_decoding(callback, userdata);
+}
+
+
+LIBDE265_API void de265_release_picture(de265_decoder_context* de265ctx,
+                                        const struct de265_image* img)
+{
+  decoder_context* ctx = (decoder_context*)de265ctx;
+
+  if (img==NULL) { return; }
+
+  ctx->release_async_picture(img);
+}
+
+
 LIBDE265_API void de265_set_image_allocation_functions(de265_decoder_context* de265ctx,
                                                        de265_image_allocation* allocfunc,
                                                        void* userdata)
@@ -708,4 +866,26 @@ LIBDE265_API void de265_get_image_NAL_header(const struct de265_image* img,
   if (nuh_layer_id)    *nuh_layer_id    = img->nal_hdr.nuh_layer_id;
   if (nuh_temporal_id) *nuh_temporal_id = img->nal_hdr.nuh_temporal_id;
 }
+
+
+static acceleration_functions scalar_acceleration_functions()
+{
+  acceleration_functions accel;
+  init_acceleration_functions_fallback(&accel);
+  return accel;
+}
+
+LIBDE265_API de265_error de265_convert_image(const struct de265_image* img,
+                                             enum de265_output_format format,
+                                             uint8_t* const* planes, const int* strides)
+{
+  if (img->decctx) {
+    return convert_image(img, img->decctx->acceleration, format, planes, strides);
+  }
+
+  // image was not created by a decoder -> no acceleration functions selected
+
+  static const acceleration_functions scalar = scalar_acceleration_functions();
+  return convert_image(img, scalar, format, planes, strides);
+}
 }
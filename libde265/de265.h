@@ -99,6 +99,7 @@ typedef enum {
   DE265_ERROR_NO_INITIAL_SLICE_HEADER=16,
   DE265_ERROR_PREMATURE_END_OF_SLICE=17,
   DE265_ERROR_UNSPECIFIED_DECODING_ERROR=18,
+  DE265_ERROR_INVALID_PARAMETER=19,
 
   // --- errors that should become obsolete in later libde265 versions ---
 
@@ -187,6 +188,31 @@ LIBDE265_API void de265_get_image_NAL_header(const struct de265_image*,
                                              int* nuh_temporal_id);
 
 
+/* --- conversion to output formats --- */
+
+enum de265_output_format {
+  de265_output_format_I420     = 0, // 8 bit, planes Y,Cb,Cr, 4:2:0
+  de265_output_format_NV12     = 1, // 8 bit, planes Y and interleaved CbCr, 4:2:0
+  de265_output_format_P010     = 2, // 16 bit (LE, MSB aligned), planes Y and interleaved CbCr, 4:2:0
+  de265_output_format_RGBA     = 3, // 8 bit, a single plane with R,G,B,A bytes
+  de265_output_format_planar   = 4, // planes Y,Cb,Cr in the image chroma format, 8 bit for planes
+                                    // with 8 bit samples, otherwise 16 bit (LE, LSB aligned)
+  de265_output_format_planar_8 = 5  // 8 bit, planes Y,Cb,Cr in the image chroma format
+};
+
+/* Convert the image (cropped to its conformance window) into the given format.
+   The caller provides the destination planes (3 for I420 and the planar formats,
+   2 for NV12/P010, 1 for RGBA) with their strides in bytes. Samples with more than
+   8 bits are dithered when converting to an 8 bit format. Missing chroma of monochrome
+   images is filled with grey, except for the planar formats, which only write the Y plane.
+   I420, NV12 and P010 need a 4:2:0 or monochrome image, otherwise
+   DE265_ERROR_NOT_IMPLEMENTED_YET is returned.
+ */
+LIBDE265_API de265_error de265_convert_image(const struct de265_image*,
+                                             enum de265_output_format format,
+                                             uint8_t* const* planes, const int* strides);
+
+
 /* === decoder === */
 
 typedef void de265_decoder_context; // private structure
@@ -203,6 +229,31 @@ LIBDE265_API de265_error de265_start_worker_threads(de265_decoder_context*, int
 /* Free decoder context. May only be called once on a context. */
 LIBDE265_API de265_error de265_free_decoder(de265_decoder_context*);
 
+
+/* === shared thread pool === */
+
+typedef void de265_thread_pool; // private structure
+
+/* Create a pool of worker threads that can be shared by several decoders.
+   Use this instead of de265_start_worker_threads() when many streams are
+   decoded in parallel, so that the total number of threads stays bounded.
+   Returns NULL if the threads could not be started. */
+LIBDE265_API de265_thread_pool* de265_new_thread_pool(int number_of_threads);
+
+/* Stop and free the thread pool. If decoders are still attached to the pool,
+   it is freed when the last of them is freed or detached with
+   de265_attach_thread_pool(ctx,NULL). No decoder may be attached after this call. */
+LIBDE265_API de265_error de265_free_thread_pool(de265_thread_pool*);
+
+/* Let the decoder run its background decoding tasks in the shared pool.
+   This replaces any worker threads started with de265_start_worker_threads().
+   Passing NULL detaches the decoder again (decoding is then done in the main thread). */
+LIBDE265_API de265_error de265_attach_thread_pool(de265_decoder_context*, de265_thread_pool*);
+
+/* Tasks of decoders with a higher priority are executed first. Decoders with
+   the same priority share the pool in round-robin order. The default priority is 0. */
+LIBDE265_API void de265_set_thread_pool_priority(de265_decoder_context*, int priority);
+
 #ifndef LIBDE265_DISABLE_DEPRECATED
 /* Push more data into the decoder, must be raw h265.
    All complete images in the data will be decoded, hence, do not push
@@ -297,6 +348,30 @@ LIBDE265_API void de265_release_next_picture(de265_decoder_context*);
 LIBDE265_API de265_error de265_get_warning(de265_decoder_context*);
 
 
+/* === asynchronous decoding === */
+
+/* Called from the dispatcher thread for each picture that is output by the decoder.
+   The picture stays valid until it is passed to de265_release_picture().
+   When the end of the stream has been reached (after de265_flush_data()) and all
+   pictures have been output, the callback is called once with 'img'==NULL. */
+typedef void (*de265_picture_callback)(de265_decoder_context*,
+                                       const struct de265_image* img,
+                                       void* userdata);
+
+/* Switch the decoder to asynchronous mode. A library-owned dispatcher thread
+   does all the decoding. The de265_push_*() functions, de265_flush_data() and
+   de265_reset() only enqueue their input and return immediately.
+   de265_decode(), de265_peek_next_picture() and de265_get_next_picture() must not
+   be used in this mode. Pictures are delivered through the callback instead.
+   All pictures have to be released before calling de265_reset(). */
+LIBDE265_API de265_error de265_start_async_decoding(de265_decoder_context*,
+                                                    de265_picture_callback callback,
+                                                    void* userdata);
+
+/* Give a picture received through the callback back to the decoder. */
+LIBDE265_API void de265_release_picture(de265_decoder_context*, const struct de265_image*);
+
+
 enum de265_image_format {
   de265_image_format_mono8    = 1,
   de265_image_format_YUV420P8 = 2,
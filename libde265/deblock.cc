@@ -48,14 +48,14 @@ void markTransformBlockBoundary(de265_image* img, int x0,int y0,
   else {
     // VER
 
-    for (int k=0;k<(1<<log2TrafoSize);k+=4) {
-      img->set_deblk_flags(x0,y0+k, filterLeftCbEdge);
+    if (filterLeftCbEdge) {
+      img->set_deblk_flags_vertical(x0,y0, 1<<log2TrafoSize, filterLeftCbEdge);
     }
 
     // HOR
 
-    for (int k=0;k<(1<<log2TrafoSize);k+=4) {
-      img->set_deblk_flags(x0+k,y0, filterTopCbEdge);
+    if (filterTopCbEdge) {
+      img->set_deblk_flags_horizontal(x0,y0, 1<<log2TrafoSize, filterTopCbEdge);
     }
   }
 }
@@ -78,46 +78,32 @@ void markPredictionBlockBoundary(de265_image* img, int x0,int y0,
 
   switch (partMode) {
   case PART_NxN:
-    for (int k=0;k<cbSize;k++) {
-      img->set_deblk_flags(x0+cbSize2,y0+k, DEBLOCK_PB_EDGE_VERTI);
-      img->set_deblk_flags(x0+k,y0+cbSize2, DEBLOCK_PB_EDGE_HORIZ);
-    }
+    img->set_deblk_flags_vertical  (x0+cbSize2,y0, cbSize, DEBLOCK_PB_EDGE_VERTI);
+    img->set_deblk_flags_horizontal(x0,y0+cbSize2, cbSize, DEBLOCK_PB_EDGE_HORIZ);
     break;
 
   case PART_Nx2N:
-    for (int k=0;k<cbSize;k++) {
-      img->set_deblk_flags(x0+cbSize2,y0+k, DEBLOCK_PB_EDGE_VERTI);
-    }
+    img->set_deblk_flags_vertical  (x0+cbSize2,y0, cbSize, DEBLOCK_PB_EDGE_VERTI);
     break;
 
   case PART_2NxN:
-    for (int k=0;k<cbSize;k++) {
-      img->set_deblk_flags(x0+k,y0+cbSize2, DEBLOCK_PB_EDGE_HORIZ);
-    }
+    img->set_deblk_flags_horizontal(x0,y0+cbSize2, cbSize, DEBLOCK_PB_EDGE_HORIZ);
     break;
 
   case PART_nLx2N:
-    for (int k=0;k<cbSize;k++) {
-      img->set_deblk_flags(x0+cbSize4,y0+k, DEBLOCK_PB_EDGE_VERTI);
-    }
+    img->set_deblk_flags_vertical  (x0+cbSize4,y0, cbSize, DEBLOCK_PB_EDGE_VERTI);
     break;
 
   case PART_nRx2N:
-    for (int k=0;k<cbSize;k++) {
-      img->set_deblk_flags(x0+cbSize2+cbSize4,y0+k, DEBLOCK_PB_EDGE_VERTI);
-    }
+    img->set_deblk_flags_vertical  (x0+cbSize2+cbSize4,y0, cbSize, DEBLOCK_PB_EDGE_VERTI);
     break;
 
   case PART_2NxnU:
-    for (int k=0;k<cbSize;k++) {
-      img->set_deblk_flags(x0+k,y0+cbSize4, DEBLOCK_PB_EDGE_HORIZ);
-    }
+    img->set_deblk_flags_horizontal(x0,y0+cbSize4, cbSize, DEBLOCK_PB_EDGE_HORIZ);
     break;
 
   case PART_2NxnD:
-    for (int k=0;k<cbSize;k++) {
-      img->set_deblk_flags(x0+k,y0+cbSize2+cbSize4, DEBLOCK_PB_EDGE_HORIZ);
-    }
+    img->set_deblk_flags_horizontal(x0,y0+cbSize2+cbSize4, cbSize, DEBLOCK_PB_EDGE_HORIZ);
     break;
 
   case PART_2Nx2N:
@@ -237,141 +223,189 @@ bool derive_edgeFlags(de265_image* img)
 }
 
 
-// 8.7.2.3 (both, EDGE_VER and EDGE_HOR)
-void derive_boundaryStrength(de265_image* img, bool vertical, int yStart,int yEnd,
-                             int xStart,int xEnd)
+/* Mask with 'flags' set in every 'step'-th deblocking unit of a group of 8 units,
+   for testing these units with a single 64-bit load.
+ */
+static uint64_t deblk_unit_mask(uint8_t flags, int step)
+{
+  uint8_t units[8];
+  for (int i=0;i<8;i++) {
+    units[i] = (i % step == 0) ? flags : 0;
+  }
+
+  uint64_t mask;
+  memcpy(&mask, units, 8);
+  return mask;
+}
+
+
+// 8.7.2.3 for a single edge segment
+static int derive_edge_boundaryStrength(de265_image* img, bool vertical, int xDi,int yDi,
+                                        uint8_t edgeFlags)
 {
-  int xIncr = vertical ? 2 : 1;
-  int yIncr = vertical ? 1 : 2;
   int xOffs = vertical ? 1 : 0;
   int yOffs = vertical ? 0 : 1;
-  int edgeMask = vertical ?
-    (DEBLOCK_FLAG_VERTI | DEBLOCK_PB_EDGE_VERTI) :
-    (DEBLOCK_FLAG_HORIZ | DEBLOCK_PB_EDGE_HORIZ);
   int transformEdgeMask = vertical ? DEBLOCK_FLAG_VERTI : DEBLOCK_FLAG_HORIZ;
 
-  xEnd = libde265_min(xEnd,img->get_deblk_width());
-  yEnd = libde265_min(yEnd,img->get_deblk_height());
+  bool p_is_intra_pred = (img->get_pred_mode(xDi-xOffs, yDi-yOffs) == MODE_INTRA);
+  bool q_is_intra_pred = (img->get_pred_mode(xDi,       yDi      ) == MODE_INTRA);
 
-  int TUShift = img->get_sps().Log2MinTrafoSize;
-  int TUStride= img->get_sps().PicWidthInTbsY;
+  int bS;
 
-  for (int y=yStart;y<yEnd;y+=yIncr)
-    for (int x=xStart;x<xEnd;x+=xIncr) {
-      int xDi = x<<2;
-      int yDi = y<<2;
+  if (p_is_intra_pred || q_is_intra_pred) {
+    bS = 2;
+  }
+  else {
+    // opposing site
+    int xDiOpp = xDi-xOffs;
+    int yDiOpp = yDi-yOffs;
+
+    if ((edgeFlags & transformEdgeMask) &&
+        (img->get_nonzero_coefficient(xDi   ,yDi) ||
+         img->get_nonzero_coefficient(xDiOpp,yDiOpp))) {
+      bS = 1;
+    }
+    else {
 
-      logtrace(LogDeblock,"%d %d %s = %s\n",xDi,yDi, vertical?"Vertical":"Horizontal",
-               (img->get_deblk_flags(xDi,yDi) & edgeMask) ? "edge" : "...");
+      bS = 0;
 
-      uint8_t edgeFlags = img->get_deblk_flags(xDi,yDi);
+      const PBMotion& mviP = img->get_mv_info(xDiOpp,yDiOpp);
+      const PBMotion& mviQ = img->get_mv_info(xDi   ,yDi);
 
-      if (edgeFlags & edgeMask) {
-        bool p_is_intra_pred = (img->get_pred_mode(xDi-xOffs, yDi-yOffs) == MODE_INTRA);
-        bool q_is_intra_pred = (img->get_pred_mode(xDi,       yDi      ) == MODE_INTRA);
+      slice_segment_header* shdrP = img->get_SliceHeader(xDiOpp,yDiOpp);
+      slice_segment_header* shdrQ = img->get_SliceHeader(xDi   ,yDi);
 
-        int bS;
+      // Fast path for the common case that both sides use the same motion
+      // (e.g. transform block edges inside a prediction block).
+      if (shdrP == shdrQ && mviP == mviQ) {
+        return 0;
+      }
+
+      int refPicP0 = mviP.predFlag[0] ? shdrP->RefPicList[0][ mviP.refIdx[0] ] : -1;
+      int refPicP1 = mviP.predFlag[1] ? shdrP->RefPicList[1][ mviP.refIdx[1] ] : -1;
+      int refPicQ0 = mviQ.predFlag[0] ? shdrQ->RefPicList[0][ mviQ.refIdx[0] ] : -1;
+      int refPicQ1 = mviQ.predFlag[1] ? shdrQ->RefPicList[1][ mviQ.refIdx[1] ] : -1;
+
+      bool samePics = ((refPicP0==refPicQ0 && refPicP1==refPicQ1) ||
+                       (refPicP0==refPicQ1 && refPicP1==refPicQ0));
+
+      if (!samePics) {
+        bS = 1;
+      }
+      else {
+        MotionVector mvP0 = mviP.mv[0]; if (!mviP.predFlag[0]) { mvP0.x=mvP0.y=0; }
+        MotionVector mvP1 = mviP.mv[1]; if (!mviP.predFlag[1]) { mvP1.x=mvP1.y=0; }
+        MotionVector mvQ0 = mviQ.mv[0]; if (!mviQ.predFlag[0]) { mvQ0.x=mvQ0.y=0; }
+        MotionVector mvQ1 = mviQ.mv[1]; if (!mviQ.predFlag[1]) { mvQ1.x=mvQ1.y=0; }
 
-        if (p_is_intra_pred || q_is_intra_pred) {
-          bS = 2;
+        int numMV_P = mviP.predFlag[0] + mviP.predFlag[1];
+        int numMV_Q = mviQ.predFlag[0] + mviQ.predFlag[1];
+
+        if (numMV_P!=numMV_Q) {
+          img->decctx->add_warning(DE265_WARNING_NUMMVP_NOT_EQUAL_TO_NUMMVQ, false);
+          img->integrity = INTEGRITY_DECODING_ERRORS;
         }
-        else {
-          // opposing site
-          int xDiOpp = xDi-xOffs;
-          int yDiOpp = yDi-yOffs;
 
-          if ((edgeFlags & transformEdgeMask) &&
-              (img->get_nonzero_coefficient(xDi   ,yDi) ||
-               img->get_nonzero_coefficient(xDiOpp,yDiOpp))) {
-            bS = 1;
+        // two different reference pictures or only one reference picture
+        if (refPicP0 != refPicP1) {
+
+          if (refPicP0 == refPicQ0) {
+            if (abs_value(mvP0.x-mvQ0.x) >= 4 ||
+                abs_value(mvP0.y-mvQ0.y) >= 4 ||
+                abs_value(mvP1.x-mvQ1.x) >= 4 ||
+                abs_value(mvP1.y-mvQ1.y) >= 4) {
+              bS = 1;
+            }
           }
           else {
+            if (abs_value(mvP0.x-mvQ1.x) >= 4 ||
+                abs_value(mvP0.y-mvQ1.y) >= 4 ||
+                abs_value(mvP1.x-mvQ0.x) >= 4 ||
+                abs_value(mvP1.y-mvQ0.y) >= 4) {
+              bS = 1;
+            }
+          }
+        }
+        else {
+          assert(refPicQ0==refPicQ1);
+
+          if ((abs_value(mvP0.x-mvQ0.x) >= 4 ||
+               abs_value(mvP0.y-mvQ0.y) >= 4 ||
+               abs_value(mvP1.x-mvQ1.x) >= 4 ||
+               abs_value(mvP1.y-mvQ1.y) >= 4)
+              &&
+              (abs_value(mvP0.x-mvQ1.x) >= 4 ||
+               abs_value(mvP0.y-mvQ1.y) >= 4 ||
+               abs_value(mvP1.x-mvQ0.x) >= 4 ||
+               abs_value(mvP1.y-mvQ0.y) >= 4)) {
+            bS = 1;
+          }
+        }
+      }
 
-            bS = 0;
+      /*
+        printf("unimplemented deblocking code for CU at %d;%d\n",xDi,yDi);
 
-            const PBMotion& mviP = img->get_mv_info(xDiOpp,yDiOpp);
-            const PBMotion& mviQ = img->get_mv_info(xDi   ,yDi);
+        logerror(LogDeblock, "unimplemented code reached (file %s, line %d)\n",
+        __FILE__, __LINE__);
+      */
+    }
+  }
 
-            slice_segment_header* shdrP = img->get_SliceHeader(xDiOpp,yDiOpp);
-            slice_segment_header* shdrQ = img->get_SliceHeader(xDi   ,yDi);
+  return bS;
+}
 
-            int refPicP0 = mviP.predFlag[0] ? shdrP->RefPicList[0][ mviP.refIdx[0] ] : -1;
-            int refPicP1 = mviP.predFlag[1] ? shdrP->RefPicList[1][ mviP.refIdx[1] ] : -1;
-            int refPicQ0 = mviQ.predFlag[0] ? shdrQ->RefPicList[0][ mviQ.refIdx[0] ] : -1;
-            int refPicQ1 = mviQ.predFlag[1] ? shdrQ->RefPicList[1][ mviQ.refIdx[1] ] : -1;
 
-            bool samePics = ((refPicP0==refPicQ0 && refPicP1==refPicQ1) ||
-                             (refPicP0==refPicQ1 && refPicP1==refPicQ0));
+// 8.7.2.3 (both, EDGE_VER and EDGE_HOR)
+void derive_boundaryStrength(de265_image* img, bool vertical, int yStart,int yEnd,
+                             int xStart,int xEnd)
+{
+  int xIncr = vertical ? 2 : 1;
+  int yIncr = vertical ? 1 : 2;
+  int edgeMask = vertical ?
+    (DEBLOCK_FLAG_VERTI | DEBLOCK_PB_EDGE_VERTI) :
+    (DEBLOCK_FLAG_HORIZ | DEBLOCK_PB_EDGE_HORIZ);
 
-            if (!samePics) {
-              bS = 1;
-            }
-            else {
-              MotionVector mvP0 = mviP.mv[0]; if (!mviP.predFlag[0]) { mvP0.x=mvP0.y=0; }
-              MotionVector mvP1 = mviP.mv[1]; if (!mviP.predFlag[1]) { mvP1.x=mvP1.y=0; }
-              MotionVector mvQ0 = mviQ.mv[0]; if (!mviQ.predFlag[0]) { mvQ0.x=mvQ0.y=0; }
-              MotionVector mvQ1 = mviQ.mv[1]; if (!mviQ.predFlag[1]) { mvQ1.x=mvQ1.y=0; }
+  xEnd = libde265_min(xEnd,img->get_deblk_width());
+  yEnd = libde265_min(yEnd,img->get_deblk_height());
 
-              int numMV_P = mviP.predFlag[0] + mviP.predFlag[1];
-              int numMV_Q = mviQ.predFlag[0] + mviQ.predFlag[1];
+  const uint64_t edgeMask8 = deblk_unit_mask(edgeMask,        xIncr);
+  const uint64_t bSMask8   = deblk_unit_mask(DEBLOCK_BS_MASK, xIncr);
 
-              if (numMV_P!=numMV_Q) {
-                img->decctx->add_warning(DE265_WARNING_NUMMVP_NOT_EQUAL_TO_NUMMVQ, false);
-                img->integrity = INTEGRITY_DECODING_ERRORS;
-              }
+  for (int y=yStart;y<yEnd;y+=yIncr) {
+    uint8_t* deblk = img->get_deblk_row(y);
 
-              // two different reference pictures or only one reference picture
-              if (refPicP0 != refPicP1) {
+    for (int x=xStart;x<xEnd;x+=xIncr) {
 
-                if (refPicP0 == refPicQ0) {
-                  if (abs_value(mvP0.x-mvQ0.x) >= 4 ||
-                      abs_value(mvP0.y-mvQ0.y) >= 4 ||
-                      abs_value(mvP1.x-mvQ1.x) >= 4 ||
-                      abs_value(mvP1.y-mvQ1.y) >= 4) {
-                    bS = 1;
-                  }
-                }
-                else {
-                  if (abs_value(mvP0.x-mvQ1.x) >= 4 ||
-                      abs_value(mvP0.y-mvQ1.y) >= 4 ||
-                      abs_value(mvP1.x-mvQ0.x) >= 4 ||
-                      abs_value(mvP1.y-mvQ0.y) >= 4) {
-                    bS = 1;
-                  }
-                }
-              }
-              else {
-                assert(refPicQ0==refPicQ1);
-
-                if ((abs_value(mvP0.x-mvQ0.x) >= 4 ||
-                     abs_value(mvP0.y-mvQ0.y) >= 4 ||
-                     abs_value(mvP1.x-mvQ1.x) >= 4 ||
-                     abs_value(mvP1.y-mvQ1.y) >= 4)
-                    &&
-                    (abs_value(mvP0.x-mvQ1.x) >= 4 ||
-                     abs_value(mvP0.y-mvQ1.y) >= 4 ||
-                     abs_value(mvP1.x-mvQ0.x) >= 4 ||
-                     abs_value(mvP1.y-mvQ0.y) >= 4)) {
-                  bS = 1;
-                }
-              }
-            }
+      // skip groups of 8 units without edges, only clearing their bS
 
-            /*
-              printf("unimplemented deblocking code for CU at %d;%d\n",xDi,yDi);
+      if (((x-xStart) & 7)==0 && x+8 <= xEnd) {
+        uint64_t units;
+        memcpy(&units, deblk+x, 8);
 
-              logerror(LogDeblock, "unimplemented code reached (file %s, line %d)\n",
-              __FILE__, __LINE__);
-            */
-          }
-        }
+        if ((units & edgeMask8)==0) {
+          units &= ~bSMask8;
+          memcpy(deblk+x, &units, 8);
 
-        img->set_deblk_bS(xDi,yDi, bS);
+          x += 8-xIncr;
+          continue;
+        }
       }
-      else {
-        img->set_deblk_bS(xDi,yDi, 0);
+
+      int xDi = x<<2;
+      int yDi = y<<2;
+
+      logtrace(LogDeblock,"%d %d %s = %s\n",xDi,yDi, vertical?"Vertical":"Horizontal",
+               (deblk[x] & edgeMask) ? "edge" : "...");
+
+      int bS = 0;
+      if (deblk[x] & edgeMask) {
+        bS = derive_edge_boundaryStrength(img, vertical, xDi,yDi, deblk[x]);
       }
+
+      deblk[x] = (deblk[x] & ~DEBLOCK_BS_MASK) | bS;
     }
+  }
 }
 
 
@@ -419,10 +453,26 @@ void edge_filtering_luma_internal(de265_image* img, bool vertical,
   xEnd = libde265_min(xEnd,img->get_deblk_width());
   yEnd = libde265_min(yEnd,img->get_deblk_height());
 
-  for (int y=yStart;y<yEnd;y+=yIncr)
+  const uint64_t bSMask8 = deblk_unit_mask(DEBLOCK_BS_MASK, xIncr);
+
+  for (int y=yStart;y<yEnd;y+=yIncr) {
+    const uint8_t* deblk = img->get_deblk_row(y);
+
     for (int x=xStart;x<xEnd;x+=xIncr) {
       // x;y in deblocking units (4x4 pixels)
 
+      // skip groups of 8 units without edges to filter
+
+      if (((x-xStart) & 7)==0 && x+8 <= xEnd) {
+        uint64_t units;
+        memcpy(&units, deblk+x, 8);
+
+        if ((units & bSMask8)==0) {
+          x += 8-xIncr;
+          continue;
+        }
+      }
+
       int xDi = x<<2; // *4 -> pixel resolution
       int yDi = y<<2; // *4 -> pixel resolution
       int bS = img->get_deblk_bS(xDi,yDi);
@@ -696,6 +746,7 @@ void edge_filtering_luma_internal(de265_image* img, bool vertical,
         }
       }
     }
+  }
 }
 
 
@@ -751,8 +802,26 @@ void edge_filtering_chroma_internal(de265_image* img, bool vertical,
 
   int bitDepth_C = sps.BitDepth_C;
 
-  for (int y=yStart;y<yEnd;y+=yIncr)
+  // chroma is only filtered at edges with bS==2
+  const uint64_t bS2Mask8 = deblk_unit_mask(2, xIncr);
+
+  for (int y=yStart;y<yEnd;y+=yIncr) {
+    const uint8_t* deblk = img->get_deblk_row(y);
+
     for (int x=xStart;x<xEnd;x+=xIncr) {
+
+      // skip groups of 8 units without edges to filter
+
+      if (((x-xStart) & 7)==0 && x+8 <= xEnd) {
+        uint64_t units;
+        memcpy(&units, deblk+x, 8);
+
+        if ((units & bS2Mask8)==0) {
+          x += 8-xIncr;
+          continue;
+        }
+      }
+
       int xDi = x << (3-SubWidthC);
       int yDi = y << (3-SubHeightC);
 
@@ -868,6 +937,7 @@ void edge_filtering_chroma_internal(de265_image* img, bool vertical,
         }
       }
     }
+  }
 }
 
 
@@ -895,26 +965,15 @@ void edge_filtering_chroma_CTB(de265_image* img, bool vertical, int xCtb,int yCt
 
 
 
-class thread_task_deblock_CTBRow : public thread_task
-{
-public:
-  struct de265_image* img;
-  int  ctb_y;
-  bool vertical;
-
-  virtual void work();
-  virtual std::string name() const {
-    char buf[100];
-    sprintf(buf,"deblock-%d",ctb_y);
-    return buf;
-  }
-};
-
-
 void thread_task_deblock_CTBRow::work()
 {
-  state = Running;
-  img->thread_run(this);
+  if (state == Blocked) {
+    img->thread_resumes(this);
+  }
+  else {
+    state = Running;
+    img->thread_run(this);
+  }
 
   int xStart=0;
   int xEnd = img->get_deblk_width();
@@ -937,19 +996,27 @@ void thread_task_deblock_CTBRow::work()
     // pass 1: vertical
 
     int CtbRow = std::min(ctb_y+1 , img->get_sps().PicHeightInCtbsY-1);
-    img->wait_for_progress(this, rightCtb,CtbRow, CTB_PROGRESS_PREFILTER);
+    if (img->suspend_until_progress(this, rightCtb,CtbRow, CTB_PROGRESS_PREFILTER)) {
+      return;
+    }
   }
   else {
     // pass 2: horizontal
 
     if (ctb_y>0) {
-      img->wait_for_progress(this, rightCtb,ctb_y-1, CTB_PROGRESS_DEBLK_V);
+      if (img->suspend_until_progress(this, rightCtb,ctb_y-1, CTB_PROGRESS_DEBLK_V)) {
+        return;
+      }
     }
 
-    img->wait_for_progress(this, rightCtb,ctb_y,  CTB_PROGRESS_DEBLK_V);
+    if (img->suspend_until_progress(this, rightCtb,ctb_y,  CTB_PROGRESS_DEBLK_V)) {
+      return;
+    }
 
     if (ctb_y+1<img->get_sps().PicHeightInCtbsY) {
-      img->wait_for_progress(this, rightCtb,ctb_y+1, CTB_PROGRESS_DEBLK_V);
+      if (img->suspend_until_progress(this, rightCtb,ctb_y+1, CTB_PROGRESS_DEBLK_V)) {
+        return;
+      }
     }
   }
 
@@ -1003,14 +1070,13 @@ void add_deblocking_tasks(image_unit* imgunit)
     {
       for (int y=0;y<img->get_sps().PicHeightInCtbsY;y++)
         {
-          thread_task_deblock_CTBRow* task = new thread_task_deblock_CTBRow;
+          thread_task_deblock_CTBRow* task = imgunit->deblock_tasks.get_task();
 
           task->img   = img;
           task->ctb_y = y;
           task->vertical = (pass==0);
 
-          imgunit->tasks.push_back(task);
-          add_task(&ctx->thread_pool_, task);
+          add_task(&ctx->task_queue_, task);
           n++;
         }
     }
@@ -23,6 +23,23 @@
 
 #include "libde265/decctx.h"
 
+
+class thread_task_deblock_CTBRow : public thread_task
+{
+public:
+  struct de265_image* img;
+  int  ctb_y;
+  bool vertical;
+
+  virtual void work();
+  virtual std::string name() const {
+    char buf[100];
+    sprintf(buf,"deblock-%d",ctb_y);
+    return buf;
+  }
+};
+
+
 void add_deblocking_tasks(image_unit* imgunit);
 void apply_deblocking_filter(de265_image* img); //decoder_context* ctx);
 
@@ -83,18 +83,6 @@ thread_context::thread_context()
   */
 
 
-  //memset(coeffList,0,sizeof(int16_t)*3*32*32);
-  //memset(coeffPos,0,sizeof(int16_t)*3*32*32);
-  //memset(nCoeff,0,sizeof(int16_t)*3);
-
-
-
-  IsCuQpDeltaCoded = false;
-  CuQpDelta = 0;
-
-  IsCuChromaQpOffsetCoded = false;
-  CuQpOffsetCb = 0;
-  CuQpOffsetCr = 0;
 
   /*
   currentQPY = 0;
@@ -114,14 +102,6 @@ thread_context::thread_context()
   memset(&ctx_model, 0, sizeof(ctx_model));
   */
 
-  decctx = NULL;
-  img = NULL;
-  shdr = NULL;
-
-  imgunit = NULL;
-  sliceunit = NULL;
-
-
   //memset(this,0,sizeof(thread_context));
 
   // There is a interesting issue here. When aligning _coeffBuf to 16 bytes offset with
@@ -138,6 +118,27 @@ thread_context::thread_context()
     coeffBuf = (int16_t *) (((uint8_t *)_coeffBuf) + (16-offset));
   }
 
+  reset();
+}
+
+
+void thread_context::reset()
+{
+  IsCuQpDeltaCoded = false;
+  CuQpDelta = 0;
+
+  IsCuChromaQpOffsetCoded = false;
+  CuQpOffsetCb = 0;
+  CuQpOffsetCr = 0;
+
+  decctx = NULL;
+  img = NULL;
+  shdr = NULL;
+
+  imgunit = NULL;
+  sliceunit = NULL;
+  task = NULL;
+
   memset(coeffBuf, 0, 32*32*sizeof(int16_t));
 }
 
@@ -155,6 +156,7 @@ slice_unit::slice_unit(decoder_context* decctx)
 {
   state = Unprocessed;
   nThreadContexts = 0;
+  nThreadContextsAllocated = 0;
 }
 
 slice_unit::~slice_unit()
@@ -167,11 +169,42 @@ slice_unit::~slice_unit()
 }
 
 
+void slice_unit::reset()
+{
+  ctx->nal_parser.free_NAL_unit(nal);
+  nal = NULL;
+
+  shdr = NULL;
+  imgunit = NULL;
+  flush_reorder_buffer = false;
+
+  state = Unprocessed;
+  finished_threads.reset();
+  nThreads = 0;
+
+  first_decoded_CTB_RS = -1;
+  last_decoded_CTB_RS = -1;
+
+  nThreadContexts = 0;
+}
+
+
 void slice_unit::allocate_thread_contexts(int n)
 {
-  assert(thread_contexts==NULL);
+  assert(nThreadContexts==0);
+
+  if (n > nThreadContextsAllocated) {
+    delete[] thread_contexts;
+
+    thread_contexts = new thread_context[n];
+    nThreadContextsAllocated = n;
+  }
+  else {
+    for (int i=0;i<n;i++) {
+      thread_contexts[i].reset();
+    }
+  }
 
-  thread_contexts = new thread_context[n];
   nThreadContexts = n;
 }
 
@@ -189,10 +222,27 @@ image_unit::~image_unit()
   for (int i=0;i<slice_units.size();i++) {
     delete slice_units[i];
   }
+}
 
-  for (int i=0;i<tasks.size();i++) {
-    delete tasks[i];
-  }
+
+void image_unit::reset()
+{
+  assert(slice_units.empty());
+
+  img=NULL;
+  sao_output.release();
+
+  suffix_SEIs.clear();
+
+  role=Invalid;
+  state=Unprocessed;
+
+  ctb_row_tasks.reset();
+  slice_segment_tasks.reset();
+  deblock_tasks.reset();
+  sao_tasks.reset();
+
+  ctx_models.clear();
 }
 
 
@@ -241,6 +291,13 @@ decoder_context::decoder_context()
   //memset(&thread_pool,0,sizeof(struct thread_pool));
   num_worker_threads = 0;
 
+  async_running = false;
+  async_stop = false;
+  async_decoder_idle = true;
+  async_input_bytes = 0;
+  async_callback = NULL;
+  async_callback_userdata = NULL;
+
 
   // frame-rate
 
@@ -318,10 +375,311 @@ decoder_context::decoder_context()
 
 decoder_context::~decoder_context()
 {
+  stop_async_decoding();
+
+  for (size_t i=0;i<image_units.size();i++) {
+    finish_slice_segments(image_units[i]);
+  }
+
+  stop_thread_pool();
+
   while (!image_units.empty()) {
     delete image_units.back();
     image_units.pop_back();
   }
+
+  free_recycled_units();
+}
+
+
+image_unit* decoder_context::get_image_unit()
+{
+  if (free_image_units.empty()) {
+    return new image_unit;
+  }
+
+  image_unit* imgunit = free_image_units.back();
+  free_image_units.pop_back();
+  return imgunit;
+}
+
+
+slice_unit* decoder_context::get_slice_unit()
+{
+  if (free_slice_units.empty()) {
+    return new slice_unit(this);
+  }
+
+  slice_unit* sliceunit = free_slice_units.back();
+  free_slice_units.pop_back();
+  return sliceunit;
+}
+
+
+void decoder_context::recycle_image_unit(image_unit* imgunit)
+{
+  for (size_t i=0;i<imgunit->slice_units.size();i++) {
+    slice_unit* sliceunit = imgunit->slice_units[i];
+    sliceunit->reset();
+    free_slice_units.push_back(sliceunit);
+  }
+
+  imgunit->slice_units.clear();
+  imgunit->reset();
+
+  free_image_units.push_back(imgunit);
+}
+
+
+void decoder_context::free_recycled_units()
+{
+  for (size_t i=0;i<free_image_units.size();i++) {
+    delete free_image_units[i];
+  }
+
+  for (size_t i=0;i<free_slice_units.size();i++) {
+    delete free_slice_units[i];
+  }
+
+  free_image_units.clear();
+  free_slice_units.clear();
+}
+
+
+#ifndef _WIN32
+static void* async_dispatcher_thread(void* ctx_ptr)
+#else
+static DWORD WINAPI async_dispatcher_thread(LPVOID ctx_ptr)
+#endif
+{
+  decoder_context* ctx = (decoder_context*)ctx_ptr;
+  ctx->run_async_dispatcher();
+  return 0;
+}
+
+
+de265_error decoder_context::start_async_decoding(de265_picture_callback callback,
+                                                  void* userdata)
+{
+  if (async_running) {
+    return DE265_ERROR_CANNOT_START_THREADPOOL;
+  }
+
+  async_callback = callback;
+  async_callback_userdata = userdata;
+  async_stop = false;
+  async_decoder_idle = false; // there might already be pending input
+  async_input_bytes = 0;
+
+  de265_mutex_init(&async_mutex);
+  de265_cond_init(&async_cond);
+
+  if (de265_thread_create(&async_thread, async_dispatcher_thread, this) != 0) {
+    de265_mutex_destroy(&async_mutex);
+    de265_cond_destroy(&async_cond);
+    return DE265_ERROR_CANNOT_START_THREADPOOL;
+  }
+
+  async_running = true;
+
+  return DE265_OK;
+}
+
+
+void decoder_context::stop_async_decoding()
+{
+  if (!async_running) {
+    return;
+  }
+
+  de265_mutex_lock(&async_mutex);
+  async_stop = true;
+  de265_mutex_unlock(&async_mutex);
+
+  de265_cond_broadcast(&async_cond, &async_mutex);
+
+  de265_thread_join(async_thread);
+  de265_thread_destroy(&async_thread);
+
+  de265_mutex_destroy(&async_mutex);
+  de265_cond_destroy(&async_cond);
+
+  // input that has not been decoded yet is dropped
+
+  for (size_t i=0;i<async_inputs.size();i++) {
+    delete async_inputs[i];
+  }
+  async_inputs.clear();
+
+  // released pictures can be reused by the (synchronous) decoder again
+
+  for (size_t i=0;i<async_released_pictures.size();i++) {
+    async_released_pictures[i]->PicOutputFlag = false;
+  }
+  async_released_pictures.clear();
+
+  async_running = false;
+}
+
+
+void decoder_context::push_async_input(async_input* input)
+{
+  de265_mutex_lock(&async_mutex);
+  async_inputs.push_back(input);
+  async_input_bytes += input->data.size();
+  de265_mutex_unlock(&async_mutex);
+
+  de265_cond_signal(&async_cond);
+}
+
+
+void decoder_context::release_async_picture(const de265_image* img)
+{
+  de265_mutex_lock(&async_mutex);
+  async_released_pictures.push_back(const_cast<de265_image*>(img));
+  de265_mutex_unlock(&async_mutex);
+
+  de265_cond_signal(&async_cond);
+}
+
+
+int decoder_context::num_async_input_bytes_pending()
+{
+  de265_mutex_lock(&async_mutex);
+  int n = async_input_bytes;
+  de265_mutex_unlock(&async_mutex);
+
+  return n;
+}
+
+
+int decoder_context::num_async_inputs_pending()
+{
+  de265_mutex_lock(&async_mutex);
+  int n = async_inputs.size();
+  de265_mutex_unlock(&async_mutex);
+
+  return n;
+}
+
+
+void decoder_context::process_async_input(async_input* input)
+{
+  switch (input->type) {
+  case async_input::Data:
+    nal_parser.push_data(input->data.data(), input->data.size(),
+                         input->pts, input->user_data);
+    break;
+  case async_input::NAL:
+    nal_parser.push_NAL(input->data.data(), input->data.size(),
+                        input->pts, input->user_data);
+    break;
+  case async_input::EndOfNAL:
+    nal_parser.flush_data();
+    break;
+  case async_input::EndOfFrame:
+    nal_parser.flush_data();
+    nal_parser.mark_end_of_frame();
+    break;
+  case async_input::EndOfStream:
+    nal_parser.flush_data();
+    nal_parser.mark_end_of_stream();
+    break;
+  case async_input::Reset:
+    reset();
+    break;
+  }
+}
+
+
+void decoder_context::output_async_pictures()
+{
+  while (dpb.num_pictures_in_output_queue()>0) {
+    de265_image* img = dpb.get_next_picture_in_output_queue();
+
+    // PicOutputFlag stays set until the application releases the picture,
+    // so that the DPB slot will not be reused before.
+    dpb.pop_next_picture_in_output_queue();
+
+    async_callback(this, img, async_callback_userdata);
+  }
+}
+
+
+void decoder_context::run_async_dispatcher()
+{
+  bool end_of_stream_pending = false;
+
+  de265_mutex_lock(&async_mutex);
+
+  for (;;) {
+    // sleep until there is something to do
+
+    while (!async_stop && async_decoder_idle &&
+           async_inputs.empty() && async_released_pictures.empty()) {
+      de265_cond_wait(&async_cond, &async_mutex);
+    }
+
+    if (async_stop) {
+      break;
+    }
+
+    std::deque<async_input*> inputs;
+    std::vector<de265_image*> released;
+
+    inputs.swap(async_inputs);
+    released.swap(async_released_pictures);
+    async_input_bytes = 0;
+
+    de265_mutex_unlock(&async_mutex);
+
+
+    for (size_t i=0;i<released.size();i++) {
+      released[i]->PicOutputFlag = false;
+    }
+
+    for (size_t i=0;i<inputs.size();i++) {
+      if (inputs[i]->type == async_input::EndOfStream) {
+        end_of_stream_pending = true;
+      }
+
+      process_async_input(inputs[i]);
+      delete inputs[i];
+    }
+
+
+    // decode one step and hand over the pictures that became available
+
+    int more=0;
+    de265_error err = decode(&more);
+
+    output_async_pictures();
+
+    bool idle;
+    if (err==DE265_ERROR_WAITING_FOR_INPUT_DATA ||
+        err==DE265_ERROR_IMAGE_BUFFER_FULL) {
+      idle = true;
+    }
+    else if (err != DE265_OK) {
+      add_warning(err, false);
+      idle = (nal_parser.get_NAL_queue_length()==0);
+    }
+    else {
+      idle = !more;
+    }
+
+    // signal the end of the stream when all pictures have been output
+
+    if (idle && err==DE265_OK && end_of_stream_pending) {
+      end_of_stream_pending = false;
+      async_callback(this, NULL, async_callback_userdata);
+    }
+
+    de265_mutex_lock(&async_mutex);
+    async_decoder_idle = idle;
+  }
+
+  de265_mutex_unlock(&async_mutex);
 }
 
 
@@ -343,30 +701,80 @@ void decoder_context::set_image_allocation_functions(de265_image_allocation* all
 
 de265_error decoder_context::start_thread_pool(int nThreads)
 {
-  ::start_thread_pool(&thread_pool_, nThreads);
+  if (task_queue_.pool) {
+    stop_thread_pool();
+  }
+
+  de265_error err = ::start_thread_pool(&thread_pool_, nThreads);
+  if (!de265_isOK(err)) {
+    ::stop_thread_pool(&thread_pool_);
+    num_worker_threads = 0;
+    return err;
+  }
+
+  attach_task_queue(&thread_pool_, &task_queue_);
 
   num_worker_threads = nThreads;
 
+  return err;
+}
+
+
+de265_error decoder_context::attach_thread_pool(thread_pool* pool)
+{
+  if (task_queue_.pool) {
+    stop_thread_pool();
+  }
+
+  if (pool->num_threads==0) {
+    return DE265_ERROR_CANNOT_START_THREADPOOL;
+  }
+
+  attach_task_queue(pool, &task_queue_);
+
+  num_worker_threads = pool->num_threads;
+
   return DE265_OK;
 }
 
 
 void decoder_context::stop_thread_pool()
 {
-  if (get_num_worker_threads()>0) {
-    //flush_thread_pool(&ctx->thread_pool);
-    ::stop_thread_pool(&thread_pool_);
+  thread_pool* pool = task_queue_.pool;
+
+  if (pool) {
+    bool release = detach_task_queue(&task_queue_);
+
+    if (pool == &thread_pool_) {
+      //flush_thread_pool(&ctx->thread_pool);
+      ::stop_thread_pool(&thread_pool_);
+    }
+    else if (release) {
+      // we were the last decoder using a shared pool that has already been freed by its owner
+      ::stop_thread_pool(pool);
+      delete pool;
+    }
   }
+
+  num_worker_threads = 0;
+}
+
+
+void decoder_context::set_thread_pool_priority(int priority)
+{
+  set_task_queue_priority(&task_queue_, priority);
 }
 
 
 void decoder_context::reset()
 {
-  if (num_worker_threads>0) {
-    //flush_thread_pool(&ctx->thread_pool);
-    ::stop_thread_pool(&thread_pool_);
+  for (size_t i=0;i<image_units.size();i++) {
+    finish_slice_segments(image_units[i]);
   }
 
+  // The worker threads (own or shared) keep running, only our tasks are removed.
+  flush_task_queue(&task_queue_);
+
   // --------------------------------------------------
 
 #if 0
@@ -422,12 +830,7 @@ void decoder_context::reset()
     image_units.pop_back();
   }
 
-  // --- start threads again ---
-
-  if (num_worker_threads>0) {
-    // TODO: need error checking
-    start_thread_pool(num_worker_threads);
-  }
+  free_recycled_units();
 }
 
 void base_context::set_acceleration_functions(enum de265_acceleration l)
@@ -456,6 +859,8 @@ void decoder_context::init_thread_context(thread_context* tctx)
 {
   // zero scrap memory for coefficient blocks
   memset(tctx->_coeffBuf, 0, sizeof(tctx->_coeffBuf));  // TODO: check if we can safely remove this
+  tctx->nCodedSubBlocks = 0;
+  tctx->coeffExtent = 0;
 
   tctx->currentQG_x = -1;
   tctx->currentQG_y = -1;
@@ -498,38 +903,80 @@ void decoder_context::add_task_decode_CTB_row(thread_context* tctx,
                                               bool firstSliceSubstream,
                                               int ctbRow)
 {
-  thread_task_ctb_row* task = new thread_task_ctb_row;
+  thread_task_ctb_row* task = tctx->imgunit->ctb_row_tasks.get_task();
   task->firstSliceSubstream = firstSliceSubstream;
   task->tctx = tctx;
   task->debug_startCtbRow = ctbRow;
+  task->substreamStarted = false;
   tctx->task = task;
 
-  add_task(&thread_pool_, task);
-
-  tctx->imgunit->tasks.push_back(task);
+  add_task(&task_queue_, task);
 }
 
 
 void decoder_context::add_task_decode_slice_segment(thread_context* tctx, bool firstSliceSubstream,
                                                     int ctbx,int ctby)
 {
-  thread_task_slice_segment* task = new thread_task_slice_segment;
+  thread_task_slice_segment* task = tctx->imgunit->slice_segment_tasks.get_task();
   task->firstSliceSubstream = firstSliceSubstream;
   task->tctx = tctx;
   task->debug_startCtbX = ctbx;
   task->debug_startCtbY = ctby;
   tctx->task = task;
 
-  add_task(&thread_pool_, task);
+  add_task(&task_queue_, task);
+}
+
+
+uint32_t parameter_set_NAL::compute_hash(const NAL_unit* nal)
+{
+  // FNV-1a
+
+  uint32_t hash = 2166136261u;
+
+  const unsigned char* data = nal->data();
+  for (int i=0;i<nal->size();i++) {
+    hash = (hash ^ data[i]) * 16777619u;
+  }
+
+  return hash;
+}
+
 
-  tctx->imgunit->tasks.push_back(task);
+bool parameter_set_NAL::is_identical(uint32_t hash, const NAL_unit* nal) const
+{
+  return (hash == mHash &&
+          mData.size() == (size_t)nal->size() &&
+          memcmp(mData.data(), nal->data(), nal->size()) == 0);
 }
 
 
-de265_error decoder_context::read_vps_NAL(bitreader& reader)
+void parameter_set_NAL::set(uint32_t hash, const NAL_unit* nal)
+{
+  mHash = hash;
+  mData.assign(nal->data(), nal->data() + nal->size());
+}
+
+
+de265_error decoder_context::read_vps_NAL(bitreader& reader, const NAL_unit* nal)
 {
   logdebug(LogHeaders,"---> read VPS\n");
 
+  // an identical VPS is already stored -> nothing to do
+
+  uint32_t hash = parameter_set_NAL::compute_hash(nal);
+
+  for (int id=0;id<DE265_MAX_VPS_SETS;id++) {
+    if (vps[id] && vps_nal[id].is_identical(hash, nal)) {
+      if (param_vps_headers_fd>=0) {
+        vps[id]->dump(param_vps_headers_fd);
+      }
+
+      return DE265_OK;
+    }
+  }
+
+
   std::shared_ptr<video_parameter_set> new_vps = std::make_shared<video_parameter_set>();
   de265_error err = new_vps->read(this,&reader);
   if (err != DE265_OK) {
@@ -541,14 +988,32 @@ de265_error decoder_context::read_vps_NAL(bitreader& reader)
   }
 
   vps[ new_vps->video_parameter_set_id ] = new_vps;
+  vps_nal[ new_vps->video_parameter_set_id ].set(hash, nal);
 
   return DE265_OK;
 }
 
-de265_error decoder_context::read_sps_NAL(bitreader& reader)
+de265_error decoder_context::read_sps_NAL(bitreader& reader, const NAL_unit* nal)
 {
   logdebug(LogHeaders,"----> read SPS\n");
 
+  /* An identical SPS is already stored -> keep the existing object. This also keeps
+     the PPSs that refer to it valid (see read_pps_NAL()).
+  */
+
+  uint32_t hash = parameter_set_NAL::compute_hash(nal);
+
+  for (int id=0;id<DE265_MAX_SPS_SETS;id++) {
+    if (sps[id] && sps_nal[id].is_identical(hash, nal)) {
+      if (param_sps_headers_fd>=0) {
+        sps[id]->dump(param_sps_headers_fd);
+      }
+
+      return DE265_OK;
+    }
+  }
+
+
   std::shared_ptr<seq_parameter_set> new_sps = std::make_shared<seq_parameter_set>();
   de265_error err;
 
@@ -561,14 +1026,34 @@ de265_error decoder_context::read_sps_NAL(bitreader& reader)
   }
 
   sps[ new_sps->seq_parameter_set_id ] = new_sps;
+  sps_nal[ new_sps->seq_parameter_set_id ].set(hash, nal);
 
   return DE265_OK;
 }
 
-de265_error decoder_context::read_pps_NAL(bitreader& reader)
+de265_error decoder_context::read_pps_NAL(bitreader& reader, const NAL_unit* nal)
 {
   logdebug(LogHeaders,"----> read PPS\n");
 
+  /* The derived values of the PPS (tile and CTB address tables) depend on the SPS.
+     Hence, an identical PPS can only be kept when it was derived from the SPS that
+     is currently stored under its ID.
+  */
+
+  uint32_t hash = parameter_set_NAL::compute_hash(nal);
+
+  for (int id=0;id<DE265_MAX_PPS_SETS;id++) {
+    if (pps[id] && pps_nal[id].is_identical(hash, nal) &&
+        pps[id]->sps == sps[ (int)pps[id]->seq_parameter_set_id ]) {
+      if (param_pps_headers_fd>=0) {
+        pps[id]->dump(param_pps_headers_fd);
+      }
+
+      return DE265_OK;
+    }
+  }
+
+
   std::shared_ptr<pic_parameter_set> new_pps = std::make_shared<pic_parameter_set>();
 
   bool success = new_pps->read(&reader,this);
@@ -579,6 +1064,7 @@ de265_error decoder_context::read_pps_NAL(bitreader& reader)
 
   if (success) {
     pps[ (int)new_pps->pic_parameter_set_id ] = new_pps;
+    pps_nal[ (int)new_pps->pic_parameter_set_id ].set(hash, nal);
   }
 
   return success ? DE265_OK : DE265_WARNING_PPS_HEADER_INVALID;
@@ -636,6 +1122,16 @@ de265_error decoder_context::read_slice_NAL(bitreader& reader, NAL_unit* nal, na
   }
 
 
+  // The slice segments of the previous picture may still be decoded in the background.
+  // They have to be finished before the new picture modifies the DPB.
+
+  if (shdr->first_slice_segment_in_pic_flag) {
+    for (size_t i=0;i<image_units.size();i++) {
+      finish_slice_segments(image_units[i]);
+    }
+  }
+
+
   if (process_slice_segment_header(shdr, &err, nal->pts, &nal_hdr, nal->user_data) == false)
     {
       if (img!=NULL) img->integrity = INTEGRITY_NOT_DECODED;
@@ -663,7 +1159,7 @@ de265_error decoder_context::read_slice_NAL(bitreader& reader, NAL_unit* nal, na
   // --- start a new image if this is the first slice ---
 
   if (shdr->first_slice_segment_in_pic_flag) {
-    image_unit* imgunit = new image_unit;
+    image_unit* imgunit = get_image_unit();
     imgunit->img = this->img;
     image_units.push_back(imgunit);
   }
@@ -673,7 +1169,7 @@ de265_error decoder_context::read_slice_NAL(bitreader& reader, NAL_unit* nal, na
 
   if ( ! image_units.empty() ) {
 
-    slice_unit* sliceunit = new slice_unit(this);
+    slice_unit* sliceunit = get_slice_unit();
     sliceunit->nal = nal;
     sliceunit->shdr = shdr;
     sliceunit->reader = reader;
@@ -751,6 +1247,18 @@ de265_error decoder_context::decode_some(bool* did_work)
     *did_work=true;
 
 
+    // wait for the slice segments that are still decoded in the background
+
+    finish_slice_segments(imgunit);
+
+    if (num_worker_threads > 0 &&
+        imgunit->img->get_pps().entropy_coding_sync_enabled_flag == false &&
+        imgunit->img->get_pps().tiles_enabled_flag == false &&
+        imgunit->slice_units.size() == 1) {
+      add_warning(DE265_WARNING_NO_WPP_CANNOT_USE_MULTITHREADING, true);
+    }
+
+
     // mark all CTBs as decoded even if they are not, because faulty input
     // streams could miss part of the picture
     // TODO: this will not work when slice decoding is parallel to post-filtering,
@@ -783,7 +1291,7 @@ de265_error decoder_context::decode_some(bool* did_work)
 
     // remove just decoded image unit from queue
 
-    delete imgunit;
+    recycle_image_unit(imgunit);
 
     pop_front(image_units);
   }
@@ -831,13 +1339,6 @@ de265_error decoder_context::decode_slice_unit_sequential(image_unit* imgunit,
                      sliceunit->reader.data,
                      sliceunit->reader.bytes_remaining);
 
-  // alloc CABAC-model array if entropy_coding_sync is enabled
-
-  if (imgunit->img->get_pps().entropy_coding_sync_enabled_flag &&
-      sliceunit->shdr->first_slice_segment_in_pic_flag) {
-    imgunit->ctx_models.resize( (img->get_sps().PicHeightInCtbsY-1) ); //* CONTEXT_MODEL_TABLE_LENGTH );
-  }
-
   sliceunit->nThreads=1;
 
   err=read_slice_segment_data(&tctx);
@@ -894,36 +1395,36 @@ de265_error decoder_context::decode_slice_unit_parallel(image_unit* imgunit,
 
   de265_image* img = imgunit->img;
   const pic_parameter_set& pps = img->get_pps();
-
-  sliceunit->state = slice_unit::InProgress;
-
-  bool use_WPP = (img->decctx->num_worker_threads > 0 &&
-                  pps.entropy_coding_sync_enabled_flag);
-
-  bool use_tiles = (img->decctx->num_worker_threads > 0 &&
-                    pps.tiles_enabled_flag);
+  slice_segment_header* shdr = sliceunit->shdr;
 
 
-  // TODO: remove this warning later when we do frame-parallel decoding
-  if (img->decctx->num_worker_threads > 0 &&
-      pps.entropy_coding_sync_enabled_flag == false &&
-      pps.tiles_enabled_flag == false) {
+  // A dependent slice segment continues with the CABAC models at the end of the
+  // previous slice segment. Let the slice segments that are still being decoded
+  // in the background finish first.
 
-    img->decctx->add_warning(DE265_WARNING_NO_WPP_CANNOT_USE_MULTITHREADING, true);
+  if (shdr->dependent_slice_segment_flag) {
+    finish_slice_segments(imgunit);
   }
 
+  sliceunit->state = slice_unit::InProgress;
+
 
   // If this is the first slice segment, mark all CTBs before this as processed
   // (the real first slice segment could be missing).
 
   if (imgunit->is_first_slice_segment(sliceunit)) {
-    slice_segment_header* shdr = sliceunit->shdr;
     int firstCTB = shdr->slice_segment_address;
 
     for (int ctb=0;ctb<firstCTB;ctb++) {
       //printf("mark pre progress %d\n",ctb);
       img->ctb_progress[ctb].set_progress(CTB_PROGRESS_PREFILTER);
     }
+
+    // reserve space to store entropy coding context models for each CTB row in each tile
+
+    if (pps.entropy_coding_sync_enabled_flag) {
+      imgunit->ctx_models.resize( img->get_sps().PicHeightInCtbsY * pps.num_tile_columns );
+    }
   }
 
 
@@ -938,9 +1439,7 @@ de265_error decoder_context::decode_slice_unit_parallel(image_unit* imgunit,
   }
 
 
-  // TODO: even though we cannot split this into several tasks, we should run it
-  // as a background thread
-  if (!use_WPP && !use_tiles) {
+  if (img->decctx->num_worker_threads == 0) {
     //printf("SEQ\n");
     err = decode_slice_unit_sequential(imgunit, sliceunit);
     sliceunit->state = slice_unit::Decoded;
@@ -949,35 +1448,48 @@ de265_error decoder_context::decode_slice_unit_parallel(image_unit* imgunit,
   }
 
 
-  if (use_WPP && use_tiles) {
-    // TODO: this is not allowed ... output some warning or error
+  // Start a task for each substream. We do not wait for them, such that the
+  // next independent slice segments can be decoded in parallel.
 
-    return DE265_WARNING_PPS_HEADER_INVALID;
-  }
+  err = decode_slice_unit_substreams(imgunit, sliceunit);
 
+  // The tasks of a dependent slice segment access the previous slice segments
+  // while they start. Finish them before the main thread adds new slice segments.
 
-  if (use_WPP) {
-    //printf("WPP\n");
-    err = decode_slice_unit_WPP(imgunit, sliceunit);
-    sliceunit->state = slice_unit::Decoded;
-    mark_whole_slice_as_processed(imgunit,sliceunit,CTB_PROGRESS_PREFILTER);
-    return err;
-  }
-  else if (use_tiles) {
-    //printf("TILE\n");
-    err = decode_slice_unit_tiles(imgunit, sliceunit);
-    sliceunit->state = slice_unit::Decoded;
-    mark_whole_slice_as_processed(imgunit,sliceunit,CTB_PROGRESS_PREFILTER);
-    return err;
+  if (shdr->dependent_slice_segment_flag) {
+    finish_slice_segments(imgunit);
   }
 
-  assert(false);
   return err;
 }
 
 
-de265_error decoder_context::decode_slice_unit_WPP(image_unit* imgunit,
-                                                   slice_unit* sliceunit)
+/* Get the first CTB (in tile-scan) of the substream that follows the substream
+   containing 'ctbAddrTS'. A new substream starts at each tile and, with WPP, at
+   each CTB row within a tile.
+ */
+int get_next_substream_start(const pic_parameter_set& pps, int ctbsWidth, int ctbAddrTS)
+{
+  int nCtbs = pps.CtbAddrTStoRS.size();
+
+  for (int ts=ctbAddrTS+1; ts<nCtbs; ts++) {
+    if (pps.tiles_enabled_flag &&
+        pps.TileId[ts] != pps.TileId[ts-1]) {
+      return ts;
+    }
+
+    if (pps.entropy_coding_sync_enabled_flag &&
+        pps.CtbAddrTStoRS[ts] / ctbsWidth != pps.CtbAddrTStoRS[ts-1] / ctbsWidth) {
+      return ts;
+    }
+  }
+
+  return nCtbs;
+}
+
+
+de265_error decoder_context::decode_slice_unit_substreams(image_unit* imgunit,
+                                                          slice_unit* sliceunit)
 {
   de265_error err = DE265_OK;
 
@@ -985,35 +1497,36 @@ de265_error decoder_context::decode_slice_unit_WPP(image_unit* imgunit,
   slice_segment_header* shdr = sliceunit->shdr;
   const pic_parameter_set& pps = img->get_pps();
 
-  int nRows = shdr->num_entry_point_offsets +1;
+  int nSubstreams = shdr->num_entry_point_offsets +1;
   int ctbsWidth = img->get_sps().PicWidthInCtbsY;
 
-
-  assert(img->num_threads_active() == 0);
-
-
-  // reserve space to store entropy coding context models for each CTB row
-
-  if (shdr->first_slice_segment_in_pic_flag) {
-    // reserve space for nRows-1 because we don't need to save the CABAC model in the last CTB row
-    imgunit->ctx_models.resize( (img->get_sps().PicHeightInCtbsY-1) ); //* CONTEXT_MODEL_TABLE_LENGTH );
+  if ((size_t)shdr->slice_segment_address >= pps.CtbAddrRStoTS.size()) {
+    return DE265_ERROR_CTB_OUTSIDE_IMAGE_AREA;
   }
 
 
-  sliceunit->allocate_thread_contexts(nRows);
+  sliceunit->allocate_thread_contexts(nSubstreams);
 
 
   // first CTB in this slice
-  int ctbAddrRS = shdr->slice_segment_address;
-  int ctbRow    = ctbAddrRS / ctbsWidth;
+  int ctbAddrTS = pps.CtbAddrRStoTS[shdr->slice_segment_address];
 
-  for (int entryPt=0;entryPt<nRows;entryPt++) {
-    // entry points other than the first start at CTB rows
+  for (int entryPt=0;entryPt<nSubstreams;entryPt++) {
+    // entry points other than the first start at tile beginnings or CTB rows
     if (entryPt>0) {
-      ctbRow++;
-      ctbAddrRS = ctbRow * ctbsWidth;
+      ctbAddrTS = get_next_substream_start(pps, ctbsWidth, ctbAddrTS);
+
+      if ((size_t)ctbAddrTS >= pps.CtbAddrTStoRS.size()) {
+        err = DE265_WARNING_SLICEHEADER_INVALID;
+        break;
+      }
     }
-    else if (nRows>1 && (ctbAddrRS % ctbsWidth) != 0) {
+
+    int ctbAddrRS = pps.CtbAddrTStoRS[ctbAddrTS];
+
+    if (entryPt==0 && nSubstreams>1 &&
+        pps.entropy_coding_sync_enabled_flag &&
+        (ctbAddrRS % ctbsWidth) != pps.colBd[ pps.TileIdRS[ctbAddrRS] % pps.num_tile_columns ]) {
       // If slice segment consists of several WPP rows, each of them
       // has to start at a row.
 
@@ -1033,7 +1546,7 @@ de265_error decoder_context::decode_slice_unit_WPP(image_unit* imgunit,
     tctx->img     = img;
     tctx->imgunit = imgunit;
     tctx->sliceunit= sliceunit;
-    tctx->CtbAddrInTS = pps.CtbAddrRStoTS[ctbAddrRS];
+    tctx->CtbAddrInTS = ctbAddrTS;
 
     init_thread_context(tctx);
 
@@ -1045,12 +1558,12 @@ de265_error decoder_context::decode_slice_unit_WPP(image_unit* imgunit,
     else            { dataStartIndex=shdr->entry_point_offset[entryPt-1]; }
 
     int dataEnd;
-    if (entryPt==nRows-1) dataEnd = sliceunit->reader.bytes_remaining;
-    else                  dataEnd = shdr->entry_point_offset[entryPt];
+    if (entryPt==nSubstreams-1) dataEnd = sliceunit->reader.bytes_remaining;
+    else                        dataEnd = shdr->entry_point_offset[entryPt];
 
     if (dataStartIndex<0 || dataEnd>sliceunit->reader.bytes_remaining ||
         dataEnd <= dataStartIndex) {
-      //printf("WPP premature end\n");
+      //printf("premature end\n");
       err = DE265_ERROR_PREMATURE_END_OF_SLICE;
       break;
     }
@@ -1061,123 +1574,37 @@ de265_error decoder_context::decode_slice_unit_WPP(image_unit* imgunit,
 
     // add task
 
-    //printf("start task for ctb-row: %d\n",ctbRow);
     img->thread_start(1);
     sliceunit->nThreads++;
-    add_task_decode_CTB_row(tctx, entryPt==0, ctbRow);
-  }
-
-#if 0
-  for (;;) {
-    printf("q:%d r:%d b:%d f:%d\n",
-           img->nThreadsQueued,
-           img->nThreadsRunning,
-           img->nThreadsBlocked,
-           img->nThreadsFinished);
 
-    if (img->debug_is_completed()) break;
-
-    usleep(1000);
+    if (pps.entropy_coding_sync_enabled_flag) {
+      //printf("start task for ctb-row: %d\n",ctbAddrRS / ctbsWidth);
+      add_task_decode_CTB_row(tctx, entryPt==0, ctbAddrRS / ctbsWidth);
+    }
+    else {
+      //printf("add tiles thread\n");
+      add_task_decode_slice_segment(tctx, entryPt==0,
+                                    ctbAddrRS % ctbsWidth,
+                                    ctbAddrRS / ctbsWidth);
+    }
   }
-#endif
-
-  img->wait_for_completion();
 
-  for (int i=0;i<imgunit->tasks.size();i++)
-    delete imgunit->tasks[i];
-  imgunit->tasks.clear();
-
-  return DE265_OK;
+  return err;
 }
 
-de265_error decoder_context::decode_slice_unit_tiles(image_unit* imgunit,
-                                                     slice_unit* sliceunit)
-{
-  de265_error err = DE265_OK;
-
-  de265_image* img = imgunit->img;
-  slice_segment_header* shdr = sliceunit->shdr;
-  const pic_parameter_set& pps = img->get_pps();
-
-  int nTiles = shdr->num_entry_point_offsets +1;
-  int ctbsWidth = img->get_sps().PicWidthInCtbsY;
-
-
-  assert(img->num_threads_active() == 0);
-
-  sliceunit->allocate_thread_contexts(nTiles);
-
-
-  // first CTB in this slice
-  int ctbAddrRS = shdr->slice_segment_address;
-  int tileID = pps.TileIdRS[ctbAddrRS];
-
-  for (int entryPt=0;entryPt<nTiles;entryPt++) {
-    // entry points other than the first start at tile beginnings
-    if (entryPt>0) {
-      tileID++;
 
-      if (tileID >= pps.num_tile_columns * pps.num_tile_rows) {
-        err = DE265_WARNING_SLICEHEADER_INVALID;
-        break;
-      }
-
-      int ctbX = pps.colBd[tileID % pps.num_tile_columns];
-      int ctbY = pps.rowBd[tileID / pps.num_tile_columns];
-      ctbAddrRS = ctbY * ctbsWidth + ctbX;
-    }
-
-    // set thread context
-
-    thread_context* tctx = sliceunit->get_thread_context(entryPt);
-
-    tctx->shdr   = shdr;
-    tctx->decctx = img->decctx;
-    tctx->img    = img;
-    tctx->imgunit = imgunit;
-    tctx->sliceunit= sliceunit;
-    tctx->CtbAddrInTS = pps.CtbAddrRStoTS[ctbAddrRS];
-
-    init_thread_context(tctx);
-
-
-    // init CABAC
-
-    int dataStartIndex;
-    if (entryPt==0) { dataStartIndex=0; }
-    else            { dataStartIndex=shdr->entry_point_offset[entryPt-1]; }
+void decoder_context::finish_slice_segments(image_unit* imgunit)
+{
+  imgunit->img->wait_for_completion();
 
-    int dataEnd;
-    if (entryPt==nTiles-1) dataEnd = sliceunit->reader.bytes_remaining;
-    else                   dataEnd = shdr->entry_point_offset[entryPt];
+  for (size_t i=0;i<imgunit->slice_units.size();i++) {
+    slice_unit* sliceunit = imgunit->slice_units[i];
 
-    if (dataStartIndex<0 || dataEnd>sliceunit->reader.bytes_remaining ||
-        dataEnd <= dataStartIndex) {
-      err = DE265_ERROR_PREMATURE_END_OF_SLICE;
-      break;
+    if (sliceunit->state == slice_unit::InProgress) {
+      sliceunit->state = slice_unit::Decoded;
+      mark_whole_slice_as_processed(imgunit,sliceunit,CTB_PROGRESS_PREFILTER);
     }
-
-    init_CABAC_decoder(&tctx->cabac_decoder,
-                       &sliceunit->reader.data[dataStartIndex],
-                       dataEnd-dataStartIndex);
-
-    // add task
-
-    //printf("add tiles thread\n");
-    img->thread_start(1);
-    sliceunit->nThreads++;
-    add_task_decode_slice_segment(tctx, entryPt==0,
-                                  ctbAddrRS % ctbsWidth,
-                                  ctbAddrRS / ctbsWidth);
   }
-
-  img->wait_for_completion();
-
-  for (int i=0;i<imgunit->tasks.size();i++)
-    delete imgunit->tasks[i];
-  imgunit->tasks.clear();
-
-  return err;
 }
 
 
@@ -1231,17 +1658,17 @@ de265_error decoder_context::decode_NAL(NAL_unit* nal)
   }
   else switch (nal_hdr.nal_unit_type) {
     case NAL_UNIT_VPS_NUT:
-      err = read_vps_NAL(reader);
+      err = read_vps_NAL(reader, nal);
       nal_parser.free_NAL_unit(nal);
       break;
 
     case NAL_UNIT_SPS_NUT:
-      err = read_sps_NAL(reader);
+      err = read_sps_NAL(reader, nal);
       nal_parser.free_NAL_unit(nal);
       break;
 
     case NAL_UNIT_PPS_NUT:
-      err = read_pps_NAL(reader);
+      err = read_pps_NAL(reader, nal);
       nal_parser.free_NAL_unit(nal);
       break;
 
@@ -2230,6 +2657,8 @@ void decoder_context::calc_tid_and_framerate_ratio()
 
 void error_queue::add_warning(de265_error warning, bool once)
 {
+  de265_mutex_lock(&mutex);
+
   // check if warning was already shown
   bool add=true;
   if (once) {
@@ -2242,6 +2671,7 @@ void error_queue::add_warning(de265_error warning, bool once)
   }
 
   if (!add) {
+    de265_mutex_unlock(&mutex);
     return;
   }
 
@@ -2259,27 +2689,40 @@ void error_queue::add_warning(de265_error warning, bool once)
 
   if (nWarnings == MAX_WARNINGS) {
     warnings[MAX_WARNINGS-1] = DE265_WARNING_WARNING_BUFFER_FULL;
-    return;
+  }
+  else {
+    warnings[nWarnings++] = warning;
   }
 
-  warnings[nWarnings++] = warning;
+  de265_mutex_unlock(&mutex);
 }
 
 error_queue::error_queue()
 {
   nWarnings = 0;
   nWarningsShown = 0;
+
+  de265_mutex_init(&mutex);
+}
+
+error_queue::~error_queue()
+{
+  de265_mutex_destroy(&mutex);
 }
 
 de265_error error_queue::get_warning()
 {
-  if (nWarnings==0) {
-    return DE265_OK;
+  de265_mutex_lock(&mutex);
+
+  de265_error warn = DE265_OK;
+
+  if (nWarnings>0) {
+    warn = warnings[0];
+    nWarnings--;
+    memmove(warnings, &warnings[1], nWarnings*sizeof(de265_error));
   }
 
-  de265_error warn = warnings[0];
-  nWarnings--;
-  memmove(warnings, &warnings[1], nWarnings*sizeof(de265_error));
+  de265_mutex_unlock(&mutex);
 
   return warn;
 }
@@ -36,6 +36,7 @@
 #include "libde265/nal-parser.h"
 
 #include <memory>
+#include <deque>
 
 #define DE265_MAX_VPS_SETS 16   // this is the maximum as defined in the standard
 #define DE265_MAX_SPS_SETS 16   // this is the maximum as defined in the standard
@@ -44,10 +45,32 @@
 #define MAX_WARNINGS 20
 
 
+/* Raw (RBSP) data of a parameter set NAL. Streams often repeat unchanged parameter
+   sets, e.g. before each IRAP picture. These repetitions are detected by comparing
+   with the data of the currently stored set and are not parsed again.
+ */
+class parameter_set_NAL
+{
+ public:
+  parameter_set_NAL() : mHash(0) { }
+
+  static uint32_t compute_hash(const NAL_unit* nal);
+
+  bool is_identical(uint32_t hash, const NAL_unit* nal) const;
+  void set(uint32_t hash, const NAL_unit* nal);
+
+ private:
+  uint32_t mHash;
+  std::vector<uint8_t> mData;
+};
+
+
 class slice_segment_header;
 class image_unit;
 class slice_unit;
 class decoder_context;
+class thread_task_deblock_CTBRow;
+class thread_task_sao;
 
 
 class thread_context
@@ -55,6 +78,8 @@ class thread_context
 public:
   thread_context();
 
+  void reset(); // prepare for reuse in the next slice segment
+
   int CtbAddrInRS;
   int CtbAddrInTS;
 
@@ -64,6 +89,7 @@ public:
   // motion vectors
 
   PBMotionCoding motion;
+  MergeCandidateCache mergeCandidateCache;
 
 
   // prediction
@@ -84,9 +110,11 @@ public:
   int16_t _coeffBuf[(32*32)+8];
   int16_t *coeffBuf; // the base pointer for into _coeffBuf, aligned to 16 bytes
 
-  int16_t coeffList[3][32*32];
-  int16_t coeffPos[3][32*32];
-  int16_t nCoeff[3];
+  // The coefficients are written (already scaled) into coeffBuf by residual_coding().
+  // After reconstruction, only the coded sub-blocks have to be cleared again.
+  int16_t coeffExtent; // OR of the x/y positions of all coefficients (see transform_coefficients())
+  int16_t nCodedSubBlocks;
+  int16_t codedSubBlockPos[8*8]; // position of the top-left coefficient in coeffBuf
 
   int32_t residual_luma[32*32]; // only used when cross-comp-prediction is enabled
 
@@ -124,15 +152,20 @@ private:
 
 
 
+/* Warnings are added by the decoding threads (including the dispatcher thread in
+   asynchronous mode) and read by the API thread, hence all accesses are locked. */
 class error_queue
 {
  public:
   error_queue();
+  ~error_queue();
 
   void add_warning(de265_error warning, bool once);
   de265_error get_warning();
 
  private:
+  de265_mutex mutex;
+
   de265_error warnings[MAX_WARNINGS];
   int nWarnings;
   de265_error warnings_shown[MAX_WARNINGS]; // warnings that have already occurred
@@ -147,6 +180,8 @@ public:
   slice_unit(decoder_context* decctx);
   ~slice_unit();
 
+  void reset(); // release the NAL and prepare for reuse (keeps the thread contexts)
+
   NAL_unit* nal;   // we are the owner
   slice_segment_header* shdr;  // not the owner (de265_image is owner)
   bitreader reader;
@@ -180,6 +215,7 @@ private:
   thread_context* thread_contexts; /* NOTE: cannot use std::vector, because thread_context has
                                       no copy constructor. */
   int nThreadContexts;
+  int nThreadContextsAllocated; // the array is only reallocated when it has to grow
 
 public:
   decoder_context* ctx;
@@ -196,6 +232,8 @@ public:
   image_unit();
   ~image_unit();
 
+  void reset(); // prepare for reuse, slice units have to be removed before
+
   de265_image* img;
   de265_image  sao_output; // if SAO is used, this is allocated and used as SAO output buffer
 
@@ -261,7 +299,12 @@ public:
          Dropped         // will not be decoded
   } state;
 
-  std::vector<thread_task*> tasks; // we are the owner
+  // All tasks of this picture. They are kept when the image_unit is recycled.
+
+  task_arena<thread_task_ctb_row>        ctb_row_tasks;
+  task_arena<thread_task_slice_segment>  slice_segment_tasks;
+  task_arena<thread_task_deblock_CTBRow> deblock_tasks;
+  task_arena<thread_task_sao>            sao_tasks;
 
   /* Saved context models for WPP.
      There is one saved model for the initialization of each CTB row.
@@ -288,13 +331,28 @@ class base_context : public error_queue
 };
 
 
+/* Input that has been pushed into a decoder in asynchronous mode, but which
+   has not been forwarded to the NAL parser by the dispatcher thread yet. */
+class async_input
+{
+ public:
+  enum input_type { Data, NAL, EndOfNAL, EndOfFrame, EndOfStream, Reset } type;
+
+  std::vector<uint8_t> data;
+  de265_PTS pts;
+  void* user_data;
+};
+
+
 class decoder_context : public base_context {
  public:
   decoder_context();
   ~decoder_context();
 
   de265_error start_thread_pool(int nThreads);
-  void        stop_thread_pool();
+  de265_error attach_thread_pool(thread_pool* pool); // use a pool shared with other decoders
+  void        stop_thread_pool(); // stops our own pool or detaches from the shared one
+  void        set_thread_pool_priority(int priority);
 
   void reset();
 
@@ -325,8 +383,10 @@ class decoder_context : public base_context {
 
   de265_error decode_slice_unit_sequential(image_unit* imgunit, slice_unit* sliceunit);
   de265_error decode_slice_unit_parallel(image_unit* imgunit, slice_unit* sliceunit);
-  de265_error decode_slice_unit_WPP(image_unit* imgunit, slice_unit* sliceunit);
-  de265_error decode_slice_unit_tiles(image_unit* imgunit, slice_unit* sliceunit);
+  de265_error decode_slice_unit_substreams(image_unit* imgunit, slice_unit* sliceunit);
+
+  // wait for all slice segments of the image unit that are decoded in the background
+  void finish_slice_segments(image_unit* imgunit);
 
 
   void process_nal_hdr(nal_header*);
@@ -377,10 +437,50 @@ class decoder_context : public base_context {
   int          num_pictures_in_output_queue() const { return dpb.num_pictures_in_output_queue(); }
   void         pop_next_picture_in_output_queue() { dpb.pop_next_picture_in_output_queue(); }
 
+
+  // --- asynchronous decoding ---
+
+  /* Start the dispatcher thread. From then on, input is only queued by push_async_input()
+     and decoded pictures are handed to the callback. They stay valid until
+     release_async_picture() is called. */
+  de265_error start_async_decoding(de265_picture_callback callback, void* userdata);
+  void        stop_async_decoding(); // waits until the dispatcher thread has ended
+
+  bool is_async_decoding() const { return async_running; }
+
+  void push_async_input(async_input* input); // we get the owner
+  void release_async_picture(const de265_image* img);
+
+  int  num_async_input_bytes_pending();
+  int  num_async_inputs_pending();
+
+  void run_async_dispatcher(); // main loop of the dispatcher thread
+
+ private:
+  void process_async_input(async_input* input);
+  void output_async_pictures();
+
+  bool async_running;
+  bool async_stop;    // request to end the dispatcher thread
+  bool async_decoder_idle; // no progress possible without new input or released pictures
+
+  de265_thread async_thread;
+  de265_mutex  async_mutex;  // protects async_inputs, async_released_pictures, async_stop
+  de265_cond   async_cond;
+
+  std::deque<async_input*>  async_inputs;
+  std::vector<de265_image*> async_released_pictures;
+  int async_input_bytes;
+
+  de265_picture_callback async_callback;
+  void*                  async_callback_userdata;
+
+ public:
+
  private:
-  de265_error read_vps_NAL(bitreader&);
-  de265_error read_sps_NAL(bitreader&);
-  de265_error read_pps_NAL(bitreader&);
+  de265_error read_vps_NAL(bitreader&, const NAL_unit* nal);
+  de265_error read_sps_NAL(bitreader&, const NAL_unit* nal);
+  de265_error read_pps_NAL(bitreader&, const NAL_unit* nal);
   de265_error read_sei_NAL(bitreader& reader, bool suffix);
   de265_error read_eos_NAL(bitreader& reader);
   de265_error read_slice_NAL(bitreader&, NAL_unit* nal, nal_header& nal_hdr);
@@ -392,12 +492,19 @@ class decoder_context : public base_context {
   std::shared_ptr<seq_parameter_set>    sps[ DE265_MAX_SPS_SETS ];
   std::shared_ptr<pic_parameter_set>    pps[ DE265_MAX_PPS_SETS ];
 
+  parameter_set_NAL vps_nal[ DE265_MAX_VPS_SETS ];
+  parameter_set_NAL sps_nal[ DE265_MAX_SPS_SETS ];
+  parameter_set_NAL pps_nal[ DE265_MAX_PPS_SETS ];
+
   std::shared_ptr<video_parameter_set>  current_vps;
   std::shared_ptr<seq_parameter_set>    current_sps;
   std::shared_ptr<pic_parameter_set>    current_pps;
 
  public:
-  thread_pool thread_pool_;
+  slice_ref_pic_set_cache slice_rps_cache; // used when reading the slice headers
+
+  thread_pool thread_pool_;       // own pool, only used when started with start_thread_pool()
+  thread_task_queue task_queue_;  // our pending tasks in either the own or a shared pool
 
  private:
   int num_worker_threads;
@@ -502,6 +609,17 @@ class decoder_context : public base_context {
 
   bool flush_reorder_buffer_at_this_frame;
 
+ private:
+  /* Retired image_units and slice_units are kept here for reuse, together with
+     their task objects and thread_context arrays. */
+  std::vector<image_unit*> free_image_units;
+  std::vector<slice_unit*> free_slice_units;
+
+  image_unit* get_image_unit();
+  slice_unit* get_slice_unit();
+  void        recycle_image_unit(image_unit*);
+  void        free_recycled_units();
+
  private:
   void init_thread_context(thread_context* tctx);
   void add_task_decode_CTB_row(thread_context* tctx, bool firstSliceSubstream, int ctbRow);
@@ -525,4 +643,9 @@ class decoder_context : public base_context {
 };
 
 
+/* Get the first CTB (in tile-scan) of the substream that follows the substream
+   containing 'ctbAddrTS'. Returns the number of CTBs if there is none. */
+int get_next_substream_start(const pic_parameter_set& pps, int ctbsWidth, int ctbAddrTS);
+
+
 #endif
@@ -167,6 +167,11 @@ LIBDE265_API de265_error en265_start_encoder(en265_encoder_context* e, int numbe
   assert(e);
   encoder_context* ectx = (encoder_context*)e;
 
+  // the threads are used for encoding several pictures in parallel
+  if (number_of_threads > 1 && ectx->params.frame_threads == 1) {
+    ectx->params.frame_threads.set(libde265_min(number_of_threads, MAX_THREADS));
+  }
+
   ectx->start_encoder();
 
   return DE265_OK;
@@ -220,7 +225,7 @@ LIBDE265_API de265_error en265_push_image(en265_encoder_context* e,
   assert(e);
   encoder_context* ectx = (encoder_context*)e;
 
-  ectx->sop->insert_new_input_image(img);
+  ectx->push_input_image(img);
   return DE265_OK;
 }
 
@@ -230,7 +235,7 @@ LIBDE265_API de265_error en265_push_eof(en265_encoder_context* e)
   assert(e);
   encoder_context* ectx = (encoder_context*)e;
 
-  ectx->sop->insert_end_of_stream();
+  ectx->push_end_of_stream();
   return DE265_OK;
 }
 
@@ -260,12 +265,18 @@ LIBDE265_API de265_error en265_encode(en265_encoder_context* e)
   assert(e);
   encoder_context* ectx = (encoder_context*)e;
 
+  ectx->move_lookahead_images_to_sop();
+
   while (ectx->picbuf.have_more_frames_to_encode())
     {
       de265_error result = ectx->encode_picture_from_input_buffer();
       if (result != DE265_OK) return result;
     }
 
+  // pictures may still be running in the frame threads, wait for them at the end of the stream
+
+  ectx->finish_encoded_pictures(ectx->picbuf.is_end_of_stream());
+
   return DE265_OK;
 }
 
@@ -282,6 +293,8 @@ LIBDE265_API struct en265_packet* en265_get_packet(en265_encoder_context* e, int
 
   assert(timeout_ms==0); // TODO: blocking not implemented yet
 
+  ectx->finish_encoded_pictures(false);
+
   if (ectx->output_packets.size()>0) {
     en265_packet* pck = ectx->output_packets.front();
     ectx->output_packets.pop_front();
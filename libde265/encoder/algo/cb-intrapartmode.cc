@@ -107,6 +107,14 @@ enc_cb* Algo_CB_IntraPartMode_BruteForce::analyze(encoder_context* ectx,
       }
 
       option[p].end();
+
+
+      // --- early termination: NxN cannot improve on a 2Nx2N CB without residual ---
+
+      if (p==0 && option[1] && mParams.zeroResidualTermination &&
+          cb->transform_tree->isZeroBlock()) {
+        option[1] = CodingOption<enc_cb>();
+      }
     }
 
   options.compute_rdo_costs();
@@ -94,11 +94,31 @@ class Algo_CB_IntraPartMode : public Algo_CB
 class Algo_CB_IntraPartMode_BruteForce : public Algo_CB_IntraPartMode
 {
  public:
+  struct params
+  {
+    params() {
+      zeroResidualTermination.set_ID("CB-IntraPartMode-BruteForce-ZeroResidualTermination");
+      zeroResidualTermination.set_default(false);
+    }
+
+    option_bool zeroResidualTermination; // do not try NxN if 2Nx2N codes no residual
+  };
+
+  void setParams(const params& p) { mParams=p; }
+  params& getParams() { return mParams; }
+
+  void registerParams(config_parameters& config) {
+    config.add_option(&mParams.zeroResidualTermination);
+  }
+
   virtual enc_cb* analyze(encoder_context*,
                           context_model_table&,
                           enc_cb* cb);
 
   virtual const char* name() const { return "cb-intrapartmode-bruteforce"; }
+
+ private:
+  params mParams;
 };
 
 
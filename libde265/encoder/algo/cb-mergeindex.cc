@@ -80,6 +80,15 @@ enc_cb* Algo_CB_MergeIndex_Fixed::analyze(encoder_context* ectx,
   const PBMotion& vec = mergeCandList[spec.merge_idx];
   cb->inter.pb[partIdx].motion = vec;
 
+  // the references may still be encoded in other frame threads (+4 rows for the interpolation)
+
+  for (int l=0;l<2;l++) {
+    if (vec.predFlag[l]) {
+      const de265_image* ref = ectx->get_image(ectx->shdr->RefPicList[l][vec.refIdx[l]]);
+      encoder_context::wait_for_reference_rows(ref, cb->y + (vec.mv[l].y>>2) + cbSize + 3);
+    }
+  }
+
   //ectx->img->set_mv_info(cb->x,cb->y, 1<<cb->log2Size,1<<cb->log2Size, vec);
 
   /*
@@ -167,7 +176,7 @@ enc_cb* Algo_CB_MergeIndex_Fixed::analyze(encoder_context* ectx,
              "pred ");
     */
 
-    cb->distortion = compute_distortion_ssd(input, ectx->img, x0,y0, cb->log2Size, 0);
+    cb->distortion = compute_distortion_ssd(ectx->acceleration, input, ectx->img, x0,y0, cb->log2Size, 0);
   }
 
   //printf("%d;%d rqt_root_cbf=%d\n",cb->x,cb->y,cb->inter.rqt_root_cbf);
@@ -82,6 +82,54 @@ enc_cb* Algo_CB_Split::encode_cb_split(encoder_context* ectx,
 
 
 
+static void get_depth_range(const enc_cb* cb, int* minDepth, int* maxDepth)
+{
+  if (cb->split_cu_flag) {
+    for (int i=0;i<4;i++)
+      if (cb->children[i]) {
+        get_depth_range(cb->children[i], minDepth, maxDepth);
+      }
+  }
+  else {
+    *minDepth = std::min(*minDepth, int(cb->ctDepth));
+    *maxDepth = std::max(*maxDepth, int(cb->ctDepth));
+  }
+}
+
+
+static bool has_coded_residual(const enc_tb* tb)
+{
+  if (tb->split_transform_flag) {
+    for (int i=0;i<4;i++)
+      if (has_coded_residual(tb->children[i])) {
+        return true;
+      }
+
+    return false;
+  }
+  else {
+    return !tb->isZeroBlock();
+  }
+}
+
+
+/* The coding options write their prediction mode and motion into the image while they
+   are analyzed. The selected CB has to be written again, because the following CBs
+   derive their merge candidates and motion vector predictors from it.
+ */
+static void write_motion_to_image(de265_image* img, const enc_cb* cb)
+{
+  img->set_pred_mode(cb->x,cb->y, cb->log2Size, cb->PredMode);
+
+  if (cb->PredMode != MODE_INTRA) {
+    assert(cb->PredMode == MODE_SKIP || cb->PartMode == PART_2Nx2N); // TODO: other partitionings
+
+    int nCS = 1<<cb->log2Size;
+    img->set_mv_info(cb->x,cb->y, nCS,nCS, cb->inter.pb[0].motion);
+  }
+}
+
+
 enc_cb* Algo_CB_Split_BruteForce::analyze(encoder_context* ectx,
                                           context_model_table& ctxModel,
                                           enc_cb* cb_input)
@@ -101,6 +149,37 @@ enc_cb* Algo_CB_Split_BruteForce::analyze(encoder_context* ectx,
   //if (can_split_CB) { can_nosplit_CB=false; } // TODO TMP
   //if (can_nosplit_CB) { can_split_CB=false; } // TODO TMP
 
+
+  // --- limit the CB depth to the range used in the neighbouring CTBs ---
+
+  /* The range is derived again for each CB instead of remembering it for the
+     whole CTB, because the algorithm is shared between the frame threads. */
+
+  if (mParams.neighbourDepthLimit && can_split_CB && can_nosplit_CB) {
+    int log2CtbSize = ectx->get_sps().Log2CtbSizeY;
+    int xCtb = cb_input->x >> log2CtbSize;
+    int yCtb = cb_input->y >> log2CtbSize;
+
+    int minDepth = std::numeric_limits<int>::max();
+    int maxDepth = -1;
+
+    if (xCtb>0 && ectx->ctbs.getCTB(xCtb-1,yCtb)) {
+      get_depth_range(ectx->ctbs.getCTB(xCtb-1,yCtb), &minDepth,&maxDepth);
+    }
+    if (yCtb>0 && ectx->ctbs.getCTB(xCtb,yCtb-1)) {
+      get_depth_range(ectx->ctbs.getCTB(xCtb,yCtb-1), &minDepth,&maxDepth);
+    }
+
+    if (maxDepth >= 0) {
+      if (cb_input->ctDepth <  minDepth-1) { can_nosplit_CB = false; }
+      if (cb_input->ctDepth >= maxDepth+1) { can_split_CB   = false; }
+    }
+  }
+
+  /* The input CB is the first option's node and may already be deleted
+     by the child algorithm when we evaluate splitting. Keep its link. */
+  enc_cb** downPtr = cb_input->downPtr;
+
   CodingOptions<enc_cb> options(ectx, cb_input, ctxModel);
 
   CodingOption<enc_cb> option_no_split = options.new_option(can_nosplit_CB);
@@ -122,7 +201,7 @@ enc_cb* Algo_CB_Split_BruteForce::analyze(encoder_context* ectx,
     opt.begin();
 
     enc_cb* cb = opt.get_node();
-    *cb_input->downPtr = cb;
+    *downPtr = cb;
 
     // set CB size in image data-structure
     //ectx->img->set_ctDepth(cb->x,cb->y,cb->log2Size, cb->ctDepth);
@@ -149,13 +228,34 @@ enc_cb* Algo_CB_Split_BruteForce::analyze(encoder_context* ectx,
     opt.end();
   }
 
+  // --- early termination: do not test splitting if the unsplit CB is already cheap ---
+
+  if (option_split && option_no_split) {
+    const enc_cb* cb = option_no_split.get_node();
+
+    if (mParams.zeroResidualTermination &&
+        (cb->PredMode == MODE_SKIP || !cb->transform_tree ||
+         !has_coded_residual(cb->transform_tree))) {
+      option_split = CodingOption<enc_cb>();
+    }
+    else if (mParams.rdCostThreshold > 0) {
+      float rdCost = cb->distortion + ectx->lambda * cb->rate;
+      float nSamples = 1<<(2*cb->log2Size);
+
+      if (rdCost < nSamples * ectx->lambda * mParams.rdCostThreshold / 100) {
+        option_split = CodingOption<enc_cb>();
+      }
+    }
+  }
+
+
   // --- encode with splitting ---
 
   if (option_split) {
     option_split.begin();
 
     enc_cb* cb = option_split.get_node();
-    *cb_input->downPtr = cb;
+    *downPtr = cb;
 
     cb = encode_cb_split(ectx, option_split.get_context(), cb);
 
@@ -172,6 +272,12 @@ enc_cb* Algo_CB_Split_BruteForce::analyze(encoder_context* ectx,
   options.compute_rdo_costs();
   enc_cb* bestCB = options.return_best_rdo_node();
 
+  // the CBs of a split are already written by their own decisions
+
+  if (!bestCB->split_cu_flag) {
+    write_motion_to_image(ectx->img, bestCB);
+  }
+
   //bestCB->debug_assertTreeConsistency(ectx->img);
 
   return bestCB;
@@ -78,11 +78,44 @@ class Algo_CB_Split : public Algo_CB
 class Algo_CB_Split_BruteForce : public Algo_CB_Split
 {
  public:
+  struct params
+  {
+    params() {
+      zeroResidualTermination.set_ID("CB-Split-BruteForce-ZeroResidualTermination");
+      zeroResidualTermination.set_default(false);
+
+      rdCostThreshold.set_ID("CB-Split-BruteForce-RDCostThreshold");
+      rdCostThreshold.set_range(0,1000);
+      rdCostThreshold.set_default(0);
+
+      neighbourDepthLimit.set_ID("CB-Split-BruteForce-NeighbourDepthLimit");
+      neighbourDepthLimit.set_default(false);
+    }
+
+    option_bool zeroResidualTermination; // do not try to split CBs without coded residual
+    option_int  rdCostThreshold;   // do not try to split CBs with an RD-cost per sample below this
+                                   // percentage of lambda (0: off)
+    option_bool neighbourDepthLimit; // limit CB depths to +/-1 of those in the left/above CTBs
+  };
+
+  void setParams(const params& p) { mParams=p; }
+
+  void registerParams(config_parameters& config) {
+    config.add_option(&mParams.zeroResidualTermination);
+    config.add_option(&mParams.rdCostThreshold);
+    config.add_option(&mParams.neighbourDepthLimit);
+  }
+
+  params& getParams() { return mParams; }
+
   virtual enc_cb* analyze(encoder_context*,
                           context_model_table&,
                           enc_cb* cb);
 
   const char* name() const { return "cb-split-bruteforce"; }
+
+ private:
+  params mParams;
 };
 
 #endif
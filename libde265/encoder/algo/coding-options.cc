@@ -32,6 +32,8 @@ CodingOptions<node>::CodingOptions(encoder_context* ectx, node* _node, context_m
   mContextModelInput = &tab;
 
   mBestRDO=-1;
+  mAdaptiveContext=false;
+  cabac=nullptr;
 
   mECtx = ectx;
 }
@@ -91,13 +93,15 @@ void CodingOptions<node>::start(enum RateEstimationMethod rateMethod)
     break;
   }
 
+  mAdaptiveContext = adaptiveContext;
+
   if (adaptiveContext) {
-    /* If we modify the context models in this algorithm,
-       we need separate models for each option.
+    /* If we modify the context models in this algorithm, we need separate
+       models for each option. These are not copied here, but only when an option
+       is actually evaluated (see CodingOption::begin()). Options that are never
+       evaluated do not need a copy at all, and the last evaluated option can take
+       over the input models without copying.
     */
-    for (auto& option : mOptions) {
-      option.context.decouple();
-    }
 
     cabac = &cabac_adaptive;
   }
@@ -177,6 +181,10 @@ void CodingOption<node>::begin()
   assert(mParent);
   assert(mParent->cabac); // did you call CodingOptions.start() ?
 
+  if (mParent->mAdaptiveContext) {
+    get_context().decouple();
+  }
+
   mParent->cabac->reset();
   mParent->cabac->set_context_models( &get_context() );
 
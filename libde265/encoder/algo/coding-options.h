@@ -86,6 +86,7 @@ class CodingOptions
   context_model_table* mContextModelInput;
 
   int mBestRDO;
+  bool mAdaptiveContext; // each option needs its own copy of the context models
 
   std::vector<CodingOptionData> mOptions;
 
@@ -44,6 +44,17 @@ enc_cb* Algo_CTB_QScale_Constant::analyze(encoder_context* ectx,
   cb->downPtr = ectx->ctbs.getCTBRootPointer(x,y);
   *cb->downPtr = cb;
 
+  // adaptive quantization offset from the lookahead
+
+  const std::vector<int8_t>& qpOffset = ectx->imgdata->ctbQPOffset;
+  if (!qpOffset.empty()) {
+    const seq_parameter_set& sps = ectx->get_sps();
+    int ctbAddrRS = (x>>sps.Log2CtbSizeY) + (y>>sps.Log2CtbSizeY)*sps.PicWidthInCtbsY;
+
+    ectx->active_qp = Clip3(-sps.QpBdOffset_Y,51, mParams.mQP + qpOffset[ctbAddrRS]);
+    ectx->lambda = encoder_context::lambda_from_QP(ectx->active_qp);
+  }
+
   cb->qp = ectx->active_qp;
 
   // write currently unused coding options
@@ -52,10 +63,11 @@ enc_cb* Algo_CTB_QScale_Constant::analyze(encoder_context* ectx,
 
   assert(mChildAlgo);
   descend(cb, "Q=%d",ectx->active_qp);
+  enc_cb** downPtr = cb->downPtr;  // 'cb' may be deleted by the child algorithm
   enc_cb* result_cb = mChildAlgo->analyze(ectx,ctxModel,cb);
   ascend();
 
-  *cb->downPtr = result_cb;
+  *downPtr = result_cb;
 
   return result_cb;
 }
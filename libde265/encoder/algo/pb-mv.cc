@@ -24,12 +24,63 @@
 #include "libde265/encoder/algo/pb-mv.h"
 #include "libde265/encoder/algo/coding-options.h"
 #include "libde265/encoder/encoder-context.h"
+#include "libde265/encoder/encoder-syntax.h"
+#include "libde265/encoder/algo/tb-split.h"
 #include <assert.h>
 #include <limits>
+#include <algorithm>
 #include <math.h>
 
 
 
+enc_cb* Algo_PB_MV::codeResidual(encoder_context* ectx,
+                                 context_model_table& ctxModel,
+                                 enc_cb* cb)
+{
+  assert(cb->PartMode == PART_2Nx2N); // TODO: other partitionings, see encode_coding_unit()
+  assert(mTBSplitAlgo);
+
+  // rate for part_mode and the motion data
+
+  CABAC_encoder_estim cabac;
+  cabac.set_context_models(&ctxModel);
+
+  encode_part_mode(ectx, &cabac, MODE_INTER, cb->PartMode, cb->log2Size);
+  encode_prediction_unit(ectx, &cabac, cb, 0, cb->x,cb->y, 1<<cb->log2Size,1<<cb->log2Size);
+
+  float rate_pb = cabac.getRDBits();
+  cabac.reset();
+
+
+  // code the residual to the prediction that has been written into the image
+
+  int IntraSplitFlag = 0;
+  int MaxTrafoDepth = ectx->get_sps().max_transform_hierarchy_depth_inter;
+
+  enc_tb* tb = new enc_tb(cb->x,cb->y,cb->log2Size,cb);
+  tb->downPtr = &cb->transform_tree;
+  cb->transform_tree = tb;
+
+  descend(cb,"residual");
+  cb->transform_tree = mTBSplitAlgo->analyze(ectx, ctxModel, ectx->imgdata->input, tb,
+                                             0, MaxTrafoDepth, IntraSplitFlag);
+  ascend();
+
+  cb->inter.rqt_root_cbf = ! cb->transform_tree->isZeroBlock();
+
+  cabac.write_CABAC_bit(CONTEXT_MODEL_RQT_ROOT_CBF, cb->inter.rqt_root_cbf);
+
+  cb->distortion = cb->transform_tree->distortion;
+  cb->rate       = rate_pb + cabac.getRDBits();
+
+  if (cb->inter.rqt_root_cbf) {
+    cb->rate += cb->transform_tree->rate;
+  }
+
+  return cb;
+}
+
+
 enc_cb* Algo_PB_MV_Test::analyze(encoder_context* ectx,
                                  context_model_table& ctxModel,
                                  enc_cb* cb,
@@ -93,75 +144,234 @@ enc_cb* Algo_PB_MV_Test::analyze(encoder_context* ectx,
 
   ectx->img->set_mv_info(x,y,w,h, vec);
 
-  /* TMP REMOVE: ectx->prediction does not exist anymore
-  generate_inter_prediction_samples(ectx, ectx->shdr, ectx->prediction,
+  // the reference may still be encoded in another frame thread (+4 rows for the interpolation)
+
+  const de265_image* refimg = ectx->get_image(ectx->shdr->RefPicList[0][0]);
+  encoder_context::wait_for_reference_rows(refimg, y + (vec.mv[0].y>>2) + h + 3);
+
+  generate_inter_prediction_samples(ectx, ectx->shdr, ectx->img,
                                     cb->x,cb->y, // int xC,int yC,
-                                    0,0,         // int xB,int yB,
+                                    x-cb->x,y-cb->y, // int xB,int yB,
                                     1<<cb->log2Size, // int nCS,
-                                    1<<cb->log2Size,
-                                    1<<cb->log2Size, // int nPbW,int nPbH,
+                                    w,h,         // int nPbW,int nPbH,
                                     &vec);
-  */
 
-  // TODO estimate rate for sending MV
+  return codeResidual(ectx, ctxModel, cb);
+}
 
-  int IntraSplitFlag = 0;
-  int MaxTrafoDepth = ectx->get_sps().max_transform_hierarchy_depth_inter;
 
-  mCodeResidual=true;
-  if (mCodeResidual) {
-    assert(mTBSplitAlgo);
-    assert(false);
-    /*
-    cb->transform_tree = mTBSplitAlgo->analyze(ectx,ctxModel, ectx->imgdata->input, NULL, cb,
-                                               cb->x,cb->y,cb->x,cb->y, cb->log2Size,0,
-                                               0, MaxTrafoDepth, IntraSplitFlag);
-    */
 
-    cb->inter.rqt_root_cbf = ! cb->transform_tree->isZeroBlock();
 
-    cb->distortion = cb->transform_tree->distortion;
-    cb->rate       = cb->transform_tree->rate;
+/* Approximate number of bits for one MVD component (in quarter samples):
+   abs_mvd_greater0/1 flags, sign and the EG1 remainder.
+ */
+static inline int mvd_bits(int d)
+{
+  if (d==0) return 1;
+
+  d = abs_value(d);
+
+  int nBits=0;
+  while (d>>nBits) nBits++;
+
+  return 2*nBits+1;
+}
+
+
+#define MAX_PB_SIZE 64
+
+/* State of the motion search for a single PB. Integer positions are given in
+   full samples, sub-sample positions in quarter samples. Both are relative to
+   the PB position.
+ */
+class mv_search
+{
+public:
+  const acceleration_functions* accel;
+
+  const uint8_t* input;
+  int inputStride;
+  const uint8_t* ref;
+  int refStride;
+
+  int x,y, pbW,pbH;
+  int picW,picH;
+
+  int minX,maxX, minY,maxY; // allowed full-sample MV range
+
+  MotionVector mvp[2];
+  float lambda;
+
+  int bestX,bestY; // full samples
+  int bestCost;
+
+  int rate(int mvx,int mvy) const {
+    int b0 = mvd_bits(mvx-mvp[0].x) + mvd_bits(mvy-mvp[0].y);
+    int b1 = mvd_bits(mvx-mvp[1].x) + mvd_bits(mvy-mvp[1].y);
+    return std::min(b0,b1);
   }
-  else {
-    const de265_image* input = ectx->imgdata->input;
-    /* TODO TMP REMOVE: prediction does not exist anymore
-    de265_image* img   = ectx->prediction;
-    int x0 = cb->x;
-    int y0 = cb->y;
-    int tbSize = 1<<cb->log2Size;
-
-    cb->distortion = compute_distortion_ssd(input, img, x0,y0, cb->log2Size, 0);
-    cb->rate = 5; // fake (MV)
-
-    cb->inter.rqt_root_cbf = 0;
-    */
+
+  // Evaluate full-sample position. Returns true if it is the new best one.
+  bool check(int mx,int my) {
+    if (mx<minX || mx>maxX || my<minY || my>maxY) return false;
+
+    int cost = accel->sad_8(ref + (y+my)*refStride + x+mx, refStride,
+                            input + y*inputStride + x, inputStride,
+                            pbW,pbH);
+    cost += (int)(lambda * rate(mx<<2, my<<2));
+
+    if (cost<bestCost) {
+      bestCost=cost;
+      bestX=mx;
+      bestY=my;
+      return true;
+    }
+
+    return false;
   }
 
-  return cb;
+  void check_predictor(const MotionVector& mv) {
+    check((mv.x+2)>>2, (mv.y+2)>>2);
+  }
+
+  void full_search();
+  void small_diamond_search(int maxIter);
+  void large_diamond_search(int maxIter);
+  void hexagon_search(int maxIter);
+
+  int  subpel_cost(int bitDepth, int mvx,int mvy) const;
+  void subpel_refinement(int bitDepth, int* mvx, int* mvy) const;
+};
+
+
+void mv_search::full_search()
+{
+  for (int my=minY; my<=maxY; my++)
+    for (int mx=minX; mx<=maxX; mx++) {
+      check(mx,my);
+    }
+}
+
+
+void mv_search::small_diamond_search(int maxIter)
+{
+  for (int i=0;i<maxIter;i++) {
+    int cx=bestX, cy=bestY;
+
+    check(cx-1,cy);
+    check(cx+1,cy);
+    check(cx,cy-1);
+    check(cx,cy+1);
+
+    if (cx==bestX && cy==bestY) break;
+  }
+}
+
+
+void mv_search::large_diamond_search(int maxIter)
+{
+  static const int8_t ldsp[8][2] = { { 0,-2}, { 1,-1}, { 2,0}, { 1,1},
+                                     { 0, 2}, {-1, 1}, {-2,0}, {-1,-1} };
+
+  for (int i=0;i<maxIter;i++) {
+    int cx=bestX, cy=bestY;
+
+    for (int k=0;k<8;k++) {
+      check(cx+ldsp[k][0], cy+ldsp[k][1]);
+    }
+
+    if (cx==bestX && cy==bestY) break;
+  }
+
+  small_diamond_search(1);
 }
 
 
+void mv_search::hexagon_search(int maxIter)
+{
+  static const int8_t hex[6][2] = { {-2,0}, {-1,-2}, { 1,-2},
+                                    { 2,0}, { 1, 2}, {-1, 2} };
+
+  for (int i=0;i<maxIter;i++) {
+    int cx=bestX, cy=bestY;
+
+    for (int k=0;k<6;k++) {
+      check(cx+hex[k][0], cy+hex[k][1]);
+    }
 
+    if (cx==bestX && cy==bestY) break;
+  }
+
+  small_diamond_search(1);
+}
 
-int sad(const uint8_t* p1,int stride1,
-        const uint8_t* p2,int stride2,
-        int w,int h)
+
+/* Cost of a quarter-sample MV, using the same interpolation filters as the decoder.
+   Returns INT_MAX if the interpolation would need samples outside of the reference
+   picture.
+ */
+int mv_search::subpel_cost(int bitDepth, int mvx,int mvy) const
 {
+  int xInt = x + (mvx>>2);
+  int yInt = y + (mvy>>2);
+
+  if (xInt-3 < 0 || xInt+pbW+4 > picW ||
+      yInt-3 < 0 || yInt+pbH+4 > picH) {
+    return std::numeric_limits<int>::max();
+  }
+
+  ALIGNED_16(int16_t) pred[MAX_PB_SIZE*MAX_PB_SIZE];
+  ALIGNED_16(int16_t) mcbuffer[MAX_PB_SIZE*(MAX_PB_SIZE+7)];
+
+  accel->put_hevc_qpel(pred, MAX_PB_SIZE,
+                       ref + yInt*refStride + xInt, refStride,
+                       pbW,pbH, mcbuffer, mvx&3, mvy&3, bitDepth);
+
+  const int shift = 14 - bitDepth;
+
   int cost=0;
+  for (int py=0;py<pbH;py++) {
+    const int16_t* p = &pred[py*MAX_PB_SIZE];
+    const uint8_t* in = &input[(y+py)*inputStride + x];
 
-  for (int y=0;y<h;y++) {
-    for (int x=0;x<w;x++) {
-      cost += abs_value(*p1 - *p2);
-      p1++;
-      p2++;
+    for (int px=0;px<pbW;px++) {
+      cost += abs_value(p[px] - (in[px]<<shift));
     }
+  }
+
+  cost >>= shift;
+
+  return cost + (int)(lambda * rate(mvx,mvy));
+}
+
 
-    p1 += stride1-w;
-    p2 += stride2-w;
+/* Half-sample refinement around the best full-sample position, followed by
+   quarter-sample refinement around the best half-sample position.
+ */
+void mv_search::subpel_refinement(int bitDepth, int* out_mvx, int* out_mvy) const
+{
+  int mvx = bestX<<2;
+  int mvy = bestY<<2;
+  int cost = bestCost;
+
+  for (int step=2; step>=1; step>>=1) {
+    int cx=mvx, cy=mvy;
+
+    for (int dy=-step; dy<=step; dy+=step)
+      for (int dx=-step; dx<=step; dx+=step) {
+        if (dx==0 && dy==0) continue;
+
+        int c = subpel_cost(bitDepth, cx+dx, cy+dy);
+        if (c<cost) {
+          cost=c;
+          mvx=cx+dx;
+          mvy=cy+dy;
+        }
+      }
   }
 
-  return cost;
+  *out_mvx = mvx;
+  *out_mvy = mvy;
 }
 
 
@@ -194,125 +404,128 @@ enc_cb* Algo_PB_MV_Search::analyze(encoder_context* ectx,
   int hrange = mParams.hrange();
   int vrange = mParams.vrange();
 
-  // previous frame (TODO)
-  const de265_image* refimg   = ectx->get_image(ectx->imgdata->frame_number -1);
+  const de265_image* refimg   = ectx->get_image(ectx->shdr->RefPicList[0][0]);
   const de265_image* inputimg = ectx->imgdata->input;
 
-  int w = refimg->get_width();
-  int h = refimg->get_height();
+  mv_search search;
+  search.accel       = &ectx->acceleration;
+  search.input       = inputimg->get_image_plane(0);
+  search.inputStride = inputimg->get_image_stride(0);
+  search.ref         = refimg->get_image_plane(0);
+  search.refStride   = refimg->get_image_stride(0);
+  search.x    = x;
+  search.y    = y;
+  search.pbW  = pbW;
+  search.pbH  = pbH;
+  search.picW = refimg->get_width();
+  search.picH = refimg->get_height();
+  search.minX = std::max(-hrange, -x);
+  search.maxX = std::min( hrange, search.picW-pbW-x);
+  search.minY = std::max(-vrange, -y);
+  search.maxY = std::min( vrange, search.picH-pbH-y);
+  search.mvp[0] = mvp[0];
+  search.mvp[1] = mvp[1];
+  search.lambda = sqrtf(ectx->lambda); // SAD-based cost
+  search.bestX = 0;
+  search.bestY = 0;
+  search.bestCost = std::numeric_limits<int>::max();
+
+  // the reference may still be encoded in another frame thread (+4 rows for the interpolation)
+  encoder_context::wait_for_reference_rows(refimg, y + search.maxY + pbH + 3);
+
+  search.check(0,0);
+
+  if (searchAlgo != MVSearchAlgo_Zero &&
+      searchAlgo != MVSearchAlgo_Full) {
+    // seed the search with the AMVP candidates and the L0 merge candidates
+
+    search.check_predictor(mvp[0]);
+    search.check_predictor(mvp[1]);
+
+    PBMotion mergeCandList[5];
+    get_merge_candidate_list(ectx, ectx->shdr, ectx->img,
+                             cb->x,cb->y, x,y, 1<<cb->log2Size, pbW,pbH, PBidx,
+                             mergeCandList);
+
+    for (int i=0;i<ectx->shdr->MaxNumMergeCand;i++) {
+      if (mergeCandList[i].predFlag[0] && mergeCandList[i].refIdx[0]==0) {
+        search.check_predictor(mergeCandList[i].mv[0]);
+      }
+    }
+  }
 
-  int mincost = 0x7fffffff;
+  int maxIter = std::max(hrange,vrange);
 
-  double lambda = 10.0;
+  switch (searchAlgo) {
+  case MVSearchAlgo_Zero:
+    break;
 
-  double *bits_h = new double[2*hrange+1];
-  double *bits_v = new double[2*vrange+1];
+  case MVSearchAlgo_Full:
+    search.full_search();
+    break;
 
-  for (int i=-hrange;i<=hrange;i++) {
-    int diff = (i - mvp[0].x);
-    int b;
+  case MVSearchAlgo_Diamond:
+    search.large_diamond_search(maxIter);
+    break;
 
-    if (diff==0) { b=0; }
-    else if (diff==1 || diff==-1) { b=2; }
-    else { b=abs_value(b+2); }
+  case MVSearchAlgo_Hexagon:
+    search.hexagon_search(maxIter);
+    break;
 
-    bits_h[i+hrange]=b;
-  }
+  case MVSearchAlgo_PMVFast:
+    {
+      // Stop if the best predictor is already good enough. If the median predictor
+      // is close, a small search around it is sufficient.
 
-  for (int i=-vrange;i<=vrange;i++) {
-    int diff = (i - mvp[0].y);
-    int b;
+      int threshold = pbW*pbH;
 
-    if (diff==0) { b=0; }
-    else if (diff==1 || diff==-1) { b=2; }
-    else { b=abs_value(b+2); }
+      if (search.bestCost > threshold) {
+        bool atMVP = (search.bestX == ((mvp[0].x+2)>>2) &&
+                      search.bestY == ((mvp[0].y+2)>>2));
 
-    bits_v[i+vrange]=b;
+        if (atMVP && search.bestCost < 4*threshold) {
+          search.small_diamond_search(maxIter);
+        }
+        else {
+          search.large_diamond_search(maxIter);
+        }
+      }
+    }
+    break;
   }
 
-  for (int my = y-vrange; my<=y+vrange; my++)
-    for (int mx = x-hrange; mx<=x+hrange; mx++)
-      {
-        if (mx<0 || mx+pbW>w || my<0 || my+pbH>h) continue;
+  int mvx = search.bestX<<2;
+  int mvy = search.bestY<<2;
 
-        int cost = sad(refimg->get_image_plane_at_pos(0,mx,my),
-                       refimg->get_image_stride(0),
-                       inputimg->get_image_plane_at_pos(0,x,y),
-                       inputimg->get_image_stride(0),
-                       pbW,pbH);
-
-        int bits = bits_h[mx-x+hrange] + bits_v[my-y+vrange];
-
-        cost += lambda * bits;
+  if (!mParams.fullpelOnly && searchAlgo != MVSearchAlgo_Zero) {
+    search.subpel_refinement(ectx->get_sps().BitDepth_Y, &mvx,&mvy);
+  }
 
-        //printf("%d %d : %d\n",mx,my,cost);
+  // use the MV predictor that results in the cheaper MVD
 
-        if (cost<mincost) {
-          mincost=cost;
+  int bits0 = mvd_bits(mvx-mvp[0].x) + mvd_bits(mvy-mvp[0].y);
+  int bits1 = mvd_bits(mvx-mvp[1].x) + mvd_bits(mvy-mvp[1].y);
+  spec.mvp_l0_flag = (bits1 < bits0);
 
-          spec.mvd[0][0]=(mx-x)<<2;
-          spec.mvd[0][1]=(my-y)<<2;
-        }
-      }
+  spec.mvd[0][0] = mvx;
+  spec.mvd[0][1] = mvy;
 
-  spec.mvd[0][0] -= mvp[0].x;
-  spec.mvd[0][1] -= mvp[0].y;
+  spec.mvd[0][0] -= mvp[spec.mvp_l0_flag].x;
+  spec.mvd[0][1] -= mvp[spec.mvp_l0_flag].y;
 
-  vec.mv[0].x = mvp[0].x + spec.mvd[0][0];
-  vec.mv[0].y = mvp[0].y + spec.mvd[0][1];
+  vec.mv[0].x = mvp[spec.mvp_l0_flag].x + spec.mvd[0][0];
+  vec.mv[0].y = mvp[spec.mvp_l0_flag].y + spec.mvd[0][1];
   vec.predFlag[0] = 1;
   vec.predFlag[1] = 0;
 
   ectx->img->set_mv_info(x,y,pbW,pbH, vec);
 
-  /* TMP REMOVE: ectx->prediction does not exist anymore
-  generate_inter_prediction_samples(ectx, ectx->shdr, ectx->prediction,
+  generate_inter_prediction_samples(ectx, ectx->shdr, ectx->img,
                                     cb->x,cb->y, // int xC,int yC,
-                                    0,0,         // int xB,int yB,
+                                    x-cb->x,y-cb->y, // int xB,int yB,
                                     1<<cb->log2Size, // int nCS,
-                                    1<<cb->log2Size,
-                                    1<<cb->log2Size, // int nPbW,int nPbH,
+                                    pbW,pbH,     // int nPbW,int nPbH,
                                     &vec);
-  */
-
-  // --- create residual ---
-
-
-
-  // TODO estimate rate for sending MV
-
-  int IntraSplitFlag = 0;
-  int MaxTrafoDepth = ectx->get_sps().max_transform_hierarchy_depth_inter;
-
-  mCodeResidual=true;
-  if (mCodeResidual) {
-    assert(false);
-    /*
-    cb->transform_tree = mTBSplitAlgo->analyze(ectx,ctxModel, ectx->imgdata->input, NULL, cb,
-                                               cb->x,cb->y,cb->x,cb->y, cb->log2Size,0,
-                                               0, MaxTrafoDepth, IntraSplitFlag);
-    */
 
-    cb->inter.rqt_root_cbf = ! cb->transform_tree->isZeroBlock();
-
-    cb->distortion = cb->transform_tree->distortion;
-    cb->rate       = cb->transform_tree->rate;
-  }
-  else {
-    const de265_image* input = ectx->imgdata->input;
-    de265_image* img   = ectx->img;
-    int x0 = cb->x;
-    int y0 = cb->y;
-    int tbSize = 1<<cb->log2Size;
-
-    cb->distortion = compute_distortion_ssd(input, img, x0,y0, cb->log2Size, 0);
-    cb->rate = 5; // fake (MV)
-
-    cb->inter.rqt_root_cbf = 0;
-  }
-
-  delete[] bits_h;
-  delete[] bits_v;
-
-  return cb;
+  return codeResidual(ectx, ctxModel, cb);
 }
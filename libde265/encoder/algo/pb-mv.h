@@ -51,6 +51,10 @@ class Algo_PB_MV : public Algo_PB
   void setChildAlgo(Algo_TB_Split* algo) { mTBSplitAlgo = algo; }
 
  protected:
+  /* Codes the residual of the CB after the prediction has been written into
+     the image and sets the CB rate and distortion. */
+  enc_cb* codeResidual(encoder_context*, context_model_table&, enc_cb* cb);
+
   Algo_TB_Split* mTBSplitAlgo;
 };
 
@@ -80,8 +84,6 @@ class option_MVTestMode : public choice_option<enum MVTestMode>
 class Algo_PB_MV_Test : public Algo_PB_MV
 {
  public:
- Algo_PB_MV_Test() : mCodeResidual(false) { }
-
   struct params
   {
     params() {
@@ -108,8 +110,6 @@ class Algo_PB_MV_Test : public Algo_PB_MV
 
  private:
   params mParams;
-
-  bool mCodeResidual;
 };
 
 
@@ -120,6 +120,7 @@ enum MVSearchAlgo
     MVSearchAlgo_Zero,
     MVSearchAlgo_Full,
     MVSearchAlgo_Diamond,
+    MVSearchAlgo_Hexagon,
     MVSearchAlgo_PMVFast
   };
 
@@ -130,6 +131,7 @@ class option_MVSearchAlgo : public choice_option<enum MVSearchAlgo>
     add_choice("zero",   MVSearchAlgo_Zero);
     add_choice("full",   MVSearchAlgo_Full, true);
     add_choice("diamond",MVSearchAlgo_Diamond);
+    add_choice("hex",    MVSearchAlgo_Hexagon);
     add_choice("pmvfast",MVSearchAlgo_PMVFast);
   }
 };
@@ -138,27 +140,30 @@ class option_MVSearchAlgo : public choice_option<enum MVSearchAlgo>
 class Algo_PB_MV_Search : public Algo_PB_MV
 {
  public:
- Algo_PB_MV_Search() : mCodeResidual(false) { }
-
   struct params
   {
     params() {
       mvSearchAlgo.set_ID("PB-MV-Search-Algo");
       hrange.set_ID      ("PB-MV-Search-HRange");
       vrange.set_ID      ("PB-MV-Search-VRange");
+      fullpelOnly.set_ID ("PB-MV-Search-FullPelOnly");
       hrange.set_default(8);
       vrange.set_default(8);
+      fullpelOnly.set_default(false);
+      fullpelOnly.set_description("skip the quarter-sample refinement of the motion vectors");
     }
 
     option_MVSearchAlgo mvSearchAlgo;
     option_int        hrange;
     option_int        vrange;
+    option_bool       fullpelOnly;
   };
 
   void registerParams(config_parameters& config) {
     config.add_option(&mParams.mvSearchAlgo);
     config.add_option(&mParams.hrange);
     config.add_option(&mParams.vrange);
+    config.add_option(&mParams.fullpelOnly);
   }
 
   void setParams(const params& p) { mParams=p; }
@@ -170,8 +175,6 @@ class Algo_PB_MV_Search : public Algo_PB_MV
 
  private:
   params mParams;
-
-  bool mCodeResidual;
 };
 
 #endif
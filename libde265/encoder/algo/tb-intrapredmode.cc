@@ -83,23 +83,30 @@ float estim_TB_bitrate(const encoder_context* ectx,
   switch (method)
     {
     case TBBitrateEstim_SSD:
-      return SSD(input->get_image_plane_at_pos(0, x0,y0),
-                 input->get_image_stride(0),
-                 tb->intra_prediction[0]->get_buffer_u8(),
-                 tb->intra_prediction[0]->getStride(),
-                 blkSize, blkSize);
+      return ectx->acceleration.ssd_8(input->get_image_plane_at_pos(0, x0,y0),
+                                      input->get_image_stride(0),
+                                      tb->intra_prediction[0]->get_buffer_u8(),
+                                      tb->intra_prediction[0]->getStride(),
+                                      blkSize, blkSize);
       break;
 
     case TBBitrateEstim_SAD:
-      return SAD(input->get_image_plane_at_pos(0, x0,y0),
-                 input->get_image_stride(0),
-                 tb->intra_prediction[0]->get_buffer_u8(),
-                 tb->intra_prediction[0]->getStride(),
-                 blkSize, blkSize);
+      return ectx->acceleration.sad_8(input->get_image_plane_at_pos(0, x0,y0),
+                                      input->get_image_stride(0),
+                                      tb->intra_prediction[0]->get_buffer_u8(),
+                                      tb->intra_prediction[0]->getStride(),
+                                      blkSize, blkSize);
       break;
 
-    case TBBitrateEstim_SATD_DCT:
     case TBBitrateEstim_SATD_Hadamard:
+      return ectx->acceleration.satd_8_block(input->get_image_plane_at_pos(0, x0,y0),
+                                             input->get_image_stride(0),
+                                             tb->intra_prediction[0]->get_buffer_u8(),
+                                             tb->intra_prediction[0]->getStride(),
+                                             tb->log2Size);
+      break;
+
+    case TBBitrateEstim_SATD_DCT:
       {
         int16_t coeffs[64*64];
         int16_t diff[64*64];
@@ -115,38 +122,21 @@ float estim_TB_bitrate(const encoder_context* ectx,
                  tb->intra_prediction[0]->getStride(),
                  blkSize);
 
-        void (*transform)(int16_t *coeffs, const int16_t *src, ptrdiff_t stride);
-
-
         if (tb->log2Size == 6) {
           // hack for 64x64 blocks: compute 4 times 32x32 blocks
 
-          if (method == TBBitrateEstim_SATD_Hadamard) {
-            transform = ectx->acceleration.hadamard_transform_8[6-1-2];
-
-            transform(coeffs,         &diff[0       ], 64);
-            transform(coeffs+1*32*32, &diff[32      ], 64);
-            transform(coeffs+2*32*32, &diff[32*64   ], 64);
-            transform(coeffs+3*32*32, &diff[32*64+32], 64);
-          }
-          else {
-            transform = ectx->acceleration.fwd_transform_8[6-1-2];
-
-            transform(coeffs,         &diff[0       ], 64);
-            transform(coeffs+1*32*32, &diff[32      ], 64);
-            transform(coeffs+2*32*32, &diff[32*64   ], 64);
-            transform(coeffs+3*32*32, &diff[32*64+32], 64);
-          }
+          void (*transform)(int16_t *coeffs, const int16_t *src, ptrdiff_t stride);
+          transform = ectx->acceleration.fwd_transform_8[6-1-2];
+
+          transform(coeffs,         &diff[0       ], 64);
+          transform(coeffs+1*32*32, &diff[32      ], 64);
+          transform(coeffs+2*32*32, &diff[32*64   ], 64);
+          transform(coeffs+3*32*32, &diff[32*64+32], 64);
         }
         else {
           assert(tb->log2Size-2 <= 3);
 
-          if (method == TBBitrateEstim_SATD_Hadamard) {
-            ectx->acceleration.hadamard_transform_8[tb->log2Size-2](coeffs, diff, &diff[blkSize] - &diff[0]);
-          }
-          else {
-            ectx->acceleration.fwd_transform_8[tb->log2Size-2](coeffs, diff, &diff[blkSize] - &diff[0]);
-          }
+          ectx->acceleration.fwd_transform_8[tb->log2Size-2](coeffs, diff, &diff[blkSize] - &diff[0]);
         }
 
         float distortion=0;
@@ -312,7 +302,7 @@ Algo_TB_IntraPredMode_MinResidual::analyze(encoder_context* ectx,
       intraMode = getPredMode(0);
     }
     else {
-      tb->intra_prediction[0] = std::make_shared<small_image_buffer>(log2TbSize, sizeof(uint8_t));
+      tb->intra_prediction[0] = small_image_buffer::create(log2TbSize, sizeof(uint8_t));
 
       for (int idx=0;idx<nPredModesEnabled();idx++) {
         enum IntraPredMode mode = getPredMode(idx);
@@ -428,7 +418,7 @@ Algo_TB_IntraPredMode_FastBrute::analyze(encoder_context* ectx,
     std::vector< std::pair<enum IntraPredMode,float> > distortions;
 
     int log2TbSize = tb->log2Size;
-    tb->intra_prediction[0] = std::make_shared<small_image_buffer>(log2TbSize, sizeof(uint8_t));
+    tb->intra_prediction[0] = small_image_buffer::create(log2TbSize, sizeof(uint8_t));
 
     for (int idx=0;idx<35;idx++)
       if (idx!=candidates[0] && idx!=candidates[1] && idx!=candidates[2] &&
@@ -506,7 +496,7 @@ Algo_TB_IntraPredMode_FastBrute::analyze(encoder_context* ectx,
                                                          opt_tb->intra_mode,
                                                          intraModeC,
                                                          option[i].get_context(),
-                                                         tb->blkIdx == 0);
+                                                         opt_tb->blkIdx == 0);
 
       opt_tb->rate_withoutCbfChroma += intraPredModeBits;
       opt_tb->rate += intraPredModeBits;
@@ -245,6 +245,7 @@ class Algo_TB_IntraPredMode_FastBrute : public Algo_TB_IntraPredMode_ModeSubset
   }
 
   void setParams(const params& p) { mParams=p; }
+  params& getParams() { return mParams; }
 
 
   virtual enc_tb* analyze(encoder_context*,
@@ -30,12 +30,15 @@
 #include <limits>
 #include <math.h>
 #include <iostream>
+#include <atomic>
 
 
+// counters are atomic, because the frame threads collect the statistics concurrently
+
 struct Logging_TB_Split : public Logging
 {
-  int skipTBSplit, noskipTBSplit;
-  int zeroBlockCorrelation[6][2][5];
+  std::atomic<int> skipTBSplit, noskipTBSplit;
+  std::atomic<int> zeroBlockCorrelation[6][2][5];
 
   const char* name() const { return "tb-split"; }
 
@@ -50,7 +53,7 @@ struct Logging_TB_Split : public Logging
 
         for (int c=0;c<5;c++) {
           printf("%d %d %d : %d %5.2f\n", tb,z,c,
-                 zeroBlockCorrelation[tb][z][c],
+                 zeroBlockCorrelation[tb][z][c].load(),
                  total==0 ? 0 : zeroBlockCorrelation[tb][z][c]/total*100);
         }
       }
@@ -97,24 +100,23 @@ void compute_residual_channel(encoder_context* ectx, enc_tb* tb, const de265_ima
 {
   int blkSize = (1<<log2Size);
 
-  enum IntraPredMode mode;
+  tb->intra_prediction[cIdx] = small_image_buffer::create(log2Size, sizeof(pixel_t));
+
+  if (tb->cb->PredMode == MODE_INTRA) {
+    // decode intra prediction
 
-  if (cIdx==0) {
-    mode = tb->intra_mode;
+    decode_intra_prediction_from_tree(ectx->img, tb, ectx->ctbs, ectx->get_sps(), cIdx);
   }
   else {
-    mode = tb->intra_mode_chroma;
-  }
-
-  // decode intra prediction
+    // the PB algorithm has written the inter prediction of the whole CB into the image
 
-  tb->intra_prediction[cIdx] = std::make_shared<small_image_buffer>(log2Size, sizeof(pixel_t));
-
-  decode_intra_prediction_from_tree(ectx->img, tb, ectx->ctbs, ectx->get_sps(), cIdx);
+    PixelAccessor predPixels(*tb->intra_prediction[cIdx], x,y);
+    predPixels.copyFromImage(ectx->img, cIdx);
+  }
 
   // create residual buffer and compute differences
 
-  tb->residual[cIdx] = std::make_shared<small_image_buffer>(log2Size, sizeof(int16_t));
+  tb->residual[cIdx] = small_image_buffer::create(log2Size, sizeof(int16_t));
 
   diff_blk<pixel_t>(tb->residual[cIdx]->get_buffer_s16(), blkSize,
                     input->get_image_plane_at_pos(cIdx,x,y),
@@ -204,9 +206,7 @@ Algo_TB_Split_BruteForce::analyze(encoder_context* ectx,
     //tb_no_split = new enc_tb(*tb);
     *tb->downPtr = tb_no_split;
 
-    if (cb->PredMode == MODE_INTRA) {
-      compute_residual<uint8_t>(ectx, tb_no_split, input, tb->blkIdx);
-    }
+    compute_residual<uint8_t>(ectx, tb_no_split, input, tb->blkIdx);
 
     tb_no_split = mAlgo_TB_Residual->analyze(ectx, option_no_split.get_context(),
                                              input, tb_no_split, TrafoDepth,MaxTrafoDepth,IntraSplitFlag);
@@ -229,6 +229,18 @@ Algo_TB_Split_BruteForce::analyze(encoder_context* ectx,
       else
         logging_tb_split.noskipTBSplit++;
     }
+
+
+    // --- early termination: do not test splitting if the unsplit TB is already cheap ---
+
+    if (test_split && mParams.rdCostThreshold > 0) {
+      float rdCost = tb_no_split->distortion + ectx->lambda * tb_no_split->rate;
+      float nSamples = 1<<(2*log2TbSize);
+
+      if (rdCost < nSamples * ectx->lambda * mParams.rdCostThreshold / 100) {
+        test_split = false;
+      }
+    }
   }
 
 
@@ -100,15 +100,23 @@ class Algo_TB_Split_BruteForce : public Algo_TB_Split
   {
     params() {
       zeroBlockPrune.set_ID("TB-Split-BruteForce-ZeroBlockPrune");
+
+      rdCostThreshold.set_ID("TB-Split-BruteForce-RDCostThreshold");
+      rdCostThreshold.set_range(0,1000);
+      rdCostThreshold.set_default(0);
     }
 
     option_ALGO_TB_Split_BruteForce_ZeroBlockPrune zeroBlockPrune;
+    option_int rdCostThreshold; // do not try to split TBs with an RD-cost per sample below this
+                                // percentage of lambda (0: off)
   };
 
   void setParams(const params& p) { mParams=p; }
+  params& getParams() { return mParams; }
 
   void registerParams(config_parameters& config) {
     config.add_option(&mParams.zeroBlockPrune);
+    config.add_option(&mParams.rdCostThreshold);
   }
 
   virtual enc_tb* analyze(encoder_context*,
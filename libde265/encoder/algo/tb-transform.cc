@@ -45,15 +45,6 @@ void diff_blk(int16_t* out,int out_stride,
 }
 
 
-static bool has_nonzero_value(const int16_t* data, int n)
-{
-  for (int i=0;i<n;i++)
-    if (data[i]) return true;
-
-  return false;
-}
-
-
 void compute_transform_coeffs(encoder_context* ectx,
                               enc_tb* tb,
                               const de265_image* input, // TODO: probably pass pixels/stride directly
@@ -70,42 +61,9 @@ void compute_transform_coeffs(encoder_context* ectx,
 
   enum PredMode predMode = cb->PredMode;
 
-  int16_t blk[32*32]; // residual
-  int16_t* residual;
-
-
-  //printf("transform-coeffs %d;%d size:%d cIdx:%d\n", tb->x,tb->y,1<<tb->log2Size,cIdx);
-
-  // --- do intra prediction ---
-
-  if (predMode==MODE_INTRA) {
-    residual = tb->residual[cIdx]->get_buffer_s16();
-
-    //printf("intra residual: %p stride: %d\n",residual, tb->residual[cIdx]->get_stride());
-  }
-  else {
-    // --- subtract prediction from input image ---
-
-    /* TMP REMOVE: ectx->prediction does not exist anymore
-
-    uint8_t* pred = ectx->prediction->get_image_plane(cIdx);
-    int stride = ectx->prediction->get_image_stride(cIdx);
-
-    //printBlk("input",input->get_image_plane_at_pos(cIdx,xC,yC), tbSize, input->get_image_stride(cIdx));
-    //printBlk("prediction", pred,tbSize, stride);
-
-    diff_blk(blk,tbSize,
-             input->get_image_plane_at_pos(cIdx,xC,yC), input->get_image_stride(cIdx),
-             &pred[yC*stride+xC],stride, tbSize);
-
-    residual=blk;
-    */
-
-    //printBlk("residual", blk,tbSize,tbSize);
-  }
-
-
+  // the residual of intra and inter TBs is computed in tb-split
 
+  const int16_t* residual = tb->residual[cIdx]->get_buffer_s16();
 
 
   // --- forward transform ---
@@ -116,7 +74,7 @@ void compute_transform_coeffs(encoder_context* ectx,
   // transformation mode (DST or DCT)
 
   int trType;
-  if (cIdx==0 && log2TbSize==2 && predMode==MODE_INTRA) trType=1; // TODO: inter mode
+  if (cIdx==0 && log2TbSize==2 && predMode==MODE_INTRA) trType=1;
   else trType=0;
 
 
@@ -127,12 +85,14 @@ void compute_transform_coeffs(encoder_context* ectx,
 
   // --- quantization ---
 
-  quant_coefficients(tb->coeff[cIdx], tb->coeff[cIdx], log2TbSize,  cb->qp, true);
+  int nNonZero = quant_coefficients(&ectx->acceleration,
+                                    tb->coeff[cIdx], tb->coeff[cIdx], log2TbSize,
+                                    get_component_QP(ectx->get_sps(), cb->qp, cIdx), true);
 
 
   // set CBF to 0 if there are no non-zero coefficients
 
-  tb->cbf[cIdx] = has_nonzero_value(tb->coeff[cIdx], 1<<(log2TbSize<<1));
+  tb->cbf[cIdx] = (nNonZero > 0);
 }
 
 
@@ -245,10 +205,11 @@ enc_tb* Algo_TB_Transform::analyze(encoder_context* ectx,
   // measure distortion
 
   int tbSize = 1<<log2TbSize;
-  tb->distortion = SSD(input->get_image_plane_at_pos(0, x0,y0), input->get_image_stride(0),
-                       tb->reconstruction[0]->get_buffer_u8(),
-                       tb->reconstruction[0]->getStride(),
-                       tbSize, tbSize);
+  tb->distortion = ectx->acceleration.ssd_8(input->get_image_plane_at_pos(0, x0,y0),
+                                            input->get_image_stride(0),
+                                            tb->reconstruction[0]->get_buffer_u8(),
+                                            tb->reconstruction[0]->getStride(),
+                                            tbSize, tbSize);
 
   return tb;
 }
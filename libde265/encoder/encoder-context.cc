@@ -42,6 +42,14 @@ encoder_context::encoder_context()
   parameters_have_been_set = false;
   headers_have_been_sent = false;
 
+  lookahead_eos_forwarded = false;
+
+  IsCuQpDeltaCoded = false;
+  qPY_PRED = 0;
+
+  is_frame_worker = false;
+  next_frame_task = 0;
+
   param_image_allocation_userdata = NULL;
   //release_func = NULL;
 
@@ -59,10 +67,16 @@ encoder_context::encoder_context()
 
 encoder_context::~encoder_context()
 {
+  stop_frame_threads();
+
   while (!output_packets.empty()) {
     en265_free_packet((en265_encoder_context*)this, output_packets.front());
     output_packets.pop_front();
   }
+
+  // the CTB trees are freed together with their node memory
+
+  ctbs.release();
 }
 
 
@@ -73,6 +87,9 @@ void encoder_context::start_encoder()
   }
 
 
+  algo.applyPreset(params);
+
+
   if (params.sop_structure() == SOP_Intra) {
     sop = std::shared_ptr<sop_creator_intra_only>(new sop_creator_intra_only());
   }
@@ -85,11 +102,94 @@ void encoder_context::start_encoder()
   sop->set_encoder_context(this);
   sop->set_encoder_picture_buffer(&picbuf);
 
+  lookahead.setParams(params.mLookahead);
+  lookahead.start(&acceleration, Log2(params.max_cb_size));
+
+  start_frame_threads();
+
 
   encoder_started=true;
 }
 
 
+const de265_image* encoder_context::get_image(int frame_id) const
+{
+  if (is_frame_worker) {
+    std::map<int,const de265_image*>::const_iterator it = reference_images.find(frame_id);
+    assert(it != reference_images.end());
+    return it->second;
+  }
+
+  return picbuf.get_picture(frame_id)->reconstruction;
+}
+
+
+bool encoder_context::has_image(int frame_id) const
+{
+  if (is_frame_worker) {
+    return reference_images.find(frame_id) != reference_images.end();
+  }
+
+  return picbuf.has_picture(frame_id);
+}
+
+
+void encoder_context::push_input_image(de265_image* img)
+{
+  if (lookahead.is_enabled()) {
+    lookahead.push_image(img);
+  }
+  else {
+    sop->insert_new_input_image(img);
+  }
+}
+
+
+void encoder_context::push_end_of_stream()
+{
+  if (lookahead.is_enabled()) {
+    lookahead.push_end_of_stream();
+  }
+  else {
+    sop->insert_end_of_stream();
+  }
+}
+
+
+void encoder_context::move_lookahead_images_to_sop()
+{
+  if (!lookahead.is_enabled()) {
+    return;
+  }
+
+  encoder_lookahead::frame_analysis analysis;
+
+  for (;;) {
+    de265_image* img = lookahead.get_next_image(&analysis);
+    if (img==NULL) {
+      break;
+    }
+
+    if (analysis.sceneCut) {
+      loginfo(LogEncoder,"scene cut at frame %d\n",sop->get_frame_number());
+      sop->force_intra_for_next_image();
+    }
+
+    int frame_number = sop->get_frame_number();
+    sop->insert_new_input_image(img);
+
+    if (!analysis.ctbQPOffset.empty()) {
+      picbuf.set_ctb_qp_offsets(frame_number, analysis.ctbQPOffset);
+    }
+  }
+
+  if (lookahead.is_end_of_stream() && !lookahead_eos_forwarded) {
+    sop->insert_end_of_stream();
+    lookahead_eos_forwarded = true;
+  }
+}
+
+
 en265_packet* encoder_context::create_packet(en265_packet_content_type t)
 {
   en265_packet* pck = new en265_packet;
@@ -165,6 +265,12 @@ de265_error encoder_context::encode_headers()
   pps->pic_disable_deblocking_filter_flag = true;
   pps->pps_loop_filter_across_slices_enabled_flag = false;
 
+  // adaptive quantization sends a QP for each CTB
+  if (lookahead.uses_adaptive_QP()) {
+    pps->cu_qp_delta_enabled_flag = true;
+    pps->diff_cu_qp_delta_depth = 0;
+  }
+
   pps->set_derived_values(sps.get());
 
 
@@ -229,11 +335,10 @@ de265_error encoder_context::encode_picture_from_input_buffer()
     algo.setParams(params);
 
 
-    // TODO: must be <30, because Y->C mapping (tab8_22) is not implemented yet
     int qp = algo.getPPS_QP();
 
     //lambda = ectx->params.lambda;
-    lambda = 0.0242 * pow(1.27245, qp);
+    lambda = lambda_from_QP(qp);
 
     parameters_have_been_set = true;
   }
@@ -247,20 +352,18 @@ de265_error encoder_context::encode_picture_from_input_buffer()
   assert(imgdata);
   picbuf.mark_encoding_started(imgdata->frame_number);
 
-  this->imgdata = imgdata;
-  this->shdr    = &imgdata->shdr;
   loginfo(LogEncoder,"encoding frame %d\n",imgdata->frame_number);
 
 
   // write headers if not written yet
 
   if (!headers_have_been_sent) {
+    this->imgdata = imgdata;
     encode_headers();
+    this->imgdata = NULL;
   }
 
 
-  // write slice header
-
   // slice
 
   imgdata->shdr.slice_deblocking_filter_disabled_flag = true;
@@ -271,6 +374,84 @@ de265_error encoder_context::encode_picture_from_input_buffer()
 
   //shdr.slice_pic_order_cnt_lsb = poc & 0xFF;
 
+
+  // create reconstruction image
+
+  /* This is done before the encoding starts, such that pictures encoded in parallel
+     can already reference it. */
+
+  de265_image* reco = new de265_image;
+  reco->set_headers(vps, sps, pps);
+  reco->PicOrderCntVal = imgdata->input->PicOrderCntVal;
+
+  reco->alloc_image(sps->pic_width_in_luma_samples, sps->pic_height_in_luma_samples,
+                    imgdata->input->get_chroma_format(), sps, true,
+                    NULL /* no decctx */, /*ectx,*/ 0,NULL,false);
+  reco->clear_metadata();
+
+  // pictures encoded in parallel may predict from it before it is finished
+  reco->PicState = UsedForShortTermReference;
+
+  picbuf.set_reconstruction_image(imgdata->frame_number, reco);
+
+
+  // encode image
+
+  if (frame_tasks.empty()) {
+    en265_packet* pck = encode_picture(imgdata, reco, algo);
+    output_picture(imgdata, pck);
+    return DE265_OK;
+  }
+
+
+  // hand over to the next free frame thread
+
+  if (frame_tasks_running.size() == frame_tasks.size()) {
+    encoder_picture_task* oldest = frame_tasks_running.front();
+    oldest->finished.wait_for_progress(1);
+    finish_encoded_pictures(false);
+  }
+
+  encoder_picture_task* task = frame_tasks[next_frame_task];
+  next_frame_task = (next_frame_task+1) % frame_tasks.size();
+
+  encoder_context& worker = task->worker;
+  if (!worker.image_spec_is_defined) {
+    worker.vps = vps;
+    worker.sps = sps;
+    worker.pps = pps;
+    worker.acceleration = acceleration;
+    worker.use_adaptive_context = use_adaptive_context;
+    worker.ctbs.alloc(image_width, image_height, sps->Log2CtbSizeY);
+    worker.image_spec_is_defined = true;
+  }
+
+  worker.lambda = lambda;
+  worker.reference_images = picbuf.get_reconstruction_images();
+
+  task->imgdata = imgdata;
+  task->reconstruction = reco;
+  task->algo = &algo;
+  task->packet = NULL;
+  task->finished.reset(0);
+
+  frame_tasks_running.push_back(task);
+  add_task(&frame_task_queue, task);
+
+  return DE265_OK;
+}
+
+
+en265_packet* encoder_context::encode_picture(image_data* imgdata, de265_image* reconstruction,
+                                              EncoderCore& algo)
+{
+  this->imgdata = imgdata;
+  this->shdr    = &imgdata->shdr;
+  this->img     = reconstruction;
+
+
+  // write slice header
+
   imgdata->nal.write(cabac_encoder);
   imgdata->shdr.write(this, cabac_encoder, sps.get(), pps.get(), imgdata->nal.nal_unit_type);
   cabac_encoder.add_trailing_bits();
@@ -286,15 +467,11 @@ de265_error encoder_context::encode_picture_from_input_buffer()
   cabac_encoder.add_trailing_bits();
   cabac_encoder.flush_VLC();
 
-
-  // set reconstruction image
-
-  picbuf.set_reconstruction_image(imgdata->frame_number, img);
-  //picbuf.set_prediction_image(imgdata->frame_number, prediction);
   img=NULL;
   this->imgdata = NULL;
   this->shdr = NULL;
 
+
   // build output packet
 
   en265_packet* pck = create_packet(EN265_PACKET_SLICE);
@@ -304,10 +481,118 @@ de265_error encoder_context::encode_picture_from_input_buffer()
   pck->nal_unit_type  = (enum en265_nal_unit_type)imgdata->nal.nal_unit_type;
   pck->nuh_layer_id   = imgdata->nal.nuh_layer_id;
   pck->nuh_temporal_id= imgdata->nal.nuh_temporal_id;
-  output_packets.push_back(pck);
 
+  return pck;
+}
+
+
+void encoder_context::output_picture(image_data* imgdata, en265_packet* pck)
+{
+  pck->encoder_context = (en265_encoder_context*)this;
+  output_packets.push_back(pck);
 
   picbuf.mark_encoding_finished(imgdata->frame_number);
+}
 
-  return DE265_OK;
+
+// --- frame-parallel encoding ---
+
+void encoder_context::start_frame_threads()
+{
+  int nThreads = params.frame_threads;
+  if (nThreads <= 1 || !frame_tasks.empty()) {
+    return;
+  }
+
+  de265_error err = ::start_thread_pool(&frame_thread_pool, nThreads);
+  if (!de265_isOK(err)) {
+    // encode without frame parallelism
+    ::stop_thread_pool(&frame_thread_pool);
+    return;
+  }
+
+  attach_task_queue(&frame_thread_pool, &frame_task_queue);
+
+  for (int i=0;i<nThreads;i++) {
+    encoder_picture_task* task = new encoder_picture_task;
+    task->worker.is_frame_worker = true;
+    frame_tasks.push_back(task);
+  }
+}
+
+
+void encoder_context::stop_frame_threads()
+{
+  if (frame_tasks.empty()) {
+    return;
+  }
+
+  // let the pictures that are still running finish, their packets are dropped
+
+  while (!frame_tasks_running.empty()) {
+    encoder_picture_task* task = frame_tasks_running.front();
+    task->finished.wait_for_progress(1);
+
+    delete[] task->packet->data;
+    delete   task->packet;
+
+    frame_tasks_running.pop_front();
+  }
+
+  detach_task_queue(&frame_task_queue);
+  ::stop_thread_pool(&frame_thread_pool);
+
+  for (size_t i=0;i<frame_tasks.size();i++) {
+    delete frame_tasks[i];
+  }
+
+  frame_tasks.clear();
+}
+
+
+void encoder_context::finish_encoded_pictures(bool wait)
+{
+  while (!frame_tasks_running.empty()) {
+    encoder_picture_task* task = frame_tasks_running.front();
+
+    if (wait) {
+      task->finished.wait_for_progress(1);
+    }
+    else if (task->finished.get_progress() < 1) {
+      break;
+    }
+
+    output_picture(task->imgdata, task->packet);
+    task->packet = NULL;
+    task->imgdata = NULL;
+
+    frame_tasks_running.pop_front();
+  }
+}
+
+
+void encoder_context::wait_for_reference_rows(const de265_image* ref, int yBottom)
+{
+  const seq_parameter_set& sps = ref->get_sps();
+
+  int ctbY = Clip3(0, sps.PicHeightInCtbsY-1, yBottom >> sps.Log2CtbSizeY);
+
+  // rows are published completely, hence it is sufficient to check the last CTB in the row
+  ref->ctb_progress[(ctbY+1)*sps.PicWidthInCtbsY - 1].wait_for_progress(CTB_PROGRESS_PREFILTER);
+}
+
+
+void encoder_picture_task::work()
+{
+  packet = worker.encode_picture(imgdata, reconstruction, *algo);
+
+  finished.set_progress(1);
+}
+
+
+std::string encoder_picture_task::name() const
+{
+  char buf[100];
+  sprintf(buf,"encode-picture-%d",imgdata ? imgdata->frame_number : -1);
+  return buf;
 }
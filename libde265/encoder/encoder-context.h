@@ -29,10 +29,16 @@
 #include "libde265/encoder/encoder-params.h"
 #include "libde265/encoder/encpicbuf.h"
 #include "libde265/encoder/sop.h"
+#include "libde265/encoder/lookahead.h"
 #include "libde265/en265.h"
 #include "libde265/util.h"
 
 #include <memory>
+#include <map>
+#include <math.h>
+
+
+class encoder_picture_task;
 
 
 class encoder_context : public base_context
@@ -41,13 +47,8 @@ class encoder_context : public base_context
   encoder_context();
   ~encoder_context();
 
-  virtual const de265_image* get_image(int frame_id) const {
-    return picbuf.get_picture(frame_id)->reconstruction;
-  }
-
-  virtual bool has_image(int frame_id) const {
-    return picbuf.has_picture(frame_id);
-  }
+  virtual const de265_image* get_image(int frame_id) const;
+  virtual bool has_image(int frame_id) const;
 
   bool encoder_started;
 
@@ -75,6 +76,7 @@ class encoder_context : public base_context
   image_data* imgdata; // input image
   slice_segment_header* shdr;
 
+  enc_node_memory node_memory; // must be destroyed after 'ctbs'
   CTBTreeMatrix ctbs;
 
   // temporary memory for motion compensated pixels (when CB-algo passes this down to TB-algo)
@@ -83,6 +85,10 @@ class encoder_context : public base_context
 
 
   int active_qp; // currently active QP
+
+  // cu_qp_delta state while writing the bitstream (quantization group = CTB)
+  bool IsCuQpDeltaCoded;
+  int  qPY_PRED;
   /*int target_qp;*/ /* QP we want to code at.
                      (Not actually the real QP. Check image.get_QPY() for that.) */
 
@@ -109,6 +115,9 @@ class encoder_context : public base_context
   encoder_picture_buffer picbuf;
   std::shared_ptr<sop_creator> sop;
 
+  encoder_lookahead lookahead;
+  bool lookahead_eos_forwarded;
+
   std::deque<en265_packet*> output_packets;
 
 
@@ -116,6 +125,8 @@ class encoder_context : public base_context
 
   float lambda;
 
+  static float lambda_from_QP(int qp) { return 0.0242 * pow(1.27245, qp); }
+
 
   // --- CABAC output and rate estimation ---
 
@@ -156,9 +167,57 @@ class encoder_context : public base_context
   // --- encoding control ---
 
   void start_encoder();
+
+  // Input images go either directly to the SOP creator or through the lookahead.
+  void push_input_image(de265_image*);
+  void push_end_of_stream();
+  void move_lookahead_images_to_sop();
+
   de265_error encode_headers();
   de265_error encode_picture_from_input_buffer();
 
+  // Encode the slice of a picture that has been prepared by encode_picture_from_input_buffer().
+  en265_packet* encode_picture(image_data* imgdata, de265_image* reconstruction,
+                               EncoderCore& algo);
+
+
+  // --- frame-parallel encoding ---
+
+  /* With more than one frame thread, each picture is encoded by a worker context in
+     the frame thread pool. The workers have their own per-picture state (reconstruction,
+     CTB trees, CABAC output), but share the parameter sets and algorithms with the
+     main context. Encoded pictures are passed back in encoding order.
+
+     The reconstruction of a picture is published row by row through the CTB progress
+     of its image. A picture can thus start while its reference pictures are still
+     being encoded, and only waits for the rows that it actually accesses.
+   */
+
+  void start_frame_threads();
+  void stop_frame_threads();
+
+  // Output the pictures that the frame threads have finished. With 'wait', block until all are done.
+  void finish_encoded_pictures(bool wait);
+
+  /* Block until the reconstruction of the reference picture is available down to
+     luma row 'yBottom'. */
+  static void wait_for_reference_rows(const de265_image* ref, int yBottom);
+
+  bool is_frame_worker;
+  std::map<int,const de265_image*> reference_images; // for workers: available reconstructions
+
+ private:
+  thread_pool       frame_thread_pool;
+  thread_task_queue frame_task_queue;
+
+  std::vector<encoder_picture_task*> frame_tasks;         // one per frame thread, we are the owner
+  std::deque<encoder_picture_task*>  frame_tasks_running; // in encoding order
+  size_t next_frame_task;
+
+  void output_picture(image_data* imgdata, en265_packet* pck);
+
+ public:
+
 
   // Input images can be released after encoding and when the output packet is released.
   // This is important to do as soon as possible, as the image might actually wrap
@@ -170,4 +229,25 @@ class encoder_context : public base_context
 };
 
 
+/* Encodes one picture in a worker context of the frame-parallel encoder.
+ */
+class encoder_picture_task : public thread_task
+{
+ public:
+  encoder_picture_task() : imgdata(NULL), reconstruction(NULL), algo(NULL), packet(NULL) { }
+
+  encoder_context worker;
+
+  image_data*   imgdata;
+  de265_image*  reconstruction;
+  EncoderCore*  algo;
+
+  en265_packet* packet; // result
+  de265_progress_lock finished; // set to 1 when the packet is available
+
+  virtual void work();
+  virtual std::string name() const;
+};
+
+
 #endif
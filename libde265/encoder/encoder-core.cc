@@ -130,18 +130,7 @@ double encode_image(encoder_context* ectx,
 {
   int stride=input->get_image_stride(0);
 
-  int w = ectx->get_sps().pic_width_in_luma_samples;
-  int h = ectx->get_sps().pic_height_in_luma_samples;
-
-  // --- create reconstruction image ---
-  ectx->img = new de265_image;
-  ectx->img->set_headers(ectx->get_shared_vps(), ectx->get_shared_sps(), ectx->get_shared_pps());
-  ectx->img->PicOrderCntVal = input->PicOrderCntVal;
-
-  ectx->img->alloc_image(w,h, input->get_chroma_format(), ectx->get_shared_sps(), true,
-                         NULL /* no decctx */, /*ectx,*/ 0,NULL,false);
-  //ectx->img->alloc_encoder_data(&ectx->sps);
-  ectx->img->clear_metadata();
+  // the reconstruction image ectx->img has been created by the caller
 
 #if 0
   if (1) {
@@ -155,6 +144,7 @@ double encode_image(encoder_context* ectx,
 #endif
 
   ectx->active_qp = ectx->get_pps().pic_init_qp; // TODO take current qp from slice
+  ectx->qPY_PRED  = ectx->shdr->SliceQPY;
 
 
   ectx->cabac_ctx_models.init(ectx->shdr->initType, ectx->shdr->SliceQPY);
@@ -179,7 +169,15 @@ double encode_image(encoder_context* ectx,
 
   // encode CTB by CTB
 
-  ectx->ctbs.clear();
+  /* The CTB trees of the previous picture are released at once. The trees of this
+     picture are kept until the next picture, as they are still used as neighbourhood
+     context by the following CTBs.
+  */
+
+  enc_node_memory::set_current(&ectx->node_memory);
+
+  ectx->ctbs.release();
+  ectx->node_memory.reset();
 
   for (int y=0;y<ectx->get_sps().PicHeightInCtbsY;y++)
     for (int x=0;x<ectx->get_sps().PicWidthInCtbsY;x++)
@@ -209,6 +207,9 @@ double encode_image(encoder_context* ectx,
           input, x0,y0, Log2CtbSize, 0, qp);
         */
 
+        // the cu_qp_delta is not included in the rate estimation
+        ectx->IsCuQpDeltaCoded = true;
+
         enc_cb* cb = algo.getAlgoCTBQScale()->analyze(ectx,ctxModel, x0,y0);
 #else
         float minCost = std::numeric_limits<float>::max();
@@ -261,8 +262,16 @@ double encode_image(encoder_context* ectx,
         cb->debug_assertTreeConsistency(ectx->img);
         */
 
+        // each CTB is a quantization group
+
+        ectx->IsCuQpDeltaCoded = false;
+
         encode_ctb(ectx, &ectx->cabac_encoder, cb, x,y);
 
+        if (ectx->IsCuQpDeltaCoded) {
+          ectx->qPY_PRED = ectx->active_qp;
+        }
+
         //printf("================================================== WRITE\n");
 
 
@@ -287,6 +296,22 @@ double encode_image(encoder_context* ectx,
         //ectx->free_all_pools();
 
         mse += cb->distortion;
+
+
+        // publish the reconstruction of the completed CTB row
+
+        /* The encoder does not apply the in-loop filters, the reconstruction of the row
+           is final. Pictures in other frame threads may now use it for reference. */
+
+        if (x==ectx->get_sps().PicWidthInCtbsY-1) {
+          for (int xCtb=0;xCtb<=x;xCtb++) {
+            ectx->ctbs.getCTB(xCtb,y)->writeReconstructionToImage(ectx->img, &ectx->get_sps());
+          }
+
+          for (int xCtb=0;xCtb<=x;xCtb++) {
+            ectx->img->ctb_progress[xCtb + y*ectx->get_sps().PicWidthInCtbsY].set_progress(CTB_PROGRESS_PREFILTER);
+          }
+        }
       }
 
   mse /= ectx->img->get_width() * ectx->img->get_height();
@@ -303,7 +328,7 @@ double encode_image(encoder_context* ectx,
 
   // frame PSNR
 
-  ectx->ctbs.writeReconstructionToImage(ectx->img, &ectx->get_sps());
+  enc_node_memory::set_current(NULL);
 
 #if 0
   std::ofstream ostr("out.pgm");
@@ -412,6 +437,62 @@ void EncoderCore_Custom::setParams(encoder_params& params)
 }
 
 
+void EncoderCore_Custom::applyPreset(encoder_params& params)
+{
+  Algo_CB_Split_BruteForce::params&        cbSplit = mAlgo_CB_Split_BruteForce.getParams();
+  Algo_TB_Split_BruteForce::params&        tbSplit = mAlgo_TB_Split_BruteForce.getParams();
+  Algo_TB_IntraPredMode_FastBrute::params& fastBrute = mAlgo_TB_IntraPredMode_FastBrute.getParams();
+  Algo_CB_IntraPartMode_BruteForce::params& partMode = mAlgo_CB_IntraPartMode_BruteForce.getParams();
+
+  switch (params.preset()) {
+  case EncPreset_UltraFast:
+    params.mAlgo_CB_IntraPartMode.set_default(ALGO_CB_IntraPartMode_Fixed);
+    params.mAlgo_TB_IntraPredMode.set_default(ALGO_TB_IntraPredMode_MinResidual);
+    params.max_transform_hierarchy_depth_intra.set_default(1);
+    tbSplit.zeroBlockPrune.set_default(ALGO_TB_BruteForce_ZeroBlockPrune_all);
+    tbSplit.rdCostThreshold.set_default(100);
+    cbSplit.zeroResidualTermination.set_default(true);
+    cbSplit.rdCostThreshold.set_default(100);
+    cbSplit.neighbourDepthLimit.set_default(true);
+    break;
+
+  case EncPreset_VeryFast:
+    params.mAlgo_CB_IntraPartMode.set_default(ALGO_CB_IntraPartMode_Fixed);
+    params.mAlgo_TB_IntraPredMode.set_default(ALGO_TB_IntraPredMode_FastBrute);
+    fastBrute.keepNBest.set_default(2);
+    params.max_transform_hierarchy_depth_intra.set_default(1);
+    tbSplit.zeroBlockPrune.set_default(ALGO_TB_BruteForce_ZeroBlockPrune_all);
+    tbSplit.rdCostThreshold.set_default(100);
+    cbSplit.zeroResidualTermination.set_default(true);
+    cbSplit.rdCostThreshold.set_default(50);
+    cbSplit.neighbourDepthLimit.set_default(true);
+    break;
+
+  case EncPreset_Fast:
+    params.mAlgo_CB_IntraPartMode.set_default(ALGO_CB_IntraPartMode_BruteForce);
+    partMode.zeroResidualTermination.set_default(true);
+    params.mAlgo_TB_IntraPredMode.set_default(ALGO_TB_IntraPredMode_FastBrute);
+    fastBrute.keepNBest.set_default(3);
+    params.max_transform_hierarchy_depth_intra.set_default(2);
+    tbSplit.zeroBlockPrune.set_default(ALGO_TB_BruteForce_ZeroBlockPrune_all);
+    tbSplit.rdCostThreshold.set_default(50);
+    cbSplit.zeroResidualTermination.set_default(true);
+    cbSplit.rdCostThreshold.set_default(0);
+    cbSplit.neighbourDepthLimit.set_default(true);
+    break;
+
+  case EncPreset_Medium:
+    // these are the defaults of the individual options
+    break;
+
+  case EncPreset_Slow:
+    params.mAlgo_TB_IntraPredMode.set_default(ALGO_TB_IntraPredMode_BruteForce);
+    tbSplit.zeroBlockPrune.set_default(ALGO_TB_BruteForce_ZeroBlockPrune_8x8);
+    break;
+  }
+}
+
+
 void Logging::print_logging(const encoder_context* ectx, const char* id, const char* filename)
 {
 #if 000
@@ -85,8 +85,13 @@ class EncoderCore_Custom : public EncoderCore
 
   void setParams(struct encoder_params& params);
 
+  // Set the default values of the encoder and algorithm parameters according to params.preset.
+  void applyPreset(struct encoder_params& params);
+
   void registerParams(config_parameters& config) {
     mAlgo_CTB_QScale_Constant.registerParams(config);
+    mAlgo_CB_Split_BruteForce.registerParams(config);
+    mAlgo_CB_IntraPartMode_BruteForce.registerParams(config);
     mAlgo_CB_IntraPartMode_Fixed.registerParams(config);
     mAlgo_CB_InterPartMode_Fixed.registerParams(config);
     mAlgo_PB_MV_Test.registerParams(config);
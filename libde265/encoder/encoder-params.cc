@@ -36,6 +36,8 @@ encoder_params::encoder_params()
 {
   //rateControlMethod = RateControlMethod_ConstantQP;
 
+  preset.set_ID("preset");
+
   min_cb_size.set_ID("min-cb-size"); min_cb_size.set_valid_values(power2range(8,64)); min_cb_size.set_default(8);
   max_cb_size.set_ID("max-cb-size"); max_cb_size.set_valid_values(power2range(8,64)); max_cb_size.set_default(32);
   min_tb_size.set_ID("min-tb-size"); min_tb_size.set_valid_values(power2range(4,32)); min_tb_size.set_default(4);
@@ -51,6 +53,11 @@ encoder_params::encoder_params()
 
   sop_structure.set_ID("sop-structure");
 
+  frame_threads.set_ID("frame-threads");
+  frame_threads.set_description("number of pictures encoded in parallel (1: no frame parallelism)");
+  frame_threads.set_range(1,MAX_THREADS);
+  frame_threads.set_default(1);
+
   mAlgo_TB_IntraPredMode.set_ID("TB-IntraPredMode");
   mAlgo_TB_IntraPredMode_Subset.set_ID("TB-IntraPredMode-subset");
   mAlgo_CB_IntraPartMode.set_ID("CB-IntraPartMode");
@@ -63,6 +70,8 @@ encoder_params::encoder_params()
 
 void encoder_params::registerParams(config_parameters& config)
 {
+  config.add_option(&preset);
+
   config.add_option(&min_cb_size);
   config.add_option(&max_cb_size);
   config.add_option(&min_tb_size);
@@ -71,6 +80,7 @@ void encoder_params::registerParams(config_parameters& config)
   config.add_option(&max_transform_hierarchy_depth_inter);
 
   config.add_option(&sop_structure);
+  config.add_option(&frame_threads);
 
   config.add_option(&mAlgo_TB_IntraPredMode);
   config.add_option(&mAlgo_TB_IntraPredMode_Subset);
@@ -80,4 +90,5 @@ void encoder_params::registerParams(config_parameters& config)
   config.add_option(&mAlgo_TB_RateEstimation);
 
   mSOP_LowDelay.registerParams(config);
+  mLookahead.registerParams(config);
 }
@@ -26,6 +26,7 @@
 #include "libde265/encoder/encoder-types.h"
 #include "libde265/encoder/encoder-core.h"
 #include "libde265/encoder/sop.h"
+#include "libde265/encoder/lookahead.h"
 
 
 enum RateControlMethod
@@ -56,6 +57,32 @@ class option_SOP_Structure : public choice_option<enum SOP_Structure>
 };
 
 
+enum EncoderPreset
+  {
+    EncPreset_UltraFast,
+    EncPreset_VeryFast,
+    EncPreset_Fast,
+    EncPreset_Medium,
+    EncPreset_Slow
+  };
+
+/* A preset only changes the default values of the other options
+   (see EncoderCore_Custom::applyPreset()). Options that are set explicitly
+   keep their value.
+ */
+class option_EncoderPreset : public choice_option<enum EncoderPreset>
+{
+ public:
+  option_EncoderPreset() {
+    add_choice("ultrafast", EncPreset_UltraFast);
+    add_choice("veryfast",  EncPreset_VeryFast);
+    add_choice("fast",      EncPreset_Fast);
+    add_choice("medium",    EncPreset_Medium, true);
+    add_choice("slow",      EncPreset_Slow);
+  }
+};
+
+
 enum MEMode
   {
     MEMode_Test,
@@ -79,6 +106,9 @@ struct encoder_params
   void registerParams(config_parameters& config);
 
 
+  option_EncoderPreset preset;
+
+
   // CB quad-tree
 
   option_int min_cb_size;
@@ -95,6 +125,10 @@ struct encoder_params
 
   sop_creator_trivial_low_delay::params mSOP_LowDelay;
 
+  encoder_lookahead::params mLookahead;
+
+  option_int frame_threads; // number of pictures that are encoded in parallel
+
 
   // --- Algo_TB_IntraPredMode
 
@@ -349,8 +349,54 @@ void encode_cbf_chroma(CABAC_encoder* cabac,
   cabac->write_CABAC_bit(CONTEXT_MODEL_CBF_CHROMA + context, cbf_chroma);
 }
 
+/* The residual syntax elements are written through these functions. They are
+   overloaded for the rate estimator so that estimating the rate of a whole
+   coefficient block does not need a virtual call for each bin.
+ */
+static inline void put_CABAC_bit(CABAC_encoder* cabac, int modelIdx, int bit)
+{
+  cabac->write_CABAC_bit(modelIdx, bit);
+}
+
+static inline void put_CABAC_bit(CABAC_encoder_estim* cabac, int modelIdx, int bit)
+{
+  cabac->estim_CABAC_bit(modelIdx, bit);
+}
+
+static inline void put_CABAC_bypass(CABAC_encoder* cabac, int bit)
+{
+  cabac->write_CABAC_bypass(bit);
+}
+
+static inline void put_CABAC_bypass(CABAC_encoder_estim* cabac, int /*bit*/)
+{
+  cabac->estim_CABAC_bypass_bits(1);
+}
+
+static inline void put_CABAC_FL_bypass(CABAC_encoder* cabac, int value, int nBits)
+{
+  cabac->write_CABAC_FL_bypass(value, nBits);
+}
+
+static inline void put_CABAC_FL_bypass(CABAC_encoder_estim* cabac, int /*value*/, int nBits)
+{
+  cabac->estim_CABAC_bypass_bits(nBits);
+}
+
+static inline void put_CABAC_TU_bypass(CABAC_encoder* cabac, int value, int cMax)
+{
+  cabac->write_CABAC_TU_bypass(value, cMax);
+}
+
+static inline void put_CABAC_TU_bypass(CABAC_encoder_estim* cabac, int value, int cMax)
+{
+  cabac->estim_CABAC_bypass_bits(value + (value<cMax));
+}
+
+
+template <class CABAC>
 static inline void encode_coded_sub_block_flag(encoder_context* ectx,
-                                               CABAC_encoder* cabac,
+                                               CABAC* cabac,
                                                int cIdx,
                                                uint8_t coded_sub_block_neighbors,
                                                int flag)
@@ -367,11 +413,12 @@ static inline void encode_coded_sub_block_flag(encoder_context* ectx,
     ctxIdxInc += 2;
   }
 
-  cabac->write_CABAC_bit(CONTEXT_MODEL_CODED_SUB_BLOCK_FLAG + ctxIdxInc, flag);
+  put_CABAC_bit(cabac, CONTEXT_MODEL_CODED_SUB_BLOCK_FLAG + ctxIdxInc, flag);
 }
 
+template <class CABAC>
 static inline void encode_significant_coeff_flag_lookup(encoder_context* ectx,
-                                                        CABAC_encoder* cabac,
+                                                        CABAC* cabac,
                                                         uint8_t ctxIdxInc,
                                                         int significantFlag)
 {
@@ -379,11 +426,12 @@ static inline void encode_significant_coeff_flag_lookup(encoder_context* ectx,
   logtrace(LogSlice,"# significant_coeff_flag = significantFlag\n");
   logtrace(LogSlice,"context: %d\n",ctxIdxInc);
 
-  cabac->write_CABAC_bit(CONTEXT_MODEL_SIGNIFICANT_COEFF_FLAG + ctxIdxInc, significantFlag);
+  put_CABAC_bit(cabac, CONTEXT_MODEL_SIGNIFICANT_COEFF_FLAG + ctxIdxInc, significantFlag);
 }
 
+template <class CABAC>
 static inline void encode_coeff_abs_level_greater1(encoder_context* ectx,
-                                                   CABAC_encoder* cabac,
+                                                   CABAC* cabac,
                                                    int cIdx, int i,
                                                    bool firstCoeffInSubblock,
                                                    bool firstSubblock,
@@ -439,15 +487,16 @@ static inline void encode_coeff_abs_level_greater1(encoder_context* ectx,
 
   if (cIdx>0) { ctxIdxInc+=16; }
 
-  cabac->write_CABAC_bit(CONTEXT_MODEL_COEFF_ABS_LEVEL_GREATER1_FLAG + ctxIdxInc,  value);
+  put_CABAC_bit(cabac, CONTEXT_MODEL_COEFF_ABS_LEVEL_GREATER1_FLAG + ctxIdxInc,  value);
 
   *lastInvocation_greater1Ctx = greater1Ctx;
   *lastInvocation_coeff_abs_level_greater1_flag = value;
   *lastInvocation_ctxSet = ctxSet;
 }
 
+template <class CABAC>
 static void encode_coeff_abs_level_greater2(encoder_context* ectx,
-                                            CABAC_encoder* cabac,
+                                            CABAC* cabac,
                                             int cIdx, // int i,int n,
                                             int ctxSet,
                                             int value)
@@ -459,7 +508,7 @@ static void encode_coeff_abs_level_greater2(encoder_context* ectx,
 
   if (cIdx>0) ctxIdxInc+=4;
 
-  cabac->write_CABAC_bit(CONTEXT_MODEL_COEFF_ABS_LEVEL_GREATER2_FLAG + ctxIdxInc,  value);
+  put_CABAC_bit(cabac, CONTEXT_MODEL_COEFF_ABS_LEVEL_GREATER2_FLAG + ctxIdxInc,  value);
 }
 
 
@@ -535,8 +584,9 @@ int blamain()
 }
 
 
+template <class CABAC>
 static void encode_coeff_abs_level_remaining(encoder_context* ectx,
-                                             CABAC_encoder* cabac,
+                                             CABAC* cabac,
                                              int cRiceParam,
                                              int level)
 {
@@ -551,13 +601,13 @@ static void encode_coeff_abs_level_remaining(encoder_context* ectx,
   // TU part, length 4 (cTRMax>>riceParam)
 
   int nOnes = (prefixPart>>cRiceParam);
-  cabac->write_CABAC_TU_bypass(nOnes, 4);
+  put_CABAC_TU_bypass(cabac, nOnes, 4);
 
   // TR suffix
 
   if (cTRMax > prefixPart) {
     int remain = prefixPart & ((1<<cRiceParam)-1);
-    cabac->write_CABAC_FL_bypass(remain, cRiceParam);
+    put_CABAC_FL_bypass(cabac, remain, cRiceParam);
   }
 
 
@@ -574,15 +624,15 @@ static void encode_coeff_abs_level_remaining(encoder_context* ectx,
     int range=1;
     int nBits=0;
     while (prefix >= base+range) {
-      cabac->write_CABAC_bypass(1);
+      put_CABAC_bypass(cabac, 1);
       base+=range;
       range*=2;
       nBits++;
     }
 
-    cabac->write_CABAC_bypass(0);
-    cabac->write_CABAC_FL_bypass(prefix-base, nBits);
-    cabac->write_CABAC_FL_bypass(suffix, ExpGRiceParam);
+    put_CABAC_bypass(cabac, 0);
+    put_CABAC_FL_bypass(cabac, prefix-base, nBits);
+    put_CABAC_FL_bypass(cabac, suffix, ExpGRiceParam);
   }
 }
 
@@ -654,11 +704,11 @@ bool subblock_has_nonzero_coefficient(const int16_t* coeff, int coeffStride,
   6   0    2   |   8, 9,10,11
   7   1    2   |  12,13,14,15
 */
-void encode_last_signficiant_coeff_prefix(encoder_context* ectx,
-                                          CABAC_encoder* cabac,
-                                          int log2TrafoSize,
-                                          int cIdx, int lastSignificant,
-                                          int context_model_index)
+template <class CABAC>
+static void encode_last_signficiant_coeff_prefix(CABAC* cabac,
+                                                 int log2TrafoSize,
+                                                 int cIdx, int lastSignificant,
+                                                 int context_model_index)
 {
   logtrace(LogSlice,"> last_significant_coeff_prefix=%d log2TrafoSize:%d cIdx:%d\n",
            lastSignificant,log2TrafoSize,cIdx);
@@ -678,13 +728,13 @@ void encode_last_signficiant_coeff_prefix(encoder_context* ectx,
   for (int binIdx=0;binIdx<lastSignificant;binIdx++)
     {
       int ctxIdxInc = (binIdx >> ctxShift);
-      cabac->write_CABAC_bit(context_model_index + ctxOffset + ctxIdxInc, 1);
+      put_CABAC_bit(cabac, context_model_index + ctxOffset + ctxIdxInc, 1);
     }
 
   if (lastSignificant != cMax) {
     int binIdx = lastSignificant;
     int ctxIdxInc = (binIdx >> ctxShift);
-    cabac->write_CABAC_bit(context_model_index + ctxOffset + ctxIdxInc, 0);
+    put_CABAC_bit(cabac, context_model_index + ctxOffset + ctxIdxInc, 0);
   }
 }
 
@@ -726,13 +776,13 @@ void split_last_significant_position(int pos, int* prefix, int* suffix, int* nSu
 
 extern uint8_t* ctxIdxLookup[4 /* 4-log2-32 */][2 /* !!cIdx */][2 /* !!scanIdx */][4 /* prevCsbf */];
 
-/* These values are read from the image metadata:
-   - intra prediction mode (x0;y0)
+/* The intra prediction mode is taken from the transform block.
  */
-void encode_residual(encoder_context* ectx,
-                     CABAC_encoder* cabac,
-                     const enc_tb* tb, const enc_cb* cb,
-                     int x0,int y0,int log2TrafoSize,int cIdx)
+template <class CABAC>
+static void encode_residual(encoder_context* ectx,
+                            CABAC* cabac,
+                            const enc_tb* tb, const enc_cb* cb,
+                            int log2TrafoSize,int cIdx)
 {
   logdebug(LogEncoder,"encode_residual %s\n",typeid(*cabac).name());
 
@@ -806,18 +856,18 @@ void encode_residual(encoder_context* ectx,
   split_last_significant_position(codedSignificantX, &prefixX,&suffixX,&suffixBitsX);
   split_last_significant_position(codedSignificantY, &prefixY,&suffixY,&suffixBitsY);
 
-  encode_last_signficiant_coeff_prefix(ectx, cabac, log2TrafoSize, cIdx, prefixX,
-                                       CONTEXT_MODEL_LAST_SIGNIFICANT_COEFFICIENT_X_PREFIX);
+  encode_last_signficiant_coeff_prefix(cabac, log2TrafoSize, cIdx, prefixX,
+                                 CONTEXT_MODEL_LAST_SIGNIFICANT_COEFFICIENT_X_PREFIX);
 
-  encode_last_signficiant_coeff_prefix(ectx, cabac, log2TrafoSize, cIdx, prefixY,
-                                       CONTEXT_MODEL_LAST_SIGNIFICANT_COEFFICIENT_Y_PREFIX);
+  encode_last_signficiant_coeff_prefix(cabac, log2TrafoSize, cIdx, prefixY,
+                                 CONTEXT_MODEL_LAST_SIGNIFICANT_COEFFICIENT_Y_PREFIX);
 
 
   if (codedSignificantX > 3) {
-    cabac->write_CABAC_FL_bypass(suffixX, suffixBitsX);
+    put_CABAC_FL_bypass(cabac, suffixX, suffixBitsX);
   }
   if (codedSignificantY > 3) {
-    cabac->write_CABAC_FL_bypass(suffixY, suffixBitsY);
+    put_CABAC_FL_bypass(cabac, suffixY, suffixBitsY);
   }
 
 
@@ -1075,13 +1125,13 @@ void encode_residual(encoder_context* ectx,
                         !cb->cu_transquant_bypass_flag);
 
       for (int n=0;n<nCoefficients-1;n++) {
-        cabac->write_CABAC_bypass(coeff_sign[n]);
+        put_CABAC_bypass(cabac, coeff_sign[n]);
         //logtrace(LogSlice,"a) sign[%d] = %d\n", n, coeff_sign[n]);
       }
 
       // n==nCoefficients-1
       if (!pps.sign_data_hiding_flag || !signHidden) {
-        cabac->write_CABAC_bypass(coeff_sign[nCoefficients-1]);
+        put_CABAC_bypass(cabac, coeff_sign[nCoefficients-1]);
         //logtrace(LogSlice,"b) sign[%d] = %d\n", nCoefficients-1, coeff_sign[nCoefficients-1]);
       }
       else {
@@ -1142,49 +1192,91 @@ void encode_residual(encoder_context* ectx,
 }
 
 
-void encode_transform_unit(encoder_context* ectx,
-                           CABAC_encoder* cabac,
-                           const enc_tb* tb, const enc_cb* cb,
-                           int x0,int y0, int xBase,int yBase,
-                           int log2TrafoSize, int trafoDepth, int blkIdx)
+template <class CABAC>
+static void encode_cu_qp_delta(CABAC* cabac, int cu_qp_delta)
+{
+  logtrace(LogSlice,"# cu_qp_delta = %d\n",cu_qp_delta);
+
+  int cu_qp_delta_abs = abs(cu_qp_delta);
+
+  // prefix: TU with cMax=5, the first bin has its own context
+
+  int prefix = libde265_min(cu_qp_delta_abs, 5);
+  put_CABAC_bit(cabac, CONTEXT_MODEL_CU_QP_DELTA_ABS + 0, prefix>0);
+  for (int i=1;i<5 && i<=prefix;i++) {
+    put_CABAC_bit(cabac, CONTEXT_MODEL_CU_QP_DELTA_ABS + 1, i<prefix);
+  }
+
+  // suffix: EG0
+
+  if (cu_qp_delta_abs >= 5) {
+    cabac->write_CABAC_EGk(cu_qp_delta_abs-5, 0);
+  }
+
+  if (cu_qp_delta_abs) {
+    put_CABAC_bypass(cabac, cu_qp_delta<0);
+  }
+}
+
+
+template <class CABAC>
+static void encode_transform_unit_internal(encoder_context* ectx,
+                                           CABAC* cabac,
+                                           const enc_tb* tb, const enc_cb* cb,
+                                           int log2TrafoSize, int trafoDepth, int blkIdx)
 {
   ESTIM_BITS_BEGIN;
 
-  if (tb->cbf[0] || tb->cbf[1] || tb->cbf[2]) {
-    if (ectx->img->get_pps().cu_qp_delta_enabled_flag &&
-        true /*!ectx->IsCuQpDeltaCoded*/) {
-      assert(0);
+  // cu_qp_delta is sent with the first TU that has coded coefficients in the quantization group
+
+  if (ectx->img->get_pps().cu_qp_delta_enabled_flag &&
+      !ectx->IsCuQpDeltaCoded) {
+
+    // For 4x4 luma blocks in 4:2:0/4:2:2, the chroma CBFs are those of the parent block.
+    bool cbfChroma;
+    if (log2TrafoSize==2 && trafoDepth>0 && ectx->get_sps().ChromaArrayType != CHROMA_444) {
+      cbfChroma = (tb->parent->cbf[1] || tb->parent->cbf[2]);
+    }
+    else {
+      cbfChroma = (tb->cbf[1] || tb->cbf[2]);
     }
 
+    if (tb->cbf[0] || cbfChroma) {
+      encode_cu_qp_delta(cabac, cb->qp - ectx->qPY_PRED);
+      ectx->IsCuQpDeltaCoded = true;
+    }
+  }
+
+  if (tb->cbf[0] || tb->cbf[1] || tb->cbf[2]) {
     if (tb->cbf[0]) {
-      encode_residual(ectx,cabac, tb,cb,x0,y0,log2TrafoSize,0);
+      encode_residual(ectx,cabac, tb,cb,log2TrafoSize,0);
     }
 
     if (ectx->get_sps().chroma_format_idc == CHROMA_444) {
       if (tb->cbf[1]) {
-        encode_residual(ectx,cabac, tb,cb,x0,y0,log2TrafoSize,1);
+        encode_residual(ectx,cabac, tb,cb,log2TrafoSize,1);
       }
       if (tb->cbf[2]) {
-        encode_residual(ectx,cabac, tb,cb,x0,y0,log2TrafoSize,2);
+        encode_residual(ectx,cabac, tb,cb,log2TrafoSize,2);
       }
     }
     else if (log2TrafoSize>2) {
       // larger than 4x4
 
       if (tb->cbf[1]) {
-        encode_residual(ectx,cabac,tb,cb,x0,y0,log2TrafoSize-1,1);
+        encode_residual(ectx,cabac, tb,cb,log2TrafoSize-1,1);
       }
       if (tb->cbf[2]) {
-        encode_residual(ectx,cabac,tb,cb,x0,y0,log2TrafoSize-1,2);
+        encode_residual(ectx,cabac, tb,cb,log2TrafoSize-1,2);
       }
     }
     else if (blkIdx==3) {
       // cannot check for tb->parent->cbf[], because this may not yet be set
       if (tb->cbf[1]) {
-        encode_residual(ectx,cabac,tb,cb,xBase,yBase,log2TrafoSize,1);
+        encode_residual(ectx,cabac, tb,cb,log2TrafoSize,1);
       }
       if (tb->cbf[2]) {
-        encode_residual(ectx,cabac,tb,cb,xBase,yBase,log2TrafoSize,2);
+        encode_residual(ectx,cabac, tb,cb,log2TrafoSize,2);
       }
     }
   }
@@ -1193,6 +1285,26 @@ void encode_transform_unit(encoder_context* ectx,
 }
 
 
+void encode_transform_unit(encoder_context* ectx,
+                           CABAC_encoder* cabac,
+                           const enc_tb* tb, const enc_cb* cb,
+                           int /*x0*/,int /*y0*/, int /*xBase*/,int /*yBase*/,
+                           int log2TrafoSize, int trafoDepth, int blkIdx)
+{
+  encode_transform_unit_internal(ectx,cabac, tb,cb, log2TrafoSize, trafoDepth, blkIdx);
+}
+
+
+void encode_transform_unit(encoder_context* ectx,
+                           CABAC_encoder_estim* cabac,
+                           const enc_tb* tb, const enc_cb* cb,
+                           int /*x0*/,int /*y0*/, int /*xBase*/,int /*yBase*/,
+                           int log2TrafoSize, int trafoDepth, int blkIdx)
+{
+  encode_transform_unit_internal(ectx,cabac, tb,cb, log2TrafoSize, trafoDepth, blkIdx);
+}
+
+
 void encode_transform_tree(encoder_context* ectx,
                            CABAC_encoder* cabac,
                            const enc_tb* tb, const enc_cb* cb,
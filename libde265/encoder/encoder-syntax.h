@@ -77,6 +77,15 @@ void encode_cu_skip_flag(encoder_context* ectx,
                          const enc_cb* cb,
                          bool skip);
 
+void encode_part_mode(encoder_context* ectx,
+                      CABAC_encoder* cabac,
+                      enum PredMode PredMode, enum PartMode PartMode, int cLog2CbSize);
+
+void encode_prediction_unit(encoder_context* ectx,
+                            CABAC_encoder* cabac,
+                            const enc_cb* cb, int pbIdx,
+                            int x0,int y0, int w, int h);
+
 void encode_cbf_luma(CABAC_encoder* cabac,
                      bool zeroTrafoDepth, int cbf_luma);
 
@@ -89,6 +98,15 @@ void encode_transform_unit(encoder_context* ectx,
                            int x0,int y0, int xBase,int yBase,
                            int log2TrafoSize, int trafoDepth, int blkIdx);
 
+/* Same as above, but the rate estimator is called without virtual function calls.
+   This is selected automatically when passing a CABAC_encoder_estim.
+ */
+void encode_transform_unit(encoder_context* ectx,
+                           CABAC_encoder_estim* cabac,
+                           const enc_tb* tb, const enc_cb* cb,
+                           int x0,int y0, int xBase,int yBase,
+                           int log2TrafoSize, int trafoDepth, int blkIdx);
+
 
 void encode_quadtree(encoder_context* ectx,
                      CABAC_encoder* cabac,
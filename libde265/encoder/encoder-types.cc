@@ -36,6 +36,123 @@ int allocCB = 0;
 #define DEBUG_ALLOCS 0
 
 
+thread_local enc_node_memory* enc_node_memory::mCurrent = NULL;
+
+
+// Each node is preceded by the enc_node_memory it was taken from.
+static const size_t NodeHeaderSize = 16;
+
+
+enc_node_memory::enc_node_memory()
+  : mCBPool(sizeof(enc_cb) + NodeHeaderSize, 200),
+    mTBPool(sizeof(enc_tb) + NodeHeaderSize, 1000)
+{
+}
+
+
+enc_node_memory::~enc_node_memory()
+{
+  for (size_t i=0;i<mLargePixelBuffers.size();i++) {
+    delete[] mLargePixelBuffers[i];
+  }
+}
+
+
+void* enc_node_memory::new_node(size_t size, bool cb)
+{
+  enc_node_memory* mem = mCurrent;
+
+  uint8_t* p;
+  if (mem) {
+    alloc_pool& pool = (cb ? mem->mCBPool : mem->mTBPool);
+    p = (uint8_t*)pool.new_obj(size + NodeHeaderSize);
+  }
+  else {
+    p = (uint8_t*)::operator new(size + NodeHeaderSize);
+  }
+
+  *(enc_node_memory**)p = mem;
+
+  return p + NodeHeaderSize;
+}
+
+
+void enc_node_memory::delete_node(void* obj, size_t size, bool cb)
+{
+  uint8_t* p = (uint8_t*)obj - NodeHeaderSize;
+  enc_node_memory* mem = *(enc_node_memory**)p;
+
+  if (mem) {
+    alloc_pool& pool = (cb ? mem->mCBPool : mem->mTBPool);
+    pool.delete_obj(p, size + NodeHeaderSize);
+  }
+  else {
+    ::operator delete(p);
+  }
+}
+
+
+uint8_t* enc_node_memory::alloc_pixels(int nBytes)
+{
+  int log2Bytes = libde265_max(Log2(nBytes), (int)MinLog2PixelBytes);
+  if ((1<<log2Bytes) < nBytes) { log2Bytes++; }
+
+  if (log2Bytes > MaxLog2PixelBytes) {
+    uint8_t* p = new uint8_t[nBytes];
+    mLargePixelBuffers.push_back(p);
+    return p;
+  }
+
+  std::unique_ptr<alloc_pool>& pool = mPixelPools[log2Bytes-MinLog2PixelBytes];
+  if (!pool) {
+    pool.reset(new alloc_pool(1<<log2Bytes, 256));
+  }
+
+  return (uint8_t*)pool->new_obj(1<<log2Bytes);
+}
+
+
+void enc_node_memory::free_pixels(uint8_t* p, int nBytes)
+{
+  int log2Bytes = libde265_max(Log2(nBytes), (int)MinLog2PixelBytes);
+  if ((1<<log2Bytes) < nBytes) { log2Bytes++; }
+
+  if (log2Bytes > MaxLog2PixelBytes) {
+    for (size_t i=0;i<mLargePixelBuffers.size();i++) {
+      if (mLargePixelBuffers[i]==p) {
+        mLargePixelBuffers[i] = mLargePixelBuffers.back();
+        mLargePixelBuffers.pop_back();
+        break;
+      }
+    }
+
+    delete[] p;
+    return;
+  }
+
+  mPixelPools[log2Bytes-MinLog2PixelBytes]->delete_obj(p, 1<<log2Bytes);
+}
+
+
+void enc_node_memory::reset()
+{
+  mCBPool.reset();
+  mTBPool.reset();
+
+  for (size_t i=0;i<mLargePixelBuffers.size();i++) {
+    delete[] mLargePixelBuffers[i];
+  }
+  mLargePixelBuffers.clear();
+
+  for (int i=0;i<=MaxLog2PixelBytes-MinLog2PixelBytes;i++) {
+    if (mPixelPools[i]) {
+      mPixelPools[i]->reset();
+    }
+  }
+}
+
+
+
 small_image_buffer::small_image_buffer(int log2Size,int bytes_per_pixel)
 {
   mWidth  = 1<<log2Size;
@@ -44,13 +161,25 @@ small_image_buffer::small_image_buffer(int log2Size,int bytes_per_pixel)
   mBytesPerRow = bytes_per_pixel * (1<<log2Size);
 
   int nBytes = mWidth*mHeight*bytes_per_pixel;
-  mBuf = new uint8_t[nBytes];
+
+  mMemory = enc_node_memory::current();
+  if (mMemory) {
+    mBuf = mMemory->alloc_pixels(nBytes);
+  }
+  else {
+    mBuf = new uint8_t[nBytes];
+  }
 }
 
 
 small_image_buffer::~small_image_buffer()
 {
-  delete[] mBuf;
+  if (mMemory) {
+    mMemory->free_pixels(mBuf, mWidth*mHeight*(mBytesPerRow/mWidth));
+  }
+  else {
+    delete[] mBuf;
+  }
 }
 
 
@@ -65,8 +194,6 @@ void enc_cb::set_rqt_root_bf_from_children_cbf()
 
 
 
-alloc_pool enc_tb::mMemPool(sizeof(enc_tb));
-
 enc_tb::enc_tb(int x,int y,int log2TbSize, enc_cb* _cb)
   : enc_node(x,y,log2TbSize)
 {
@@ -77,6 +204,7 @@ enc_tb::enc_tb(int x,int y,int log2TbSize, enc_cb* _cb)
 
   split_transform_flag = false;
   coeff[0]=coeff[1]=coeff[2]=NULL;
+  coeffMemory = enc_node_memory::current();
 
   TrafoDepth = 0;
   cbf[0] = cbf[1] = cbf[2] = 0;
@@ -101,7 +229,14 @@ enc_tb::~enc_tb()
   }
   else {
     for (int i=0;i<3;i++) {
-      delete[] coeff[i];
+      if (coeff[i]==NULL) {
+        continue;
+      }
+
+      int nBytes = sizeof(int16_t) << (2*log2Size);
+
+      if (coeffMemory) { coeffMemory->free_pixels((uint8_t*)coeff[i], nBytes); }
+      else             { delete[] coeff[i]; }
     }
   }
 
@@ -112,7 +247,13 @@ enc_tb::~enc_tb()
 void enc_tb::alloc_coeff_memory(int cIdx, int tbSize)
 {
   assert(coeff[cIdx]==NULL);
-  coeff[cIdx] = new int16_t[tbSize*tbSize];
+  assert(tbSize <= (1<<log2Size));
+
+  // The chroma buffers have the luma size, too, such that ~enc_tb() knows their size.
+  int nBytes = sizeof(int16_t) << (2*log2Size);
+
+  if (coeffMemory) { coeff[cIdx] = (int16_t*)coeffMemory->alloc_pixels(nBytes); }
+  else             { coeff[cIdx] = new int16_t[nBytes/sizeof(int16_t)]; }
 }
 
 
@@ -134,59 +275,21 @@ void enc_tb::reconstruct_tb(encoder_context* ectx,
 
   if (!reconstruction[cIdx]) {
 
-    reconstruction[cIdx] = std::make_shared<small_image_buffer>(log2TbSize, sizeof(uint8_t));
+    reconstruction[cIdx] = small_image_buffer::create(log2TbSize, sizeof(uint8_t));
 
     if (cb->PredMode == MODE_SKIP) {
       PixelAccessor dstPixels(*reconstruction[cIdx], xC,yC);
       dstPixels.copyFromImage(img, cIdx);
     }
     else { // not SKIP mode
-      if (cb->PredMode == MODE_INTRA) {
-
-        //enum IntraPredMode intraPredMode  = img->get_IntraPredMode(x0,y0);
-        enum IntraPredMode intraPredMode  = intra_mode;
-
-        if (cIdx>0) {
-          intraPredMode = intra_mode_chroma;
-        }
-
-        //printf("reconstruct TB (%d;%d): intra mode (cIdx=%d) = %d\n",xC,yC,cIdx,intraPredMode);
-
-        //decode_intra_prediction(img, xC,yC,  intraPredMode, 1<< log2TbSize   , cIdx);
+      // intra or inter prediction, computed in tb-split
 
-        //printf("access intra-prediction of TB %p\n",this);
-
-        intra_prediction[cIdx]->copy_to(*reconstruction[cIdx]);
-        /*
-          copy_subimage(img->get_image_plane_at_pos(cIdx,xC,yC),
-          img->get_image_stride(cIdx),
-          intra_prediction[cIdx]->get_buffer<uint8_t>(), 1<<log2TbSize,
-          1<<log2TbSize, 1<<log2TbSize);
-        */
-      }
-      else {
-        assert(0); // -> TODO: now only store in tb_enc
-
-        int size = 1<<log2TbSize;
-
-        uint8_t* dst_ptr  = img->get_image_plane_at_pos(cIdx, xC,  yC  );
-        int dst_stride  = img->get_image_stride(cIdx);
-
-        /* TODO TMP HACK: prediction does not exist anymore
-        uint8_t* src_ptr  = ectx->prediction->get_image_plane_at_pos(cIdx, xC,  yC  );
-        int src_stride  = ectx->prediction->get_image_stride(cIdx);
-
-        for (int y=0;y<size;y++) {
-          for (int x=0;x<size;x++) {
-            dst_ptr[y*dst_stride+x] = src_ptr[y*src_stride+x];
-          }
-        }
-        */
-      }
+      intra_prediction[cIdx]->copy_to(*reconstruction[cIdx]);
 
       ALIGNED_16(int16_t) dequant_coeff[32*32];
 
-      if (cbf[cIdx]) dequant_coefficients(dequant_coeff, coeff[cIdx], log2TbSize, cb->qp);
+      if (cbf[cIdx]) dequant_coefficients(dequant_coeff, coeff[cIdx], log2TbSize,
+                                          get_component_QP(ectx->get_sps(), cb->qp, cIdx));
 
       if (0 && cbf[cIdx]) {
         printf("--- quantized coeffs ---\n");
@@ -201,7 +304,7 @@ void enc_tb::reconstruct_tb(encoder_context* ectx,
       int stride  = img->get_image_stride(cIdx);
 #endif
 
-      int trType = (cIdx==0 && log2TbSize==2); // TODO: inter
+      int trType = (cIdx==0 && log2TbSize==2 && cb->PredMode==MODE_INTRA);
 
       //printf("--- prediction %d %d / %d ---\n",x0,y0,cIdx);
       //printBlk("prediction",ptr,1<<log2TbSize,stride);
@@ -301,9 +404,6 @@ void enc_tb::set_cbf_flags_from_children()
 
 
 
-alloc_pool enc_cb::mMemPool(sizeof(enc_cb), 200);
-
-
 enc_cb::enc_cb()
   : split_cu_flag(false),
     cu_transquant_bypass_flag(false),
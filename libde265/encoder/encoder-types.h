@@ -27,6 +27,7 @@
 #include "libde265/decctx.h"
 #include "libde265/image-io.h"
 #include "libde265/alloc_pool.h"
+#include "libde265/transform.h"
 
 #include <memory>
 
@@ -34,12 +35,119 @@ class encoder_context;
 class enc_cb;
 
 
+// QP of colour component 'cIdx', derived as in 8.6.1 (the encoder does not use chroma QP offsets)
+inline int get_component_QP(const seq_parameter_set& sps, int qpY, int cIdx)
+{
+  if (cIdx==0) {
+    return qpY;
+  }
+
+  int qPi = Clip3(-sps.QpBdOffset_C, 57, qpY);
+
+  if (sps.ChromaArrayType == CHROMA_420) {
+    return table8_22(qPi);
+  }
+  else {
+    return qPi;
+  }
+}
+
+
+/* Memory for the enc_cb / enc_tb trees and their pixel buffers.
+
+   Each thread that builds coding trees activates its own enc_node_memory with
+   set_current(). All nodes allocated in that thread are then taken from it without
+   any locking. Nodes discarded during the RDO search go back to the free-lists,
+   reset() releases everything at once when the trees are not needed anymore.
+   Everything a node owns (coefficients, image buffers) is also taken from this memory,
+   such that the trees can be dropped without deleting them node by node.
+
+   When no memory is active, nodes and buffers are allocated from the heap.
+ */
+class enc_node_memory
+{
+ public:
+  enc_node_memory();
+  ~enc_node_memory();
+
+  /* Nodes remember the memory they were taken from. They can thus also be deleted
+     while no memory (or another one) is active, but only in the thread that owns
+     that memory. */
+  static void* new_cb(size_t size) { return new_node(size, true); }
+  static void  delete_cb(void* p, size_t size) { delete_node(p, size, true); }
+
+  static void* new_tb(size_t size) { return new_node(size, false); }
+  static void  delete_tb(void* p, size_t size) { delete_node(p, size, false); }
+
+  uint8_t* alloc_pixels(int nBytes);
+  void     free_pixels(uint8_t* p, int nBytes);
+
+  // All nodes and buffers allocated from this memory become invalid.
+  void reset();
+
+  static enc_node_memory* current() { return mCurrent; }
+  static void set_current(enc_node_memory* mem) { mCurrent = mem; }
+
+ private:
+  alloc_pool mCBPool;
+  alloc_pool mTBPool;
+
+  // pixel buffers of 2^(MinLog2PixelBytes+i) bytes, larger buffers are taken from the heap
+  enum { MinLog2PixelBytes = 4, MaxLog2PixelBytes = 13 };
+  std::unique_ptr<alloc_pool> mPixelPools[MaxLog2PixelBytes-MinLog2PixelBytes+1];
+  std::vector<uint8_t*> mLargePixelBuffers;
+
+  static void* new_node(size_t size, bool cb);
+  static void  delete_node(void* p, size_t size, bool cb);
+
+  static thread_local enc_node_memory* mCurrent;
+
+  enc_node_memory(const enc_node_memory&); // not allowed
+  enc_node_memory& operator=(const enc_node_memory&); // not allowed
+};
+
+
+/* Allocator for std::allocate_shared() that takes the memory from an enc_node_memory
+   (or from the heap if there is none).
+ */
+template <class T> class enc_node_allocator
+{
+ public:
+  typedef T value_type;
+
+  explicit enc_node_allocator(enc_node_memory* mem) : mMemory(mem) { }
+  template <class U> enc_node_allocator(const enc_node_allocator<U>& a) : mMemory(a.mMemory) { }
+
+  T* allocate(size_t n) {
+    if (mMemory) { return (T*)mMemory->alloc_pixels(n*sizeof(T)); }
+    else         { return (T*)::operator new(n*sizeof(T)); }
+  }
+
+  void deallocate(T* p, size_t n) {
+    if (mMemory) { mMemory->free_pixels((uint8_t*)p, n*sizeof(T)); }
+    else         { ::operator delete(p); }
+  }
+
+  template <class U> bool operator==(const enc_node_allocator<U>& a) const { return mMemory==a.mMemory; }
+  template <class U> bool operator!=(const enc_node_allocator<U>& a) const { return mMemory!=a.mMemory; }
+
+  enc_node_memory* mMemory;
+};
+
+
 class small_image_buffer
 {
  public:
   explicit small_image_buffer(int log2Size,int bytes_per_pixel=1);
   ~small_image_buffer();
 
+  // Allocate a buffer with its shared_ptr control block from the current enc_node_memory.
+  static std::shared_ptr<small_image_buffer> create(int log2Size,int bytes_per_pixel=1) {
+    return std::allocate_shared<small_image_buffer>(
+        enc_node_allocator<small_image_buffer>(enc_node_memory::current()),
+        log2Size, bytes_per_pixel);
+  }
+
   uint8_t*  get_buffer_u8() const { return mBuf; }
   int16_t*  get_buffer_s16() const { return (int16_t*)mBuf; }
   uint16_t* get_buffer_u16() const { return (uint16_t*)mBuf; }
@@ -58,6 +166,7 @@ class small_image_buffer
 
  private:
   uint8_t*  mBuf;
+  enc_node_memory* mMemory; // where mBuf was allocated from (NULL: heap)
   uint16_t  mStride;
   uint16_t  mBytesPerRow;
 
@@ -153,9 +262,12 @@ class enc_tb : public enc_node
 
   uint8_t cbf[3];
 
+  enc_node_memory* coeffMemory; // where coeff[] was allocated from (NULL: heap)
+
 
   /* intra_prediction and residual is filled in tb-split, because this is where we decide
      on the final block-size the TB is coded with.
+     In inter CBs, intra_prediction holds the motion-compensated prediction.
    */
   //mutable uint8_t debug_intra_border[2*64+1];
   std::shared_ptr<small_image_buffer> intra_prediction[3];
@@ -200,17 +312,15 @@ class enc_tb : public enc_node
   void writeReconstructionToImage(de265_image* img,
                                   const seq_parameter_set* sps) const;
 
-  /*
-  static void* operator new(const size_t size) { return mMemPool.new_obj(size); }
-  static void operator delete(void* obj) { mMemPool.delete_obj(obj); }
-  */
+  // memory management
+
+  static void* operator new(const size_t size) { return enc_node_memory::new_tb(size); }
+  static void operator delete(void* obj, const size_t size) { enc_node_memory::delete_tb(obj,size); }
 
 
   virtual void debug_dumpTree(int flags, int indent=0) const;
 
 private:
-  static alloc_pool mMemPool;
-
   void reconstruct_tb(encoder_context* ectx,
                       de265_image* img, int x0,int y0, int log2TbSize,
                       int cIdx) const;
@@ -319,20 +429,11 @@ public:
 
   // memory management
 
-  static void* operator new(const size_t size) {
-    void* p = mMemPool.new_obj(size);
-    //printf("ALLOC %p\n",p);
-    return p;
-  }
-  static void operator delete(void* obj) {
-    //printf("DELETE %p\n",obj);
-    mMemPool.delete_obj(obj);
-  }
+  static void* operator new(const size_t size) { return enc_node_memory::new_cb(size); }
+  static void operator delete(void* obj, const size_t size) { enc_node_memory::delete_cb(obj,size); }
 
  private:
   //void write_to_image(de265_image*) const;
-
-  static alloc_pool mMemPool;
 };
 
 
@@ -346,6 +447,14 @@ class CTBTreeMatrix
   void alloc(int w,int h, int log2CtbSize);
   void clear() { free(); }
 
+  /* Forget all CTB trees without deleting them. Their nodes and buffers have to be
+     released with enc_node_memory::reset() instead. */
+  void release() {
+    for (size_t i=0 ; i<mCTBs.size() ; i++) {
+      mCTBs[i]=NULL;
+    }
+  }
+
   void setCTB(int xCTB, int yCTB, enc_cb* ctb) {
     int idx = xCTB + yCTB*mWidthCtbs;
     assert(idx < mCTBs.size());
@@ -165,6 +165,15 @@ void encoder_picture_buffer::sop_metadata_commit(int frame_number)
 }
 
 
+void encoder_picture_buffer::set_ctb_qp_offsets(int frame_number,
+                                                const std::vector<int8_t>& offsets)
+{
+  image_data* data = get_picture(frame_number);
+
+  data->ctbQPOffset = offsets;
+}
+
+
 
 // --- infos pushed by encoder ---
 
@@ -216,6 +225,20 @@ void encoder_picture_buffer::mark_encoding_finished(int frame_number)
   FOR_LOOP(int, f, data->keep)     { get_picture(f)->mark_used=true; }
   data->mark_used=true;
 
+  // pictures that are still being encoded in other frame threads need their references
+
+#ifdef FOR_LOOP_AUTO_SUPPORT
+  FOR_LOOP(auto, imgdata, mImages) {
+#else
+  FOR_LOOP(image_data *, imgdata, mImages) {
+#endif
+    if (imgdata->state == image_data::state_encoding) {
+      FOR_LOOP(int, f, imgdata->ref0)     { get_picture(f)->mark_used=true; }
+      FOR_LOOP(int, f, imgdata->ref1)     { get_picture(f)->mark_used=true; }
+      FOR_LOOP(int, f, imgdata->longterm) { get_picture(f)->mark_used=true; }
+    }
+  }
+
   // copy over all images that we still keep
 
   std::deque<image_data*> newImageSet;
@@ -224,7 +247,13 @@ void encoder_picture_buffer::mark_encoding_finished(int frame_number)
 #else
   FOR_LOOP(image_data *, imgdata, mImages) {
 #endif
-    if (imgdata->mark_used || imgdata->is_in_output_queue) {
+    // images that have not been encoded yet (queued by the lookahead) or that are
+    // still being encoded in another frame thread also stay
+
+    if (imgdata->state <= image_data::state_encoding) {
+      newImageSet.push_back(imgdata);
+    }
+    else if (imgdata->mark_used || imgdata->is_in_output_queue) {
       imgdata->reconstruction->PicState = UsedForShortTermReference; // TODO: this is only a hack
 
       newImageSet.push_back(imgdata);
@@ -291,6 +320,20 @@ image_data* encoder_picture_buffer::get_picture(int frame_number)
 }
 
 
+std::map<int,const de265_image*> encoder_picture_buffer::get_reconstruction_images() const
+{
+  std::map<int,const de265_image*> images;
+
+  for (int i=0;i<mImages.size();i++) {
+    if (mImages[i]->reconstruction) {
+      images[mImages[i]->frame_number] = mImages[i]->reconstruction;
+    }
+  }
+
+  return images;
+}
+
+
 bool encoder_picture_buffer::has_picture(int frame_number) const
 {
   for (int i=0;i<mImages.size();i++) {
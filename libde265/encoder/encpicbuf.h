@@ -25,6 +25,7 @@
 #include "libde265/sps.h"
 
 #include <deque>
+#include <map>
 #include <vector>
 
 
@@ -56,6 +57,8 @@ struct image_data
   int skip_priority;
   bool is_intra;  // TODO: remove, use shdr.slice_type instead
 
+  std::vector<int8_t> ctbQPOffset; // QP offset for each CTB (raster-scan), empty if none
+
   /* unprocessed              only input image has been inserted, no metadata
      sop_metadata_available   sop-creator has filled in references and skipping metadata
      a) encoding              encoding started for this frame, reconstruction image was created
@@ -108,6 +111,11 @@ class encoder_picture_buffer
   void sop_metadata_commit(int frame_number); // note: frame_number is only for consistency checking
 
 
+  // --- lookahead ---
+
+  void set_ctb_qp_offsets(int frame_number, const std::vector<int8_t>& offsets);
+
+
   // --- infos pushed by encoder ---
 
   void mark_encoding_started(int frame_number);
@@ -120,6 +128,7 @@ class encoder_picture_buffer
   // --- data access ---
 
   bool have_more_frames_to_encode() const;
+  bool is_end_of_stream() const { return mEndOfStream; }
   image_data* get_next_picture_to_encode(); // or return NULL if no picture is available
   const image_data* get_picture(int frame_number) const;
   bool has_picture(int frame_number) const;
@@ -129,6 +138,9 @@ class encoder_picture_buffer
     return mImages.front();
   }
 
+  // reconstruction images of all pictures that have one, indexed by frame number
+  std::map<int,const de265_image*> get_reconstruction_images() const;
+
   void mark_image_is_outputted(int frame_number);
   void release_input_image(int frame_number);
 
@@ -0,0 +1,405 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2013-2014 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "libde265/encoder/lookahead.h"
+#include "libde265/util.h"
+
+#include <assert.h>
+#include <string.h>
+#include <math.h>
+
+
+// block size of the analysis in the half-resolution image
+#define LOOKAHEAD_BLKSIZE      8
+
+// full-pel search range for the inter cost (half-resolution pixels)
+#define LOOKAHEAD_SEARCH_RANGE 8
+
+#define LOOKAHEAD_MAX_QP_OFFSET 8
+
+
+encoder_lookahead::encoder_lookahead()
+{
+  mAccel = NULL;
+  mLog2CtbSize = 0;
+
+  mEndOfStream = false;
+
+  mThreadRunning = false;
+  mStopThread = false;
+
+  mHalfWidth = mHalfHeight = 0;
+  mHavePrev = false;
+}
+
+
+encoder_lookahead::~encoder_lookahead()
+{
+  stop();
+
+  // images that have not been taken by the encoder are dropped
+
+  for (size_t i=0;i<mQueue.size();i++) {
+    delete mQueue[i]->img;
+    delete mQueue[i];
+  }
+}
+
+
+#ifndef _WIN32
+void* encoder_lookahead::thread_main(void* lookahead_ptr)
+#else
+DWORD WINAPI encoder_lookahead::thread_main(LPVOID lookahead_ptr)
+#endif
+{
+  encoder_lookahead* la = (encoder_lookahead*)lookahead_ptr;
+
+  for (;;) {
+    de265_mutex_lock(&la->mMutex);
+
+    while (la->mPending.empty() && !la->mStopThread) {
+      de265_cond_wait(&la->mCond, &la->mMutex);
+    }
+
+    if (la->mStopThread) {
+      de265_mutex_unlock(&la->mMutex);
+      break;
+    }
+
+    // Entries are only removed from mQueue after they have been analysed,
+    // hence, the pointer stays valid while we work on it without the lock.
+
+    entry* e = la->mPending.front();
+    la->mPending.pop_front();
+    de265_mutex_unlock(&la->mMutex);
+
+    la->analyse(e);
+
+    de265_mutex_lock(&la->mMutex);
+    e->analysed = true;
+    de265_mutex_unlock(&la->mMutex);
+
+    de265_cond_broadcast(&la->mCond, &la->mMutex);
+  }
+
+  return 0;
+}
+
+
+void encoder_lookahead::start(const acceleration_functions* accel, int log2CtbSize)
+{
+  if (!is_enabled() || mThreadRunning) {
+    return;
+  }
+
+  mAccel = accel;
+  mLog2CtbSize = log2CtbSize;
+
+  mStopThread = false;
+
+  de265_mutex_init(&mMutex);
+  de265_cond_init(&mCond);
+
+  if (de265_thread_create(&mThread, thread_main, this) != 0) {
+    de265_mutex_destroy(&mMutex);
+    de265_cond_destroy(&mCond);
+
+    // without the thread, we cannot analyse anything -> pass images through directly
+    mParams.depth.set(0);
+    return;
+  }
+
+  mThreadRunning = true;
+}
+
+
+void encoder_lookahead::stop()
+{
+  if (!mThreadRunning) {
+    return;
+  }
+
+  de265_mutex_lock(&mMutex);
+  mStopThread = true;
+  de265_mutex_unlock(&mMutex);
+
+  de265_cond_broadcast(&mCond, &mMutex);
+
+  de265_thread_join(mThread);
+  de265_thread_destroy(&mThread);
+
+  de265_mutex_destroy(&mMutex);
+  de265_cond_destroy(&mCond);
+
+  mThreadRunning = false;
+}
+
+
+void encoder_lookahead::push_image(de265_image* img)
+{
+  assert(mThreadRunning);
+
+  entry* e = new entry;
+  e->img = img;
+  e->analysed = false;
+
+  de265_mutex_lock(&mMutex);
+  mQueue.push_back(e);
+  mPending.push_back(e);
+  de265_mutex_unlock(&mMutex);
+
+  de265_cond_broadcast(&mCond, &mMutex);
+}
+
+
+void encoder_lookahead::push_end_of_stream()
+{
+  de265_mutex_lock(&mMutex);
+  mEndOfStream = true;
+  de265_mutex_unlock(&mMutex);
+}
+
+
+de265_image* encoder_lookahead::get_next_image(frame_analysis* analysis)
+{
+  de265_mutex_lock(&mMutex);
+
+  if (mQueue.empty() ||
+      (mQueue.size() <= (size_t)mParams.depth && !mEndOfStream)) {
+    de265_mutex_unlock(&mMutex);
+    return NULL;
+  }
+
+  entry* e = mQueue.front();
+  while (!e->analysed) {
+    de265_cond_wait(&mCond, &mMutex);
+  }
+
+  mQueue.pop_front();
+  de265_mutex_unlock(&mMutex);
+
+  de265_image* img = e->img;
+  *analysis = e->analysis;
+  delete e;
+
+  return img;
+}
+
+
+bool encoder_lookahead::is_end_of_stream() const
+{
+  de265_mutex_lock(&mMutex);
+  bool eos = (mEndOfStream && mQueue.empty());
+  de265_mutex_unlock(&mMutex);
+
+  return eos;
+}
+
+
+// --- analysis ---
+
+static void downscale_luma(uint8_t* dst, int dstWidth, int dstHeight,
+                           const uint8_t* src, int srcStride)
+{
+  for (int y=0;y<dstHeight;y++) {
+    const uint8_t* s0 = src + 2*y*srcStride;
+    const uint8_t* s1 = s0 + srcStride;
+    uint8_t* d = dst + y*dstWidth;
+
+    for (int x=0;x<dstWidth;x++) {
+      d[x] = (s0[2*x] + s0[2*x+1] + s1[2*x] + s1[2*x+1] + 2) >> 2;
+    }
+  }
+}
+
+
+/* Minimum SATD of DC, horizontal and vertical prediction. The prediction is
+   built from the original (not reconstructed) neighbouring pixels.
+ */
+static uint32_t intra_cost(const acceleration_functions* accel,
+                           const uint8_t* img, int stride, int x0,int y0)
+{
+  const int N = LOOKAHEAD_BLKSIZE;
+  const uint8_t* src = img + x0 + y0*stride;
+
+  uint8_t pred[N*N];
+
+  bool haveLeft = (x0>0);
+  bool haveTop  = (y0>0);
+
+  // DC
+
+  int sum=0, cnt=0;
+  if (haveLeft) { for (int i=0;i<N;i++) sum += src[i*stride-1]; cnt+=N; }
+  if (haveTop)  { for (int i=0;i<N;i++) sum += src[i-stride];   cnt+=N; }
+  int dc = (cnt ? (sum + cnt/2)/cnt : 128);
+
+  memset(pred, dc, N*N);
+  uint32_t cost = accel->satd_8[1](src,stride, pred,N);
+
+  // horizontal
+
+  if (haveLeft) {
+    for (int y=0;y<N;y++) {
+      memset(pred+y*N, src[y*stride-1], N);
+    }
+
+    cost = libde265_min(cost, accel->satd_8[1](src,stride, pred,N));
+  }
+
+  // vertical
+
+  if (haveTop) {
+    for (int y=0;y<N;y++) {
+      memcpy(pred+y*N, src-stride, N);
+    }
+
+    cost = libde265_min(cost, accel->satd_8[1](src,stride, pred,N));
+  }
+
+  return cost;
+}
+
+
+/* Full-pel search around the co-located block with SAD, SATD of the best match.
+ */
+static uint32_t inter_cost(const acceleration_functions* accel,
+                           const uint8_t* img, const uint8_t* ref, int stride,
+                           int width, int height, int x0,int y0)
+{
+  const int N = LOOKAHEAD_BLKSIZE;
+  const uint8_t* src = img + x0 + y0*stride;
+
+  int xMin = libde265_max(x0-LOOKAHEAD_SEARCH_RANGE, 0);
+  int yMin = libde265_max(y0-LOOKAHEAD_SEARCH_RANGE, 0);
+  int xMax = libde265_min(x0+LOOKAHEAD_SEARCH_RANGE, width -N);
+  int yMax = libde265_min(y0+LOOKAHEAD_SEARCH_RANGE, height-N);
+
+  uint32_t minSAD = accel->sad_8(src,stride, ref + x0 + y0*stride, stride, N,N);
+  int bestX=x0, bestY=y0;
+
+  for (int y=yMin;y<=yMax;y++)
+    for (int x=xMin;x<=xMax;x++) {
+      uint32_t sad = accel->sad_8(src,stride, ref + x + y*stride, stride, N,N);
+      if (sad < minSAD) {
+        minSAD = sad;
+        bestX = x;
+        bestY = y;
+      }
+    }
+
+  return accel->satd_8[1](src,stride, ref + bestX + bestY*stride, stride);
+}
+
+
+void encoder_lookahead::analyse(entry* e)
+{
+  const de265_image* img = e->img;
+  frame_analysis& fa = e->analysis;
+
+  const int N = LOOKAHEAD_BLKSIZE;
+
+  int w = img->get_width()  / 2;
+  int h = img->get_height() / 2;
+
+  if (w != mHalfWidth || h != mHalfHeight) {
+    mHalfWidth  = w;
+    mHalfHeight = h;
+    mHavePrev = false;
+  }
+
+  mHalfRes.resize(w*h);
+  downscale_luma(mHalfRes.data(), w,h, img->get_image_plane(0), img->get_image_stride(0));
+
+
+  // CTB grid of the full-resolution image
+
+  int ctbSize = 1<<mLog2CtbSize;
+  int widthCtbs  = (img->get_width()  + ctbSize-1) >> mLog2CtbSize;
+  int heightCtbs = (img->get_height() + ctbSize-1) >> mLog2CtbSize;
+
+  std::vector<int64_t> ctbCost(widthCtbs*heightCtbs, 0);
+  std::vector<int>     ctbBlocks(widthCtbs*heightCtbs, 0);
+
+
+  // block costs (only blocks completely inside the image)
+
+  fa.intraCost = 0;
+  fa.interCost = 0;
+
+  for (int y0=0; y0+N<=h; y0+=N)
+    for (int x0=0; x0+N<=w; x0+=N) {
+      uint32_t intra = intra_cost(mAccel, mHalfRes.data(), w, x0,y0);
+      fa.intraCost += intra;
+
+      if (mHavePrev) {
+        uint32_t inter = inter_cost(mAccel, mHalfRes.data(), mPrevHalfRes.data(), w,
+                                    w,h, x0,y0);
+        fa.interCost += libde265_min(intra, inter);
+      }
+
+      int ctbAddr = ((2*x0) >> mLog2CtbSize) + ((2*y0) >> mLog2CtbSize)*widthCtbs;
+      ctbCost[ctbAddr] += intra;
+      ctbBlocks[ctbAddr]++;
+    }
+
+
+  // scene cut: inter prediction does not save enough compared to intra
+
+  fa.sceneCut = (mHavePrev &&
+                 mParams.sceneCutThreshold > 0 &&
+                 fa.interCost*100 > (100-mParams.sceneCutThreshold)*fa.intraCost);
+
+
+  // adaptive QP: offset proportional to the log-cost of the CTB relative to the average
+
+  fa.ctbQPOffset.clear();
+
+  if (mParams.aqStrength > 0) {
+    std::vector<double> energy(widthCtbs*heightCtbs, 0.0);
+    double meanEnergy = 0;
+    int nCtbs = 0;
+
+    for (int i=0;i<widthCtbs*heightCtbs;i++) {
+      if (ctbBlocks[i]) {
+        energy[i] = log2(ctbCost[i] / (double)ctbBlocks[i] + 1.0);
+        meanEnergy += energy[i];
+        nCtbs++;
+      }
+    }
+
+    if (nCtbs) { meanEnergy /= nCtbs; }
+
+    double strength = 2.0 * mParams.aqStrength / 10.0;
+
+    fa.ctbQPOffset.resize(widthCtbs*heightCtbs, 0);
+
+    for (int i=0;i<widthCtbs*heightCtbs;i++) {
+      if (ctbBlocks[i]) {
+        int offset = (int)floor(strength * (energy[i] - meanEnergy) + 0.5);
+        fa.ctbQPOffset[i] = Clip3(-LOOKAHEAD_MAX_QP_OFFSET, LOOKAHEAD_MAX_QP_OFFSET, offset);
+      }
+    }
+  }
+
+
+  mPrevHalfRes.swap(mHalfRes);
+  mHavePrev = true;
+}
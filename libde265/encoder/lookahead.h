@@ -0,0 +1,161 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2013-2014 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DE265_LOOKAHEAD_H
+#define DE265_LOOKAHEAD_H
+
+#include "libde265/image.h"
+#include "libde265/threads.h"
+#include "libde265/acceleration.h"
+#include "libde265/configparam.h"
+
+#include <deque>
+#include <vector>
+
+
+/* The lookahead analyses the input images in a separate thread before they are
+   handed to the SOP creator. Each image is downscaled to half resolution and
+   coarse intra (DC/H/V prediction) and inter (small full-pel search against the
+   previous image) SATD costs are computed on 8x8 blocks of the half-resolution
+   image (corresponding to 16x16 blocks of the input).
+
+   From these, we derive
+   - a scene-cut flag when the inter cost comes close to the intra cost, and
+   - a QP offset for each CTB (adaptive quantization): CTBs with more texture
+     than the picture average get a higher QP, flat CTBs get a lower QP.
+
+   An image is only released to the encoder when 'depth' further images have
+   been pushed (or at the end of the stream), which gives the thread time to
+   work in parallel to the encoding of the previous images.
+ */
+class encoder_lookahead
+{
+ public:
+  struct params
+  {
+    params() {
+      depth.set_ID("lookahead");
+      depth.set_description("number of images analysed ahead of the encoder (0: disabled)");
+      depth.set_range(0,32);
+      depth.set_default(0);
+
+      sceneCutThreshold.set_ID("lookahead-scenecut");
+      sceneCutThreshold.set_description("insert an intra picture when inter prediction saves less than this percentage (0: disabled)");
+      sceneCutThreshold.set_range(0,100);
+      sceneCutThreshold.set_default(40);
+
+      aqStrength.set_ID("aq-strength");
+      aqStrength.set_description("strength of the adaptive CTB QP offsets in 1/10 (0: disabled)");
+      aqStrength.set_range(0,30);
+      aqStrength.set_default(10);
+    }
+
+    void registerParams(config_parameters& config) {
+      config.add_option(&depth);
+      config.add_option(&sceneCutThreshold);
+      config.add_option(&aqStrength);
+    }
+
+    option_int depth;
+    option_int sceneCutThreshold;
+    option_int aqStrength;
+  };
+
+
+  struct frame_analysis
+  {
+    int64_t intraCost;
+    int64_t interCost;  // only valid if there was a previous image
+    bool    sceneCut;
+
+    std::vector<int8_t> ctbQPOffset;  // in raster-scan order, empty when AQ is disabled
+  };
+
+
+  encoder_lookahead();
+  ~encoder_lookahead();
+
+  void setParams(const params& p) { mParams=p; }
+
+  bool is_enabled() const { return mParams.depth > 0; }
+  bool uses_adaptive_QP() const { return is_enabled() && mParams.aqStrength > 0; }
+
+  void start(const acceleration_functions* accel, int log2CtbSize);
+  void stop();
+
+  // --- input ---
+
+  void push_image(de265_image* img);
+  void push_end_of_stream();
+
+  // --- output ---
+
+  /* Returns the next image together with its analysis, or NULL if the image cannot
+     be released yet. This blocks while the analysis of the image is still running.
+   */
+  de265_image* get_next_image(frame_analysis* analysis);
+
+  // All images have been handed out and the end of the stream was reached.
+  bool is_end_of_stream() const;
+
+ private:
+  params mParams;
+
+  const acceleration_functions* mAccel;
+  int mLog2CtbSize;
+
+  struct entry
+  {
+    de265_image* img;
+    bool analysed;
+    frame_analysis analysis;
+  };
+
+  std::deque<entry*> mQueue;    // all images in input order, we are the owner
+  std::deque<entry*> mPending;  // images that have not been analysed yet
+  bool mEndOfStream;
+
+  bool mThreadRunning;
+  bool mStopThread;
+  de265_thread mThread;
+  mutable de265_mutex mMutex;
+  de265_cond  mCond;
+
+  // data of the analysis thread
+
+  std::vector<uint8_t> mHalfRes;
+  std::vector<uint8_t> mPrevHalfRes;
+  int mHalfWidth, mHalfHeight;
+  bool mHavePrev;
+
+  void analyse(entry*);
+
+#ifndef _WIN32
+  static void* thread_main(void* lookahead_ptr);
+#else
+  static DWORD WINAPI thread_main(LPVOID lookahead_ptr);
+#endif
+
+  encoder_lookahead(const encoder_lookahead&); // not allowed
+  const encoder_lookahead& operator=(const encoder_lookahead&); // not allowed
+};
+
+
+#endif
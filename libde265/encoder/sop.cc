@@ -59,6 +59,7 @@ void sop_creator_intra_only::insert_new_input_image(de265_image* img)
 
 sop_creator_trivial_low_delay::sop_creator_trivial_low_delay()
 {
+  mNextIntraFrame = 0;
 }
 
 
@@ -80,16 +81,20 @@ void sop_creator_trivial_low_delay::insert_new_input_image(de265_image* img)
   img->PicOrderCntVal = get_pic_order_count();
 
   int frame = get_frame_number();
+  bool intra = isIntra(frame);
 
   std::vector<int> l0, l1, empty;
-  if (!isIntra(frame)) {
+  if (!intra) {
     l0.push_back(frame-1);
   }
 
   assert(mEncPicBuf);
   image_data* imgdata = mEncPicBuf->insert_next_image_in_encoding_order(img, get_frame_number());
 
-  if (isIntra(frame)) {
+  if (intra) {
+    mNextIntraFrame = frame + mParams.intraPeriod;
+    mForceIntra = false;
+
     reset_poc();
     imgdata->set_intra();
     imgdata->set_NAL_type(NAL_UNIT_IDR_N_LP);
@@ -70,7 +70,7 @@ class pic_order_counter
 class sop_creator : public pic_order_counter
 {
  public:
-  sop_creator() { mEncCtx=NULL; mEncPicBuf=NULL; }
+  sop_creator() { mEncCtx=NULL; mEncPicBuf=NULL; mForceIntra=false; }
   virtual ~sop_creator() { }
 
   void set_encoder_context(encoder_context* encctx) { mEncCtx=encctx; }
@@ -91,6 +91,10 @@ class sop_creator : public pic_order_counter
   virtual void insert_new_input_image(de265_image*) = 0;
   virtual void insert_end_of_stream() { mEncPicBuf->insert_end_of_stream(); }
 
+  /* Code the next input image as an intra picture, regardless of the SOP structure
+     (e.g. because the lookahead detected a scene cut). */
+  void force_intra_for_next_image() { mForceIntra=true; }
+
   virtual int  get_number_of_temporal_layers() const { return 1; }
 
   //virtual std::vector<refpic_set> get_sps_refpic_sets() const = 0;
@@ -98,6 +102,8 @@ class sop_creator : public pic_order_counter
  protected:
   encoder_context*        mEncCtx;
   encoder_picture_buffer* mEncPicBuf;
+
+  bool mForceIntra;
 };
 
 
@@ -140,7 +146,9 @@ class sop_creator_trivial_low_delay : public sop_creator
  private:
   params mParams;
 
-  bool isIntra(int frame) const { return (frame % mParams.intraPeriod)==0; }
+  int mNextIntraFrame; // the intra period restarts at forced intra pictures
+
+  bool isIntra(int frame) const { return mForceIntra || frame >= mNextIntraFrame; }
 };
 
 
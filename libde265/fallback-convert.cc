@@ -0,0 +1,74 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2013-2014 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "fallback-convert.h"
+
+
+void reduce_bit_depth_row_fallback(uint8_t* dst, const uint16_t* src, int width, int bit_depth,
+                                   const uint16_t* dither)
+{
+  const int shift = bit_depth-8;
+
+  for (int x=0;x<width;x++) {
+    int v = src[x] + dither[x&7];
+    if (v>0xFFFF) v=0xFFFF;
+
+    v >>= shift;
+    dst[x] = (v>255 ? 255 : v);
+  }
+}
+
+
+void interleave_chroma_row_8_fallback(uint8_t* dst, const uint8_t* cb, const uint8_t* cr,
+                                      int width)
+{
+  for (int x=0;x<width;x++) {
+    dst[2*x  ] = cb[x];
+    dst[2*x+1] = cr[x];
+  }
+}
+
+
+void interleave_chroma_row_16_fallback(uint16_t* dst, const uint16_t* cb, const uint16_t* cr,
+                                       int width, int shift)
+{
+  for (int x=0;x<width;x++) {
+    dst[2*x  ] = cb[x] << shift;
+    dst[2*x+1] = cr[x] << shift;
+  }
+}
+
+
+void shift_row_16_fallback(uint16_t* dst, const uint16_t* src, int width, int shift)
+{
+  for (int x=0;x<width;x++) {
+    dst[x] = src[x] << shift;
+  }
+}
+
+
+void yuv_to_rgba_row_fallback(uint8_t* dst, const uint8_t* y,
+                              const uint8_t* cb, const uint8_t* cr, int width,
+                              const int16_t* matrix)
+{
+  for (int x=0;x<width;x++) {
+    yuv_to_rgba_pixel(dst+4*x, y[x], cb[x>>1], cr[x>>1], matrix);
+  }
+}
@@ -0,0 +1,64 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2013-2014 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FALLBACK_CONVERT_H
+#define FALLBACK_CONVERT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/* YCbCr to RGB matrix as used by the yuv_to_rgba acceleration functions:
+   { Y offset, Y factor, Cr->R, Cb->G, Cr->G, Cb->B }, factors scaled by 256.
+ */
+enum { YUV2RGB_YOFFSET, YUV2RGB_Y, YUV2RGB_CR_R, YUV2RGB_CB_G, YUV2RGB_CR_G, YUV2RGB_CB_B };
+
+static inline void yuv_to_rgba_pixel(uint8_t* dst, int y,int cb,int cr, const int16_t* m)
+{
+  int yv = (y - m[YUV2RGB_YOFFSET]) * m[YUV2RGB_Y] + 128;
+  cb -= 128;
+  cr -= 128;
+
+  int r = (yv + m[YUV2RGB_CR_R]*cr) >> 8;
+  int g = (yv + m[YUV2RGB_CB_G]*cb + m[YUV2RGB_CR_G]*cr) >> 8;
+  int b = (yv + m[YUV2RGB_CB_B]*cb) >> 8;
+
+  dst[0] = (r<0 ? 0 : r>255 ? 255 : r);
+  dst[1] = (g<0 ? 0 : g>255 ? 255 : g);
+  dst[2] = (b<0 ? 0 : b>255 ? 255 : b);
+  dst[3] = 255;
+}
+
+
+void reduce_bit_depth_row_fallback(uint8_t* dst, const uint16_t* src, int width, int bit_depth,
+                                   const uint16_t* dither);
+
+void interleave_chroma_row_8_fallback(uint8_t* dst, const uint8_t* cb, const uint8_t* cr,
+                                      int width);
+void interleave_chroma_row_16_fallback(uint16_t* dst, const uint16_t* cb, const uint16_t* cr,
+                                       int width, int shift);
+
+void shift_row_16_fallback(uint16_t* dst, const uint16_t* src, int width, int shift);
+
+void yuv_to_rgba_row_fallback(uint8_t* dst, const uint8_t* y,
+                              const uint8_t* cb, const uint8_t* cr, int width,
+                              const int16_t* matrix);
+
+#endif
@@ -90,6 +90,22 @@ void transform_skip_residual_fallback(int32_t *residual, const int16_t *coeffs,
 }
 
 
+void cross_comp_pred_fallback(int32_t* residual, const int32_t* residual_luma, int nT,
+                              int resScaleVal, int bitDepthC, int bitDepthY)
+{
+  if (bitDepthC == bitDepthY) {
+    for (int i=0;i<nT*nT;i++) {
+      residual[i] += (resScaleVal * residual_luma[i]) >> 3;
+    }
+  }
+  else {
+    for (int i=0;i<nT*nT;i++) {
+      residual[i] += (resScaleVal * ((residual_luma[i] << bitDepthC ) >> bitDepthY ) ) >> 3;
+    }
+  }
+}
+
+
 void transform_skip_rdpcm_v_8_fallback(uint8_t *dst, const int16_t *coeffs, int log2nT, ptrdiff_t stride)
 {
   int bitDepth = 8;
@@ -258,7 +274,7 @@ void rotate_coefficients_fallback(int16_t *coeff, int nT)
 
 
 
-static int8_t mat_8_357[4][4] = {
+const int8_t mat_8_357[4][4] = {
   { 29, 55, 74, 84 },
   { 74, 74,  0,-74 },
   { 84,-29,-74, 55 },
@@ -510,7 +526,7 @@ void transform_idst_4x4_fallback(int32_t *dst, const int16_t *coeffs, int bdShif
 
 
 
-static int8_t mat_dct[32][32] = {
+const int8_t mat_dct[32][32] = {
   { 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,      64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64},
   { 90, 90, 88, 85, 82, 78, 73, 67, 61, 54, 46, 38, 31, 22, 13,  4,      -4,-13,-22,-31,-38,-46,-54,-61,-67,-73,-78,-82,-85,-88,-90,-90},
   { 90, 87, 80, 70, 57, 43, 25,  9, -9,-25,-43,-57,-70,-80,-87,-90,     -90,-87,-80,-70,-57,-43,-25, -9,  9, 25, 43, 57, 70, 80, 87, 90},
@@ -693,6 +709,68 @@ void transform_idct_add(pixel_t *dst, ptrdiff_t stride,
 
 
 
+/* Inverse DCT when only the DC coefficient is non-zero.
+   All residual values are equal and computed with the same rounding as transform_idct_add().
+ */
+template <class pixel_t>
+void transform_idct_dc_add(pixel_t *dst, ptrdiff_t stride,
+                           int nT, const int16_t *coeffs, int bit_depth)
+{
+  int postShift = 20-bit_depth;
+
+  int g   = Clip3(-32768,32767, (64*coeffs[0] + (1<<6))>>7);
+  int out = (64*g + (1<<(postShift-1)))>>postShift;
+
+  for (int y=0;y<nT;y++)
+    for (int x=0;x<nT;x++) {
+      dst[y*stride+x] = Clip_BitDepth(dst[y*stride+x] + out, bit_depth);
+    }
+}
+
+
+/* Inverse DCT when all non-zero coefficients are in the top-left KxK block.
+   Only the first K columns of the intermediate result can be non-zero.
+ */
+template <class pixel_t>
+void transform_idct_sparse_add(pixel_t *dst, ptrdiff_t stride,
+                               int nT, int K, const int16_t *coeffs, int bit_depth)
+{
+  int postShift = 20-bit_depth;
+  int rnd1 = 1<<(7-1);
+  int rnd2 = 1<<(postShift-1);
+  int fact = (1<<(5-Log2(nT)));
+
+  int16_t g[32*8];  // [nT][K]
+
+  for (int c=0;c<K;c++) {
+    for (int i=0;i<nT;i++) {
+      int sum=0;
+
+      for (int j=0;j<K;j++) {
+        sum += mat_dct[fact*j][i] * coeffs[c+j*nT];
+      }
+
+      g[i*K+c] = Clip3(-32768,32767, (sum+rnd1)>>7);
+    }
+  }
+
+  for (int y=0;y<nT;y++) {
+    for (int i=0;i<nT;i++) {
+      int sum=0;
+
+      for (int j=0;j<K;j++) {
+        sum += mat_dct[fact*j][i] * g[y*K+j];
+      }
+
+      int out = (sum+rnd2)>>postShift;
+
+      dst[y*stride+i] = Clip_BitDepth(dst[y*stride+i] + out, bit_depth);
+    }
+  }
+}
+
+
+
 void transform_idct_fallback(int32_t *dst, int nT, const int16_t *coeffs, int bdShift, int max_coeff_bits)
 {
   /*
@@ -883,6 +961,53 @@ void transform_32x32_add_8_fallback(uint8_t *dst, const int16_t *coeffs, ptrdiff
 }
 
 
+void transform_4x4_dc_add_8_fallback(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride)
+{
+  transform_idct_dc_add<uint8_t>(dst,stride,  4, coeffs, 8);
+}
+
+void transform_8x8_dc_add_8_fallback(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride)
+{
+  transform_idct_dc_add<uint8_t>(dst,stride,  8, coeffs, 8);
+}
+
+void transform_16x16_dc_add_8_fallback(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride)
+{
+  transform_idct_dc_add<uint8_t>(dst,stride,  16, coeffs, 8);
+}
+
+void transform_32x32_dc_add_8_fallback(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride)
+{
+  transform_idct_dc_add<uint8_t>(dst,stride,  32, coeffs, 8);
+}
+
+
+void transform_8x8_sparse4_add_8_fallback(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride)
+{
+  transform_idct_sparse_add<uint8_t>(dst,stride,  8, 4, coeffs, 8);
+}
+
+void transform_16x16_sparse4_add_8_fallback(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride)
+{
+  transform_idct_sparse_add<uint8_t>(dst,stride,  16, 4, coeffs, 8);
+}
+
+void transform_16x16_sparse8_add_8_fallback(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride)
+{
+  transform_idct_sparse_add<uint8_t>(dst,stride,  16, 8, coeffs, 8);
+}
+
+void transform_32x32_sparse4_add_8_fallback(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride)
+{
+  transform_idct_sparse_add<uint8_t>(dst,stride,  32, 4, coeffs, 8);
+}
+
+void transform_32x32_sparse8_add_8_fallback(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride)
+{
+  transform_idct_sparse_add<uint8_t>(dst,stride,  32, 8, coeffs, 8);
+}
+
+
 void transform_4x4_add_16_fallback(uint16_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth)
 {
   transform_idct_add<uint16_t>(dst,stride,  4, coeffs, bit_depth);
@@ -904,6 +1029,53 @@ void transform_32x32_add_16_fallback(uint16_t *dst, const int16_t *coeffs, ptrdi
 }
 
 
+void transform_4x4_dc_add_16_fallback(uint16_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth)
+{
+  transform_idct_dc_add<uint16_t>(dst,stride,  4, coeffs, bit_depth);
+}
+
+void transform_8x8_dc_add_16_fallback(uint16_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth)
+{
+  transform_idct_dc_add<uint16_t>(dst,stride,  8, coeffs, bit_depth);
+}
+
+void transform_16x16_dc_add_16_fallback(uint16_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth)
+{
+  transform_idct_dc_add<uint16_t>(dst,stride,  16, coeffs, bit_depth);
+}
+
+void transform_32x32_dc_add_16_fallback(uint16_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth)
+{
+  transform_idct_dc_add<uint16_t>(dst,stride,  32, coeffs, bit_depth);
+}
+
+
+void transform_8x8_sparse4_add_16_fallback(uint16_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth)
+{
+  transform_idct_sparse_add<uint16_t>(dst,stride,  8, 4, coeffs, bit_depth);
+}
+
+void transform_16x16_sparse4_add_16_fallback(uint16_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth)
+{
+  transform_idct_sparse_add<uint16_t>(dst,stride,  16, 4, coeffs, bit_depth);
+}
+
+void transform_16x16_sparse8_add_16_fallback(uint16_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth)
+{
+  transform_idct_sparse_add<uint16_t>(dst,stride,  16, 8, coeffs, bit_depth);
+}
+
+void transform_32x32_sparse4_add_16_fallback(uint16_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth)
+{
+  transform_idct_sparse_add<uint16_t>(dst,stride,  32, 4, coeffs, bit_depth);
+}
+
+void transform_32x32_sparse8_add_16_fallback(uint16_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth)
+{
+  transform_idct_sparse_add<uint16_t>(dst,stride,  32, 8, coeffs, bit_depth);
+}
+
+
 static void transform_fdct_8(int16_t* coeffs, int nT,
                              const int16_t *input, ptrdiff_t stride)
 {
@@ -1208,3 +1380,98 @@ void hadamard_32x32_8_fallback(int16_t *coeffs, const int16_t *input, ptrdiff_t
 {
   hadamard_transform_8(coeffs,32, input,stride);
 }
+
+
+
+int quant_coefficients_fallback(int16_t* out_coeff, const int16_t* in_coeff, int nCoeff,
+                                int scale, int offset, int shift)
+{
+  int nNonZero=0;
+
+  for (int i=0;i<nCoeff;i++) {
+    int level = in_coeff[i];
+    int sign  = (level < 0 ? -1: 1);
+
+    level = (abs_value(level) * scale + offset) >> shift;
+    nNonZero += (level != 0);
+
+    out_coeff[i] = Clip3(-32768, 32767, level*sign);
+  }
+
+  return nNonZero;
+}
+
+
+uint32_t sad_8_fallback(const uint8_t* img, ptrdiff_t imgStride,
+                        const uint8_t* ref, ptrdiff_t refStride, int width, int height)
+{
+  uint32_t sum=0;
+
+  for (int y=0;y<height;y++) {
+    for (int x=0;x<width;x++) {
+      sum += abs_value(img[x] - ref[x]);
+    }
+
+    img += imgStride;
+    ref += refStride;
+  }
+
+  return sum;
+}
+
+
+uint32_t ssd_8_fallback(const uint8_t* img, ptrdiff_t imgStride,
+                        const uint8_t* ref, ptrdiff_t refStride, int width, int height)
+{
+  uint32_t sum=0;
+
+  for (int y=0;y<height;y++) {
+    for (int x=0;x<width;x++) {
+      int diff = img[x] - ref[x];
+      sum += diff*diff;
+    }
+
+    img += imgStride;
+    ref += refStride;
+  }
+
+  return sum;
+}
+
+
+template <int nT>
+static uint32_t satd_8_fallback(const uint8_t* img, ptrdiff_t imgStride,
+                                const uint8_t* ref, ptrdiff_t refStride,
+                                void (*hadamard)(int16_t *coeffs, const int16_t *input, ptrdiff_t stride))
+{
+  int16_t diff[nT*nT];
+  int16_t coeffs[nT*nT];
+
+  for (int y=0;y<nT;y++)
+    for (int x=0;x<nT;x++) {
+      diff[x+y*nT] = img[x+y*imgStride] - ref[x+y*refStride];
+    }
+
+  hadamard(coeffs, diff, nT);
+
+  uint32_t sum=0;
+  for (int i=0;i<nT*nT;i++) {
+    sum += abs_value(coeffs[i]);
+  }
+
+  return sum;
+}
+
+
+uint32_t satd_4x4_8_fallback(const uint8_t* img, ptrdiff_t imgStride,
+                             const uint8_t* ref, ptrdiff_t refStride)
+{
+  return satd_8_fallback<4>(img,imgStride, ref,refStride, hadamard_4x4_8_fallback);
+}
+
+
+uint32_t satd_8x8_8_fallback(const uint8_t* img, ptrdiff_t imgStride,
+                             const uint8_t* ref, ptrdiff_t refStride)
+{
+  return satd_8_fallback<8>(img,imgStride, ref,refStride, hadamard_8x8_8_fallback);
+}
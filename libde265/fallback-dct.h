@@ -27,6 +27,11 @@
 #include "util.h"
 
 
+// transform matrices, also used by the CPU specific implementations
+extern const int8_t mat_8_357[4][4]; // DST
+extern const int8_t mat_dct[32][32];
+
+
 // --- decoding ---
 
 void transform_skip_8_fallback(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride);
@@ -43,6 +48,17 @@ void transform_8x8_add_8_fallback(uint8_t *dst, const int16_t *coeffs, ptrdiff_t
 void transform_16x16_add_8_fallback(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride);
 void transform_32x32_add_8_fallback(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride);
 
+void transform_4x4_dc_add_8_fallback(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride);
+void transform_8x8_dc_add_8_fallback(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride);
+void transform_16x16_dc_add_8_fallback(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride);
+void transform_32x32_dc_add_8_fallback(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride);
+
+void transform_8x8_sparse4_add_8_fallback(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride);
+void transform_16x16_sparse4_add_8_fallback(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride);
+void transform_16x16_sparse8_add_8_fallback(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride);
+void transform_32x32_sparse4_add_8_fallback(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride);
+void transform_32x32_sparse8_add_8_fallback(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride);
+
 
 void transform_skip_16_fallback(uint16_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth);
 void transform_bypass_16_fallback(uint16_t *dst, const int16_t *coeffs, int nT, ptrdiff_t stride, int bit_depth);
@@ -53,6 +69,17 @@ void transform_8x8_add_16_fallback(uint16_t *dst, const int16_t *coeffs, ptrdiff
 void transform_16x16_add_16_fallback(uint16_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth);
 void transform_32x32_add_16_fallback(uint16_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth);
 
+void transform_4x4_dc_add_16_fallback(uint16_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth);
+void transform_8x8_dc_add_16_fallback(uint16_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth);
+void transform_16x16_dc_add_16_fallback(uint16_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth);
+void transform_32x32_dc_add_16_fallback(uint16_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth);
+
+void transform_8x8_sparse4_add_16_fallback(uint16_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth);
+void transform_16x16_sparse4_add_16_fallback(uint16_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth);
+void transform_16x16_sparse8_add_16_fallback(uint16_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth);
+void transform_32x32_sparse4_add_16_fallback(uint16_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth);
+void transform_32x32_sparse8_add_16_fallback(uint16_t *dst, const int16_t *coeffs, ptrdiff_t stride, int bit_depth);
+
 void rotate_coefficients_fallback(int16_t *coeff, int nT);
 
 
@@ -79,6 +106,9 @@ void rdpcm_h_fallback(int32_t* residual, const int16_t* coeffs, int nT, int tsSh
 void transform_skip_residual_fallback(int32_t *residual, const int16_t *coeffs, int nT,
                                       int tsShift,int bdShift);
 
+void cross_comp_pred_fallback(int32_t* residual, const int32_t* residual_luma, int nT,
+                              int resScaleVal, int bitDepthC, int bitDepthY);
+
 
 // --- encoding ---
 
@@ -93,4 +123,19 @@ void hadamard_8x8_8_fallback(int16_t *coeffs, const int16_t *input, ptrdiff_t st
 void hadamard_16x16_8_fallback(int16_t *coeffs, const int16_t *input, ptrdiff_t stride);
 void hadamard_32x32_8_fallback(int16_t *coeffs, const int16_t *input, ptrdiff_t stride);
 
+int quant_coefficients_fallback(int16_t* out_coeff, const int16_t* in_coeff, int nCoeff,
+                                int scale, int offset, int shift);
+
+
+// --- distortion measures ---
+
+uint32_t sad_8_fallback(const uint8_t* img, ptrdiff_t imgStride,
+                        const uint8_t* ref, ptrdiff_t refStride, int width, int height);
+uint32_t ssd_8_fallback(const uint8_t* img, ptrdiff_t imgStride,
+                        const uint8_t* ref, ptrdiff_t refStride, int width, int height);
+uint32_t satd_4x4_8_fallback(const uint8_t* img, ptrdiff_t imgStride,
+                             const uint8_t* ref, ptrdiff_t refStride);
+uint32_t satd_8x8_8_fallback(const uint8_t* img, ptrdiff_t imgStride,
+                             const uint8_t* ref, ptrdiff_t refStride);
+
 #endif
@@ -312,7 +312,7 @@ void put_epel_hv_fallback(int16_t *dst, ptrdiff_t dst_stride,
 
   int nPbH_extra = extra_top  + nPbHC + extra_bottom;
 
-  int16_t* tmp2buf = (int16_t*)alloca( nPbWC      * nPbH_extra * sizeof(int16_t) );
+  int32_t* tmp2buf = (int32_t*)alloca( nPbWC      * nPbH_extra * sizeof(int32_t) );
 
   /*
   int nPbW_extra = extra_left + nPbWC + extra_right;
@@ -343,7 +343,7 @@ void put_epel_hv_fallback(int16_t *dst, ptrdiff_t dst_stride,
     const pixel_t* p = &src[y*src_stride - extra_left];
 
     for (int x=0;x<nPbWC;x++) {
-      int16_t v;
+      int32_t v;
       switch (xFracC) {
       case 0: v = p[1]; break;
       case 1: v = (-2*p[0]+58*p[1]+10*p[2]-2*p[3])>>shift1; break;
@@ -371,7 +371,7 @@ void put_epel_hv_fallback(int16_t *dst, ptrdiff_t dst_stride,
   int vshift = (xFracC==0 ? shift1 : shift2);
 
   for (int x=0;x<nPbWC;x++) {
-    int16_t* p = &tmp2buf[x*nPbH_extra];
+    int32_t* p = &tmp2buf[x*nPbH_extra];
 
     for (int y=0;y<nPbHC;y++) {
       int16_t v;
@@ -21,6 +21,7 @@
 #include "fallback.h"
 #include "fallback-motion.h"
 #include "fallback-dct.h"
+#include "fallback-convert.h"
 
 
 void init_acceleration_functions_fallback(struct acceleration_functions* accel)
@@ -94,6 +95,20 @@ void init_acceleration_functions_fallback(struct acceleration_functions* accel)
   accel->transform_add_8[2] = transform_16x16_add_8_fallback;
   accel->transform_add_8[3] = transform_32x32_add_8_fallback;
 
+  accel->transform_dc_add_8[0] = transform_4x4_dc_add_8_fallback;
+  accel->transform_dc_add_8[1] = transform_8x8_dc_add_8_fallback;
+  accel->transform_dc_add_8[2] = transform_16x16_dc_add_8_fallback;
+  accel->transform_dc_add_8[3] = transform_32x32_dc_add_8_fallback;
+
+  accel->transform_sparse_add_8[0][0] = transform_4x4_add_8_fallback;
+  accel->transform_sparse_add_8[0][1] = transform_4x4_add_8_fallback;
+  accel->transform_sparse_add_8[1][0] = transform_8x8_sparse4_add_8_fallback;
+  accel->transform_sparse_add_8[1][1] = transform_8x8_add_8_fallback;
+  accel->transform_sparse_add_8[2][0] = transform_16x16_sparse4_add_8_fallback;
+  accel->transform_sparse_add_8[2][1] = transform_16x16_sparse8_add_8_fallback;
+  accel->transform_sparse_add_8[3][0] = transform_32x32_sparse4_add_8_fallback;
+  accel->transform_sparse_add_8[3][1] = transform_32x32_sparse8_add_8_fallback;
+
   accel->transform_skip_16 = transform_skip_16_fallback;
   accel->transform_4x4_dst_add_16 = transform_4x4_luma_add_16_fallback;
   accel->transform_add_16[0] = transform_4x4_add_16_fallback;
@@ -101,12 +116,27 @@ void init_acceleration_functions_fallback(struct acceleration_functions* accel)
   accel->transform_add_16[2] = transform_16x16_add_16_fallback;
   accel->transform_add_16[3] = transform_32x32_add_16_fallback;
 
+  accel->transform_dc_add_16[0] = transform_4x4_dc_add_16_fallback;
+  accel->transform_dc_add_16[1] = transform_8x8_dc_add_16_fallback;
+  accel->transform_dc_add_16[2] = transform_16x16_dc_add_16_fallback;
+  accel->transform_dc_add_16[3] = transform_32x32_dc_add_16_fallback;
+
+  accel->transform_sparse_add_16[0][0] = transform_4x4_add_16_fallback;
+  accel->transform_sparse_add_16[0][1] = transform_4x4_add_16_fallback;
+  accel->transform_sparse_add_16[1][0] = transform_8x8_sparse4_add_16_fallback;
+  accel->transform_sparse_add_16[1][1] = transform_8x8_add_16_fallback;
+  accel->transform_sparse_add_16[2][0] = transform_16x16_sparse4_add_16_fallback;
+  accel->transform_sparse_add_16[2][1] = transform_16x16_sparse8_add_16_fallback;
+  accel->transform_sparse_add_16[3][0] = transform_32x32_sparse4_add_16_fallback;
+  accel->transform_sparse_add_16[3][1] = transform_32x32_sparse8_add_16_fallback;
+
   accel->rotate_coefficients = rotate_coefficients_fallback;
   accel->add_residual_8  = add_residual_fallback<uint8_t>;
   accel->add_residual_16 = add_residual_fallback<uint16_t>;
   accel->rdpcm_h = rdpcm_h_fallback;
   accel->rdpcm_v = rdpcm_v_fallback;
   accel->transform_skip_residual = transform_skip_residual_fallback;
+  accel->cross_comp_pred = cross_comp_pred_fallback;
 
   accel->transform_idst_4x4   = transform_idst_4x4_fallback;
   accel->transform_idct_4x4   = transform_idct_4x4_fallback;
@@ -120,8 +150,21 @@ void init_acceleration_functions_fallback(struct acceleration_functions* accel)
   accel->fwd_transform_8[2] = fdct_16x16_8_fallback;
   accel->fwd_transform_8[3] = fdct_32x32_8_fallback;
 
+  accel->quant_coefficients = quant_coefficients_fallback;
+
   accel->hadamard_transform_8[0] = hadamard_4x4_8_fallback;
   accel->hadamard_transform_8[1] = hadamard_8x8_8_fallback;
   accel->hadamard_transform_8[2] = hadamard_16x16_8_fallback;
   accel->hadamard_transform_8[3] = hadamard_32x32_8_fallback;
+
+  accel->sad_8 = sad_8_fallback;
+  accel->ssd_8 = ssd_8_fallback;
+  accel->satd_8[0] = satd_4x4_8_fallback;
+  accel->satd_8[1] = satd_8x8_8_fallback;
+
+  accel->reduce_bit_depth_row     = reduce_bit_depth_row_fallback;
+  accel->interleave_chroma_row_8  = interleave_chroma_row_8_fallback;
+  accel->interleave_chroma_row_16 = interleave_chroma_row_16_fallback;
+  accel->shift_row_16             = shift_row_16_fallback;
+  accel->yuv_to_rgba_row          = yuv_to_rgba_row_fallback;
 }
@@ -0,0 +1,297 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2013-2014 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "image-convert.h"
+#include "image.h"
+#include "sps.h"
+#include "fallback-convert.h"
+
+#include <string.h>
+#include <vector>
+
+
+// ordered dither matrix, values 0..63
+static const uint8_t dither_matrix[8][8] = {
+  {  0,32, 8,40, 2,34,10,42 },
+  { 48,16,56,24,50,18,58,26 },
+  { 12,44, 4,36,14,46, 6,38 },
+  { 60,28,52,20,62,30,54,22 },
+  {  3,35,11,43, 1,33, 9,41 },
+  { 51,19,59,27,49,17,57,25 },
+  { 15,47, 7,39,13,45, 5,37 },
+  { 63,31,55,23,61,29,53,21 }
+};
+
+
+// { Y offset, Y factor, Cr->R, Cb->G, Cr->G, Cb->B }, see fallback-convert.h
+static const int16_t yuv2rgb_bt601[2][6] = {
+  { 16, 298, 409, -100, -208, 516 },  // limited range
+  {  0, 256, 359,  -88, -183, 454 }   // full range
+};
+
+static const int16_t yuv2rgb_bt709[2][6] = {
+  { 16, 298, 459,  -55, -136, 541 },
+  {  0, 256, 403,  -48, -120, 475 }
+};
+
+
+static inline bool host_is_little_endian()
+{
+  const uint16_t v = 1;
+  return *(const uint8_t*)&v == 1;
+}
+
+
+class image_converter
+{
+public:
+  image_converter(const de265_image* img, const acceleration_functions& accel)
+    : img(img), accel(accel)
+  {
+    int w = img->width_confwin;
+    row_buffer[0].resize(w);
+    row_buffer[1].resize(w);
+    row_buffer[2].resize(w);
+    grey.resize(w, 0);
+  }
+
+  // row 'y' of channel 'c' with 8 bits, dithered if necessary
+  const uint8_t* row8(int c, int y, int width)
+  {
+    const uint8_t* src = plane_row(c,y);
+    int bit_depth = img->get_bit_depth(c);
+
+    if (bit_depth==8) {
+      return src;
+    }
+
+    uint8_t* out = (uint8_t*)&row_buffer[c][0];
+    reduce(out, src, y, width, bit_depth);
+    return out;
+  }
+
+  void reduce(uint8_t* dst, const uint8_t* src, int y, int width, int bit_depth)
+  {
+    uint16_t dither[8];
+    for (int i=0;i<8;i++) {
+      dither[i] = (dither_matrix[y&7][i] << (bit_depth-8)) >> 6;
+    }
+
+    accel.reduce_bit_depth_row(dst, (const uint16_t*)src, width, bit_depth, dither);
+  }
+
+  // row 'y' of channel 'c' as 16 bit samples (not shifted)
+  const uint16_t* row16(int c, int y, int width)
+  {
+    const uint8_t* src = plane_row(c,y);
+
+    if (img->get_bit_depth(c) > 8) {
+      return (const uint16_t*)src;
+    }
+
+    uint16_t* out = &row_buffer[c][0];
+    for (int x=0;x<width;x++) {
+      out[x] = src[x];
+    }
+
+    return out;
+  }
+
+  // a row of 128 (8 bit) or 0x8000 (16 bit) grey samples for monochrome images
+  const uint8_t* grey_row8(int width) {
+    memset(&grey[0], 0x80, width);
+    return (const uint8_t*)&grey[0];
+  }
+
+  const uint16_t* grey_row16(int width) {
+    for (int x=0;x<width;x++) { grey[x] = 0x8000; }
+    return &grey[0];
+  }
+
+  const uint8_t* plane_row(int c, int y) const {
+    return img->pixels_confwin[c] + y * img->get_image_stride(c) * img->get_bytes_per_pixel(c);
+  }
+
+private:
+  const de265_image* img;
+  const acceleration_functions& accel;
+
+  // uint16_t, such that they can hold a 16 bit row, used as uint8_t for 8 bit rows
+  std::vector<uint16_t> row_buffer[3];
+  std::vector<uint16_t> grey;
+};
+
+
+de265_error convert_image(const de265_image* img, const acceleration_functions& accel,
+                          enum de265_output_format format,
+                          uint8_t* const* planes, const int* strides)
+{
+  const de265_chroma chroma = img->get_chroma_format();
+  const bool mono = (chroma == de265_chroma_mono);
+
+  const int width  = img->width_confwin;
+  const int height = img->height_confwin;
+
+  // chroma size of the 4:2:0 output formats
+  const int cwidth  = (mono ? (width +1)/2 : img->chroma_width_confwin);
+  const int cheight = (mono ? (height+1)/2 : img->chroma_height_confwin);
+
+  const bool yuv420_format = (format == de265_output_format_I420 ||
+                              format == de265_output_format_NV12 ||
+                              format == de265_output_format_P010);
+
+  if (yuv420_format && chroma != de265_chroma_420 && !mono) {
+    return DE265_ERROR_NOT_IMPLEMENTED_YET;
+  }
+
+  image_converter conv(img, accel);
+
+  switch (format) {
+  case de265_output_format_I420:
+  case de265_output_format_NV12:
+    for (int y=0;y<height;y++) {
+      uint8_t* dst = planes[0] + y*strides[0];
+      int bit_depth = img->get_bit_depth(0);
+
+      if (bit_depth==8) {
+        memcpy(dst, conv.plane_row(0,y), width);
+      }
+      else {
+        conv.reduce(dst, conv.plane_row(0,y), y, width, bit_depth);
+      }
+    }
+
+    for (int y=0;y<cheight;y++) {
+      const uint8_t* cb = (mono ? conv.grey_row8(cwidth) : conv.row8(1,y,cwidth));
+      const uint8_t* cr = (mono ? cb                      : conv.row8(2,y,cwidth));
+
+      if (format == de265_output_format_I420) {
+        memcpy(planes[1] + y*strides[1], cb, cwidth);
+        memcpy(planes[2] + y*strides[2], cr, cwidth);
+      }
+      else {
+        accel.interleave_chroma_row_8(planes[1] + y*strides[1], cb,cr, cwidth);
+      }
+    }
+    break;
+
+  case de265_output_format_P010:
+    {
+      const int shiftY = 16 - img->get_bit_depth(0);
+      const int shiftC = (mono ? 0 : 16 - img->get_bit_depth(1));
+
+      for (int y=0;y<height;y++) {
+        accel.shift_row_16((uint16_t*)(planes[0] + y*strides[0]), conv.row16(0,y,width),
+                           width, shiftY);
+      }
+
+      for (int y=0;y<cheight;y++) {
+        const uint16_t* cb = (mono ? conv.grey_row16(cwidth) : conv.row16(1,y,cwidth));
+        const uint16_t* cr = (mono ? cb                       : conv.row16(2,y,cwidth));
+
+        accel.interleave_chroma_row_16((uint16_t*)(planes[1] + y*strides[1]), cb,cr,
+                                       cwidth, shiftC);
+      }
+    }
+    break;
+
+  case de265_output_format_RGBA:
+    {
+      const int16_t* matrix = yuv2rgb_bt601[0];
+
+      if (img->has_sps()) {
+        const video_usability_information& vui = img->get_sps().vui;
+        bool full_range = (img->get_sps().vui_parameters_present_flag &&
+                           vui.video_signal_type_present_flag &&
+                           vui.video_full_range_flag);
+        bool bt709 = (img->get_sps().vui_parameters_present_flag &&
+                      vui.video_signal_type_present_flag &&
+                      vui.colour_description_present_flag &&
+                      vui.matrix_coeffs == 1);
+
+        matrix = (bt709 ? yuv2rgb_bt709 : yuv2rgb_bt601)[full_range];
+      }
+
+      const int chromaShiftY = (chroma == de265_chroma_420 ? 1 : 0);
+
+      for (int y=0;y<height;y++) {
+        uint8_t* dst = planes[0] + y*strides[0];
+        const uint8_t* luma = conv.row8(0,y,width);
+
+        if (mono) {
+          const uint8_t* grey = conv.grey_row8(cwidth);
+          accel.yuv_to_rgba_row(dst, luma, grey,grey, width, matrix);
+        }
+        else if (chroma == de265_chroma_444) {
+          const uint8_t* cb = conv.row8(1,y,width);
+          const uint8_t* cr = conv.row8(2,y,width);
+
+          for (int x=0;x<width;x++) {
+            yuv_to_rgba_pixel(dst+4*x, luma[x], cb[x], cr[x], matrix);
+          }
+        }
+        else {
+          const int yC = y >> chromaShiftY;
+          const uint8_t* cb = conv.row8(1,yC, img->chroma_width_confwin);
+          const uint8_t* cr = conv.row8(2,yC, img->chroma_width_confwin);
+
+          accel.yuv_to_rgba_row(dst, luma, cb,cr, width, matrix);
+        }
+      }
+    }
+    break;
+
+  case de265_output_format_planar:
+  case de265_output_format_planar_8:
+    for (int c=0;c<(mono ? 1 : 3);c++) {
+      const int w = (c==0 ? width  : img->chroma_width_confwin);
+      const int h = (c==0 ? height : img->chroma_height_confwin);
+      const int bit_depth = img->get_bit_depth(c);
+
+      for (int y=0;y<h;y++) {
+        uint8_t* dst = planes[c] + y*strides[c];
+        const uint8_t* src = conv.plane_row(c,y);
+
+        if (bit_depth==8) {
+          memcpy(dst, src, w);
+        }
+        else if (format == de265_output_format_planar_8) {
+          conv.reduce(dst, src, y, w, bit_depth);
+        }
+        else if (host_is_little_endian()) {
+          memcpy(dst, src, w*2);
+        }
+        else {
+          const uint16_t* src16 = (const uint16_t*)src;
+          for (int x=0;x<w;x++) {
+            dst[2*x+0] = src16[x] & 0xFF;
+            dst[2*x+1] = src16[x] >> 8;
+          }
+        }
+      }
+    }
+    break;
+
+  default:
+    return DE265_ERROR_NOT_IMPLEMENTED_YET;
+  }
+
+  return DE265_OK;
+}
@@ -0,0 +1,33 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2013-2014 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DE265_IMAGE_CONVERT_H
+#define DE265_IMAGE_CONVERT_H
+
+#include "libde265/de265.h"
+#include "libde265/acceleration.h"
+
+
+// implementation of de265_convert_image()
+de265_error convert_image(const de265_image* img, const acceleration_functions& accel,
+                          enum de265_output_format format,
+                          uint8_t* const* planes, const int* strides);
+
+#endif
@@ -668,33 +668,40 @@ void de265_image::thread_finishes(const thread_task* task)
   de265_mutex_unlock(&mutex);
 }
 
-void de265_image::wait_for_progress(thread_task* task, int ctbx,int ctby, int progress)
+bool de265_image::suspend_until_progress(thread_task* task, int ctbx,int ctby, int progress)
 {
-  const int ctbW = sps->PicWidthInCtbsY;
-
-  wait_for_progress(task, ctbx + ctbW*ctby, progress);
+  return suspend_until_progress(task, &ctb_progress[ctbx + sps->PicWidthInCtbsY*ctby], progress);
 }
 
-void de265_image::wait_for_progress(thread_task* task, int ctbAddrRS, int progress)
+bool de265_image::suspend_until_progress(thread_task* task, de265_progress_lock* progresslock,
+                                         int progress)
 {
-  if (task==NULL) { return; }
-
-  de265_progress_lock* progresslock = &ctb_progress[ctbAddrRS];
-  if (progresslock->get_progress() < progress) {
-    thread_blocks();
+  if (task==NULL) { return false; }
 
-    assert(task!=NULL);
-    task->state = thread_task::Blocked;
+  if (progresslock->get_progress() >= progress) {
+    return false;
+  }
 
-    /* TODO: check whether we are the first blocked task in the list.
-       If we are, we have to conceal input errors.
-       Simplest concealment: do not block.
-    */
+  thread_blocks();
+  task->state = thread_task::Blocked;
 
-    progresslock->wait_for_progress(progress);
-    task->state = thread_task::Running;
-    thread_unblocks();
+  if (progresslock->resume_task_at_progress(task, progress)) {
+    return true;
   }
+
+  // progress was set in the meantime, continue right away
+
+  task->state = thread_task::Running;
+  thread_unblocks();
+  return false;
+}
+
+void de265_image::thread_resumes(thread_task* task)
+{
+  assert(task->state == thread_task::Blocked);
+
+  task->state = thread_task::Running;
+  thread_unblocks();
 }
 
 
@@ -459,8 +459,17 @@ public:
      will push this image to the output queue and free all decoder data. */
   void thread_finishes(const thread_task*);
 
-  void wait_for_progress(thread_task* task, int ctbx,int ctby, int progress);
-  void wait_for_progress(thread_task* task, int ctbAddrRS, int progress);
+  /* Tasks never block a worker thread while waiting for decoding progress. If the
+     progress has not been reached, the task is suspended and 'true' is returned.
+     The task then has to return from work() immediately. It will be queued again when
+     the progress is set and should call thread_resumes() instead of thread_run() when
+     it continues. Without a task (decoding in the main thread), nothing is waited for. */
+  bool suspend_until_progress(thread_task* task, int ctbx,int ctby, int progress);
+
+  // Same as above, but for any progress lock that belongs to the decoding of this image.
+  bool suspend_until_progress(thread_task* task, de265_progress_lock* progresslock, int progress);
+
+  void thread_resumes(thread_task* task);
 
   void wait_for_completion();  // block until image is decoded by background threads
   bool debug_is_completed() const;
@@ -825,6 +834,38 @@ public:
     }
   }
 
+  // set flags along a vertical / horizontal edge of 'len' luma samples (clipped at the image border)
+
+  void    set_deblk_flags_vertical(int x0,int y0,int len, uint8_t flags)
+  {
+    const int xd = x0/4;
+    if (xd >= deblk_info.width_in_units) return;
+
+    int ydEnd = (y0+len)/4;
+    if (ydEnd > deblk_info.height_in_units) ydEnd = deblk_info.height_in_units;
+
+    for (int yd=y0/4; yd<ydEnd; yd++) {
+      deblk_info[xd + yd*deblk_info.width_in_units] |= flags;
+    }
+  }
+
+  void    set_deblk_flags_horizontal(int x0,int y0,int len, uint8_t flags)
+  {
+    const int yd = y0/4;
+    if (yd >= deblk_info.height_in_units) return;
+
+    int xdEnd = (x0+len)/4;
+    if (xdEnd > deblk_info.width_in_units) xdEnd = deblk_info.width_in_units;
+
+    uint8_t* row = &deblk_info[yd*deblk_info.width_in_units];
+    for (int xd=x0/4; xd<xdEnd; xd++) {
+      row[xd] |= flags;
+    }
+  }
+
+  // flags of a row of deblocking units (4x4 luma samples)
+  uint8_t* get_deblk_row(int yd) { return &deblk_info[yd*deblk_info.width_in_units]; }
+
   uint8_t get_deblk_flags(int x0,int y0) const
   {
     const int xd = x0/4;
@@ -311,6 +311,19 @@ void decode_intra_prediction_internal(de265_image* img,
   }
 }
 
+template
+void decode_intra_prediction_internal<uint8_t>(de265_image* img,
+                                               int xB0,int yB0,
+                                               enum IntraPredMode intraPredMode,
+                                               uint8_t* dst, int dstStride,
+                                               int nT, int cIdx);
+template
+void decode_intra_prediction_internal<uint16_t>(de265_image* img,
+                                                int xB0,int yB0,
+                                                enum IntraPredMode intraPredMode,
+                                                uint16_t* dst, int dstStride,
+                                                int nT, int cIdx);
+
 
 // (8.4.4.2.1)
 void decode_intra_prediction(de265_image* img,
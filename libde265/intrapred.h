@@ -91,6 +91,14 @@ void decode_intra_prediction(de265_image* img,
                              enum IntraPredMode intraPredMode,
                              int nT, int cIdx);
 
+// Same as above, but with the pixel type known by the caller.
+template <class pixel_t>
+void decode_intra_prediction_internal(de265_image* img,
+                                      int xB0,int yB0,
+                                      enum IntraPredMode intraPredMode,
+                                      pixel_t* dst, int dstStride,
+                                      int nT, int cIdx);
+
 // TODO: remove this
 template <class pixel_t> void decode_intra_prediction(de265_image* img,
                                                       int xB0,int yB0,
@@ -152,6 +160,7 @@ class intra_border_computer
   }
   void preproc();
   void fill_from_image();
+  void fill_from_image_constrained_intra();
 
   void reference_sample_substitution();
 };
@@ -527,11 +536,103 @@ void intra_border_computer<pixel_t>::preproc()
 }
 
 
+/* Without constrained intra prediction, the availability only depends on the z-scan order
+   (the slice and tile boundaries are handled at CTB level in preproc()).
+   - The samples directly left, top-left, and above the block always precede it in z-scan order.
+   - The bottom-left and top-right segments each lie in a single CTB. The z-scan order increases
+     monotonically along a row or column within a CTB. Hence, only a prefix of these segments
+     can be available and we can stop at the first unavailable sample group.
+ */
 template <class pixel_t>
 void intra_border_computer<pixel_t>::fill_from_image()
 {
   assert(nT<=32);
 
+  if (pps->constrained_intra_pred_flag) {
+    fill_from_image_constrained_intra();
+    return;
+  }
+
+  pixel_t* image;
+  int stride;
+  image  = (pixel_t*)img->get_image_plane(cIdx);
+  stride = img->get_image_stride(cIdx);
+
+  const int log2MinTrafoSize = sps->Log2MinTrafoSize;
+  const int picWidthInTbs = sps->PicWidthInTbsY;
+
+  int currBlockAddr = pps->MinTbAddrZS[ ((xB*SubWidth )>>log2MinTrafoSize) +
+                                        ((yB*SubHeight)>>log2MinTrafoSize) * picWidthInTbs ];
+
+
+  // --- number of available samples in the left column (counted from the top) ---
+
+  int nLeft = 0;
+  if (availableLeft) {
+    nLeft = nT;
+
+    int xN = ((xB-1)*SubWidth) >> log2MinTrafoSize;
+    while (nLeft < nBottom &&
+           pps->MinTbAddrZS[ xN + (((yB+nLeft+3)*SubHeight)>>log2MinTrafoSize) * picWidthInTbs ]
+           <= currBlockAddr) {
+      nLeft += 4;
+    }
+  }
+
+  // --- number of available samples in the top row (counted from the left) ---
+
+  int nTop = (availableTop ? nT : 0);
+
+  int nTopRight = 0;
+  if (availableTopRight) {
+    int yN = (((yB-1)*SubHeight) >> log2MinTrafoSize) * picWidthInTbs;
+    while (nT+nTopRight < nRight &&
+           pps->MinTbAddrZS[ (((xB+nT+nTopRight)*SubWidth)>>log2MinTrafoSize) + yN ]
+           <= currBlockAddr) {
+      nTopRight += 4;
+    }
+  }
+
+
+  // --- copy the available samples ---
+
+  const pixel_t* left = image + xB-1 + yB*stride;
+  for (int y=0;y<nLeft;y++) {
+    out_border[-y-1] = left[y*stride];
+  }
+  memset(available-nLeft, 1, nLeft);
+
+  if (availableTopLeft) {
+    out_border[0] = image[xB-1 + (yB-1)*stride];
+    available[0] = 1;
+  }
+
+  const pixel_t* top = image + xB + (yB-1)*stride;
+  if (nTop) {
+    memcpy(out_border+1, top, nTop*sizeof(pixel_t));
+    memset(available+1, 1, nTop);
+  }
+
+  if (nTopRight) {
+    memcpy(out_border+1+nT, top+nT, nTopRight*sizeof(pixel_t));
+    memset(available+1+nT, 1, nTopRight);
+  }
+
+  nAvail = nLeft + availableTopLeft + nTop + nTopRight;
+
+  // the first available sample in the order of the substitution process (8.4.4.2.2)
+
+  if      (nLeft)            firstValue = out_border[-nLeft];
+  else if (availableTopLeft) firstValue = out_border[0];
+  else if (nTop)             firstValue = out_border[1];
+  else if (nTopRight)        firstValue = out_border[1+nT];
+}
+
+
+template <class pixel_t>
+void intra_border_computer<pixel_t>::fill_from_image_constrained_intra()
+{
+
   pixel_t* image;
   int stride;
   image  = (pixel_t*)img->get_image_plane(cIdx);
@@ -697,7 +697,10 @@ bool PBMotion::operator==(const PBMotion& b) const
 }
 
 
-class MotionVectorAccess_de265_image : public MotionVectorAccess
+/* Declared 'final' so that the calls in the decoder's merge candidate derivation,
+   which is instantiated for this class directly, are not dispatched virtually.
+ */
+class MotionVectorAccess_de265_image final : public MotionVectorAccess
 {
 public:
   MotionVectorAccess_de265_image(const de265_image* i) : img(i) { }
@@ -754,15 +757,15 @@ private:
   second part to the parameters of the first part, since then, we could use 2Nx2N
   right away. -> Exclude this candidate.
 */
-int derive_spatial_merging_candidates(//const de265_image* img,
-                                      const MotionVectorAccess& mvaccess,
-                                      const de265_image* img,
-                                      int xC, int yC, int nCS, int xP, int yP,
-                                      uint8_t singleMCLFlag,
-                                      int nPbW, int nPbH,
-                                      int partIdx,
-                                      PBMotion* out_cand,
-                                      int maxCandidates)
+template <class MVAccess>
+static int derive_spatial_merging_candidates(const MVAccess& mvaccess,
+                                             const de265_image* img,
+                                             int xC, int yC, int nCS, int xP, int yP,
+                                             uint8_t singleMCLFlag,
+                                             int nPbW, int nPbH,
+                                             int partIdx,
+                                             PBMotion* out_cand,
+                                             int maxCandidates)
 {
   const pic_parameter_set* pps = &img->get_pps();
   const int log2_parallel_merge_level = pps->log2_parallel_merge_level;
@@ -1422,16 +1425,34 @@ void derive_combined_bipredictive_merging_candidates(const base_context* ctx,
 }
 
 
+/* Use single MCL for CBs of size 8x8, except when parallel-merge-level is at 4x4.
+   Without this flag, PBs smaller than 8x8 would not receive as much merging candidates.
+   Having additional candidates might have these advantages:
+   - coding MVs for these small PBs is expensive, and
+   - since the PBs are not far away from a proper (neighboring) merging candidate,
+   the quality of the candidates will still be good.
+*/
+static inline bool single_merge_candidate_list(const de265_image* img, int nCS)
+{
+  return img->get_pps().log2_parallel_merge_level > 2 && nCS==8;
+}
+
+
 // 8.5.3.1.1
 
-void get_merge_candidate_list_without_step_9(base_context* ctx,
-                                             const slice_segment_header* shdr,
-                                             const MotionVectorAccess& mvaccess,
-                                             de265_image* img,
-                                             int xC,int yC, int xP,int yP,
-                                             int nCS, int nPbW,int nPbH, int partIdx,
-                                             int max_merge_idx,
-                                             PBMotion* mergeCandList)
+/* Candidates are only derived up to 'max_merge_idx'. Since every step appends to the
+   list in a fixed order, the first entries do not depend on how many are requested.
+ */
+template <class MVAccess>
+static void get_merge_candidate_list_without_step_9_internal(base_context* ctx,
+                                                             const slice_segment_header* shdr,
+                                                             const MVAccess& mvaccess,
+                                                             de265_image* img,
+                                                             int xC,int yC, int xP,int yP,
+                                                             int nCS, int nPbW,int nPbH,
+                                                             int partIdx,
+                                                             int max_merge_idx,
+                                                             PBMotion* mergeCandList)
 {
 
   //int xOrigP = xP;
@@ -1441,14 +1462,7 @@ void get_merge_candidate_list_without_step_9(base_context* ctx,
 
   int singleMCLFlag; // single merge-candidate-list (MCL) flag
 
-  /* Use single MCL for CBs of size 8x8, except when parallel-merge-level is at 4x4.
-     Without this flag, PBs smaller than 8x8 would not receive as much merging candidates.
-     Having additional candidates might have these advantages:
-     - coding MVs for these small PBs is expensive, and
-     - since the PBs are not far away from a proper (neighboring) merging candidate,
-     the quality of the candidates will still be good.
-  */
-  singleMCLFlag = (img->get_pps().log2_parallel_merge_level > 2 && nCS==8);
+  singleMCLFlag = single_merge_candidate_list(img, nCS);
 
   if (singleMCLFlag) {
     xP=xC;
@@ -1525,6 +1539,21 @@ void get_merge_candidate_list_without_step_9(base_context* ctx,
 }
 
 
+void get_merge_candidate_list_without_step_9(base_context* ctx,
+                                             const slice_segment_header* shdr,
+                                             const MotionVectorAccess& mvaccess,
+                                             de265_image* img,
+                                             int xC,int yC, int xP,int yP,
+                                             int nCS, int nPbW,int nPbH, int partIdx,
+                                             int max_merge_idx,
+                                             PBMotion* mergeCandList)
+{
+  get_merge_candidate_list_without_step_9_internal(ctx, shdr, mvaccess, img,
+                                                   xC,yC,xP,yP,nCS,nPbW,nPbH, partIdx,
+                                                   max_merge_idx, mergeCandList);
+}
+
+
 
 void get_merge_candidate_list(base_context* ctx,
                               const slice_segment_header* shdr,
@@ -1535,10 +1564,10 @@ void get_merge_candidate_list(base_context* ctx,
 {
   int max_merge_idx = 5-shdr->five_minus_max_num_merge_cand -1;
 
-  get_merge_candidate_list_without_step_9(ctx, shdr,
-                                          MotionVectorAccess_de265_image(img), img,
-                                          xC,yC,xP,yP,nCS,nPbW,nPbH, partIdx,
-                                          max_merge_idx, mergeCandList);
+  get_merge_candidate_list_without_step_9_internal(ctx, shdr,
+                                                   MotionVectorAccess_de265_image(img), img,
+                                                   xC,yC,xP,yP,nCS,nPbW,nPbH, partIdx,
+                                                   max_merge_idx, mergeCandList);
 
   // 9. for encoder: modify all merge candidates
 
@@ -1560,17 +1589,37 @@ void derive_luma_motion_merge_mode(base_context* ctx,
                                    int xC,int yC, int xP,int yP,
                                    int nCS, int nPbW,int nPbH, int partIdx,
                                    int merge_idx,
-                                   PBMotion* out_vi)
+                                   PBMotion* out_vi,
+                                   MergeCandidateCache* mergeCache)
 {
-  PBMotion mergeCandList[5];
+  // With a single merge-candidate list, the list does not depend on the PB and
+  // we can reuse the one computed for the first PB of the CB.
+
+  if (mergeCache && single_merge_candidate_list(img, nCS)) {
+    if (mergeCache->numCandidates <= merge_idx ||
+        mergeCache->xC != xC ||
+        mergeCache->yC != yC) {
+      get_merge_candidate_list_without_step_9_internal(ctx, shdr,
+                                                       MotionVectorAccess_de265_image(img), img,
+                                                       xC,yC,xP,yP,nCS,nPbW,nPbH, partIdx,
+                                                       merge_idx, mergeCache->mergeCandList);
+      mergeCache->xC = xC;
+      mergeCache->yC = yC;
+      mergeCache->numCandidates = merge_idx+1;
+    }
 
-  get_merge_candidate_list_without_step_9(ctx, shdr,
-                                          MotionVectorAccess_de265_image(img), img,
-                                          xC,yC,xP,yP,nCS,nPbW,nPbH, partIdx,
-                                          merge_idx, mergeCandList);
+    *out_vi = mergeCache->mergeCandList[merge_idx];
+  }
+  else {
+    PBMotion mergeCandList[5];
 
+    get_merge_candidate_list_without_step_9_internal(ctx, shdr,
+                                                     MotionVectorAccess_de265_image(img), img,
+                                                     xC,yC,xP,yP,nCS,nPbW,nPbH, partIdx,
+                                                     merge_idx, mergeCandList);
 
-  *out_vi = mergeCandList[merge_idx];
+    *out_vi = mergeCandList[merge_idx];
+  }
 
   // 8.5.3.1.1 / 9.
 
@@ -2012,7 +2061,8 @@ void motion_vectors_and_ref_indices(base_context* ctx,
                                     const PBMotionCoding& motion,
                                     int xC,int yC, int xB,int yB, int nCS, int nPbW,int nPbH,
                                     int partIdx,
-                                    PBMotion* out_vi)
+                                    PBMotion* out_vi,
+                                    MergeCandidateCache* mergeCache)
 {
   //slice_segment_header* shdr = tctx->shdr;
 
@@ -2026,7 +2076,7 @@ void motion_vectors_and_ref_indices(base_context* ctx,
     {
       derive_luma_motion_merge_mode(ctx,shdr,img,
                                     xC,yC, xP,yP, nCS,nPbW,nPbH, partIdx,
-                                    motion.merge_idx, out_vi);
+                                    motion.merge_idx, out_vi, mergeCache);
 
       logMV(xP,yP,nPbW,nPbH, "merge_mode", out_vi);
     }
@@ -2089,18 +2139,25 @@ void decode_prediction_unit(base_context* ctx,
                             const slice_segment_header* shdr,
                             de265_image* img,
                             const PBMotionCoding& motion,
-                            int xC,int yC, int xB,int yB, int nCS, int nPbW,int nPbH, int partIdx)
+                            int xC,int yC, int xB,int yB, int nCS, int nPbW,int nPbH, int partIdx,
+                            MergeCandidateCache* mergeCache)
 {
   logtrace(LogMotion,"decode_prediction_unit POC=%d %d;%d %dx%d\n",
            img->PicOrderCntVal, xC+xB,yC+yB, nPbW,nPbH);
 
   //slice_segment_header* shdr = tctx->shdr;
 
+  // a cached merge candidate list is only valid for the PBs of the same CB
+
+  if (mergeCache && partIdx==0) {
+    mergeCache->invalidate();
+  }
+
   // 1.
 
   PBMotion vi;
   motion_vectors_and_ref_indices(ctx, shdr, img, motion,
-                                 xC,yC, xB,yB, nCS, nPbW,nPbH, partIdx, &vi);
+                                 xC,yC, xB,yB, nCS, nPbW,nPbH, partIdx, &vi, mergeCache);
 
   // 2.
 
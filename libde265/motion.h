@@ -67,6 +67,23 @@ class PBMotionCoding
 };
 
 
+/* When the single merge-candidate-list flag is set (8x8 CB with Log2ParMrgLevel > 2),
+   all PBs of the CB share the same merge candidate list. The list computed for the
+   first merge-mode PB is kept here and reused for the second PB of the CB.
+ */
+class MergeCandidateCache
+{
+ public:
+  MergeCandidateCache() { invalidate(); }
+
+  void invalidate() { numCandidates=0; }
+
+  int xC,yC;          // CB for which the list was computed
+  int numCandidates;  // number of valid entries in 'mergeCandList'
+  PBMotion mergeCandList[5];
+};
+
+
 void get_merge_candidate_list(base_context* ctx,
                               const slice_segment_header* shdr,
                               struct de265_image* img,
@@ -106,7 +123,8 @@ void fill_luma_motion_vector_predictors(base_context* ctx,
 
 void decode_prediction_unit(base_context* ctx,const slice_segment_header* shdr,
                             de265_image* img, const PBMotionCoding& motion,
-                            int xC,int yC, int xB,int yB, int nCS, int nPbW,int nPbH, int partIdx);
+                            int xC,int yC, int xB,int yB, int nCS, int nPbW,int nPbH, int partIdx,
+                            MergeCandidateCache* mergeCache);
 
 
 
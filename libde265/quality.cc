@@ -19,6 +19,7 @@
  */
 
 #include "quality.h"
+#include "acceleration.h"
 #include <math.h>
 
 
@@ -109,3 +110,13 @@ uint32_t compute_distortion_ssd(const de265_image* img1, const de265_image* img2
              img2->get_image_plane_at_pos(cIdx,x0,y0), img2->get_image_stride(cIdx),
              1<<log2size, 1<<log2size);
 }
+
+
+uint32_t compute_distortion_ssd(const struct acceleration_functions& accel,
+                                const de265_image* img1, const de265_image* img2,
+                                int x0, int y0, int log2size, int cIdx)
+{
+  return accel.ssd_8(img1->get_image_plane_at_pos(cIdx,x0,y0), img1->get_image_stride(cIdx),
+                     img2->get_image_plane_at_pos(cIdx,x0,y0), img2->get_image_stride(cIdx),
+                     1<<log2size, 1<<log2size);
+}
@@ -25,6 +25,8 @@
 #include <libde265/de265.h>
 #include <libde265/image.h>
 
+struct acceleration_functions;
+
 
 LIBDE265_API uint32_t SSD(const uint8_t* img, int imgStride,
                           const uint8_t* ref, int refStride,
@@ -44,4 +46,9 @@ LIBDE265_API double PSNR(double mse);
 LIBDE265_API uint32_t compute_distortion_ssd(const de265_image* img1, const de265_image* img2,
                                              int x0, int y0, int log2size, int cIdx);
 
+// same, but using the CPU optimized functions
+LIBDE265_API uint32_t compute_distortion_ssd(const struct acceleration_functions& accel,
+                                             const de265_image* img1, const de265_image* img2,
+                                             int x0, int y0, int log2size, int cIdx);
+
 #endif
@@ -75,6 +75,64 @@ void ref_pic_set::compute_derived_values()
 }
 
 
+static int remaining_bits(const bitreader& br)
+{
+  return br.bytes_remaining*8 + br.nextbits_cnt;
+}
+
+
+bool slice_ref_pic_set_cache::lookup(const seq_parameter_set* sps, bitreader* br,
+                                     ref_pic_set* out_set) const
+{
+  if (mNumBits==0 || mSPS.get() != sps ||
+      remaining_bits(*br) < mNumBits) {
+    return false;
+  }
+
+  bitreader tmp = *br;
+
+  int nBits = mNumBits;
+  for (int i=0; nBits>0; i++) {
+    int n = libde265_min(nBits, (int)BITS_PER_WORD);
+    if (get_bits(&tmp,n) != mBits[i]) {
+      return false;
+    }
+
+    nBits -= n;
+  }
+
+  *br = tmp;
+  *out_set = mSet;
+
+  return true;
+}
+
+
+void slice_ref_pic_set_cache::store(const std::shared_ptr<const seq_parameter_set>& sps,
+                                    const bitreader& start, const bitreader& end,
+                                    const ref_pic_set& set)
+{
+  int nBits = remaining_bits(start) - remaining_bits(end);
+  if (nBits <= 0 || nBits > MAX_BITS) {
+    mNumBits = 0;
+    mSPS.reset();
+    return;
+  }
+
+  bitreader tmp = start;
+
+  mNumBits = nBits;
+  for (int i=0; nBits>0; i++) {
+    int n = libde265_min(nBits, (int)BITS_PER_WORD);
+    mBits[i] = get_bits(&tmp,n);
+    nBits -= n;
+  }
+
+  mSPS = sps;
+  mSet = set;
+}
+
+
 /* A ref-pic-set is coded either coded
    - as a list of the relative POC deltas themselves, or
    - by shifting an existing ref-pic-set by some number of frames
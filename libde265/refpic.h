@@ -23,8 +23,12 @@
 
 #include "libde265/bitstream.h"
 
+#include <memory>
+
 #define MAX_NUM_REF_PICS 16  // maximum defined by standard, may be lower for some Levels
 
+class seq_parameter_set;
+
 
 class ref_pic_set
 {
@@ -55,6 +59,38 @@ class ref_pic_set
 };
 
 
+/* Remembers the last short-term ref-pic-set that was coded in a slice header, together
+   with its coded bits. Consecutive slices usually code the same set. Since the syntax
+   is parsed deterministically for a given SPS, identical bits give an identical set and
+   we can skip over the bits instead of parsing and deriving the set again.
+ */
+class slice_ref_pic_set_cache
+{
+ public:
+  slice_ref_pic_set_cache() : mNumBits(0) { }
+
+  /* If the bitstream continues with the cached bits (for the same SPS), advance 'br'
+     behind them, return the set in 'out_set' and return true.
+   */
+  bool lookup(const seq_parameter_set* sps, bitreader* br, ref_pic_set* out_set) const;
+
+  /* Store the set that was read between the bitreader positions 'start' and 'end'.
+   */
+  void store(const std::shared_ptr<const seq_parameter_set>& sps,
+             const bitreader& start, const bitreader& end,
+             const ref_pic_set& set);
+
+ private:
+  enum { MAX_BITS = 8*24, BITS_PER_WORD = 24 };
+
+  std::shared_ptr<const seq_parameter_set> mSPS;
+
+  int mNumBits; // 0 if nothing is cached
+  int mBits[MAX_BITS / BITS_PER_WORD];
+  ref_pic_set mSet;
+};
+
+
 void dump_short_term_ref_pic_set(const ref_pic_set*, FILE* fh);
 void dump_compact_short_term_ref_pic_set(const ref_pic_set* set, int range, FILE* fh);
 
@@ -372,31 +372,15 @@ void apply_sample_adaptive_offset_sequential(de265_image* img)
 
 
 
-class thread_task_sao : public thread_task
-{
-public:
-  int  ctb_y;
-  de265_image* img; /* this is where we get the SPS from
-                       (either inputImg or outputImg can be a dummy image)
-                    */
-
-  de265_image* inputImg;
-  de265_image* outputImg;
-  int inputProgress;
-
-  virtual void work();
-  virtual std::string name() const {
-    char buf[100];
-    sprintf(buf,"sao-%d",ctb_y);
-    return buf;
-  }
-};
-
-
 void thread_task_sao::work()
 {
-  state = Running;
-  img->thread_run(this);
+  if (state == Blocked) {
+    img->thread_resumes(this);
+  }
+  else {
+    state = Running;
+    img->thread_run(this);
+  }
 
   const seq_parameter_set& sps = img->get_sps();
 
@@ -406,14 +390,20 @@ void thread_task_sao::work()
 
   // wait until also the CTB-rows below and above are ready
 
-  img->wait_for_progress(this, rightCtb,ctb_y,  inputProgress);
+  if (img->suspend_until_progress(this, rightCtb,ctb_y,  inputProgress)) {
+    return;
+  }
 
   if (ctb_y>0) {
-    img->wait_for_progress(this, rightCtb,ctb_y-1, inputProgress);
+    if (img->suspend_until_progress(this, rightCtb,ctb_y-1, inputProgress)) {
+      return;
+    }
   }
 
   if (ctb_y+1<sps.PicHeightInCtbsY) {
-    img->wait_for_progress(this, rightCtb,ctb_y+1, inputProgress);
+    if (img->suspend_until_progress(this, rightCtb,ctb_y+1, inputProgress)) {
+      return;
+    }
   }
 
 
@@ -495,7 +485,7 @@ bool add_sao_tasks(image_unit* imgunit, int saoInputProgress)
 
   for (int y=0;y<nRows;y++)
     {
-      thread_task_sao* task = new thread_task_sao;
+      thread_task_sao* task = imgunit->sao_tasks.get_task();
 
       task->inputImg  = img;
       task->outputImg = &imgunit->sao_output;
@@ -503,8 +493,7 @@ bool add_sao_tasks(image_unit* imgunit, int saoInputProgress)
       task->ctb_y = y;
       task->inputProgress = saoInputProgress;
 
-      imgunit->tasks.push_back(task);
-      add_task(&ctx->thread_pool_, task);
+      add_task(&ctx->task_queue_, task);
       n++;
     }
 
@@ -47,11 +47,11 @@ extern bool read_short_term_ref_pic_set(error_queue* errqueue,
                                         bool sliceRefPicSet);
 
 
-void read_coding_tree_unit(thread_context* tctx);
-void read_coding_quadtree(thread_context* tctx,
-                          int xCtb, int yCtb,
-                          int Log2CtbSizeY,
-                          int ctDepth);
+template <class format> void read_coding_tree_unit(thread_context* tctx);
+template <class format> void read_coding_quadtree(thread_context* tctx,
+                                                  int xCtb, int yCtb,
+                                                  int Log2CtbSizeY,
+                                                  int ctDepth);
 /*
 void decode_inter_block(decoder_context* ctx,thread_context* tctx,
                         int xC, int yC, int log2CbSize);
@@ -471,11 +471,17 @@ de265_error slice_segment_header::read(bitreader* br, decoder_context* ctx,
       short_term_ref_pic_set_sps_flag = get_bits(br,1);
 
       if (!short_term_ref_pic_set_sps_flag) {
-        read_short_term_ref_pic_set(ctx, sps,
-                                    br, &slice_ref_pic_set,
-                                    sps->num_short_term_ref_pic_sets(),
-                                    sps->ref_pic_sets,
-                                    true);
+        if (!ctx->slice_rps_cache.lookup(sps, br, &slice_ref_pic_set)) {
+          bitreader start = *br;
+
+          if (read_short_term_ref_pic_set(ctx, sps,
+                                          br, &slice_ref_pic_set,
+                                          sps->num_short_term_ref_pic_sets(),
+                                          sps->ref_pic_sets,
+                                          true)) {
+            ctx->slice_rps_cache.store(pps->sps, start, *br, slice_ref_pic_set);
+          }
+        }
 
         CurrRpsIdx = sps->num_short_term_ref_pic_sets();
         CurrRps    = slice_ref_pic_set;
@@ -810,7 +816,15 @@ de265_error slice_segment_header::read(bitreader* br, decoder_context* ctx,
       return DE265_ERROR_CODED_PARAMETER_OUT_OF_RANGE;
     }
 
-    if (pps->entropy_coding_sync_enabled_flag) {
+    if (pps->entropy_coding_sync_enabled_flag && pps->tiles_enabled_flag) {
+      // one substream per CTB row in each tile
+
+      if (num_entry_point_offsets >= pps->num_tile_columns * sps->PicHeightInCtbsY) {
+        ctx->add_warning(DE265_WARNING_SLICEHEADER_INVALID, false);
+        return DE265_ERROR_CODED_PARAMETER_OUT_OF_RANGE;
+      }
+    }
+    else if (pps->entropy_coding_sync_enabled_flag) {
       // check num_entry_points for valid range
 
       int firstCTBRow = slice_segment_address / sps->PicWidthInCtbsY;
@@ -820,8 +834,7 @@ de265_error slice_segment_header::read(bitreader* br, decoder_context* ctx,
         return DE265_ERROR_CODED_PARAMETER_OUT_OF_RANGE;
       }
     }
-
-    if (pps->tiles_enabled_flag) {
+    else if (pps->tiles_enabled_flag) {
       if (num_entry_point_offsets > pps->num_tile_columns * pps->num_tile_rows) {
         ctx->add_warning(DE265_WARNING_SLICEHEADER_INVALID, false);
         return DE265_ERROR_CODED_PARAMETER_OUT_OF_RANGE;
@@ -2832,6 +2845,63 @@ void read_sao(thread_context* tctx, int xCtb,int yCtb,
 }
 
 
+/* The CTB decoding functions are instantiated per image format. 'format_main420' is the
+   8-bit 4:2:0 case (Main profile), in which the pixel type and the chroma format are
+   compile-time constants. All other formats use 'format_generic', which takes them from
+   the SPS and decides on the pixel type for each block.
+ */
+
+struct format_generic
+{
+  static int ChromaArrayType(const seq_parameter_set& sps) { return sps.ChromaArrayType; }
+  static int SubWidthC(const seq_parameter_set& sps)  { return sps.SubWidthC; }
+  static int SubHeightC(const seq_parameter_set& sps) { return sps.SubHeightC; }
+
+  static bool high_bit_depth(const de265_image* img, int cIdx) { return img->high_bit_depth(cIdx); }
+
+  static void decode_intra_prediction(de265_image* img, int xB0,int yB0,
+                                      enum IntraPredMode intraPredMode, int nT, int cIdx) {
+    ::decode_intra_prediction(img, xB0,yB0, intraPredMode, nT,cIdx);
+  }
+
+  static void scale_coefficients(thread_context* tctx, int xT,int yT,
+                                 int nT, int cIdx,
+                                 bool transform_skip_flag, int rdpcmMode) {
+    ::scale_coefficients(tctx, xT,yT, nT,cIdx, transform_skip_flag, rdpcmMode);
+  }
+};
+
+struct format_main420
+{
+  static int ChromaArrayType(const seq_parameter_set&) { return CHROMA_420; }
+  static int SubWidthC(const seq_parameter_set&)  { return 2; }
+  static int SubHeightC(const seq_parameter_set&) { return 2; }
+
+  static bool high_bit_depth(const de265_image*, int) { return false; }
+
+  static void decode_intra_prediction(de265_image* img, int xB0,int yB0,
+                                      enum IntraPredMode intraPredMode, int nT, int cIdx) {
+    decode_intra_prediction_internal<uint8_t>(img, xB0,yB0, intraPredMode,
+                                              img->get_image_plane_at_pos_NEW<uint8_t>(cIdx,xB0,yB0),
+                                              img->get_image_stride(cIdx),
+                                              nT,cIdx);
+  }
+
+  static void scale_coefficients(thread_context* tctx, int xT,int yT,
+                                 int nT, int cIdx,
+                                 bool transform_skip_flag, int rdpcmMode) {
+    scale_coefficients_internal<uint8_t>(tctx, xT,yT, nT,cIdx, transform_skip_flag, rdpcmMode);
+  }
+
+  static bool matches(const seq_parameter_set& sps) {
+    return (sps.ChromaArrayType == CHROMA_420 &&
+            sps.BitDepth_Y == 8 &&
+            sps.BitDepth_C == 8);
+  }
+};
+
+
+template <class format>
 void read_coding_tree_unit(thread_context* tctx)
 {
   slice_segment_header* shdr = tctx->shdr;
@@ -2858,7 +2928,7 @@ void read_coding_tree_unit(thread_context* tctx)
       read_sao(tctx, xCtb,yCtb, CtbAddrInSliceSeg);
     }
 
-  read_coding_quadtree(tctx, xCtbPixels, yCtbPixels, sps.Log2CtbSizeY, 0);
+  read_coding_quadtree<format>(tctx, xCtbPixels, yCtbPixels, sps.Log2CtbSizeY, 0);
 }
 
 
@@ -3069,9 +3139,17 @@ int residual_coding(thread_context* tctx,
 
 
 
+  // --- scaling of the coefficients (done while they are stored into coeffBuf) ---
+
+  coefficient_scaling scaling;
+  scaling.init(tctx, cIdx, log2TrafoSize, PredMode == MODE_INTRA);
+
+  int coeffExtent = 0;
+
+
   // ----- decode coefficients -----
 
-  tctx->nCoeff[cIdx] = 0;
+  tctx->nCodedSubBlocks = 0;
 
 
   // i - subblock index
@@ -3228,6 +3306,8 @@ int residual_coding(thread_context* tctx,
 
 
     if (nCoefficients) {
+      tctx->codedSubBlockPos[ tctx->nCodedSubBlocks++ ] = (S.x<<2) + (S.y<<2)*CoeffStride;
+
       int ctxSet;
       if (i==0 || cIdx>0) { ctxSet=0; }
       else { ctxSet=2; }
@@ -3400,14 +3480,14 @@ int residual_coding(thread_context* tctx,
         //TransCoeffLevel[yC*CoeffStride + xC] = currCoeff;
 #endif
 
-        // put coefficient in list
+        // put scaled coefficient into the coefficient block
         int p = coeff_scan_pos[n];
         xC = (S.x<<2) + ScanOrderPos[p].x;
         yC = (S.y<<2) + ScanOrderPos[p].y;
 
-        tctx->coeffList[cIdx][ tctx->nCoeff[cIdx] ] = currCoeff;
-        tctx->coeffPos [cIdx][ tctx->nCoeff[cIdx] ] = xC + yC*CoeffStride;
-        tctx->nCoeff[cIdx]++;
+        int pos = xC + yC*CoeffStride;
+        tctx->coeffBuf[pos] = scaling.scale(currCoeff, pos);
+        coeffExtent |= xC | yC;
 
         //printf("%d ",currCoeff);
       }  // iterate through coefficients in sub-block
@@ -3417,13 +3497,15 @@ int residual_coding(thread_context* tctx,
     }  // if nonZero
   }  // next sub-block
 
+  tctx->coeffExtent = coeffExtent;
+
   return DE265_OK;
 }
 
 
+template <class format>
 static void decode_TU(thread_context* tctx,
                       int x0,int y0,
-                      int xCUBase,int yCUBase,
                       int nT, int cIdx, enum PredMode cuPredMode, bool cbf)
 {
   de265_image* img = tctx->img;
@@ -3439,8 +3521,8 @@ static void decode_TU(thread_context* tctx,
         intraPredMode = img->get_IntraPredMode(x0,y0);
       }
       else {
-        const int SubWidthC  = sps.SubWidthC;
-        const int SubHeightC = sps.SubHeightC;
+        const int SubWidthC  = format::SubWidthC(sps);
+        const int SubHeightC = format::SubHeightC(sps);
 
         intraPredMode = img->get_IntraPredModeC(x0*SubWidthC,y0*SubHeightC);
       }
@@ -3450,7 +3532,7 @@ static void decode_TU(thread_context* tctx,
         intraPredMode = INTRA_DC;
       }
 
-      decode_intra_prediction(img, x0,y0, intraPredMode, nT, cIdx);
+      format::decode_intra_prediction(img, x0,y0, intraPredMode, nT, cIdx);
 
 
       residualDpcm = sps.range_extension.implicit_rdpcm_enabled_flag &&
@@ -3468,8 +3550,8 @@ static void decode_TU(thread_context* tctx,
     }
 
   if (cbf) {
-    scale_coefficients(tctx, x0,y0, xCUBase,yCUBase, nT, cIdx,
-                       tctx->transform_skip_flag[cIdx], cuPredMode==MODE_INTRA, residualDpcm);
+    format::scale_coefficients(tctx, x0,y0, nT, cIdx,
+                               tctx->transform_skip_flag[cIdx], residualDpcm);
   }
   /*
   else if (!cbf && cIdx==0) {
@@ -3479,11 +3561,12 @@ static void decode_TU(thread_context* tctx,
   else if (!cbf && cIdx!=0 && tctx->ResScaleVal) {
     // --- cross-component-prediction when CBF==0 ---
 
-    tctx->nCoeff[cIdx] = 0;
+    tctx->nCodedSubBlocks = 0;
+    tctx->coeffExtent = 0;
     residualDpcm=0;
 
-    scale_coefficients(tctx, x0,y0, xCUBase,yCUBase, nT, cIdx,
-                       tctx->transform_skip_flag[cIdx], cuPredMode==MODE_INTRA, residualDpcm);
+    format::scale_coefficients(tctx, x0,y0, nT, cIdx,
+                               tctx->transform_skip_flag[cIdx], residualDpcm);
   }
 }
 
@@ -3546,6 +3629,7 @@ static void read_cross_comp_pred(thread_context* tctx, int cIdxMinus1)
 }
 
 
+template <class format>
 int read_transform_unit(thread_context* tctx,
                         int x0, int y0,        // position of TU in frame
                         int xBase, int yBase,  // position of parent TU in frame
@@ -3564,7 +3648,7 @@ int read_transform_unit(thread_context* tctx,
 
   const seq_parameter_set& sps = tctx->img->get_sps();
 
-  const int ChromaArrayType = sps.ChromaArrayType;
+  const int ChromaArrayType = format::ChromaArrayType(sps);
 
   int log2TrafoSizeC = (ChromaArrayType==CHROMA_444 ? log2TrafoSize : log2TrafoSize-1);
   log2TrafoSizeC = libde265_max(2, log2TrafoSizeC);
@@ -3650,8 +3734,8 @@ int read_transform_unit(thread_context* tctx,
   int nT = 1<<log2TrafoSize;
   int nTC = 1<<log2TrafoSizeC;
 
-  const int SubWidthC  = sps.SubWidthC;
-  const int SubHeightC = sps.SubHeightC;
+  const int SubWidthC  = format::SubWidthC(sps);
+  const int SubHeightC = format::SubHeightC(sps);
 
   // --- luma ---
 
@@ -3662,7 +3746,7 @@ int read_transform_unit(thread_context* tctx,
     if ((err=residual_coding(tctx,x0,y0, log2TrafoSize,0)) != DE265_OK) return err;
   }
 
-  decode_TU(tctx, x0,y0, xCUBase,yCUBase, nT, 0, cuPredMode, cbf_luma);
+  decode_TU<format>(tctx, x0,y0, nT, 0, cuPredMode, cbf_luma);
 
 
   // --- chroma ---
@@ -3689,10 +3773,10 @@ int read_transform_unit(thread_context* tctx,
         if ((err=residual_coding(tctx,x0,y0,log2TrafoSizeC,1)) != DE265_OK) return err;
       }
 
-      if (sps.ChromaArrayType != CHROMA_MONO) {
-        decode_TU(tctx,
-                  x0/SubWidthC,y0/SubHeightC,
-                  xCUBase/SubWidthC,yCUBase/SubHeightC, nTC, 1, cuPredMode, cbf_cb & 1);
+      if (ChromaArrayType != CHROMA_MONO) {
+        decode_TU<format>(tctx,
+                          x0/SubWidthC,y0/SubHeightC,
+                          nTC, 1, cuPredMode, cbf_cb & 1);
       }
     }
 
@@ -3706,10 +3790,9 @@ int read_transform_unit(thread_context* tctx,
                                  log2TrafoSizeC,1)) != DE265_OK) return err;
       }
 
-      decode_TU(tctx,
-                x0/SubWidthC,y0/SubHeightC + yOffset,
-                xCUBase/SubWidthC,yCUBase/SubHeightC +yOffset,
-                nTC, 1, cuPredMode, cbf_cb & 2);
+      decode_TU<format>(tctx,
+                        x0/SubWidthC,y0/SubHeightC + yOffset,
+                        nTC, 1, cuPredMode, cbf_cb & 2);
     }
 
 
@@ -3725,11 +3808,10 @@ int read_transform_unit(thread_context* tctx,
         if ((err=residual_coding(tctx,x0,y0,log2TrafoSizeC,2)) != DE265_OK) return err;
       }
 
-      if (sps.ChromaArrayType != CHROMA_MONO) {
-        decode_TU(tctx,
-                  x0/SubWidthC,y0/SubHeightC,
-                  xCUBase/SubWidthC,yCUBase/SubHeightC,
-                  nTC, 2, cuPredMode, cbf_cr & 1);
+      if (ChromaArrayType != CHROMA_MONO) {
+        decode_TU<format>(tctx,
+                          x0/SubWidthC,y0/SubHeightC,
+                          nTC, 2, cuPredMode, cbf_cr & 1);
       }
     }
 
@@ -3743,10 +3825,9 @@ int read_transform_unit(thread_context* tctx,
                                  log2TrafoSizeC,2)) != DE265_OK) return err;
       }
 
-      decode_TU(tctx,
-                x0/SubWidthC,y0/SubHeightC+yOffset,
-                xCUBase/SubWidthC,yCUBase/SubHeightC+yOffset,
-                nTC, 2, cuPredMode, cbf_cr & 2);
+      decode_TU<format>(tctx,
+                        x0/SubWidthC,y0/SubHeightC+yOffset,
+                        nTC, 2, cuPredMode, cbf_cr & 2);
     }
   }
   else if (blkIdx==3) {
@@ -3755,10 +3836,10 @@ int read_transform_unit(thread_context* tctx,
                                log2TrafoSize,1)) != DE265_OK) return err;
     }
 
-    if (sps.ChromaArrayType != CHROMA_MONO) {
-      decode_TU(tctx,
-                xBase/SubWidthC,  yBase/SubHeightC,
-                xCUBase/SubWidthC,yCUBase/SubHeightC, nT, 1, cuPredMode, cbf_cb & 1);
+    if (ChromaArrayType != CHROMA_MONO) {
+      decode_TU<format>(tctx,
+                        xBase/SubWidthC,  yBase/SubHeightC,
+                        nT, 1, cuPredMode, cbf_cb & 1);
     }
 
     // 4:2:2
@@ -3769,9 +3850,9 @@ int read_transform_unit(thread_context* tctx,
     }
 
     if (ChromaArrayType == CHROMA_422) {
-      decode_TU(tctx,
-                xBase/SubWidthC,  yBase/SubHeightC + (1<<log2TrafoSize),
-                xCUBase/SubWidthC,yCUBase/SubHeightC, nT, 1, cuPredMode, cbf_cb & 2);
+      decode_TU<format>(tctx,
+                        xBase/SubWidthC,  yBase/SubHeightC + (1<<log2TrafoSize),
+                        nT, 1, cuPredMode, cbf_cb & 2);
     }
 
     if (cbf_cr & 1) {
@@ -3779,10 +3860,10 @@ int read_transform_unit(thread_context* tctx,
                                log2TrafoSize,2)) != DE265_OK) return err;
     }
 
-    if (sps.ChromaArrayType != CHROMA_MONO) {
-      decode_TU(tctx,
-                xBase/SubWidthC,  yBase/SubHeightC,
-                xCUBase/SubWidthC,yCUBase/SubHeightC, nT, 2, cuPredMode, cbf_cr & 1);
+    if (ChromaArrayType != CHROMA_MONO) {
+      decode_TU<format>(tctx,
+                        xBase/SubWidthC,  yBase/SubHeightC,
+                        nT, 2, cuPredMode, cbf_cr & 1);
     }
 
     // 4:2:2
@@ -3793,9 +3874,9 @@ int read_transform_unit(thread_context* tctx,
     }
 
     if (ChromaArrayType == CHROMA_422) {
-      decode_TU(tctx,
-                xBase/SubWidthC,  yBase/SubHeightC + (1<<log2TrafoSize),
-                xCUBase/SubWidthC,yCUBase/SubHeightC, nT, 2, cuPredMode, cbf_cr & 2);
+      decode_TU<format>(tctx,
+                        xBase/SubWidthC,  yBase/SubHeightC + (1<<log2TrafoSize),
+                        nT, 2, cuPredMode, cbf_cr & 2);
     }
   }
 
@@ -3818,6 +3899,7 @@ static void dump_cbsize(de265_image* img)
 }
 
 
+template <class format>
 void read_transform_tree(thread_context* tctx,
                          int x0, int y0,        // position of TU in frame
                          int xBase, int yBase,  // position of parent TU in frame
@@ -3837,6 +3919,8 @@ void read_transform_tree(thread_context* tctx,
   de265_image* img = tctx->img;
   const seq_parameter_set& sps = img->get_sps();
 
+  const int ChromaArrayType = format::ChromaArrayType(sps);
+
   int split_transform_flag;
 
   enum PredMode PredMode = img->get_pred_mode(x0,y0);
@@ -3881,13 +3965,13 @@ void read_transform_tree(thread_context* tctx,
   // 4:2:0 and 4:4:4 modes: binary flag in bit 0
   // 4:2:2 mode: bit 0: top block, bit 1: bottom block
 
-  if ((log2TrafoSize>2 && sps.ChromaArrayType != CHROMA_MONO) ||
-      sps.ChromaArrayType == CHROMA_444) {
+  if ((log2TrafoSize>2 && ChromaArrayType != CHROMA_MONO) ||
+      ChromaArrayType == CHROMA_444) {
     // we do not have to test for trafoDepth==0, because parent_cbf_cb is 1 at depth 0
     if (/*trafoDepth==0 ||*/ parent_cbf_cb) {
       cbf_cb = decode_cbf_chroma(tctx,trafoDepth);
 
-      if (sps.ChromaArrayType == CHROMA_422 && (!split_transform_flag || log2TrafoSize==3)) {
+      if (ChromaArrayType == CHROMA_422 && (!split_transform_flag || log2TrafoSize==3)) {
         cbf_cb |= (decode_cbf_chroma(tctx,trafoDepth) << 1);
       }
     }
@@ -3896,7 +3980,7 @@ void read_transform_tree(thread_context* tctx,
     if (/*trafoDepth==0 ||*/ parent_cbf_cr) {
       cbf_cr = decode_cbf_chroma(tctx,trafoDepth);
 
-      if (sps.ChromaArrayType == CHROMA_422 && (!split_transform_flag || log2TrafoSize==3)) {
+      if (ChromaArrayType == CHROMA_422 && (!split_transform_flag || log2TrafoSize==3)) {
         cbf_cr |= (decode_cbf_chroma(tctx,trafoDepth) << 1);
       }
     }
@@ -3935,14 +4019,14 @@ void read_transform_tree(thread_context* tctx,
 
     logtrace(LogSlice,"transform split.\n");
 
-    read_transform_tree(tctx, x0,y0, x0,y0, xCUBase,yCUBase, log2TrafoSize-1, trafoDepth+1, 0,
-                        MaxTrafoDepth,IntraSplitFlag, cuPredMode, cbf_cb,cbf_cr);
-    read_transform_tree(tctx, x1,y0, x0,y0, xCUBase,yCUBase, log2TrafoSize-1, trafoDepth+1, 1,
-                        MaxTrafoDepth,IntraSplitFlag, cuPredMode, cbf_cb,cbf_cr);
-    read_transform_tree(tctx, x0,y1, x0,y0, xCUBase,yCUBase, log2TrafoSize-1, trafoDepth+1, 2,
-                        MaxTrafoDepth,IntraSplitFlag, cuPredMode, cbf_cb,cbf_cr);
-    read_transform_tree(tctx, x1,y1, x0,y0, xCUBase,yCUBase, log2TrafoSize-1, trafoDepth+1, 3,
-                        MaxTrafoDepth,IntraSplitFlag, cuPredMode, cbf_cb,cbf_cr);
+    read_transform_tree<format>(tctx, x0,y0, x0,y0, xCUBase,yCUBase, log2TrafoSize-1, trafoDepth+1, 0,
+                                MaxTrafoDepth,IntraSplitFlag, cuPredMode, cbf_cb,cbf_cr);
+    read_transform_tree<format>(tctx, x1,y0, x0,y0, xCUBase,yCUBase, log2TrafoSize-1, trafoDepth+1, 1,
+                                MaxTrafoDepth,IntraSplitFlag, cuPredMode, cbf_cb,cbf_cr);
+    read_transform_tree<format>(tctx, x0,y1, x0,y0, xCUBase,yCUBase, log2TrafoSize-1, trafoDepth+1, 2,
+                                MaxTrafoDepth,IntraSplitFlag, cuPredMode, cbf_cb,cbf_cr);
+    read_transform_tree<format>(tctx, x1,y1, x0,y0, xCUBase,yCUBase, log2TrafoSize-1, trafoDepth+1, 3,
+                                MaxTrafoDepth,IntraSplitFlag, cuPredMode, cbf_cb,cbf_cr);
   }
   else {
     int cbf_luma;
@@ -3960,8 +4044,8 @@ void read_transform_tree(thread_context* tctx,
 
     logtrace(LogSlice,"call read_transform_unit %d/%d\n",x0,y0);
 
-    read_transform_unit(tctx, x0,y0,xBase,yBase, xCUBase,yCUBase, log2TrafoSize,trafoDepth, blkIdx,
-                        cbf_luma, cbf_cb, cbf_cr);
+    read_transform_unit<format>(tctx, x0,y0,xBase,yBase, xCUBase,yCUBase, log2TrafoSize,trafoDepth, blkIdx,
+                                cbf_luma, cbf_cb, cbf_cr);
   }
 }
 
@@ -4134,7 +4218,8 @@ void read_prediction_unit(thread_context* tctx,
 
 
   decode_prediction_unit(tctx->decctx, tctx->shdr, tctx->img, tctx->motion,
-                         xC,yC,xB,yB, nCS, nPbW,nPbH, partIdx);
+                         xC,yC,xB,yB, nCS, nPbW,nPbH, partIdx,
+                         &tctx->mergeCandidateCache);
 }
 
 
@@ -4182,6 +4267,7 @@ void read_pcm_samples_internal(thread_context* tctx, int x0, int y0, int log2CbS
       }
 }
 
+template <class format>
 static void read_pcm_samples(thread_context* tctx, int x0, int y0, int log2CbSize)
 {
   bitreader br;
@@ -4191,14 +4277,14 @@ static void read_pcm_samples(thread_context* tctx, int x0, int y0, int log2CbSiz
   br.nextbits_cnt = 0;
 
 
-  if (tctx->img->high_bit_depth(0)) {
+  if (format::high_bit_depth(tctx->img, 0)) {
     read_pcm_samples_internal<uint16_t>(tctx,x0,y0,log2CbSize,0,br);
   } else {
     read_pcm_samples_internal<uint8_t>(tctx,x0,y0,log2CbSize,0,br);
   }
 
-  if (tctx->img->get_sps().ChromaArrayType != CHROMA_MONO) {
-    if (tctx->img->high_bit_depth(1)) {
+  if (format::ChromaArrayType(tctx->img->get_sps()) != CHROMA_MONO) {
+    if (format::high_bit_depth(tctx->img, 1)) {
       read_pcm_samples_internal<uint16_t>(tctx,x0,y0,log2CbSize,1,br);
       read_pcm_samples_internal<uint16_t>(tctx,x0,y0,log2CbSize,2,br);
     } else {
@@ -4242,6 +4328,7 @@ static const uint8_t map_chroma_422[35] = {
   21,22,23,23,24,24,25,25,26,27,27,28,28,29,29,30,31
 };
 
+template <class format>
 void read_coding_unit(thread_context* tctx,
                       int x0, int y0,  // position of coding unit in frame
                       int log2CbSize,
@@ -4252,6 +4339,8 @@ void read_coding_unit(thread_context* tctx,
   const pic_parameter_set& pps = img->get_pps();
   slice_segment_header* shdr = tctx->shdr;
 
+  const int ChromaArrayType = format::ChromaArrayType(sps);
+
   logtrace(LogSlice,"- read_coding_unit %d;%d cbsize:%d\n",x0,y0,1<<log2CbSize);
 
 
@@ -4307,7 +4396,8 @@ void read_coding_unit(thread_context* tctx,
 
     int nCS_L = 1<<log2CbSize;
     decode_prediction_unit(tctx->decctx,tctx->shdr,tctx->img,tctx->motion,
-                           x0,y0, 0,0, nCS_L, nCS_L,nCS_L, 0);
+                           x0,y0, 0,0, nCS_L, nCS_L,nCS_L, 0,
+                           &tctx->mergeCandidateCache);
   }
   else /* not skipped */ {
     if (shdr->slice_type != SLICE_TYPE_I) {
@@ -4353,7 +4443,7 @@ void read_coding_unit(thread_context* tctx,
       if (pcm_flag) {
         img->set_pcm_flag(x0,y0,log2CbSize);
 
-        read_pcm_samples(tctx, x0,y0, log2CbSize);
+        read_pcm_samples<format>(tctx, x0,y0, log2CbSize);
       }
       else {
         int pbOffset = (PartMode == PART_NxN) ? (nCbS/2) : nCbS;
@@ -4444,7 +4534,7 @@ void read_coding_unit(thread_context* tctx,
 
         // set chroma intra prediction mode
 
-        if (sps.ChromaArrayType == CHROMA_444) {
+        if (ChromaArrayType == CHROMA_444) {
           // chroma 4:4:4
 
           idx = 0;
@@ -4467,7 +4557,7 @@ void read_coding_unit(thread_context* tctx,
               idx++;
             }
         }
-        else if (sps.ChromaArrayType != CHROMA_MONO) {
+        else if (ChromaArrayType != CHROMA_MONO) {
           // chroma 4:2:0 and 4:2:2
 
           int intra_chroma_pred_mode = decode_intra_chroma_pred_mode(tctx);
@@ -4475,7 +4565,7 @@ void read_coding_unit(thread_context* tctx,
           logtrace(LogSlice,"IntraPredMode: %d\n",IntraPredMode);
           int IntraPredModeC = map_chroma_pred_mode(intra_chroma_pred_mode, IntraPredMode);
 
-          if (sps.ChromaArrayType == CHROMA_422) {
+          if (ChromaArrayType == CHROMA_422) {
             IntraPredModeC = map_chroma_422[ IntraPredModeC ];
           }
 
@@ -4563,13 +4653,13 @@ void read_coding_unit(thread_context* tctx,
         logtrace(LogSlice,"MaxTrafoDepth: %d\n",MaxTrafoDepth);
 
         uint8_t initial_chroma_cbf = 1;
-        if (sps.ChromaArrayType == CHROMA_MONO) {
+        if (ChromaArrayType == CHROMA_MONO) {
           initial_chroma_cbf = 0;
         }
 
-        read_transform_tree(tctx, x0,y0, x0,y0, x0,y0, log2CbSize, 0,0,
-                            MaxTrafoDepth, IntraSplitFlag, cuPredMode,
-                            initial_chroma_cbf, initial_chroma_cbf);
+        read_transform_tree<format>(tctx, x0,y0, x0,y0, x0,y0, log2CbSize, 0,0,
+                                    MaxTrafoDepth, IntraSplitFlag, cuPredMode,
+                                    initial_chroma_cbf, initial_chroma_cbf);
       }
     } // !pcm
   }
@@ -4579,6 +4669,7 @@ void read_coding_unit(thread_context* tctx,
 // ------------------------------------------------------------------------------------------
 
 
+template <class format>
 void read_coding_quadtree(thread_context* tctx,
                           int x0, int y0,
                           int log2CbSize,
@@ -4627,24 +4718,24 @@ void read_coding_quadtree(thread_context* tctx,
     int x1 = x0 + (1<<(log2CbSize-1));
     int y1 = y0 + (1<<(log2CbSize-1));
 
-    read_coding_quadtree(tctx,x0,y0, log2CbSize-1, ctDepth+1);
+    read_coding_quadtree<format>(tctx,x0,y0, log2CbSize-1, ctDepth+1);
 
     if (x1<sps.pic_width_in_luma_samples)
-      read_coding_quadtree(tctx,x1,y0, log2CbSize-1, ctDepth+1);
+      read_coding_quadtree<format>(tctx,x1,y0, log2CbSize-1, ctDepth+1);
 
     if (y1<sps.pic_height_in_luma_samples)
-      read_coding_quadtree(tctx,x0,y1, log2CbSize-1, ctDepth+1);
+      read_coding_quadtree<format>(tctx,x0,y1, log2CbSize-1, ctDepth+1);
 
     if (x1<sps.pic_width_in_luma_samples &&
         y1<sps.pic_height_in_luma_samples)
-      read_coding_quadtree(tctx,x1,y1, log2CbSize-1, ctDepth+1);
+      read_coding_quadtree<format>(tctx,x1,y1, log2CbSize-1, ctDepth+1);
   }
   else {
     // set ctDepth of this CU
 
     img->set_ctDepth(x0,y0, log2CbSize, ctDepth);
 
-    read_coding_unit(tctx, x0,y0, log2CbSize, ctDepth);
+    read_coding_unit<format>(tctx, x0,y0, log2CbSize, ctDepth);
   }
 
   logtrace(LogSlice,"-\n");
@@ -4656,10 +4747,54 @@ void read_coding_quadtree(thread_context* tctx,
 enum DecodeResult {
   Decode_EndOfSliceSegment,
   Decode_EndOfSubstream,
-  Decode_Error
+  Decode_Error,
+  Decode_Suspended
 };
 
+/* Returns the x position of the CTB in the row above that has to be decoded before
+   CTB (ctbx;ctby) in WPP mode. This is the CTB above right, or the CTB above at the
+   right tile border. There is no dependency in the first CTB row of a tile and when
+   the CTB above belongs to an earlier slice, since it is not available for prediction.
+ */
+static bool get_WPP_dependency(const thread_context* tctx, int ctbx,int ctby, int* depCtbX)
+{
+  const pic_parameter_set& pps = tctx->img->get_pps();
+  const int ctbW = tctx->img->get_sps().PicWidthInCtbsY;
+
+  int tileID = pps.TileIdRS[ctbx + ctby*ctbW];
+  int tileX  = tileID % pps.num_tile_columns;
+  int tileY  = tileID / pps.num_tile_columns;
+
+  if (ctby == pps.rowBd[tileY]) {
+    return false;
+  }
+
+  int x = std::min(ctbx+1, pps.colBd[tileX+1]-1);
+
+  if (pps.CtbAddrRStoTS[x + (ctby-1)*ctbW] < pps.CtbAddrRStoTS[tctx->shdr->SliceAddrRS]) {
+    return false;
+  }
+
+  *depCtbX = x;
+  return true;
+}
+
+
+/* Index into image_unit::ctx_models where the WPP context models for the CTB row
+   starting at (ctbx;ctby) are stored. There is one entry per CTB row and tile column.
+ */
+static int get_WPP_context_index(const pic_parameter_set& pps, int ctbW, int ctbx,int ctby)
+{
+  int tileX = pps.TileIdRS[ctbx + ctby*ctbW] % pps.num_tile_columns;
+  return ctby * pps.num_tile_columns + tileX;
+}
+
+
 /* Decode CTBs until the end of sub-stream, the end-of-slice, or some error occurs.
+   With block_wpp, the task in tctx is suspended when the CTB above right has not
+   been decoded yet (Decode_Suspended). The same happens at the start of a WPP row
+   while the context models of the row above are not available. Calling the function
+   again with the same thread context continues decoding at the current CTB.
  */
 enum DecodeResult decode_substream(thread_context* tctx,
                                    bool block_wpp, // block on WPP dependencies
@@ -4670,33 +4805,40 @@ enum DecodeResult decode_substream(thread_context* tctx,
 
   const int ctbW = sps.PicWidthInCtbsY;
 
-
-  const int startCtbY = tctx->CtbY;
+  const bool main420 = format_main420::matches(sps);
 
   //printf("start decoding substream at %d;%d\n",tctx->CtbX,tctx->CtbY);
 
   // in WPP mode: initialize CABAC model with stored model from row above
 
-  if ((!first_independent_substream || tctx->CtbY != startCtbY) &&
+  if (!first_independent_substream &&
       pps.entropy_coding_sync_enabled_flag &&
-      tctx->CtbY>=1 && tctx->CtbX==0)
+      tctx->CtbAddrInRS < sps.PicSizeInCtbsY &&
+      tctx->CtbX == pps.colBd[ pps.TileIdRS[tctx->CtbAddrInRS] % pps.num_tile_columns ])
     {
-      if (sps.PicWidthInCtbsY>1) {
-        if ((tctx->CtbY-1) >= tctx->imgunit->ctx_models.size()) {
+      // The models are taken from the CTB above right, if that is in the same tile and slice.
+
+      int depCtbX;
+      if (get_WPP_dependency(tctx, tctx->CtbX,tctx->CtbY, &depCtbX) &&
+          depCtbX == tctx->CtbX+1) {
+        int ctxIdx = get_WPP_context_index(pps, ctbW, depCtbX, tctx->CtbY-1);
+        if ((size_t)ctxIdx >= tctx->imgunit->ctx_models.size()) {
           return Decode_Error;
         }
 
-        //printf("CTX wait on %d/%d\n",1,tctx->CtbY-1);
+        //printf("CTX wait on %d/%d\n",depCtbX,tctx->CtbY-1);
 
         // we have to wait until the context model data is there
-        tctx->img->wait_for_progress(tctx->task, 1,tctx->CtbY-1,CTB_PROGRESS_PREFILTER);
+        if (tctx->img->suspend_until_progress(tctx->task, depCtbX,tctx->CtbY-1,
+                                              CTB_PROGRESS_PREFILTER)) {
+          return Decode_Suspended;
+        }
 
         // copy CABAC model from previous CTB row
-        tctx->ctx_model = tctx->imgunit->ctx_models[(tctx->CtbY-1)];
-        tctx->imgunit->ctx_models[(tctx->CtbY-1)].release(); // not used anymore
+        tctx->ctx_model = tctx->imgunit->ctx_models[ctxIdx];
+        tctx->imgunit->ctx_models[ctxIdx].release(); // not used anymore
       }
       else {
-        tctx->img->wait_for_progress(tctx->task, 0,tctx->CtbY-1,CTB_PROGRESS_PREFILTER);
         initialize_CABAC_models(tctx);
       }
     }
@@ -4715,13 +4857,14 @@ enum DecodeResult decode_substream(thread_context* tctx,
         return Decode_Error;
     }
 
-    if (block_wpp && ctby>0 && ctbx < ctbW-1) {
+    int depCtbX;
+    if (block_wpp && get_WPP_dependency(tctx, ctbx,ctby, &depCtbX)) {
 
-      // TODO: if we are in tiles mode and at the right border, do not wait for x+1,y-1
+      //printf("wait on %d/%d (%d)\n",depCtbX,ctby-1, depCtbX+(ctby-1)*sps->PicWidthInCtbsY);
 
-      //printf("wait on %d/%d (%d)\n",ctbx+1,ctby-1, ctbx+1+(ctby-1)*sps->PicWidthInCtbsY);
-
-      tctx->img->wait_for_progress(tctx->task, ctbx+1,ctby-1, CTB_PROGRESS_PREFILTER);
+      if (tctx->img->suspend_until_progress(tctx->task, depCtbX,ctby-1, CTB_PROGRESS_PREFILTER)) {
+        return Decode_Suspended;
+      }
     }
 
     //printf("%p: decode %d;%d\n", tctx, tctx->CtbX,tctx->CtbY);
@@ -4733,23 +4876,34 @@ enum DecodeResult decode_substream(thread_context* tctx,
       return Decode_Error;
     }
 
-    read_coding_tree_unit(tctx);
+    if (main420) {
+      read_coding_tree_unit<format_main420>(tctx);
+    }
+    else {
+      read_coding_tree_unit<format_generic>(tctx);
+    }
 
 
-    // save CABAC-model for WPP (except in last CTB row)
+    // save CABAC-model for WPP (except in last CTB row of a tile)
+
+    if (pps.entropy_coding_sync_enabled_flag) {
+      int tileID = pps.TileIdRS[tctx->CtbAddrInRS];
+      int tileX  = tileID % pps.num_tile_columns;
+      int tileY  = tileID / pps.num_tile_columns;
+
+      if (ctbx == pps.colBd[tileX]+1 &&
+          ctby <  pps.rowBd[tileY+1]-1) {
+        int ctxIdx = get_WPP_context_index(pps, ctbW, ctbx,ctby);
 
-    if (pps.entropy_coding_sync_enabled_flag &&
-        ctbx == 1 &&
-        ctby < sps.PicHeightInCtbsY-1)
-      {
         // no storage for context table has been allocated
-        if (tctx->imgunit->ctx_models.size() <= ctby) {
+        if (tctx->imgunit->ctx_models.size() <= (size_t)ctxIdx) {
           return Decode_Error;
         }
 
-        tctx->imgunit->ctx_models[ctby] = tctx->ctx_model;
-        tctx->imgunit->ctx_models[ctby].decouple(); // store an independent copy
+        tctx->imgunit->ctx_models[ctxIdx] = tctx->ctx_model;
+        tctx->imgunit->ctx_models[ctxIdx].decouple(); // store an independent copy
       }
+    }
 
 
     // end of slice segment ?
@@ -4831,8 +4985,13 @@ enum DecodeResult decode_substream(thread_context* tctx,
 
 
 
-bool initialize_CABAC_at_slice_segment_start(thread_context* tctx)
+/* Returns false on error. If the previous slice segment is still being decoded by other
+   tasks, the task in tctx is suspended and *suspended is set. The function then has to
+   be called again when the task continues. */
+bool initialize_CABAC_at_slice_segment_start(thread_context* tctx, bool* suspended)
 {
+  *suspended = false;
+
   de265_image* img = tctx->img;
   const pic_parameter_set& pps = img->get_pps();
   const seq_parameter_set& sps = img->get_sps();
@@ -4864,15 +5023,18 @@ bool initialize_CABAC_at_slice_segment_start(thread_context* tctx)
         return false;
       }
 
-      prevSliceSegment->finished_threads.wait_for_progress(prevSliceSegment->nThreads);
-
-
-      /*
-      printf("wait for %d,%d (init)\n",
-             prevCtb / sps->PicWidthInCtbsY,
-             prevCtb % sps->PicWidthInCtbsY);
-      tctx->img->wait_for_progress(tctx->task, prevCtb, CTB_PROGRESS_PREFILTER);
-      */
+      if (tctx->task) {
+        if (img->suspend_until_progress(tctx->task, &prevSliceSegment->finished_threads,
+                                        prevSliceSegment->nThreads)) {
+          *suspended = true;
+          return true;
+        }
+      }
+      else {
+        // Decoding in the main thread, which is not a pool worker. It may have to wait
+        // for the tasks of the previous slice segment when that was decoded in parallel.
+        prevSliceSegment->finished_threads.wait_for_progress(prevSliceSegment->nThreads);
+      }
 
       if (!prevCtbHdr->ctx_model_storage_defined) {
         return false;
@@ -4910,15 +5072,25 @@ void thread_task_slice_segment::work()
   thread_context* tctx = data->tctx;
   de265_image* img = tctx->img;
 
-  state = Running;
-  img->thread_run(this);
+  if (state == Blocked) {
+    img->thread_resumes(this);
+  }
+  else {
+    state = Running;
+    img->thread_run(this);
 
-  setCtbAddrFromTS(tctx);
+    setCtbAddrFromTS(tctx);
+  }
 
   //printf("%p: A start decoding at %d/%d\n", tctx, tctx->CtbX,tctx->CtbY);
 
   if (data->firstSliceSubstream) {
-    bool success = initialize_CABAC_at_slice_segment_start(tctx);
+    bool suspended;
+    bool success = initialize_CABAC_at_slice_segment_start(tctx, &suspended);
+    if (suspended) {
+      return; // we will continue when the previous slice segment is decoded
+    }
+
     if (!success) {
       state = Finished;
       tctx->sliceunit->finished_threads.increase_progress(1);
@@ -4949,48 +5121,79 @@ void thread_task_ctb_row::work()
   de265_image* img = tctx->img;
 
   const seq_parameter_set& sps = img->get_sps();
+  const pic_parameter_set& pps = img->get_pps();
   int ctbW = sps.PicWidthInCtbsY;
 
-  state = Running;
-  img->thread_run(this);
+  if (state == Blocked) {
+    img->thread_resumes(this);
+  }
+  else {
+    state = Running;
+    img->thread_run(this);
 
-  setCtbAddrFromTS(tctx);
+    setCtbAddrFromTS(tctx);
+  }
 
-  int ctby = tctx->CtbAddrInRS / ctbW;
-  int myCtbRow = ctby;
+  int myCtbRow = tctx->CtbAddrInRS / ctbW;
 
-  //printf("start CTB-row decoding at row %d\n", ctby);
+  // CTB row of the tile that we are decoding (the whole picture width without tiles)
 
-  if (data->firstSliceSubstream) {
-    bool success = initialize_CABAC_at_slice_segment_start(tctx);
-    if (!success) {
-      // could not decode this row, mark whole row as finished
-      for (int x=0;x<ctbW;x++) {
-        img->ctb_progress[myCtbRow*ctbW + x].set_progress(CTB_PROGRESS_PREFILTER);
-      }
+  int tileX = pps.TileIdRS[tctx->CtbAddrInRS] % pps.num_tile_columns;
+  int firstCtbX = pps.colBd[tileX];
+  int lastCtbX  = pps.colBd[tileX+1];
 
-      state = Finished;
-      tctx->sliceunit->finished_threads.increase_progress(1);
-      img->thread_finishes(this);
+  if (!substreamStarted) {
+    // Do not start before the CTB row above is far enough.
+
+    int depCtbX;
+    if (get_WPP_dependency(tctx, tctx->CtbX, myCtbRow, &depCtbX) &&
+        img->suspend_until_progress(this, depCtbX, myCtbRow-1,
+                                    CTB_PROGRESS_PREFILTER)) {
       return;
     }
-    //initialize_CABAC(tctx);
-  }
 
-  init_CABAC_decoder_2(&tctx->cabac_decoder);
+    //printf("start CTB-row decoding at row %d\n", myCtbRow);
+
+    if (data->firstSliceSubstream) {
+      bool suspended;
+      bool success = initialize_CABAC_at_slice_segment_start(tctx, &suspended);
+      if (suspended) {
+        return; // we will continue when the previous slice segment is decoded
+      }
+
+      if (!success) {
+        // could not decode this row, mark whole row as finished
+        for (int x=firstCtbX;x<lastCtbX;x++) {
+          img->ctb_progress[myCtbRow*ctbW + x].set_progress(CTB_PROGRESS_PREFILTER);
+        }
+
+        state = Finished;
+        tctx->sliceunit->finished_threads.increase_progress(1);
+        img->thread_finishes(this);
+        return;
+      }
+      //initialize_CABAC(tctx);
+    }
+
+    init_CABAC_decoder_2(&tctx->cabac_decoder);
+
+    substreamStarted = true;
+  }
 
   bool firstIndependentSubstream =
     data->firstSliceSubstream && !tctx->shdr->dependent_slice_segment_flag;
 
-  /*enum DecodeResult result =*/
-  decode_substream(tctx, true, firstIndependentSubstream);
+  enum DecodeResult result = decode_substream(tctx, true, firstIndependentSubstream);
+
+  if (result == Decode_Suspended) {
+    return; // we will continue when the CTB row above has progressed
+  }
 
   // mark progress on remaining CTBs in row (in case of decoder error and early termination)
 
   // TODO: what about slices that end properly in the middle of a CTB row?
 
   if (tctx->CtbY == myCtbRow) {
-    int lastCtbX = sps.PicWidthInCtbsY; // assume no tiles when WPP is on
     for (int x = tctx->CtbX; x<lastCtbX ; x++) {
 
       if (x        < sps.PicWidthInCtbsY &&
@@ -5015,7 +5218,8 @@ de265_error read_slice_segment_data(thread_context* tctx)
   const seq_parameter_set& sps = img->get_sps();
   slice_segment_header* shdr = tctx->shdr;
 
-  bool success = initialize_CABAC_at_slice_segment_start(tctx);
+  bool suspended;
+  bool success = initialize_CABAC_at_slice_segment_start(tctx, &suspended);
   if (!success) {
     return DE265_ERROR_UNSPECIFIED_DECODING_ERROR;
   }
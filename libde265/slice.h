@@ -291,6 +291,8 @@ public:
   int    debug_startCtbRow;
   thread_context* tctx;
 
+  bool   substreamStarted; // CABAC is initialized, continue decoding after suspension
+
   virtual void work();
   virtual std::string name() const;
 };
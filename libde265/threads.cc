@@ -112,25 +112,74 @@ void de265_progress_lock::wait_for_progress(int progress)
 
 void de265_progress_lock::set_progress(int progress)
 {
+  std::vector<thread_task*> ready;
+
   de265_mutex_lock(&mutex);
 
   if (progress>mProgress) {
     mProgress = progress;
 
     de265_cond_broadcast(&cond, &mutex);
+    take_ready_tasks(ready);
   }
 
   de265_mutex_unlock(&mutex);
+
+  for (size_t i=0;i<ready.size();i++) {
+    resume_task(ready[i]);
+  }
 }
 
 void de265_progress_lock::increase_progress(int progress)
 {
+  std::vector<thread_task*> ready;
+
   de265_mutex_lock(&mutex);
 
   mProgress += progress;
   de265_cond_broadcast(&cond, &mutex);
+  take_ready_tasks(ready);
 
   de265_mutex_unlock(&mutex);
+
+  for (size_t i=0;i<ready.size();i++) {
+    resume_task(ready[i]);
+  }
+}
+
+bool de265_progress_lock::resume_task_at_progress(thread_task* task, int progress)
+{
+  if (mProgress >= progress) {
+    return false;
+  }
+
+  de265_mutex_lock(&mutex);
+
+  bool suspend = (mProgress < progress);
+  if (suspend) {
+    waiting_task w;
+    w.task = task;
+    w.progress = progress;
+    waiting_tasks.push_back(w);
+  }
+
+  de265_mutex_unlock(&mutex);
+
+  return suspend;
+}
+
+void de265_progress_lock::take_ready_tasks(std::vector<thread_task*>& ready)
+{
+  for (size_t i=0;i<waiting_tasks.size(); ) {
+    if (waiting_tasks[i].progress <= mProgress) {
+      ready.push_back(waiting_tasks[i].task);
+      waiting_tasks[i] = waiting_tasks.back();
+      waiting_tasks.pop_back();
+    }
+    else {
+      i++;
+    }
+  }
 }
 
 int  de265_progress_lock::get_progress() const
@@ -184,6 +233,38 @@ void printblks(const thread_pool* pool)
 #endif
 
 
+/* Take the next task from the queue with the highest priority. Queues of the
+   same priority are served round-robin. Must be called with the pool mutex held
+   and num_tasks>0.
+ */
+static thread_task* get_next_task(thread_pool* pool)
+{
+  int nQueues = pool->queues.size();
+
+  int bestIdx = -1;
+  for (int i=0;i<nQueues;i++) {
+    int idx = (pool->next_queue + i) % nQueues;
+    const thread_task_queue* q = pool->queues[idx];
+
+    if (!q->tasks.empty() &&
+        (bestIdx<0 || q->priority > pool->queues[bestIdx]->priority)) {
+      bestIdx = idx;
+    }
+  }
+
+  assert(bestIdx>=0);
+
+  thread_task_queue* q = pool->queues[bestIdx];
+  thread_task* task = q->tasks.front();
+  q->tasks.pop_front();
+
+  pool->num_tasks--;
+  pool->next_queue = (bestIdx+1) % nQueues;
+
+  return task;
+}
+
+
 static THREAD_RESULT worker_thread(THREAD_PARAM pool_ptr)
 {
   thread_pool* pool = (thread_pool*)pool_ptr;
@@ -198,7 +279,7 @@ static THREAD_RESULT worker_thread(THREAD_PARAM pool_ptr)
     for (;;) {
       // end waiting if thread-pool has been stopped or we have a task to execute
 
-      if (pool->stopped || pool->tasks.size()>0) {
+      if (pool->stopped || pool->num_tasks>0) {
         break;
       }
 
@@ -216,8 +297,12 @@ static THREAD_RESULT worker_thread(THREAD_PARAM pool_ptr)
 
     // get a task
 
-    thread_task* task = pool->tasks.front();
-    pool->tasks.pop_front();
+    thread_task* task = get_next_task(pool);
+
+    // Remember the queue now. A task that suspends itself may already be running
+    // again in another thread when work() returns.
+    thread_task_queue* queue = task->queue;
+    queue->num_running++;
 
     pool->num_threads_working++;
 
@@ -235,6 +320,11 @@ static THREAD_RESULT worker_thread(THREAD_PARAM pool_ptr)
     de265_mutex_lock(&pool->mutex);
 
     pool->num_threads_working--;
+
+    queue->num_running--;
+    if (queue->num_running==0 && queue->detaching) {
+      de265_cond_broadcast(&pool->cond_task_finished, &pool->mutex);
+    }
   }
   de265_mutex_unlock(&pool->mutex);
 
@@ -257,10 +347,14 @@ de265_error start_thread_pool(thread_pool* pool, int num_threads)
 
   de265_mutex_init(&pool->mutex);
   de265_cond_init(&pool->cond_var);
+  de265_cond_init(&pool->cond_task_finished);
 
   de265_mutex_lock(&pool->mutex);
   pool->num_threads_working = 0;
+  pool->num_tasks = 0;
+  pool->next_queue = 0;
   pool->stopped = false;
+  pool->release_when_detached = false;
   de265_mutex_unlock(&pool->mutex);
 
   // start worker threads
@@ -292,17 +386,132 @@ void stop_thread_pool(thread_pool* pool)
     de265_thread_destroy(&pool->thread[i]);
   }
 
+  // queues that are still attached will not be served anymore
+
+  for (size_t i=0;i<pool->queues.size();i++) {
+    pool->queues[i]->tasks.clear();
+    pool->queues[i]->pool = NULL;
+  }
+
+  pool->queues.clear();
+  pool->num_tasks = 0;
+
   de265_mutex_destroy(&pool->mutex);
   de265_cond_destroy(&pool->cond_var);
+  de265_cond_destroy(&pool->cond_task_finished);
+}
+
+
+bool release_thread_pool(thread_pool* pool)
+{
+  de265_mutex_lock(&pool->mutex);
+
+  bool unused = pool->queues.empty();
+  if (!unused) {
+    pool->release_when_detached = true;
+  }
+
+  de265_mutex_unlock(&pool->mutex);
+
+  return unused;
+}
+
+
+void attach_task_queue(thread_pool* pool, thread_task_queue* queue)
+{
+  assert(queue->pool == NULL);
+  assert(!pool->release_when_detached);
+
+  de265_mutex_lock(&pool->mutex);
+  pool->queues.push_back(queue);
+  queue->pool = pool;
+  de265_mutex_unlock(&pool->mutex);
 }
 
 
-void   add_task(thread_pool* pool, thread_task* task)
+/* Wait until the workers have finished the tasks they already took from the queue.
+   New tasks are not accepted meanwhile. Must be called with the pool mutex held. */
+static void wait_for_running_tasks(thread_pool* pool, thread_task_queue* queue)
 {
+  queue->detaching = true;
+  while (queue->num_running > 0) {
+    de265_cond_wait(&pool->cond_task_finished, &pool->mutex);
+  }
+  queue->detaching = false;
+}
+
+
+void flush_task_queue(thread_task_queue* queue)
+{
+  thread_pool* pool = queue->pool;
+  if (pool==NULL) {
+    return;
+  }
+
   de265_mutex_lock(&pool->mutex);
-  if (!pool->stopped) {
 
-    pool->tasks.push_back(task);
+  pool->num_tasks -= queue->tasks.size();
+  queue->tasks.clear();
+
+  wait_for_running_tasks(pool, queue);
+
+  de265_mutex_unlock(&pool->mutex);
+}
+
+
+bool detach_task_queue(thread_task_queue* queue)
+{
+  thread_pool* pool = queue->pool;
+  if (pool==NULL) {
+    return false;
+  }
+
+  de265_mutex_lock(&pool->mutex);
+
+  for (size_t i=0;i<pool->queues.size();i++) {
+    if (pool->queues[i] == queue) {
+      pool->queues.erase(pool->queues.begin()+i);
+      break;
+    }
+  }
+
+  pool->next_queue = 0;
+  pool->num_tasks -= queue->tasks.size();
+  queue->tasks.clear();
+
+  wait_for_running_tasks(pool, queue);
+
+  queue->pool = NULL;
+
+  bool release = (pool->release_when_detached && pool->queues.empty());
+
+  de265_mutex_unlock(&pool->mutex);
+
+  return release;
+}
+
+
+void set_task_queue_priority(thread_task_queue* queue, int priority)
+{
+  thread_pool* pool = queue->pool;
+
+  if (pool) { de265_mutex_lock(&pool->mutex); }
+  queue->priority = priority;
+  if (pool) { de265_mutex_unlock(&pool->mutex); }
+}
+
+
+void   add_task(thread_task_queue* queue, thread_task* task)
+{
+  thread_pool* pool = queue->pool;
+  assert(pool);
+
+  de265_mutex_lock(&pool->mutex);
+  if (!pool->stopped && !queue->detaching) {
+
+    task->queue = queue;
+    queue->tasks.push_back(task);
+    pool->num_tasks++;
 
     // wake up one thread
 
@@ -310,3 +519,23 @@ void   add_task(thread_pool* pool, thread_task* task)
   }
   de265_mutex_unlock(&pool->mutex);
 }
+
+
+void   resume_task(thread_task* task)
+{
+  thread_task_queue* queue = task->queue;
+  thread_pool* pool = queue->pool;
+  if (pool==NULL) {
+    return;
+  }
+
+  de265_mutex_lock(&pool->mutex);
+  if (!pool->stopped && !queue->detaching) {
+
+    queue->tasks.push_front(task);
+    pool->num_tasks++;
+
+    de265_cond_signal(&pool->cond_var);
+  }
+  de265_mutex_unlock(&pool->mutex);
+}
@@ -32,6 +32,7 @@
 #endif
 
 #include <deque>
+#include <vector>
 #include <string>
 #include <atomic>
 
@@ -75,6 +76,9 @@ void de265_cond_wait(de265_cond* c,de265_mutex* m);
 void de265_cond_signal(de265_cond* c);
 
 
+class thread_task;
+
+
 class de265_progress_lock
 {
 public:
@@ -85,10 +89,26 @@ public:
   void set_progress(int progress);
   void increase_progress(int progress);
   int  get_progress() const;
-  void reset(int value=0) { mProgress=value; }
+  void reset(int value=0) { mProgress=value; waiting_tasks.clear(); }
+
+  /* Instead of blocking the worker thread, remember the task and put it back into
+     its queue as soon as 'progress' is reached. Returns false if the progress has
+     already been reached and the task can just continue. If it returns true, the
+     caller must not touch the task anymore, since it may already be running again
+     in another thread. */
+  bool resume_task_at_progress(thread_task* task, int progress);
 
 private:
-  int mProgress;
+  std::atomic<int> mProgress; // read without the mutex in the fast paths
+
+  struct waiting_task {
+    thread_task* task;
+    int progress;
+  };
+
+  std::vector<waiting_task> waiting_tasks;
+
+  void take_ready_tasks(std::vector<thread_task*>& ready); // call with mutex locked
 
   // private data
 
@@ -98,20 +118,62 @@ private:
 
 
 
+class thread_task_queue;
+
 class thread_task
 {
 public:
-  thread_task() : state(Queued) { }
+  thread_task() : state(Queued), queue(NULL) { }
   virtual ~thread_task() { }
 
   enum { Queued, Running, Blocked, Finished } state;
 
+  thread_task_queue* queue; // the queue the task was added to, used to resume suspended tasks
+
   virtual void work() = 0;
 
   virtual std::string name() const { return "noname"; }
 };
 
 
+/* Owns task objects of a single type. Tasks handed out by get_task() stay
+   alive until the arena is destroyed. reset() makes all of them available
+   again at once, so that the same objects can be reused for the next picture
+   without going through new/delete for every task.
+ */
+template <class T> class task_arena
+{
+ public:
+  task_arena() : mUsed(0) { }
+  ~task_arena() {
+    for (size_t i=0;i<mTasks.size();i++) {
+      delete mTasks[i];
+    }
+  }
+
+  T* get_task() {
+    if (mUsed == mTasks.size()) {
+      mTasks.push_back(new T);
+    }
+
+    T* task = mTasks[mUsed++];
+    task->state = thread_task::Queued;
+    return task;
+  }
+
+  void reset() { mUsed=0; }
+
+  size_t num_tasks_in_use() const { return mUsed; }
+
+ private:
+  std::vector<T*> mTasks;
+  size_t mUsed;
+
+  task_arena(const task_arena&); // not allowed
+  const task_arena& operator=(const task_arena&); // not allowed
+};
+
+
 #define MAX_THREADS 32
 
 /* TODO NOTE: When unblocking a task, we have to check first
@@ -120,29 +182,78 @@ public:
    of the just unblocked task.
  */
 
+class thread_pool;
+
+
+/* Queue of pending tasks from one client (decoder) of a thread pool.
+   Several queues can be attached to the same pool. The pool always takes
+   the next task from the non-empty queue with the highest priority and
+   switches round-robin between queues of equal priority.
+ */
+class thread_task_queue
+{
+ public:
+  thread_task_queue() : pool(NULL), priority(0), num_running(0), detaching(false) { }
+
+  thread_pool* pool; // the pool this queue is attached to, or NULL
+
+  std::deque<thread_task*> tasks;  // we are not the owner
+
+  int priority; // higher values are served first
+
+  int  num_running; // tasks of this queue currently executed by a worker
+  bool detaching;   // no new tasks are accepted while waiting for the running ones
+};
+
+
 class thread_pool
 {
  public:
   bool stopped;
 
-  std::deque<thread_task*> tasks;  // we are not the owner
+  std::vector<thread_task_queue*> queues; // we are not the owner
+  int next_queue;  // round-robin start position for the next queue search
+  int num_tasks;   // total number of tasks in all queues
 
   de265_thread thread[MAX_THREADS];
   int num_threads;
 
   int num_threads_working;
 
+  bool release_when_detached; // the owner freed the pool while queues were still attached
+
   int ctbx[MAX_THREADS]; // the CTB the thread is working on
   int ctby[MAX_THREADS];
 
   de265_mutex  mutex;
   de265_cond   cond_var;
+  de265_cond   cond_task_finished; // signalled when the last running task of a detaching queue ends
 };
 
 
 de265_error start_thread_pool(thread_pool* pool, int num_threads);
 void        stop_thread_pool(thread_pool* pool); // do not process remaining tasks
 
-void        add_task(thread_pool* pool, thread_task* task); // TOCO: can make thread_task const
+/* Returns true if the pool can be stopped and freed right away. Otherwise, it is
+   marked for release and detach_task_queue() reports when the last queue is gone. */
+bool        release_thread_pool(thread_pool* pool);
+
+void        attach_task_queue(thread_pool* pool, thread_task_queue* queue);
+
+/* Remaining tasks are dropped. Tasks of this queue that are currently running are
+   waited for, so that their owner can be freed afterwards. Returns true if the pool
+   was released by its owner and this was the last attached queue. The caller then
+   has to stop and free the pool. */
+bool        detach_task_queue(thread_task_queue* queue);
+/* Drop the pending tasks and wait for the running ones. The queue stays attached. */
+void        flush_task_queue(thread_task_queue* queue);
+
+void        set_task_queue_priority(thread_task_queue* queue, int priority);
+
+void        add_task(thread_task_queue* queue, thread_task* task); // TOCO: can make thread_task const
+
+/* Put a suspended task back into its queue. It is inserted at the front, because
+   it is older than all other tasks in the queue. */
+void        resume_task(thread_task* task);
 
 #endif
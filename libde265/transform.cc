@@ -67,11 +67,20 @@ void decode_quantization_parameters(thread_context* tctx, int xC,int yC,
 
   int qPY_PRED;
 
-  // first QG in CTB row ?
+  // first QG in CTB row (of a tile) ?
 
   int ctbLSBMask = ((1<<sps.Log2CtbSizeY)-1);
   bool firstInCTBRow = (xQG == 0 && ((yQG & ctbLSBMask)==0));
 
+  if (pps.tiles_enabled_flag && pps.entropy_coding_sync_enabled_flag &&
+      (xQG & ctbLSBMask)==0 && (yQG & ctbLSBMask)==0) {
+    int ctbX = xQG >> sps.Log2CtbSizeY;
+    int ctbY = yQG >> sps.Log2CtbSizeY;
+    int tileX = pps.TileIdRS[ctbX + ctbY*sps.PicWidthInCtbsY] % pps.num_tile_columns;
+
+    firstInCTBRow = (ctbX == pps.colBd[tileX]);
+  }
+
   // first QG in slice ?    TODO: a "firstQG" flag in the thread context would be faster
 
   int first_ctb_in_slice_RS = tctx->shdr->SliceAddrRS;
@@ -211,10 +220,14 @@ void decode_quantization_parameters(thread_context* tctx, int xC,int yC,
 
 
 
+/* 'coeffExtent' is the bitwise OR of the x and y positions of all non-zero coefficients.
+   It is 0 if there is only a DC coefficient, <4 if all coefficients are within the top-left
+   4x4 block, and <8 if they are within the top-left 8x8 block.
+ */
 template <class pixel_t>
 void transform_coefficients(acceleration_functions* acceleration,
                             int16_t* coeff, int coeffStride, int nT, int trType,
-                            pixel_t* dst, int dstStride, int bit_depth)
+                            pixel_t* dst, int dstStride, int bit_depth, int coeffExtent)
 {
   logtrace(LogTransform,"transform --- trType: %d nT: %d\n",trType,nT);
 
@@ -225,10 +238,12 @@ void transform_coefficients(acceleration_functions* acceleration,
 
   } else {
 
-    /**/ if (nT==4)  { acceleration->transform_add<pixel_t>(0,dst,coeff,dstStride, bit_depth); }
-    else if (nT==8)  { acceleration->transform_add<pixel_t>(1,dst,coeff,dstStride, bit_depth); }
-    else if (nT==16) { acceleration->transform_add<pixel_t>(2,dst,coeff,dstStride, bit_depth); }
-    else             { acceleration->transform_add<pixel_t>(3,dst,coeff,dstStride, bit_depth); }
+    int sizeIdx = Log2(nT)-2;
+
+    /**/ if (coeffExtent==0) { acceleration->transform_dc_add<pixel_t>(sizeIdx,dst,coeff,dstStride, bit_depth); }
+    else if (coeffExtent<4)  { acceleration->transform_sparse_add<pixel_t>(sizeIdx,0,dst,coeff,dstStride, bit_depth); }
+    else if (coeffExtent<8)  { acceleration->transform_sparse_add<pixel_t>(sizeIdx,1,dst,coeff,dstStride, bit_depth); }
+    else                     { acceleration->transform_add<pixel_t>(sizeIdx,dst,coeff,dstStride, bit_depth); }
   }
 
 #if 0
@@ -241,30 +256,21 @@ void transform_coefficients(acceleration_functions* acceleration,
 }
 
 
-// TODO: make this an accelerated function
 void cross_comp_pred(const thread_context* tctx, int32_t* residual, int nT)
 {
   const int BitDepthC = tctx->img->get_sps().BitDepth_C;
   const int BitDepthY = tctx->img->get_sps().BitDepth_Y;
 
-  for (int y=0;y<nT;y++)
-    for (int x=0;x<nT;x++) {
-      /* TODO: the most usual case is definitely BitDepthY == BitDepthC, in which case
-         we could just omit two shifts. The second most common case is probably
-         BitDepthY>BitDepthC, for which we could also eliminate one shift. The remaining
-         case is also one shift only.
-      */
-
-      residual[y*nT+x] += (tctx->ResScaleVal *
-                           ((tctx->residual_luma[y*nT+x] << BitDepthC ) >> BitDepthY ) ) >> 3;
-    }
+  tctx->decctx->acceleration.cross_comp_pred(residual, tctx->residual_luma, nT,
+                                             tctx->ResScaleVal, BitDepthC, BitDepthY);
 }
 
 
 template <class pixel_t>
 void transform_coefficients_explicit(thread_context* tctx,
                                      int16_t* coeff, int coeffStride, int nT, int trType,
-                                     pixel_t* dst, int dstStride, int bit_depth, int cIdx)
+                                     pixel_t* dst, int dstStride, int bit_depth, int cIdx,
+                                     int coeffExtent)
 {
   logtrace(LogTransform,"transform --- trType: %d nT: %d\n",trType,nT);
 
@@ -288,6 +294,20 @@ void transform_coefficients_explicit(thread_context* tctx,
 
     acceleration->transform_idst_4x4(residual, coeff, bdShift, max_coeff_bits);
 
+  } else if (coeffExtent==0) {
+
+    // DC only: all residual values are equal
+
+    int CoeffMax = (1<<max_coeff_bits)-1;
+    int CoeffMin = -(1<<max_coeff_bits);
+
+    int g = Clip3(CoeffMin,CoeffMax, (64*coeff[0] + (1<<6))>>7);
+    int r = (64*g + (1<<(bdShift-1)))>>bdShift;
+
+    for (int i=0;i<nT*nT;i++) {
+      residual[i] = r;
+    }
+
   } else {
 
     /**/ if (nT==4)  { acceleration->transform_idct_4x4(residual,coeff,bdShift,max_coeff_bits); }
@@ -358,14 +378,14 @@ void fwd_transform(acceleration_functions* acceleration,
 
 static const int levelScale[] = { 40,45,51,57,64,72 };
 
-// (8.6.2) and (8.6.3)
-template <class pixel_t>
-void scale_coefficients_internal(thread_context* tctx,
-                                 int xT,int yT, // position of TU in frame (chroma adapted)
-                                 int x0,int y0, // position of CU in frame (chroma adapted)
-                                 int nT, int cIdx,
-                                 bool transform_skip_flag, bool intra, int rdpcmMode)
+
+void coefficient_scaling::init(const thread_context* tctx, int cIdx, int log2TrafoSize, bool intra)
 {
+  if (tctx->cu_transquant_bypass_flag) {
+    mode = Bypass;
+    return;
+  }
+
   const seq_parameter_set& sps = tctx->img->get_sps();
   const pic_parameter_set& pps = tctx->img->get_pps();
 
@@ -379,6 +399,47 @@ void scale_coefficients_internal(thread_context* tctx,
 
   logtrace(LogTransform,"qP: %d\n",qP);
 
+  int bdShift = (cIdx==0 ? sps.BitDepth_Y : sps.BitDepth_C) + log2TrafoSize - 5;
+
+  fact = levelScale[qP%6] << (qP/6);
+
+  if (sps.scaling_list_enable_flag==0) {
+    mode = Flat;
+    bdShift -= 4;  // this is equivalent to having a m_x_y of 16 and we can use 32bit integers
+  }
+  else {
+    mode = ScalingList;
+
+    int nT = 1<<log2TrafoSize;
+
+    int matrixID = cIdx;
+    if (!intra) {
+      if (nT<32) { matrixID += 3; }
+      else { matrixID++; }
+    }
+
+    switch (nT) {
+    case  4: sclist = &pps.scaling_list.ScalingFactor_Size0[matrixID][0][0]; break;
+    case  8: sclist = &pps.scaling_list.ScalingFactor_Size1[matrixID][0][0]; break;
+    case 16: sclist = &pps.scaling_list.ScalingFactor_Size2[matrixID][0][0]; break;
+    case 32: sclist = &pps.scaling_list.ScalingFactor_Size3[matrixID][0][0]; break;
+    default: assert(0);
+    }
+  }
+
+  shift  = bdShift;
+  offset = 1<<(bdShift-1);
+}
+
+
+// (8.6.2) and (8.6.3)
+template <class pixel_t>
+void scale_coefficients_internal(thread_context* tctx,
+                                 int xT,int yT, // position of TU in frame (chroma adapted)
+                                 int nT, int cIdx,
+                                 bool transform_skip_flag, int rdpcmMode)
+{
+  const seq_parameter_set& sps = tctx->img->get_sps();
 
   int16_t* coeff;
   int      coeffStride;
@@ -399,7 +460,6 @@ void scale_coefficients_internal(thread_context* tctx,
   // can optimize away a lot of code for 8-bit pixels.
   const int bit_depth = ((sizeof(pixel_t)==1) ? 8 : sps.get_bit_depth(cIdx));
 
-  //assert(intra == (tctx->img->get_pred_mode(xT,yT)==MODE_INTRA));
   int cuPredModeIntra = (tctx->img->get_pred_mode(xT,yT)==MODE_INTRA);
 
   bool rotateCoeffs = (sps.range_extension.transform_skip_rotation_enabled_flag &&
@@ -415,12 +475,6 @@ void scale_coefficients_internal(thread_context* tctx,
     else         residual = residual_buffer;
 
 
-    // TODO: we could fold the coefficient rotation into the coefficient expansion here:
-    for (int i=0;i<tctx->nCoeff[cIdx];i++) {
-      int32_t currCoeff = tctx->coeffList[cIdx][i];
-      tctx->coeffBuf[ tctx->coeffPos[cIdx][i] ] = currCoeff;
-    }
-
     if (rotateCoeffs) {
       tctx->decctx->acceleration.rotate_coefficients(coeff, nT);
     }
@@ -450,74 +504,9 @@ void scale_coefficients_internal(thread_context* tctx,
   else {
     // (8.6.3)
 
-    int bdShift = (cIdx==0 ? sps.BitDepth_Y : sps.BitDepth_C) + Log2(nT) - 5;
-
-    logtrace(LogTransform,"bdShift=%d\n",bdShift);
-
-    logtrace(LogTransform,"dequant %d;%d cIdx=%d qp=%d\n",xT*(cIdx?2:1),yT*(cIdx?2:1),cIdx,qP);
-
+    // The coefficients have already been scaled (8.6.3) in residual_coding().
 
-    // --- inverse quantization ---
-
-    if (sps.scaling_list_enable_flag==0) {
-
-      //const int m_x_y = 16;
-      const int m_x_y = 1;
-      bdShift -= 4;  // this is equivalent to having a m_x_y of 16 and we can use 32bit integers
-
-      const int offset = (1<<(bdShift-1));
-      const int fact = m_x_y * levelScale[qP%6] << (qP/6);
-
-      for (int i=0;i<tctx->nCoeff[cIdx];i++) {
-
-        // usually, this needs to be 64bit, but because we modify the shift above, we can use 16 bit
-        int32_t currCoeff  = tctx->coeffList[cIdx][i];
-
-        //logtrace(LogTransform,"coefficient[%d] = %d\n",tctx->coeffPos[cIdx][i],
-        //tctx->coeffList[cIdx][i]);
-
-        currCoeff = Clip3(-32768,32767,
-                          ( (currCoeff * fact + offset ) >> bdShift));
-
-        //logtrace(LogTransform," -> %d\n",currCoeff);
-
-        tctx->coeffBuf[ tctx->coeffPos[cIdx][i] ] = currCoeff;
-      }
-    }
-    else {
-      const int offset = (1<<(bdShift-1));
-
-      const uint8_t* sclist;
-      int matrixID = cIdx;
-      if (!intra) {
-        if (nT<32) { matrixID += 3; }
-        else { matrixID++; }
-      }
-
-      switch (nT) {
-      case  4: sclist = &pps.scaling_list.ScalingFactor_Size0[matrixID][0][0]; break;
-      case  8: sclist = &pps.scaling_list.ScalingFactor_Size1[matrixID][0][0]; break;
-      case 16: sclist = &pps.scaling_list.ScalingFactor_Size2[matrixID][0][0]; break;
-      case 32: sclist = &pps.scaling_list.ScalingFactor_Size3[matrixID][0][0]; break;
-      default: assert(0);
-      }
-
-      for (int i=0;i<tctx->nCoeff[cIdx];i++) {
-        int pos = tctx->coeffPos[cIdx][i];
-        int x = pos%nT;
-        int y = pos/nT;
-
-        const int m_x_y = sclist[x+y*nT];
-        const int fact = m_x_y * levelScale[qP%6] << (qP/6);
-
-        int64_t currCoeff  = tctx->coeffList[cIdx][i];
-
-        currCoeff = Clip3(-32768,32767,
-                          ( (currCoeff * fact + offset ) >> bdShift));
-
-        tctx->coeffBuf[ tctx->coeffPos[cIdx][i] ] = currCoeff;
-      }
-    }
+    const int coeffExtent = tctx->coeffExtent;
 
 
     // --- do transform or skip ---
@@ -605,11 +594,11 @@ void scale_coefficients_internal(thread_context* tctx,
         // cross-component-prediction: transform to residual buffer and add in a separate step
 
         transform_coefficients_explicit(tctx, coeff, coeffStride, nT, trType,
-                                        pred, stride, bit_depth, cIdx);
+                                        pred, stride, bit_depth, cIdx, coeffExtent);
       }
       else {
         transform_coefficients(&tctx->decctx->acceleration, coeff, coeffStride, nT, trType,
-                               pred, stride, bit_depth);
+                               pred, stride, bit_depth, coeffExtent);
       }
     }
   }
@@ -627,28 +616,37 @@ void scale_coefficients_internal(thread_context* tctx,
     logtrace(LogTransform,"*\n");
   }
 
-  // zero out scrap coefficient buffer again
+  // zero out scrap coefficient buffer again (only the coded 4x4 sub-blocks contain coefficients)
 
-  for (int i=0;i<tctx->nCoeff[cIdx];i++) {
-    tctx->coeffBuf[ tctx->coeffPos[cIdx][i] ] = 0;
+  for (int i=0;i<tctx->nCodedSubBlocks;i++) {
+    int16_t* sb = coeff + tctx->codedSubBlockPos[i];
+    for (int y=0;y<4;y++) {
+      memset(sb + y*coeffStride, 0, 4*sizeof(int16_t));
+    }
   }
 }
 
+template
+void scale_coefficients_internal<uint8_t>(thread_context* tctx,
+                                          int xT,int yT, int nT, int cIdx,
+                                          bool transform_skip_flag, int rdpcmMode);
+template
+void scale_coefficients_internal<uint16_t>(thread_context* tctx,
+                                           int xT,int yT, int nT, int cIdx,
+                                           bool transform_skip_flag, int rdpcmMode);
+
 
 void scale_coefficients(thread_context* tctx,
                         int xT,int yT, // position of TU in frame (chroma adapted)
-                        int x0,int y0, // position of CU in frame (chroma adapted)
                         int nT, int cIdx,
-                        bool transform_skip_flag, bool intra,
+                        bool transform_skip_flag,
                         int rdpcmMode // 0 - off, 1 - Horizontal, 2 - Vertical
                         )
 {
   if (tctx->img->high_bit_depth(cIdx)) {
-    scale_coefficients_internal<uint16_t>(tctx, xT,yT, x0,y0, nT,cIdx, transform_skip_flag, intra,
-                                          rdpcmMode);
+    scale_coefficients_internal<uint16_t>(tctx, xT,yT, nT,cIdx, transform_skip_flag, rdpcmMode);
   } else {
-    scale_coefficients_internal<uint8_t> (tctx, xT,yT, x0,y0, nT,cIdx, transform_skip_flag, intra,
-                                          rdpcmMode);
+    scale_coefficients_internal<uint8_t> (tctx, xT,yT, nT,cIdx, transform_skip_flag, rdpcmMode);
   }
 }
 
@@ -663,11 +661,11 @@ const static uint16_t g_quantScales[6] = {
   26214,23302,20560,18396,16384,14564
 };
 
-void quant_coefficients(//encoder_context* ectx,
-                        int16_t* out_coeff,
-                        const int16_t* in_coeff,
-                        int log2TrSize, int qp,
-                        bool intra)
+int quant_coefficients(acceleration_functions* acceleration,
+                       int16_t* out_coeff,
+                       const int16_t* in_coeff,
+                       int log2TrSize, int qp,
+                       bool intra)
 {
   const int qpDiv6 = qp / 6;
   const int qpMod6 = qp % 6;
@@ -683,27 +681,8 @@ void quant_coefficients(//encoder_context* ectx,
    */
   int rnd = (intra ? 171 : 85) << (qBits-9);
 
-  int x, y;
-  int uiAcSum = 0;
-
-  int nStride = (1<<log2TrSize);
-
-  for (y=0; y < (1<<log2TrSize) ; y++) {
-    for (x=0; x < (1<<log2TrSize) ; x++) {
-      int level;
-      int sign;
-      int blockPos = y * nStride + x;
-      level  = in_coeff[blockPos];
-      //logtrace(LogTransform,"(%d,%d) %d -> ", x,y,level);
-      sign   = (level < 0 ? -1: 1);
-
-      level = (abs_value(level) * uiQ + rnd ) >> qBits;
-      uiAcSum += level;
-      level *= sign;
-      out_coeff[blockPos] = Clip3(-32768, 32767, level);
-      //logtrace(LogTransform,"%d\n", out_coeff[blockPos]);
-    }
-  }
+  return acceleration->quant_coefficients(out_coeff, in_coeff, 1<<(log2TrSize<<1),
+                                          uiQ, rnd, qBits);
 }
 
 
@@ -37,12 +37,51 @@ LIBDE265_INLINE static int table8_22(int qPi)
 void decode_quantization_parameters(thread_context* tctx, int xC,int yC,
                                     int xCUBase, int yCUBase);
 
+/* Scaling of the transform coefficient levels (8.6.3). This is applied in residual_coding()
+   when each coefficient is decoded, such that only the non-zero coefficients are touched.
+ */
+class coefficient_scaling
+{
+ public:
+  void init(const thread_context* tctx, int cIdx, int log2TrafoSize, bool intra);
+
+  // 'pos' is the position in the coefficient block (x + y*nT)
+  LIBDE265_INLINE int16_t scale(int32_t level, int pos) const {
+    switch (mode) {
+    case Flat:
+      // usually, this needs to be 64bit, but because we reduced the shift by 4, we can use 32 bit
+      return Clip3(-32768,32767, (level * fact + offset) >> shift);
+
+    case ScalingList:
+      return Clip3(-32768,32767, ((int64_t)level * (sclist[pos] * fact) + offset) >> shift);
+
+    default:
+      return level; // cu_transquant_bypass
+    }
+  }
+
+ private:
+  enum { Bypass, Flat, ScalingList } mode;
+
+  int fact;   // levelScale[qP%6] << (qP/6)  (times m=16 for flat scaling, folded into 'shift')
+  int offset;
+  int shift;
+  const uint8_t* sclist;
+};
+
+
 // (8.6.2)
 void scale_coefficients(thread_context* tctx,
                         int xT,int yT, // position of TU in frame (chroma adapted)
-                        int x0,int y0, // position of CU in frame (chroma adapted)
                         int nT, int cIdx,
-                        bool transform_skip_flag, bool intra, int rdpcmMode);
+                        bool transform_skip_flag, int rdpcmMode);
+
+// Same as above, but with the pixel type known by the caller.
+template <class pixel_t>
+void scale_coefficients_internal(thread_context* tctx,
+                                 int xT,int yT,
+                                 int nT, int cIdx,
+                                 bool transform_skip_flag, int rdpcmMode);
 
 
 void inv_transform(acceleration_functions* acceleration,
@@ -53,10 +92,12 @@ void fwd_transform(acceleration_functions* acceleration,
                    int16_t* coeff, int coeffStride, int log2TbSize, int trType,
                    const int16_t* src, int srcStride);
 
-void quant_coefficients(int16_t* out_coeff,
-                        const int16_t* in_coeff,
-                        int log2TrSize, int qp,
-                        bool intra);
+// returns the number of non-zero coefficients
+int quant_coefficients(acceleration_functions* acceleration,
+                       int16_t* out_coeff,
+                       const int16_t* in_coeff,
+                       int log2TrSize, int qp,
+                       bool intra);
 
 void dequant_coefficients(int16_t* out_coeff,
                           const int16_t* in_coeff,
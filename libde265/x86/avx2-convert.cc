@@ -0,0 +1,109 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2013-2014 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "x86/avx2-convert.h"
+#include "x86/sse-convert.h"
+#include "libde265/fallback-convert.h"
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <immintrin.h>
+
+
+void reduce_bit_depth_row_avx2(uint8_t* dst, const uint16_t* src, int width, int bit_depth,
+                               const uint16_t* dither)
+{
+  const __m256i d     = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)dither));
+  const __m128i shift = _mm_cvtsi32_si128(bit_depth-8);
+
+  int x=0;
+  for (;x+32<=width;x+=32) {
+    __m256i v0 = _mm256_adds_epu16(_mm256_loadu_si256((const __m256i*)(src+x   )), d);
+    __m256i v1 = _mm256_adds_epu16(_mm256_loadu_si256((const __m256i*)(src+x+16)), d);
+
+    v0 = _mm256_srl_epi16(v0, shift);
+    v1 = _mm256_srl_epi16(v1, shift);
+
+    // packus works within the 128 bit lanes -> reorder the 64 bit blocks
+    __m256i p = _mm256_permute4x64_epi64(_mm256_packus_epi16(v0,v1), 0xD8);
+    _mm256_storeu_si256((__m256i*)(dst+x), p);
+  }
+
+  reduce_bit_depth_row_sse4(dst+x, src+x, width-x, bit_depth, dither);
+}
+
+
+/* Same computation as yuv_to_rgba_row_sse4(), for 16 pixels at once. The unpack and pack
+   operations work within the 128 bit lanes, such that the intermediate results stay in
+   pixel order except for the final interleaving.
+ */
+void yuv_to_rgba_row_avx2(uint8_t* dst, const uint8_t* y,
+                          const uint8_t* cb, const uint8_t* cr, int width,
+                          const int16_t* m)
+{
+  const __m256i yoffset = _mm256_set1_epi16(m[YUV2RGB_YOFFSET]);
+  const __m256i c128    = _mm256_set1_epi16(128);
+  const __m256i one     = _mm256_set1_epi16(1);
+  const __m256i alpha   = _mm256_set1_epi16(255);
+
+  const __m256i cY = _mm256_set1_epi32((128<<16) | (uint16_t)m[YUV2RGB_Y]);
+  const __m256i cR = _mm256_set1_epi32(((uint32_t)(uint16_t)m[YUV2RGB_CR_R]<<16));
+  const __m256i cG = _mm256_set1_epi32(((uint32_t)(uint16_t)m[YUV2RGB_CR_G]<<16) |
+                                       (uint16_t)m[YUV2RGB_CB_G]);
+  const __m256i cB = _mm256_set1_epi32((uint16_t)m[YUV2RGB_CB_B]);
+
+  int x=0;
+  for (;x+16<=width;x+=16) {
+    __m256i yv = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(y+x))),
+                                  yoffset);
+
+    __m128i u8 = _mm_loadl_epi64((const __m128i*)(cb+x/2));
+    __m128i v8 = _mm_loadl_epi64((const __m128i*)(cr+x/2));
+    __m256i u = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_unpacklo_epi8(u8,u8)), c128);
+    __m256i v = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_unpacklo_epi8(v8,v8)), c128);
+
+    __m256i ylo = _mm256_madd_epi16(_mm256_unpacklo_epi16(yv,one), cY);
+    __m256i yhi = _mm256_madd_epi16(_mm256_unpackhi_epi16(yv,one), cY);
+    __m256i clo = _mm256_unpacklo_epi16(u,v);
+    __m256i chi = _mm256_unpackhi_epi16(u,v);
+
+    __m256i r = _mm256_packs_epi32(_mm256_srai_epi32(_mm256_add_epi32(ylo, _mm256_madd_epi16(clo,cR)), 8),
+                                   _mm256_srai_epi32(_mm256_add_epi32(yhi, _mm256_madd_epi16(chi,cR)), 8));
+    __m256i g = _mm256_packs_epi32(_mm256_srai_epi32(_mm256_add_epi32(ylo, _mm256_madd_epi16(clo,cG)), 8),
+                                   _mm256_srai_epi32(_mm256_add_epi32(yhi, _mm256_madd_epi16(chi,cG)), 8));
+    __m256i b = _mm256_packs_epi32(_mm256_srai_epi32(_mm256_add_epi32(ylo, _mm256_madd_epi16(clo,cB)), 8),
+                                   _mm256_srai_epi32(_mm256_add_epi32(yhi, _mm256_madd_epi16(chi,cB)), 8));
+
+    __m256i rg = _mm256_packus_epi16(r,g);
+    __m256i ba = _mm256_packus_epi16(b,alpha);
+    rg = _mm256_unpacklo_epi8(rg, _mm256_srli_si256(rg,8));
+    ba = _mm256_unpacklo_epi8(ba, _mm256_srli_si256(ba,8));
+
+    __m256i lo = _mm256_unpacklo_epi16(rg,ba);  // pixels 0-3 | 8-11
+    __m256i hi = _mm256_unpackhi_epi16(rg,ba);  // pixels 4-7 | 12-15
+
+    _mm256_storeu_si256((__m256i*)(dst+4*x   ), _mm256_permute2x128_si256(lo,hi, 0x20));
+    _mm256_storeu_si256((__m256i*)(dst+4*x+32), _mm256_permute2x128_si256(lo,hi, 0x31));
+  }
+
+  yuv_to_rgba_row_sse4(dst+4*x, y+x, cb+x/2, cr+x/2, width-x, m);
+}
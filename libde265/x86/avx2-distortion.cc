@@ -0,0 +1,179 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2013-2014 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "x86/avx2-distortion.h"
+#include "x86/sse-distortion.h"
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <immintrin.h>
+
+
+// Only blocks with a width that is a multiple of 32 profit from AVX2.
+// All others are passed on to the SSE4 functions.
+
+uint32_t sad_8_avx2(const uint8_t* img, ptrdiff_t imgStride,
+                    const uint8_t* ref, ptrdiff_t refStride, int width, int height)
+{
+  if (width & 31) {
+    return sad_8_sse4(img,imgStride, ref,refStride, width,height);
+  }
+
+  __m256i sum = _mm256_setzero_si256();
+
+  for (int y=0;y<height;y++) {
+    for (int x=0; x<width; x+=32) {
+      __m256i a = _mm256_loadu_si256((const __m256i*)(img+x));
+      __m256i b = _mm256_loadu_si256((const __m256i*)(ref+x));
+      sum = _mm256_add_epi32(sum, _mm256_sad_epu8(a,b));
+    }
+
+    img += imgStride;
+    ref += refStride;
+  }
+
+  __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum),
+                            _mm256_extracti128_si256(sum,1));
+  s = _mm_add_epi32(s, _mm_srli_si128(s,8));
+
+  return _mm_cvtsi128_si32(s);
+}
+
+
+uint32_t ssd_8_avx2(const uint8_t* img, ptrdiff_t imgStride,
+                    const uint8_t* ref, ptrdiff_t refStride, int width, int height)
+{
+  if (width & 31) {
+    return ssd_8_sse4(img,imgStride, ref,refStride, width,height);
+  }
+
+  __m256i sum = _mm256_setzero_si256();
+
+  for (int y=0;y<height;y++) {
+    for (int x=0; x<width; x+=16) {
+      __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(img+x)));
+      __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(ref+x)));
+      __m256i d = _mm256_sub_epi16(a,b);
+
+      sum = _mm256_add_epi32(sum, _mm256_madd_epi16(d,d));
+    }
+
+    img += imgStride;
+    ref += refStride;
+  }
+
+  __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum),
+                            _mm256_extracti128_si256(sum,1));
+  s = _mm_add_epi32(s, _mm_srli_si128(s,8));
+  s = _mm_add_epi32(s, _mm_srli_si128(s,4));
+
+  return _mm_cvtsi128_si32(s);
+}
+
+
+// Horizontal 8-point Hadamard transform of all rows in the register.
+// In each butterfly, the upper element receives the (negated) difference. The sign does
+// not matter, because the following stages only combine elements of equal sign and the
+// SATD sums up absolute values.
+
+static inline __m256i hadamard_8_rows(__m256i v)
+{
+  const __m256i swap_epi16 = _mm256_setr_epi8(2,3,0,1, 6,7,4,5, 10,11,8,9, 14,15,12,13,
+                                              2,3,0,1, 6,7,4,5, 10,11,8,9, 14,15,12,13);
+  __m256i s;
+
+  // distance 4
+  s = _mm256_shuffle_epi32(v, 0x4E);
+  v = _mm256_blend_epi32(_mm256_add_epi16(v,s), _mm256_sub_epi16(s,v), 0xCC);
+
+  // distance 2
+  s = _mm256_shuffle_epi32(v, 0xB1);
+  v = _mm256_blend_epi32(_mm256_add_epi16(v,s), _mm256_sub_epi16(s,v), 0xAA);
+
+  // distance 1
+  s = _mm256_shuffle_epi8(v, swap_epi16);
+  v = _mm256_blend_epi16(_mm256_add_epi16(v,s), _mm256_sub_epi16(s,v), 0xAA);
+
+  return v;
+}
+
+
+static inline void butterfly(__m256i& a, __m256i& b)
+{
+  __m256i t = a;
+  a = _mm256_add_epi16(t,b);
+  b = _mm256_sub_epi16(t,b);
+}
+
+
+/* Rows y and y+4 of the 8x8 block share one register (lower and upper lane). The
+   column transform needs one butterfly across the lanes and then works on both lanes
+   in parallel. The row transform is done within the registers, without a transpose.
+ */
+uint32_t satd_8x8_8_avx2(const uint8_t* img, ptrdiff_t imgStride,
+                         const uint8_t* ref, ptrdiff_t refStride)
+{
+  __m256i r[4];
+
+  for (int y=0;y<4;y++) {
+    __m128i a = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)(img+ y   *imgStride)),
+                                   _mm_loadl_epi64((const __m128i*)(img+(y+4)*imgStride)));
+    __m128i b = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)(ref+ y   *refStride)),
+                                   _mm_loadl_epi64((const __m128i*)(ref+(y+4)*refStride)));
+
+    // 8 bit -> 16 bit: rows y in the lower lane, rows y+4 in the upper lane
+    r[y] = _mm256_sub_epi16(_mm256_cvtepu8_epi16(a), _mm256_cvtepu8_epi16(b));
+  }
+
+  // column transform, first stage (rows y and y+4): the upper lane gets the negated difference
+
+  for (int y=0;y<4;y++) {
+    __m256i swapped = _mm256_permute2x128_si256(r[y],r[y], 0x01);
+    r[y] = _mm256_blend_epi32(_mm256_add_epi16(r[y],swapped),
+                              _mm256_sub_epi16(swapped,r[y]), 0xF0);
+  }
+
+  // remaining column stages, within the lanes
+
+  butterfly(r[0],r[2]);
+  butterfly(r[1],r[3]);
+  butterfly(r[0],r[1]);
+  butterfly(r[2],r[3]);
+
+  // row transforms and sum of absolute values
+  // The coefficients stay below 64*255 and therefore fit into 16 bit.
+
+  const __m256i ones = _mm256_set1_epi16(1);
+
+  __m256i sum = _mm256_setzero_si256();
+  for (int y=0;y<4;y++) {
+    __m256i c = _mm256_abs_epi16(hadamard_8_rows(r[y]));
+    sum = _mm256_add_epi32(sum, _mm256_madd_epi16(c, ones));
+  }
+
+  __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum),
+                            _mm256_extracti128_si256(sum,1));
+  s = _mm_add_epi32(s, _mm_srli_si128(s,8));
+  s = _mm_add_epi32(s, _mm_srli_si128(s,4));
+
+  return _mm_cvtsi128_si32(s);
+}
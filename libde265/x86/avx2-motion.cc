@@ -0,0 +1,198 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2013-2014 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "x86/avx2-motion.h"
+#include "x86/sse-motion.h"
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <immintrin.h>
+
+
+// Blocks with a width that is not a multiple of 16 are passed on to the SSE4 functions.
+// The arithmetic is the same as in the SSE4 code (see there).
+
+static inline void store_pred_samples(uint8_t* dst, __m256i v, __m256i maxval)
+{
+  // packing works within each 128 bit lane -> move the two 64 bit results together
+  v = _mm256_permute4x64_epi64(_mm256_packus_epi16(v,v), 0xD8);
+  _mm_storeu_si128((__m128i*)dst, _mm256_castsi256_si128(v));
+}
+
+static inline void store_pred_samples(uint16_t* dst, __m256i v, __m256i maxval)
+{
+  v = _mm256_min_epi16(_mm256_max_epi16(v, _mm256_setzero_si256()), maxval);
+  _mm256_storeu_si256((__m256i*)dst, v);
+}
+
+
+template <class pixel_t>
+static void put_weighted_pred_avx2(pixel_t *dst, ptrdiff_t dststride,
+                                   const int16_t *src, ptrdiff_t srcstride,
+                                   int width, int height,
+                                   int w,int o,int log2WD, int bit_depth)
+{
+  const int rnd = (log2WD>0 ? 1<<(log2WD-1) : 0);
+
+  const __m256i one    = _mm256_set1_epi16(1);
+  const __m256i w_rnd  = _mm256_set1_epi32((rnd<<16) | (w & 0xFFFF));
+  const __m128i shift  = _mm_cvtsi32_si128(log2WD);
+  const __m256i offset = _mm256_set1_epi32(o);
+  const __m256i maxval = _mm256_set1_epi16((1<<bit_depth)-1);
+
+  for (int y=0;y<height;y++) {
+    for (int x=0;x<width;x+=16) {
+      __m256i in = _mm256_loadu_si256((const __m256i*)(src+x));
+
+      __m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi16(in, one), w_rnd);
+      __m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi16(in, one), w_rnd);
+
+      lo = _mm256_add_epi32(_mm256_sra_epi32(lo, shift), offset);
+      hi = _mm256_add_epi32(_mm256_sra_epi32(hi, shift), offset);
+
+      store_pred_samples(dst+x, _mm256_packs_epi32(lo, hi), maxval);
+    }
+
+    dst += dststride;
+    src += srcstride;
+  }
+}
+
+
+template <class pixel_t>
+static void put_weighted_bipred_avx2(pixel_t *dst, ptrdiff_t dststride,
+                                     const int16_t *src1, const int16_t *src2,
+                                     ptrdiff_t srcstride,
+                                     int width, int height,
+                                     int w1,int w2, int rnd, int shift, int bit_depth)
+{
+  const __m256i w1_w2    = _mm256_set1_epi32((int)(((uint32_t)w2<<16) | (w1 & 0xFFFF)));
+  const __m256i rounding = _mm256_set1_epi32(rnd);
+  const __m128i shiftv   = _mm_cvtsi32_si128(shift);
+  const __m256i maxval   = _mm256_set1_epi16((1<<bit_depth)-1);
+
+  for (int y=0;y<height;y++) {
+    for (int x=0;x<width;x+=16) {
+      __m256i in1 = _mm256_loadu_si256((const __m256i*)(src1+x));
+      __m256i in2 = _mm256_loadu_si256((const __m256i*)(src2+x));
+
+      __m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi16(in1, in2), w1_w2);
+      __m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi16(in1, in2), w1_w2);
+
+      lo = _mm256_sra_epi32(_mm256_add_epi32(lo, rounding), shiftv);
+      hi = _mm256_sra_epi32(_mm256_add_epi32(hi, rounding), shiftv);
+
+      store_pred_samples(dst+x, _mm256_packs_epi32(lo, hi), maxval);
+    }
+
+    dst  += dststride;
+    src1 += srcstride;
+    src2 += srcstride;
+  }
+}
+
+
+void put_weighted_pred_8_avx2(uint8_t *dst, ptrdiff_t dststride,
+                              const int16_t *src, ptrdiff_t srcstride,
+                              int width, int height,
+                              int w,int o,int log2WD)
+{
+  if (width & 15) {
+    put_weighted_pred_8_sse4(dst,dststride, src,srcstride, width,height, w,o,log2WD);
+    return;
+  }
+
+  put_weighted_pred_avx2(dst,dststride, src,srcstride, width,height, w,o,log2WD, 8);
+}
+
+void put_weighted_bipred_8_avx2(uint8_t *dst, ptrdiff_t dststride,
+                                const int16_t *src1, const int16_t *src2, ptrdiff_t srcstride,
+                                int width, int height,
+                                int w1,int o1, int w2,int o2, int log2WD)
+{
+  if (width & 15) {
+    put_weighted_bipred_8_sse4(dst,dststride, src1,src2,srcstride, width,height,
+                               w1,o1,w2,o2,log2WD);
+    return;
+  }
+
+  put_weighted_bipred_avx2(dst,dststride, src1,src2,srcstride, width,height,
+                           w1,w2, (o1+o2+1) << log2WD, log2WD+1, 8);
+}
+
+void put_unweighted_pred_16_avx2(uint16_t *dst, ptrdiff_t dststride,
+                                 const int16_t *src, ptrdiff_t srcstride,
+                                 int width, int height, int bit_depth)
+{
+  if (width & 15) {
+    put_unweighted_pred_16_sse4(dst,dststride, src,srcstride, width,height, bit_depth);
+    return;
+  }
+
+  put_weighted_pred_avx2(dst,dststride, src,srcstride, width,height,
+                         1,0, 14-bit_depth, bit_depth);
+}
+
+void put_weighted_pred_avg_16_avx2(uint16_t *dst, ptrdiff_t dststride,
+                                   const int16_t *src1, const int16_t *src2,
+                                   ptrdiff_t srcstride, int width,
+                                   int height, int bit_depth)
+{
+  if (width & 15) {
+    put_weighted_pred_avg_16_sse4(dst,dststride, src1,src2,srcstride, width,height, bit_depth);
+    return;
+  }
+
+  int shift2 = 15-bit_depth;
+
+  put_weighted_bipred_avx2(dst,dststride, src1,src2,srcstride, width,height,
+                           1,1, 1<<(shift2-1), shift2, bit_depth);
+}
+
+void put_weighted_pred_16_avx2(uint16_t *dst, ptrdiff_t dststride,
+                               const int16_t *src, ptrdiff_t srcstride,
+                               int width, int height,
+                               int w,int o,int log2WD, int bit_depth)
+{
+  if (width & 15) {
+    put_weighted_pred_16_sse4(dst,dststride, src,srcstride, width,height,
+                              w,o,log2WD, bit_depth);
+    return;
+  }
+
+  put_weighted_pred_avx2(dst,dststride, src,srcstride, width,height, w,o,log2WD, bit_depth);
+}
+
+void put_weighted_bipred_16_avx2(uint16_t *dst, ptrdiff_t dststride,
+                                 const int16_t *src1, const int16_t *src2, ptrdiff_t srcstride,
+                                 int width, int height,
+                                 int w1,int o1, int w2,int o2, int log2WD, int bit_depth)
+{
+  if (width & 15) {
+    put_weighted_bipred_16_sse4(dst,dststride, src1,src2,srcstride, width,height,
+                                w1,o1,w2,o2,log2WD, bit_depth);
+    return;
+  }
+
+  put_weighted_bipred_avx2(dst,dststride, src1,src2,srcstride, width,height,
+                           w1,w2, (o1+o2+1) << log2WD, log2WD+1, bit_depth);
+}
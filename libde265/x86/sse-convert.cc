@@ -0,0 +1,158 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2013-2014 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "x86/sse-convert.h"
+#include "libde265/fallback-convert.h"
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <emmintrin.h>
+#include <smmintrin.h>
+
+
+/* All functions process the bulk of the row with SIMD and leave the remaining
+   pixels at the right border to the scalar code.
+ */
+
+void reduce_bit_depth_row_sse4(uint8_t* dst, const uint16_t* src, int width, int bit_depth,
+                               const uint16_t* dither)
+{
+  const __m128i d     = _mm_loadu_si128((const __m128i*)dither);
+  const __m128i shift = _mm_cvtsi32_si128(bit_depth-8);
+
+  int x=0;
+  for (;x+16<=width;x+=16) {
+    __m128i v0 = _mm_adds_epu16(_mm_loadu_si128((const __m128i*)(src+x  )), d);
+    __m128i v1 = _mm_adds_epu16(_mm_loadu_si128((const __m128i*)(src+x+8)), d);
+
+    v0 = _mm_srl_epi16(v0, shift);
+    v1 = _mm_srl_epi16(v1, shift);
+
+    _mm_storeu_si128((__m128i*)(dst+x), _mm_packus_epi16(v0,v1));
+  }
+
+  reduce_bit_depth_row_fallback(dst+x, src+x, width-x, bit_depth, dither);
+}
+
+
+void interleave_chroma_row_8_sse4(uint8_t* dst, const uint8_t* cb, const uint8_t* cr,
+                                  int width)
+{
+  int x=0;
+  for (;x+16<=width;x+=16) {
+    __m128i u = _mm_loadu_si128((const __m128i*)(cb+x));
+    __m128i v = _mm_loadu_si128((const __m128i*)(cr+x));
+
+    _mm_storeu_si128((__m128i*)(dst+2*x   ), _mm_unpacklo_epi8(u,v));
+    _mm_storeu_si128((__m128i*)(dst+2*x+16), _mm_unpackhi_epi8(u,v));
+  }
+
+  interleave_chroma_row_8_fallback(dst+2*x, cb+x, cr+x, width-x);
+}
+
+
+void interleave_chroma_row_16_sse4(uint16_t* dst, const uint16_t* cb, const uint16_t* cr,
+                                   int width, int shift)
+{
+  const __m128i s = _mm_cvtsi32_si128(shift);
+
+  int x=0;
+  for (;x+8<=width;x+=8) {
+    __m128i u = _mm_sll_epi16(_mm_loadu_si128((const __m128i*)(cb+x)), s);
+    __m128i v = _mm_sll_epi16(_mm_loadu_si128((const __m128i*)(cr+x)), s);
+
+    _mm_storeu_si128((__m128i*)(dst+2*x  ), _mm_unpacklo_epi16(u,v));
+    _mm_storeu_si128((__m128i*)(dst+2*x+8), _mm_unpackhi_epi16(u,v));
+  }
+
+  interleave_chroma_row_16_fallback(dst+2*x, cb+x, cr+x, width-x, shift);
+}
+
+
+void shift_row_16_sse4(uint16_t* dst, const uint16_t* src, int width, int shift)
+{
+  const __m128i s = _mm_cvtsi32_si128(shift);
+
+  int x=0;
+  for (;x+8<=width;x+=8) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(src+x));
+    _mm_storeu_si128((__m128i*)(dst+x), _mm_sll_epi16(v, s));
+  }
+
+  shift_row_16_fallback(dst+x, src+x, width-x, shift);
+}
+
+
+/* Computes the R,G,B sums with pmaddwd: the Y part as (Y-offset)*cY + 128*1, the chroma parts
+   on interleaved (Cb-128,Cr-128) pairs. The result is identical to yuv_to_rgba_pixel().
+ */
+void yuv_to_rgba_row_sse4(uint8_t* dst, const uint8_t* y,
+                          const uint8_t* cb, const uint8_t* cr, int width,
+                          const int16_t* m)
+{
+  const __m128i yoffset = _mm_set1_epi16(m[YUV2RGB_YOFFSET]);
+  const __m128i c128    = _mm_set1_epi16(128);
+  const __m128i one     = _mm_set1_epi16(1);
+  const __m128i alpha   = _mm_set1_epi16(255);
+
+  const __m128i cY = _mm_set1_epi32((128<<16) | (uint16_t)m[YUV2RGB_Y]);
+  const __m128i cR = _mm_set1_epi32(((uint32_t)(uint16_t)m[YUV2RGB_CR_R]<<16));
+  const __m128i cG = _mm_set1_epi32(((uint32_t)(uint16_t)m[YUV2RGB_CR_G]<<16) |
+                                    (uint16_t)m[YUV2RGB_CB_G]);
+  const __m128i cB = _mm_set1_epi32((uint16_t)m[YUV2RGB_CB_B]);
+
+  int x=0;
+  for (;x+8<=width;x+=8) {
+    __m128i yv = _mm_sub_epi16(_mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*)(y+x))),
+                               yoffset);
+
+    // load 4 chroma samples and duplicate them for the 8 luma samples
+    __m128i u = _mm_cvtsi32_si128(*(const int32_t*)(cb+x/2));
+    __m128i v = _mm_cvtsi32_si128(*(const int32_t*)(cr+x/2));
+    u = _mm_sub_epi16(_mm_cvtepu8_epi16(_mm_unpacklo_epi8(u,u)), c128);
+    v = _mm_sub_epi16(_mm_cvtepu8_epi16(_mm_unpacklo_epi8(v,v)), c128);
+
+    __m128i ylo = _mm_madd_epi16(_mm_unpacklo_epi16(yv,one), cY);
+    __m128i yhi = _mm_madd_epi16(_mm_unpackhi_epi16(yv,one), cY);
+    __m128i clo = _mm_unpacklo_epi16(u,v);
+    __m128i chi = _mm_unpackhi_epi16(u,v);
+
+    __m128i r = _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(ylo, _mm_madd_epi16(clo,cR)), 8),
+                                _mm_srai_epi32(_mm_add_epi32(yhi, _mm_madd_epi16(chi,cR)), 8));
+    __m128i g = _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(ylo, _mm_madd_epi16(clo,cG)), 8),
+                                _mm_srai_epi32(_mm_add_epi32(yhi, _mm_madd_epi16(chi,cG)), 8));
+    __m128i b = _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(ylo, _mm_madd_epi16(clo,cB)), 8),
+                                _mm_srai_epi32(_mm_add_epi32(yhi, _mm_madd_epi16(chi,cB)), 8));
+
+    // clip to 8 bit and interleave to RGBA
+
+    __m128i rg = _mm_packus_epi16(r,g);
+    __m128i ba = _mm_packus_epi16(b,alpha);
+    rg = _mm_unpacklo_epi8(rg, _mm_srli_si128(rg,8));
+    ba = _mm_unpacklo_epi8(ba, _mm_srli_si128(ba,8));
+
+    _mm_storeu_si128((__m128i*)(dst+4*x   ), _mm_unpacklo_epi16(rg,ba));
+    _mm_storeu_si128((__m128i*)(dst+4*x+16), _mm_unpackhi_epi16(rg,ba));
+  }
+
+  yuv_to_rgba_row_fallback(dst+4*x, y+x, cb+x/2, cr+x/2, width-x, m);
+}
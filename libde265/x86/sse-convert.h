@@ -0,0 +1,41 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2013-2014 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SSE_CONVERT_H
+#define SSE_CONVERT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+void reduce_bit_depth_row_sse4(uint8_t* dst, const uint16_t* src, int width, int bit_depth,
+                               const uint16_t* dither);
+
+void interleave_chroma_row_8_sse4(uint8_t* dst, const uint8_t* cb, const uint8_t* cr,
+                                  int width);
+void interleave_chroma_row_16_sse4(uint16_t* dst, const uint16_t* cb, const uint16_t* cr,
+                                   int width, int shift);
+
+void shift_row_16_sse4(uint16_t* dst, const uint16_t* src, int width, int shift);
+
+void yuv_to_rgba_row_sse4(uint8_t* dst, const uint8_t* y,
+                          const uint8_t* cb, const uint8_t* cr, int width,
+                          const int16_t* matrix);
+
+#endif
@@ -21,11 +21,13 @@
 
 #include "x86/sse-dct.h"
 #include "libde265/util.h"
+#include "libde265/fallback-dct.h"
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
 
+#include <stdlib.h>
 #include <emmintrin.h> // SSE2
 #include <tmmintrin.h> // SSSE3
 
@@ -7092,3 +7094,602 @@ void ff_hevc_transform_32x32_add_10_sse4(uint8_t *_dst, const int16_t *coeffs,
 }
 #endif
 
+
+
+#if HAVE_SSE4_1
+
+// --- forward transforms ---
+
+/* Matrix rows, split into pairs of coefficients (j,j+1) that are broadcast into
+   each 32-bit lane, such that _mm_madd_epi16 can be applied to two interleaved
+   input rows.
+ */
+template <int nT>
+struct fwd_transform_matrix
+{
+  __m128i pair[nT][nT/2];
+
+  fwd_transform_matrix(const int8_t* mat, int matStride) {
+    for (int i=0;i<nT;i++)
+      for (int p=0;p<nT/2;p++) {
+        const int8_t* row = &mat[i*matStride];
+        pair[i][p] = _mm_set1_epi32((uint16_t)row[2*p] | ((uint32_t)(uint16_t)row[2*p+1] << 16));
+      }
+  }
+};
+
+
+/* dst = (M * src + rnd) >> shift, i.e., transform of all columns.
+   'dst' is written with stride nT.
+ */
+template <int nT>
+static void fwd_transform_columns(int16_t* dst, const int16_t* src, ptrdiff_t srcStride,
+                                  const fwd_transform_matrix<nT>& M, int shift)
+{
+  const __m128i rnd = _mm_set1_epi32(1<<(shift-1));
+
+  if (nT==4) {
+    __m128i rows01 = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(src)),
+                                        _mm_loadl_epi64((const __m128i*)(src+srcStride)));
+    __m128i rows23 = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(src+2*srcStride)),
+                                        _mm_loadl_epi64((const __m128i*)(src+3*srcStride)));
+
+    for (int i=0;i<4;i++) {
+      __m128i acc = _mm_add_epi32(_mm_madd_epi16(rows01, M.pair[i][0]),
+                                  _mm_madd_epi16(rows23, M.pair[i][1]));
+      acc = _mm_srai_epi32(_mm_add_epi32(acc, rnd), shift);
+
+      _mm_storel_epi64((__m128i*)(dst+i*4), _mm_packs_epi32(acc,acc));
+    }
+
+    return;
+  }
+
+  for (int c=0;c<nT;c+=8) {
+    __m128i lo[nT/2], hi[nT/2];
+
+    for (int p=0;p<nT/2;p++) {
+      __m128i a = _mm_loadu_si128((const __m128i*)(src+(2*p  )*srcStride+c));
+      __m128i b = _mm_loadu_si128((const __m128i*)(src+(2*p+1)*srcStride+c));
+      lo[p] = _mm_unpacklo_epi16(a,b);
+      hi[p] = _mm_unpackhi_epi16(a,b);
+    }
+
+    for (int i=0;i<nT;i++) {
+      __m128i acc_lo = _mm_madd_epi16(lo[0], M.pair[i][0]);
+      __m128i acc_hi = _mm_madd_epi16(hi[0], M.pair[i][0]);
+
+      for (int p=1;p<nT/2;p++) {
+        acc_lo = _mm_add_epi32(acc_lo, _mm_madd_epi16(lo[p], M.pair[i][p]));
+        acc_hi = _mm_add_epi32(acc_hi, _mm_madd_epi16(hi[p], M.pair[i][p]));
+      }
+
+      acc_lo = _mm_srai_epi32(_mm_add_epi32(acc_lo, rnd), shift);
+      acc_hi = _mm_srai_epi32(_mm_add_epi32(acc_hi, rnd), shift);
+
+      _mm_storeu_si128((__m128i*)(dst+i*nT+c), _mm_packs_epi32(acc_lo,acc_hi));
+    }
+  }
+}
+
+
+template <int nT>
+static void transpose_block(int16_t* dst, const int16_t* src)
+{
+  if (nT==4) {
+    __m128i u0 = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(src  )),
+                                    _mm_loadl_epi64((const __m128i*)(src+4)));
+    __m128i u1 = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(src+8)),
+                                    _mm_loadl_epi64((const __m128i*)(src+12)));
+
+    _mm_storeu_si128((__m128i*)(dst  ), _mm_unpacklo_epi32(u0,u1));
+    _mm_storeu_si128((__m128i*)(dst+8), _mm_unpackhi_epi32(u0,u1));
+    return;
+  }
+
+  for (int by=0;by<nT;by+=8)
+    for (int bx=0;bx<nT;bx+=8) {
+      __m128i r[8];
+      for (int i=0;i<8;i++) {
+        r[i] = _mm_loadu_si128((const __m128i*)(src+(by+i)*nT+bx));
+      }
+
+      __m128i a0 = _mm_unpacklo_epi16(r[0],r[1]);
+      __m128i a1 = _mm_unpackhi_epi16(r[0],r[1]);
+      __m128i a2 = _mm_unpacklo_epi16(r[2],r[3]);
+      __m128i a3 = _mm_unpackhi_epi16(r[2],r[3]);
+      __m128i a4 = _mm_unpacklo_epi16(r[4],r[5]);
+      __m128i a5 = _mm_unpackhi_epi16(r[4],r[5]);
+      __m128i a6 = _mm_unpacklo_epi16(r[6],r[7]);
+      __m128i a7 = _mm_unpackhi_epi16(r[6],r[7]);
+
+      __m128i b0 = _mm_unpacklo_epi32(a0,a2);
+      __m128i b1 = _mm_unpackhi_epi32(a0,a2);
+      __m128i b2 = _mm_unpacklo_epi32(a1,a3);
+      __m128i b3 = _mm_unpackhi_epi32(a1,a3);
+      __m128i b4 = _mm_unpacklo_epi32(a4,a6);
+      __m128i b5 = _mm_unpackhi_epi32(a4,a6);
+      __m128i b6 = _mm_unpacklo_epi32(a5,a7);
+      __m128i b7 = _mm_unpackhi_epi32(a5,a7);
+
+      int16_t* d = dst+bx*nT+by;
+      _mm_storeu_si128((__m128i*)(d+0*nT), _mm_unpacklo_epi64(b0,b4));
+      _mm_storeu_si128((__m128i*)(d+1*nT), _mm_unpackhi_epi64(b0,b4));
+      _mm_storeu_si128((__m128i*)(d+2*nT), _mm_unpacklo_epi64(b1,b5));
+      _mm_storeu_si128((__m128i*)(d+3*nT), _mm_unpackhi_epi64(b1,b5));
+      _mm_storeu_si128((__m128i*)(d+4*nT), _mm_unpacklo_epi64(b2,b6));
+      _mm_storeu_si128((__m128i*)(d+5*nT), _mm_unpackhi_epi64(b2,b6));
+      _mm_storeu_si128((__m128i*)(d+6*nT), _mm_unpacklo_epi64(b3,b7));
+      _mm_storeu_si128((__m128i*)(d+7*nT), _mm_unpackhi_epi64(b3,b7));
+    }
+}
+
+
+/* Same rounding as the fallback: the vertical pass is computed first, then the
+   horizontal pass is computed as a vertical pass on the transposed block.
+ */
+template <int nT>
+static void fwd_transform_2d(int16_t* coeffs, const int16_t* input, ptrdiff_t stride,
+                             const fwd_transform_matrix<nT>& M, int shift1, int shift2)
+{
+  ALIGNED_16(int16_t) g[nT*nT];
+  ALIGNED_16(int16_t) h[nT*nT];
+
+  fwd_transform_columns<nT>(g, input, stride, M, shift1);
+  transpose_block<nT>(h, g);
+  fwd_transform_columns<nT>(g, h, nT, M, shift2);
+  transpose_block<nT>(coeffs, g);
+}
+
+
+void fdst_4x4_8_sse4(int16_t *coeffs, const int16_t *input, ptrdiff_t stride)
+{
+  static const fwd_transform_matrix<4> M(&mat_8_357[0][0], 4);
+
+  fwd_transform_2d<4>(coeffs, input, stride, M, 1, 8);
+}
+
+
+void fdct_4x4_8_sse4(int16_t *coeffs, const int16_t *input, ptrdiff_t stride)
+{
+  static const fwd_transform_matrix<4> M(&mat_dct[0][0], 8*32);
+
+  fwd_transform_2d<4>(coeffs, input, stride, M, 1, 8);
+}
+
+
+void fdct_8x8_8_sse4(int16_t *coeffs, const int16_t *input, ptrdiff_t stride)
+{
+  static const fwd_transform_matrix<8> M(&mat_dct[0][0], 4*32);
+
+  fwd_transform_2d<8>(coeffs, input, stride, M, 2, 9);
+}
+
+
+void fdct_16x16_8_sse4(int16_t *coeffs, const int16_t *input, ptrdiff_t stride)
+{
+  static const fwd_transform_matrix<16> M(&mat_dct[0][0], 2*32);
+
+  fwd_transform_2d<16>(coeffs, input, stride, M, 3, 10);
+}
+
+
+void fdct_32x32_8_sse4(int16_t *coeffs, const int16_t *input, ptrdiff_t stride)
+{
+  static const fwd_transform_matrix<32> M(&mat_dct[0][0], 32);
+
+  fwd_transform_2d<32>(coeffs, input, stride, M, 4, 11);
+}
+
+
+// --- inverse transforms for blocks with only low-frequency coefficients ---
+
+/* DC only: all residual values are equal. They are added with unsigned saturation,
+   which equals the clipping to [0;255].
+ */
+template <int nT>
+static void transform_dc_add_8_sse4(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride)
+{
+  int g   = Clip3(-32768,32767, (64*coeffs[0] + (1<<6))>>7);
+  int out = (64*g + (1<<11))>>12;
+
+  const __m128i v = _mm_set1_epi8((char)libde265_min(abs(out),255));
+
+  for (int y=0;y<nT;y++) {
+    uint8_t* d = dst+y*stride;
+
+    if (nT==4) {
+      __m128i p = _mm_cvtsi32_si128(*(const int32_t*)d);
+      p = (out>=0 ? _mm_adds_epu8(p,v) : _mm_subs_epu8(p,v));
+      *(int32_t*)d = _mm_cvtsi128_si32(p);
+    }
+    else if (nT==8) {
+      __m128i p = _mm_loadl_epi64((const __m128i*)d);
+      p = (out>=0 ? _mm_adds_epu8(p,v) : _mm_subs_epu8(p,v));
+      _mm_storel_epi64((__m128i*)d, p);
+    }
+    else {
+      for (int x=0;x<nT;x+=16) {
+        __m128i p = _mm_loadu_si128((const __m128i*)(d+x));
+        p = (out>=0 ? _mm_adds_epu8(p,v) : _mm_subs_epu8(p,v));
+        _mm_storeu_si128((__m128i*)(d+x), p);
+      }
+    }
+  }
+}
+
+
+/* The first K rows of the nT-point DCT matrix, split into 8 outputs per chunk. Rows
+   (2p,2p+1) are interleaved, such that _mm_madd_epi16 with a broadcast pair of input
+   values gives four outputs.
+ */
+template <int nT, int K>
+struct inv_transform_matrix
+{
+  __m128i lo[K/2][nT/8];
+  __m128i hi[K/2][nT/8];
+
+  inv_transform_matrix() {
+    const int fact = 32/nT;
+
+    for (int p=0;p<K/2;p++)
+      for (int c=0;c<nT/8;c++) {
+        const int8_t* r0 = &mat_dct[fact*(2*p  )][c*8];
+        const int8_t* r1 = &mat_dct[fact*(2*p+1)][c*8];
+
+        __m128i a = _mm_setr_epi16(r0[0],r0[1],r0[2],r0[3],r0[4],r0[5],r0[6],r0[7]);
+        __m128i b = _mm_setr_epi16(r1[0],r1[1],r1[2],r1[3],r1[4],r1[5],r1[6],r1[7]);
+
+        lo[p][c] = _mm_unpacklo_epi16(a,b);
+        hi[p][c] = _mm_unpackhi_epi16(a,b);
+      }
+  }
+};
+
+
+static inline __m128i pair_epi16(int16_t a, int16_t b)
+{
+  return _mm_set1_epi32((uint16_t)a | ((uint32_t)(uint16_t)b << 16));
+}
+
+
+// 8 outputs of chunk 'c' for the K inputs given as broadcast pairs
+template <int nT, int K>
+static inline __m128i inv_transform_chunk(const inv_transform_matrix<nT,K>& M,
+                                          const __m128i* in, int c,
+                                          __m128i rnd, int shift)
+{
+  __m128i acc_lo = _mm_madd_epi16(M.lo[0][c], in[0]);
+  __m128i acc_hi = _mm_madd_epi16(M.hi[0][c], in[0]);
+
+  for (int p=1;p<K/2;p++) {
+    acc_lo = _mm_add_epi32(acc_lo, _mm_madd_epi16(M.lo[p][c], in[p]));
+    acc_hi = _mm_add_epi32(acc_hi, _mm_madd_epi16(M.hi[p][c], in[p]));
+  }
+
+  acc_lo = _mm_srai_epi32(_mm_add_epi32(acc_lo, rnd), shift);
+  acc_hi = _mm_srai_epi32(_mm_add_epi32(acc_hi, rnd), shift);
+
+  return _mm_packs_epi32(acc_lo, acc_hi);
+}
+
+
+/* All non-zero coefficients are in the top-left KxK block. The vertical pass is only
+   computed for the first K columns, the horizontal pass only uses K inputs per row.
+   Saturation in _mm_packs_epi32 after the first pass is the 16 bit clipping of the
+   intermediate values.
+ */
+template <int nT, int K>
+static void transform_sparse_add_8_sse4(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride)
+{
+  static const inv_transform_matrix<nT,K> M;
+
+  ALIGNED_16(int16_t) gT[K*nT]; // transposed intermediate result: [column][row]
+
+  __m128i in[K/2];
+
+  const __m128i rnd1 = _mm_set1_epi32(1<<6);
+  for (int x=0;x<K;x++) {
+    for (int p=0;p<K/2;p++) {
+      in[p] = pair_epi16(coeffs[x+(2*p)*nT], coeffs[x+(2*p+1)*nT]);
+    }
+
+    for (int c=0;c<nT/8;c++) {
+      _mm_store_si128((__m128i*)(gT+x*nT+c*8), inv_transform_chunk<nT,K>(M,in,c, rnd1,7));
+    }
+  }
+
+  const __m128i rnd2 = _mm_set1_epi32(1<<11);
+  const __m128i zero = _mm_setzero_si128();
+  for (int y=0;y<nT;y++) {
+    for (int p=0;p<K/2;p++) {
+      in[p] = pair_epi16(gT[(2*p)*nT+y], gT[(2*p+1)*nT+y]);
+    }
+
+    uint8_t* d = dst+y*stride;
+
+    for (int c=0;c<nT/8;c++) {
+      __m128i r = inv_transform_chunk<nT,K>(M,in,c, rnd2,12);
+      __m128i p = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(d+c*8)), zero);
+
+      _mm_storel_epi64((__m128i*)(d+c*8), _mm_packus_epi16(_mm_adds_epi16(p,r), zero));
+    }
+  }
+}
+
+
+void transform_4x4_dc_add_8_sse4(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride)
+{
+  transform_dc_add_8_sse4<4>(dst,coeffs,stride);
+}
+
+void transform_8x8_dc_add_8_sse4(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride)
+{
+  transform_dc_add_8_sse4<8>(dst,coeffs,stride);
+}
+
+void transform_16x16_dc_add_8_sse4(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride)
+{
+  transform_dc_add_8_sse4<16>(dst,coeffs,stride);
+}
+
+void transform_32x32_dc_add_8_sse4(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride)
+{
+  transform_dc_add_8_sse4<32>(dst,coeffs,stride);
+}
+
+
+void transform_16x16_sparse4_add_8_sse4(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride)
+{
+  transform_sparse_add_8_sse4<16,4>(dst,coeffs,stride);
+}
+
+void transform_16x16_sparse8_add_8_sse4(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride)
+{
+  transform_sparse_add_8_sse4<16,8>(dst,coeffs,stride);
+}
+
+void transform_32x32_sparse4_add_8_sse4(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride)
+{
+  transform_sparse_add_8_sse4<32,4>(dst,coeffs,stride);
+}
+
+void transform_32x32_sparse8_add_8_sse4(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride)
+{
+  transform_sparse_add_8_sse4<32,8>(dst,coeffs,stride);
+}
+
+
+// --- quantization ---
+
+int quant_coefficients_sse4(int16_t* out_coeff, const int16_t* in_coeff, int nCoeff,
+                            int scale, int offset, int shift)
+{
+  const __m128i vscale  = _mm_set1_epi32(scale);
+  const __m128i voffset = _mm_set1_epi32(offset);
+  const __m128i zero    = _mm_setzero_si128();
+
+  __m128i nZero = _mm_setzero_si128(); // number of zero levels in each lane
+
+  // nCoeff is always a multiple of 16 (4x4 blocks at least)
+
+  for (int i=0;i<nCoeff;i+=8) {
+    __m128i c = _mm_loadu_si128((const __m128i*)(in_coeff+i));
+    __m128i a = _mm_abs_epi16(c);
+
+    // |c| may be 32768, hence zero-extend
+    __m128i lo = _mm_cvtepu16_epi32(a);
+    __m128i hi = _mm_cvtepu16_epi32(_mm_srli_si128(a,8));
+
+    lo = _mm_srai_epi32(_mm_add_epi32(_mm_mullo_epi32(lo, vscale), voffset), shift);
+    hi = _mm_srai_epi32(_mm_add_epi32(_mm_mullo_epi32(hi, vscale), voffset), shift);
+
+    __m128i level = _mm_sign_epi16(_mm_packs_epi32(lo,hi), c);
+
+    _mm_storeu_si128((__m128i*)(out_coeff+i), level);
+
+    nZero = _mm_sub_epi16(nZero, _mm_cmpeq_epi16(level,zero));
+  }
+
+  nZero = _mm_madd_epi16(nZero, _mm_set1_epi16(1));
+  nZero = _mm_add_epi32(nZero, _mm_srli_si128(nZero,8));
+  nZero = _mm_add_epi32(nZero, _mm_srli_si128(nZero,4));
+
+  return nCoeff - _mm_cvtsi128_si32(nZero);
+}
+
+#endif
+
+
+#if HAVE_SSE4_1
+
+// --- range extension residual tools (transform skip, transquant bypass, RDPCM, cross-component) ---
+
+// four coefficients, scaled like in transform_skip_residual_fallback(), or unscaled for bypass
+
+template <bool scaled>
+static inline __m128i residual_samples(const int16_t* coeffs,
+                                       __m128i tsShift, __m128i rnd, __m128i bdShift)
+{
+  __m128i c = _mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i*)coeffs));
+
+  if (scaled) {
+    c = _mm_sra_epi32(_mm_add_epi32(_mm_sll_epi32(c, tsShift), rnd), bdShift);
+  }
+
+  return c;
+}
+
+
+template <bool scaled>
+static void residual_sse4(int32_t* residual, const int16_t* coeffs, int nT,
+                          int tsShift,int bdShift)
+{
+  const __m128i ts  = _mm_cvtsi32_si128(tsShift);
+  const __m128i bd  = _mm_cvtsi32_si128(bdShift);
+  const __m128i rnd = _mm_set1_epi32(scaled ? 1<<(bdShift-1) : 0);
+
+  for (int i=0;i<nT*nT;i+=4) {
+    _mm_storeu_si128((__m128i*)(residual+i), residual_samples<scaled>(coeffs+i, ts,rnd,bd));
+  }
+}
+
+
+// vertical RDPCM: accumulate the rows, four columns at a time
+
+template <bool scaled>
+static void rdpcm_v_sse4(int32_t* residual, const int16_t* coeffs, int nT,
+                         int tsShift,int bdShift)
+{
+  const __m128i ts  = _mm_cvtsi32_si128(tsShift);
+  const __m128i bd  = _mm_cvtsi32_si128(bdShift);
+  const __m128i rnd = _mm_set1_epi32(scaled ? 1<<(bdShift-1) : 0);
+
+  for (int x=0;x<nT;x+=4) {
+    __m128i sum = _mm_setzero_si128();
+
+    for (int y=0;y<nT;y++) {
+      sum = _mm_add_epi32(sum, residual_samples<scaled>(coeffs+x+y*nT, ts,rnd,bd));
+      _mm_storeu_si128((__m128i*)(residual+x+y*nT), sum);
+    }
+  }
+}
+
+
+// horizontal RDPCM: prefix sum within each group of four, plus the carry from the left
+
+template <bool scaled>
+static void rdpcm_h_sse4(int32_t* residual, const int16_t* coeffs, int nT,
+                         int tsShift,int bdShift)
+{
+  const __m128i ts  = _mm_cvtsi32_si128(tsShift);
+  const __m128i bd  = _mm_cvtsi32_si128(bdShift);
+  const __m128i rnd = _mm_set1_epi32(scaled ? 1<<(bdShift-1) : 0);
+
+  for (int y=0;y<nT;y++) {
+    __m128i carry = _mm_setzero_si128();
+
+    for (int x=0;x<nT;x+=4) {
+      __m128i v = residual_samples<scaled>(coeffs+x+y*nT, ts,rnd,bd);
+      v = _mm_add_epi32(v, _mm_slli_si128(v,4));
+      v = _mm_add_epi32(v, _mm_slli_si128(v,8));
+      v = _mm_add_epi32(v, carry);
+
+      _mm_storeu_si128((__m128i*)(residual+x+y*nT), v);
+
+      carry = _mm_shuffle_epi32(v, 0xFF);
+    }
+  }
+}
+
+
+void transform_skip_residual_sse4(int32_t *residual, const int16_t *coeffs, int nT,
+                                  int tsShift,int bdShift)
+{
+  residual_sse4<true>(residual, coeffs, nT, tsShift, bdShift);
+}
+
+void transform_bypass_sse4(int32_t *residual, const int16_t *coeffs, int nT)
+{
+  residual_sse4<false>(residual, coeffs, nT, 0,0);
+}
+
+void rdpcm_v_sse4(int32_t* residual, const int16_t* coeffs, int nT,int tsShift,int bdShift)
+{
+  rdpcm_v_sse4<true>(residual, coeffs, nT, tsShift, bdShift);
+}
+
+void rdpcm_h_sse4(int32_t* residual, const int16_t* coeffs, int nT,int tsShift,int bdShift)
+{
+  rdpcm_h_sse4<true>(residual, coeffs, nT, tsShift, bdShift);
+}
+
+void transform_bypass_rdpcm_v_sse4(int32_t *residual, const int16_t *coeffs, int nT)
+{
+  rdpcm_v_sse4<false>(residual, coeffs, nT, 0,0);
+}
+
+void transform_bypass_rdpcm_h_sse4(int32_t *residual, const int16_t *coeffs, int nT)
+{
+  rdpcm_h_sse4<false>(residual, coeffs, nT, 0,0);
+}
+
+
+void cross_comp_pred_sse4(int32_t* residual, const int32_t* residual_luma, int nT,
+                          int resScaleVal, int bitDepthC, int bitDepthY)
+{
+  const __m128i scale = _mm_set1_epi32(resScaleVal);
+  const __m128i bdC   = _mm_cvtsi32_si128(bitDepthC);
+  const __m128i bdY   = _mm_cvtsi32_si128(bitDepthY);
+
+  for (int i=0;i<nT*nT;i+=4) {
+    __m128i rY = _mm_loadu_si128((const __m128i*)(residual_luma+i));
+    __m128i r  = _mm_loadu_si128((const __m128i*)(residual+i));
+
+    if (bitDepthC != bitDepthY) {
+      rY = _mm_sra_epi32(_mm_sll_epi32(rY, bdC), bdY);
+    }
+
+    rY = _mm_srai_epi32(_mm_mullo_epi32(rY, scale), 3);
+
+    _mm_storeu_si128((__m128i*)(residual+i), _mm_add_epi32(r, rY));
+  }
+}
+
+
+/* The residual is packed to 16 bit with signed saturation. Since the result is clipped
+   to [0;255] afterwards, this does not change the result.
+ */
+void add_residual_8_sse4(uint8_t *dst, ptrdiff_t stride,
+                         const int32_t* r, int nT, int bit_depth)
+{
+  if (nT==4) {
+    for (int y=0;y<4;y++) {
+      __m128i res = _mm_loadu_si128((const __m128i*)(r+4*y));
+      __m128i pix = _mm_cvtepu8_epi16(_mm_cvtsi32_si128(*(const int32_t*)(dst+y*stride)));
+
+      pix = _mm_adds_epi16(pix, _mm_packs_epi32(res,res));
+      *(int32_t*)(dst+y*stride) = _mm_cvtsi128_si32(_mm_packus_epi16(pix,pix));
+    }
+
+    return;
+  }
+
+  for (int y=0;y<nT;y++) {
+    for (int x=0;x<nT;x+=8) {
+      __m128i res0 = _mm_loadu_si128((const __m128i*)(r+x));
+      __m128i res1 = _mm_loadu_si128((const __m128i*)(r+x+4));
+      __m128i pix  = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*)(dst+x)));
+
+      pix = _mm_adds_epi16(pix, _mm_packs_epi32(res0,res1));
+      _mm_storel_epi64((__m128i*)(dst+x), _mm_packus_epi16(pix,pix));
+    }
+
+    dst += stride;
+    r   += nT;
+  }
+}
+
+
+void add_residual_16_sse4(uint16_t *dst, ptrdiff_t stride,
+                          const int32_t* r, int nT, int bit_depth)
+{
+  const __m128i maxval = _mm_set1_epi16((1<<bit_depth)-1);
+
+  for (int y=0;y<nT;y++) {
+    for (int x=0;x<nT;x+=4) {
+      __m128i res = _mm_loadu_si128((const __m128i*)(r+x));
+      __m128i pix = _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)(dst+x)));
+
+      pix = _mm_add_epi32(pix, res);
+      pix = _mm_min_epu16(_mm_packus_epi32(pix,pix), maxval);
+
+      _mm_storel_epi64((__m128i*)(dst+x), pix);
+    }
+
+    dst += stride;
+    r   += nT;
+  }
+}
+
+#endif
@@ -32,4 +32,39 @@ void ff_hevc_transform_8x8_add_8_sse4(uint8_t *dst, const int16_t *coeffs, ptrdi
 void ff_hevc_transform_16x16_add_8_sse4(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride);
 void ff_hevc_transform_32x32_add_8_sse4(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride);
 
+void transform_4x4_dc_add_8_sse4(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride);
+void transform_8x8_dc_add_8_sse4(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride);
+void transform_16x16_dc_add_8_sse4(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride);
+void transform_32x32_dc_add_8_sse4(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride);
+
+void transform_16x16_sparse4_add_8_sse4(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride);
+void transform_16x16_sparse8_add_8_sse4(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride);
+void transform_32x32_sparse4_add_8_sse4(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride);
+void transform_32x32_sparse8_add_8_sse4(uint8_t *dst, const int16_t *coeffs, ptrdiff_t stride);
+
+void fdst_4x4_8_sse4(int16_t *coeffs, const int16_t *input, ptrdiff_t stride);
+void fdct_4x4_8_sse4(int16_t *coeffs, const int16_t *input, ptrdiff_t stride);
+void fdct_8x8_8_sse4(int16_t *coeffs, const int16_t *input, ptrdiff_t stride);
+void fdct_16x16_8_sse4(int16_t *coeffs, const int16_t *input, ptrdiff_t stride);
+void fdct_32x32_8_sse4(int16_t *coeffs, const int16_t *input, ptrdiff_t stride);
+
+void transform_skip_residual_sse4(int32_t *residual, const int16_t *coeffs, int nT,
+                                  int tsShift,int bdShift);
+void transform_bypass_sse4(int32_t *residual, const int16_t *coeffs, int nT);
+void rdpcm_v_sse4(int32_t* residual, const int16_t* coeffs, int nT,int tsShift,int bdShift);
+void rdpcm_h_sse4(int32_t* residual, const int16_t* coeffs, int nT,int tsShift,int bdShift);
+void transform_bypass_rdpcm_v_sse4(int32_t *residual, const int16_t *coeffs, int nT);
+void transform_bypass_rdpcm_h_sse4(int32_t *residual, const int16_t *coeffs, int nT);
+
+void cross_comp_pred_sse4(int32_t* residual, const int32_t* residual_luma, int nT,
+                          int resScaleVal, int bitDepthC, int bitDepthY);
+
+void add_residual_8_sse4(uint8_t *dst, ptrdiff_t stride,
+                         const int32_t* r, int nT, int bit_depth);
+void add_residual_16_sse4(uint16_t *dst, ptrdiff_t stride,
+                          const int32_t* r, int nT, int bit_depth);
+
+int quant_coefficients_sse4(int16_t* out_coeff, const int16_t* in_coeff, int nCoeff,
+                            int scale, int offset, int shift);
+
 #endif
@@ -0,0 +1,276 @@
+/*
+ * H.265 video codec.
+ * Copyright (c) 2013-2014 struktur AG, Dirk Farin <farin@struktur.de>
+ *
+ * This file is part of libde265.
+ *
+ * libde265 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libde265 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libde265.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "x86/sse-distortion.h"
+#include "libde265/util.h"
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <emmintrin.h> // SSE2
+#include <tmmintrin.h> // SSSE3
+
+
+static inline __m128i load_4_pixels(const uint8_t* p)
+{
+  int32_t v;
+  memcpy(&v,p,4);
+  return _mm_cvtsi32_si128(v);
+}
+
+
+uint32_t sad_8_sse4(const uint8_t* img, ptrdiff_t imgStride,
+                    const uint8_t* ref, ptrdiff_t refStride, int width, int height)
+{
+  __m128i sum = _mm_setzero_si128();
+  uint32_t tail = 0;
+
+  for (int y=0;y<height;y++) {
+    int x=0;
+
+    for (; x+16<=width; x+=16) {
+      __m128i a = _mm_loadu_si128((const __m128i*)(img+x));
+      __m128i b = _mm_loadu_si128((const __m128i*)(ref+x));
+      sum = _mm_add_epi32(sum, _mm_sad_epu8(a,b));
+    }
+
+    if (x+8<=width) {
+      __m128i a = _mm_loadl_epi64((const __m128i*)(img+x));
+      __m128i b = _mm_loadl_epi64((const __m128i*)(ref+x));
+      sum = _mm_add_epi32(sum, _mm_sad_epu8(a,b));
+      x+=8;
+    }
+
+    if (x+4<=width) {
+      sum = _mm_add_epi32(sum, _mm_sad_epu8(load_4_pixels(img+x), load_4_pixels(ref+x)));
+      x+=4;
+    }
+
+    for (; x<width; x++) {
+      tail += abs_value(img[x] - ref[x]);
+    }
+
+    img += imgStride;
+    ref += refStride;
+  }
+
+  sum = _mm_add_epi32(sum, _mm_srli_si128(sum,8));
+
+  return _mm_cvtsi128_si32(sum) + tail;
+}
+
+
+uint32_t ssd_8_sse4(const uint8_t* img, ptrdiff_t imgStride,
+                    const uint8_t* ref, ptrdiff_t refStride, int width, int height)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i sum = _mm_setzero_si128();
+  uint32_t tail = 0;
+
+  for (int y=0;y<height;y++) {
+    int x=0;
+
+    for (; x+16<=width; x+=16) {
+      __m128i a = _mm_loadu_si128((const __m128i*)(img+x));
+      __m128i b = _mm_loadu_si128((const __m128i*)(ref+x));
+
+      __m128i dlo = _mm_sub_epi16(_mm_unpacklo_epi8(a,zero), _mm_unpacklo_epi8(b,zero));
+      __m128i dhi = _mm_sub_epi16(_mm_unpackhi_epi8(a,zero), _mm_unpackhi_epi8(b,zero));
+
+      sum = _mm_add_epi32(sum, _mm_madd_epi16(dlo,dlo));
+      sum = _mm_add_epi32(sum, _mm_madd_epi16(dhi,dhi));
+    }
+
+    if (x+8<=width) {
+      __m128i a = _mm_loadl_epi64((const __m128i*)(img+x));
+      __m128i b = _mm_loadl_epi64((const __m128i*)(ref+x));
+
+      __m128i d = _mm_sub_epi16(_mm_unpacklo_epi8(a,zero), _mm_unpacklo_epi8(b,zero));
+      sum = _mm_add_epi32(sum, _mm_madd_epi16(d,d));
+      x+=8;
+    }
+
+    if (x+4<=width) {
+      __m128i d = _mm_sub_epi16(_mm_unpacklo_epi8(load_4_pixels(img+x),zero),
+                                _mm_unpacklo_epi8(load_4_pixels(ref+x),zero));
+      sum = _mm_add_epi32(sum, _mm_madd_epi16(d,d));
+      x+=4;
+    }
+
+    for (; x<width; x++) {
+      int diff = img[x] - ref[x];
+      tail += diff*diff;
+    }
+
+    img += imgStride;
+    ref += refStride;
+  }
+
+  sum = _mm_add_epi32(sum, _mm_srli_si128(sum,8));
+  sum = _mm_add_epi32(sum, _mm_srli_si128(sum,4));
+
+  return _mm_cvtsi128_si32(sum) + tail;
+}
+
+
+static inline void butterfly(__m128i& a, __m128i& b)
+{
+  __m128i t = a;
+  a = _mm_add_epi16(t,b);
+  b = _mm_sub_epi16(t,b);
+}
+
+
+static inline __m128i sum_abs_epi16(__m128i v)
+{
+  return _mm_madd_epi16(_mm_abs_epi16(v), _mm_set1_epi16(1));
+}
+
+
+uint32_t satd_4x4_8_sse4(const uint8_t* img, ptrdiff_t imgStride,
+                         const uint8_t* ref, ptrdiff_t refStride)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i r[4];
+
+  // differences, one row in the lower half of each register
+
+  for (int y=0;y<4;y++) {
+    r[y] = _mm_sub_epi16(_mm_unpacklo_epi8(load_4_pixels(img+y*imgStride),zero),
+                         _mm_unpacklo_epi8(load_4_pixels(ref+y*refStride),zero));
+  }
+
+  // column transforms
+
+  butterfly(r[0],r[2]);
+  butterfly(r[1],r[3]);
+  butterfly(r[0],r[1]);
+  butterfly(r[2],r[3]);
+
+  // transpose: columns 0,1 in c01 and columns 2,3 in c23 (lower and upper half)
+
+  __m128i u0  = _mm_unpacklo_epi16(r[0],r[1]);
+  __m128i u1  = _mm_unpacklo_epi16(r[2],r[3]);
+  __m128i c01 = _mm_unpacklo_epi32(u0,u1);
+  __m128i c23 = _mm_unpackhi_epi32(u0,u1);
+
+  // row transforms
+
+  butterfly(c01,c23);
+
+  __m128i s01 = _mm_shuffle_epi32(c01, 0x4E); // swap halves
+  __m128i s23 = _mm_shuffle_epi32(c23, 0x4E);
+
+  // Both halves of each register contain the same coefficients (up to the sign),
+  // hence, everything is summed up twice.
+
+  __m128i sum;
+  sum = sum_abs_epi16(_mm_add_epi16(c01,s01));
+  sum = _mm_add_epi32(sum, sum_abs_epi16(_mm_sub_epi16(c01,s01)));
+  sum = _mm_add_epi32(sum, sum_abs_epi16(_mm_add_epi16(c23,s23)));
+  sum = _mm_add_epi32(sum, sum_abs_epi16(_mm_sub_epi16(c23,s23)));
+
+  sum = _mm_add_epi32(sum, _mm_srli_si128(sum,8));
+  sum = _mm_add_epi32(sum, _mm_srli_si128(sum,4));
+
+  return _mm_cvtsi128_si32(sum) >> 1;
+}
+
+
+static inline void hadamard_8_columns(__m128i r[8])
+{
+  butterfly(r[0],r[4]);
+  butterfly(r[1],r[5]);
+  butterfly(r[2],r[6]);
+  butterfly(r[3],r[7]);
+
+  butterfly(r[0],r[2]);
+  butterfly(r[1],r[3]);
+  butterfly(r[4],r[6]);
+  butterfly(r[5],r[7]);
+
+  butterfly(r[0],r[1]);
+  butterfly(r[2],r[3]);
+  butterfly(r[4],r[5]);
+  butterfly(r[6],r[7]);
+}
+
+
+static inline void transpose_8x8_epi16(__m128i r[8])
+{
+  __m128i a0 = _mm_unpacklo_epi16(r[0],r[1]);
+  __m128i a1 = _mm_unpackhi_epi16(r[0],r[1]);
+  __m128i a2 = _mm_unpacklo_epi16(r[2],r[3]);
+  __m128i a3 = _mm_unpackhi_epi16(r[2],r[3]);
+  __m128i a4 = _mm_unpacklo_epi16(r[4],r[5]);
+  __m128i a5 = _mm_unpackhi_epi16(r[4],r[5]);
+  __m128i a6 = _mm_unpacklo_epi16(r[6],r[7]);
+  __m128i a7 = _mm_unpackhi_epi16(r[6],r[7]);
+
+  __m128i b0 = _mm_unpacklo_epi32(a0,a2);
+  __m128i b1 = _mm_unpackhi_epi32(a0,a2);
+  __m128i b2 = _mm_unpacklo_epi32(a1,a3);
+  __m128i b3 = _mm_unpackhi_epi32(a1,a3);
+  __m128i b4 = _mm_unpacklo_epi32(a4,a6);
+  __m128i b5 = _mm_unpackhi_epi32(a4,a6);
+  __m128i b6 = _mm_unpacklo_epi32(a5,a7);
+  __m128i b7 = _mm_unpackhi_epi32(a5,a7);
+
+  r[0] = _mm_unpacklo_epi64(b0,b4);
+  r[1] = _mm_unpackhi_epi64(b0,b4);
+  r[2] = _mm_unpacklo_epi64(b1,b5);
+  r[3] = _mm_unpackhi_epi64(b1,b5);
+  r[4] = _mm_unpacklo_epi64(b2,b6);
+  r[5] = _mm_unpackhi_epi64(b2,b6);
+  r[6] = _mm_unpacklo_epi64(b3,b7);
+  r[7] = _mm_unpackhi_epi64(b3,b7);
+}
+
+
+uint32_t satd_8x8_8_sse4(const uint8_t* img, ptrdiff_t imgStride,
+                         const uint8_t* ref, ptrdiff_t refStride)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i r[8];
+
+  for (int y=0;y<8;y++) {
+    __m128i a = _mm_loadl_epi64((const __m128i*)(img+y*imgStride));
+    __m128i b = _mm_loadl_epi64((const __m128i*)(ref+y*refStride));
+    r[y] = _mm_sub_epi16(_mm_unpacklo_epi8(a,zero), _mm_unpacklo_epi8(b,zero));
+  }
+
+  // The coefficients stay below 64*255 and therefore fit into 16 bit.
+
+  hadamard_8_columns(r);
+  transpose_8x8_epi16(r);
+  hadamard_8_columns(r);
+
+  __m128i sum = sum_abs_epi16(r[0]);
+  for (int i=1;i<8;i++) {
+    sum = _mm_add_epi32(sum, sum_abs_epi16(r[i]));
+  }
+
+  sum = _mm_add_epi32(sum, _mm_srli_si128(sum,8));
+  sum = _mm_add_epi32(sum, _mm_srli_si128(sum,4));
+
+  return _mm_cvtsi128_si32(sum);
+}
@@ -352,605 +352,320 @@ void ff_hevc_put_weighted_pred_avg_sse(uint8_t *_dst, ptrdiff_t _dststride,
     }
 }
 
-#if 0
-void ff_hevc_weighted_pred_8_sse4(uint8_t denom, int16_t wlxFlag, int16_t olxFlag,
-                                  uint8_t *_dst, ptrdiff_t _dststride,
-                                  const int16_t *src, ptrdiff_t srcstride,
-                                  int width, int height) {
-
-    int log2Wd;
-    int x, y;
-
-    uint8_t *dst = (uint8_t*) _dst;
-    ptrdiff_t dststride = _dststride / sizeof(uint8_t);
-    __m128i x0, x1, x2, x3, c0, add, add2;
-
-    log2Wd = denom + 14 - BIT_DEPTH;
-
-    add = _mm_set1_epi32(olxFlag * (1 << (BIT_DEPTH - 8)));
-    add2 = _mm_set1_epi32(1 << (log2Wd - 1));
-    c0 = _mm_set1_epi16(wlxFlag);
-    if (log2Wd >= 1){
-        if(!(width & 15)){
-            for (y = 0; y < height; y++) {
-                for (x = 0; x < width; x += 16) {
-                    x0 = _mm_load_si128((__m128i *) &src[x]);
-                    x2 = _mm_load_si128((__m128i *) &src[x + 8]);
-                    x1 = _mm_unpackhi_epi16(_mm_mullo_epi16(x0, c0),
-                            _mm_mulhi_epi16(x0, c0));
-                    x3 = _mm_unpackhi_epi16(_mm_mullo_epi16(x2, c0),
-                            _mm_mulhi_epi16(x2, c0));
-                    x0 = _mm_unpacklo_epi16(_mm_mullo_epi16(x0, c0),
-                            _mm_mulhi_epi16(x0, c0));
-                    x2 = _mm_unpacklo_epi16(_mm_mullo_epi16(x2, c0),
-                            _mm_mulhi_epi16(x2, c0));
-                    x0 = _mm_add_epi32(x0, add2);
-                    x1 = _mm_add_epi32(x1, add2);
-                    x2 = _mm_add_epi32(x2, add2);
-                    x3 = _mm_add_epi32(x3, add2);
-                    x0 = _mm_srai_epi32(x0, log2Wd);
-                    x1 = _mm_srai_epi32(x1, log2Wd);
-                    x2 = _mm_srai_epi32(x2, log2Wd);
-                    x3 = _mm_srai_epi32(x3, log2Wd);
-                    x0 = _mm_add_epi32(x0, add);
-                    x1 = _mm_add_epi32(x1, add);
-                    x2 = _mm_add_epi32(x2, add);
-                    x3 = _mm_add_epi32(x3, add);
-                    x0 = _mm_packus_epi32(x0, x1);
-                    x2 = _mm_packus_epi32(x2, x3);
-                    x0 = _mm_packus_epi16(x0, x2);
-
-                    _mm_storeu_si128((__m128i *) (dst + x), x0);
-
-                }
-                dst += dststride;
-                src += srcstride;
-            }
-        }else if(!(width & 7)){
-            for (y = 0; y < height; y++) {
-                for(x=0;x<width;x+=8){
-                    x0 = _mm_load_si128((__m128i *) (src+x));
-                    x1 = _mm_unpackhi_epi16(_mm_mullo_epi16(x0, c0),
-                            _mm_mulhi_epi16(x0, c0));
-
-                    x0 = _mm_unpacklo_epi16(_mm_mullo_epi16(x0, c0),
-                            _mm_mulhi_epi16(x0, c0));
-
-                    x0 = _mm_add_epi32(x0, add2);
-                    x1 = _mm_add_epi32(x1, add2);
-
-                    x0 = _mm_srai_epi32(x0, log2Wd);
-                    x1 = _mm_srai_epi32(x1, log2Wd);
+/* Explicit weighted prediction (8.5.3.3.4.3).
 
-                    x0 = _mm_add_epi32(x0, add);
-                    x1 = _mm_add_epi32(x1, add);
-
-                    x0 = _mm_packus_epi32(x0, x1);
-                    x0 = _mm_packus_epi16(x0, x0);
-
-                    _mm_storel_epi64((__m128i *) (dst+x), x0);
-
-                }
-                dst += dststride;
-                src += srcstride;
-            }
-        }else if(!(width & 3)){
-            for (y = 0; y < height; y++) {
-                for(x=0;x<width;x+=4){
-                    x0 = _mm_loadl_epi64((__m128i *)(src+x));
-                    x1 = _mm_unpackhi_epi16(_mm_mullo_epi16(x0, c0),
-                            _mm_mulhi_epi16(x0, c0));
-                    x0 = _mm_unpacklo_epi16(_mm_mullo_epi16(x0, c0),
-                            _mm_mulhi_epi16(x0, c0));
-
-                    x0 = _mm_add_epi32(x0, add2);
-                    x1 = _mm_add_epi32(x1, add2);
-                    x0 = _mm_srai_epi32(x0, log2Wd);
-                    x1 = _mm_srai_epi32(x1, log2Wd);
-                    x0 = _mm_add_epi32(x0, add);
-                    x1 = _mm_add_epi32(x1, add);
-                    x0 = _mm_packus_epi32(x0, x1);
-                    x0 = _mm_packus_epi16(x0, x0);
-
-                    _mm_maskmoveu_si128(x0,_mm_set_epi8(0,0,0,0,0,0,0,0,0,0,0,0,-1,-1,-1,-1),(char *) (dst+x));
-                    // _mm_storeu_si128((__m128i *) (dst + x), x0);
-                }
-                dst += dststride;
-                src += srcstride;
-            }
-        }else{
-            for (y = 0; y < height; y++) {
-                for(x=0;x<width;x+=2){
-                    x0 = _mm_loadl_epi64((__m128i *)(src+x));
-                    x1 = _mm_unpackhi_epi16(_mm_mullo_epi16(x0, c0),
-                            _mm_mulhi_epi16(x0, c0));
-                    x0 = _mm_unpacklo_epi16(_mm_mullo_epi16(x0, c0),
-                            _mm_mulhi_epi16(x0, c0));
-
-                    x0 = _mm_add_epi32(x0, add2);
-                    x1 = _mm_add_epi32(x1, add2);
-                    x0 = _mm_srai_epi32(x0, log2Wd);
-                    x1 = _mm_srai_epi32(x1, log2Wd);
-                    x0 = _mm_add_epi32(x0, add);
-                    x1 = _mm_add_epi32(x1, add);
-                    x0 = _mm_packus_epi32(x0, x1);
-                    x0 = _mm_packus_epi16(x0, x0);
-
-                    _mm_maskmoveu_si128(x0,_mm_set_epi8(0,0,0,0,0,0,0,0,0,0,0,0,0,0,-1,-1),(char *) (dst+x));
-                    // _mm_storeu_si128((__m128i *) (dst + x), x0);
-                }
-                dst += dststride;
-                src += srcstride;
-            }
-        }
-    }else{
-        if(!(width & 15)){
-            for (y = 0; y < height; y++) {
-                for (x = 0; x < width; x += 16) {
-
-                    x0 = _mm_load_si128((__m128i *) &src[x]);
-                    x2 = _mm_load_si128((__m128i *) &src[x + 8]);
-                    x1 = _mm_unpackhi_epi16(_mm_mullo_epi16(x0, c0),
-                            _mm_mulhi_epi16(x0, c0));
-                    x3 = _mm_unpackhi_epi16(_mm_mullo_epi16(x2, c0),
-                            _mm_mulhi_epi16(x2, c0));
-                    x0 = _mm_unpacklo_epi16(_mm_mullo_epi16(x0, c0),
-                            _mm_mulhi_epi16(x0, c0));
-                    x2 = _mm_unpacklo_epi16(_mm_mullo_epi16(x2, c0),
-                            _mm_mulhi_epi16(x2, c0));
-
-                    x0 = _mm_add_epi32(x0, add2);
-                    x1 = _mm_add_epi32(x1, add2);
-                    x2 = _mm_add_epi32(x2, add2);
-                    x3 = _mm_add_epi32(x3, add2);
-
-                    x0 = _mm_packus_epi32(x0, x1);
-                    x2 = _mm_packus_epi32(x2, x3);
-                    x0 = _mm_packus_epi16(x0, x2);
-
-                    _mm_storeu_si128((__m128i *) (dst + x), x0);
-
-                }
-                dst += dststride;
-                src += srcstride;
-            }
-        }else if(!(width & 7)){
-            for (y = 0; y < height; y++) {
-                for(x=0;x<width;x+=8){
-                    x0 = _mm_load_si128((__m128i *) (src+x));
-                    x1 = _mm_unpackhi_epi16(_mm_mullo_epi16(x0, c0),
-                            _mm_mulhi_epi16(x0, c0));
-
-                    x0 = _mm_unpacklo_epi16(_mm_mullo_epi16(x0, c0),
-                            _mm_mulhi_epi16(x0, c0));
-
-
-                    x0 = _mm_add_epi32(x0, add2);
-                    x1 = _mm_add_epi32(x1, add2);
+   All products are computed with 32 bit precision by interleaving the two factors of
+   each sum and using pmaddwd. The results are packed with signed saturation to 16 bit,
+   which does not change the outcome of the final clipping to the output bit depth.
+ */
 
-                    x0 = _mm_packus_epi32(x0, x1);
-                    x0 = _mm_packus_epi16(x0, x0);
+static inline __m128i load_pred_samples(const int16_t* src, int n)
+{
+  if (n==8)      return _mm_loadu_si128((const __m128i*)src);
+  else if (n==4) return _mm_loadl_epi64((const __m128i*)src);
+  else           return _mm_cvtsi32_si128(*(const int32_t*)src);
+}
 
-                    _mm_storeu_si128((__m128i *) (dst+x), x0);
-                }
+static inline void store_pred_samples(uint8_t* dst, __m128i v, int n, __m128i maxval)
+{
+  v = _mm_packus_epi16(v,v);
 
-                dst += dststride;
-                src += srcstride;
-            }
-        }else if(!(width & 3)){
-            for (y = 0; y < height; y++) {
-                for(x=0;x<width;x+=4){
-                    x0 = _mm_loadl_epi64((__m128i *) (src+x));
-                    x1 = _mm_unpackhi_epi16(_mm_mullo_epi16(x0, c0),
-                            _mm_mulhi_epi16(x0, c0));
+  if (n==8)      _mm_storel_epi64((__m128i*)dst, v);
+  else if (n==4) *((uint32_t*)dst) = _mm_cvtsi128_si32(v);
+  else           *((uint16_t*)dst) = _mm_cvtsi128_si32(v);
+}
 
-                    x0 = _mm_unpacklo_epi16(_mm_mullo_epi16(x0, c0),
-                            _mm_mulhi_epi16(x0, c0));
+static inline void store_pred_samples(uint16_t* dst, __m128i v, int n, __m128i maxval)
+{
+  v = _mm_min_epi16(_mm_max_epi16(v, _mm_setzero_si128()), maxval);
 
+  if (n==8)      _mm_storeu_si128((__m128i*)dst, v);
+  else if (n==4) _mm_storel_epi64((__m128i*)dst, v);
+  else           *((uint32_t*)dst) = _mm_cvtsi128_si32(v);
+}
 
-                    x0 = _mm_add_epi32(x0, add2);
-                    x1 = _mm_add_epi32(x1, add2);
 
+// ((in*w + rnd) >> log2WD) + o
+static inline __m128i weighted_pred_samples(__m128i in, __m128i w_rnd, __m128i shift, __m128i o)
+{
+  const __m128i one = _mm_set1_epi16(1);
 
-                    x0 = _mm_packus_epi32(x0, x1);
-                    x0 = _mm_packus_epi16(x0, x0);
+  __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(in, one), w_rnd);
+  __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(in, one), w_rnd);
 
+  lo = _mm_add_epi32(_mm_sra_epi32(lo, shift), o);
+  hi = _mm_add_epi32(_mm_sra_epi32(hi, shift), o);
 
-                    _mm_maskmoveu_si128(x0,_mm_set_epi8(0,0,0,0,0,0,0,0,0,0,0,0,-1,-1,-1,-1),(char *) (dst+x));
-                }
-                dst += dststride;
-                src += srcstride;
-            }
-        }else{
-            for (y = 0; y < height; y++) {
-                for(x=0;x<width;x+=2){
-                    x0 = _mm_loadl_epi64((__m128i *) (src+x));
-                    x1 = _mm_unpackhi_epi16(_mm_mullo_epi16(x0, c0),
-                            _mm_mulhi_epi16(x0, c0));
+  return _mm_packs_epi32(lo, hi);
+}
 
-                    x0 = _mm_unpacklo_epi16(_mm_mullo_epi16(x0, c0),
-                            _mm_mulhi_epi16(x0, c0));
+// (in1*w1 + in2*w2 + rnd) >> shift
+static inline __m128i weighted_bipred_samples(__m128i in1, __m128i in2,
+                                              __m128i w1_w2, __m128i rnd, __m128i shift)
+{
+  __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(in1, in2), w1_w2);
+  __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(in1, in2), w1_w2);
 
+  lo = _mm_sra_epi32(_mm_add_epi32(lo, rnd), shift);
+  hi = _mm_sra_epi32(_mm_add_epi32(hi, rnd), shift);
 
-                    x0 = _mm_add_epi32(x0, add2);
-                    x1 = _mm_add_epi32(x1, add2);
+  return _mm_packs_epi32(lo, hi);
+}
 
 
-                    x0 = _mm_packus_epi32(x0, x1);
-                    x0 = _mm_packus_epi16(x0, x0);
+template <class pixel_t>
+static void put_weighted_pred_sse4(pixel_t *dst, ptrdiff_t dststride,
+                                   const int16_t *src, ptrdiff_t srcstride,
+                                   int width, int height,
+                                   int w,int o,int log2WD, int bit_depth)
+{
+  const int rnd = (log2WD>0 ? 1<<(log2WD-1) : 0);
 
+  const __m128i w_rnd  = _mm_set1_epi32((rnd<<16) | (w & 0xFFFF));
+  const __m128i shift  = _mm_cvtsi32_si128(log2WD);
+  const __m128i offset = _mm_set1_epi32(o);
+  const __m128i maxval = _mm_set1_epi16((1<<bit_depth)-1);
 
-                    _mm_maskmoveu_si128(x0,_mm_set_epi8(0,0,0,0,0,0,0,0,0,0,0,0,0,0,-1,-1),(char *) (dst+x));
-                }
-                dst += dststride;
-                src += srcstride;
-            }
+  for (int y=0;y<height;y++) {
+    int x=0;
 
-        }
+    for (;x+8<=width;x+=8) {
+      __m128i v = weighted_pred_samples(load_pred_samples(src+x,8), w_rnd,shift,offset);
+      store_pred_samples(dst+x, v, 8, maxval);
+    }
 
+    for (int n=4;n>=2;n>>=1) {
+      if (x+n<=width) {
+        __m128i v = weighted_pred_samples(load_pred_samples(src+x,n), w_rnd,shift,offset);
+        store_pred_samples(dst+x, v, n, maxval);
+        x+=n;
+      }
     }
 
+    dst += dststride;
+    src += srcstride;
+  }
 }
-#endif
 
 
-#if 0
-void ff_hevc_weighted_pred_sse(uint8_t denom, int16_t wlxFlag, int16_t olxFlag,
-                               uint8_t *_dst, ptrdiff_t _dststride,
-                               const int16_t *src, ptrdiff_t srcstride,
-                               int width, int height) {
-
-    int log2Wd;
-    int x, y;
-
-    uint8_t *dst = (uint8_t*) _dst;
-    ptrdiff_t dststride = _dststride / sizeof(uint8_t);
-    __m128i x0, x1, x2, x3, c0, add, add2;
-
-    log2Wd = denom + 14 - BIT_DEPTH;
-
-    add = _mm_set1_epi32(olxFlag * (1 << (BIT_DEPTH - 8)));
-    add2 = _mm_set1_epi32(1 << (log2Wd - 1));
-    c0 = _mm_set1_epi16(wlxFlag);
-    if (log2Wd >= 1)
-        for (y = 0; y < height; y++) {
-            for (x = 0; x < width; x += 16) {
-                x0 = _mm_load_si128((__m128i *) &src[x]);
-                x2 = _mm_load_si128((__m128i *) &src[x + 8]);
-                x1 = _mm_unpackhi_epi16(_mm_mullo_epi16(x0, c0),
-                        _mm_mulhi_epi16(x0, c0));
-                x3 = _mm_unpackhi_epi16(_mm_mullo_epi16(x2, c0),
-                        _mm_mulhi_epi16(x2, c0));
-                x0 = _mm_unpacklo_epi16(_mm_mullo_epi16(x0, c0),
-                        _mm_mulhi_epi16(x0, c0));
-                x2 = _mm_unpacklo_epi16(_mm_mullo_epi16(x2, c0),
-                        _mm_mulhi_epi16(x2, c0));
-                x0 = _mm_add_epi32(x0, add2);
-                x1 = _mm_add_epi32(x1, add2);
-                x2 = _mm_add_epi32(x2, add2);
-                x3 = _mm_add_epi32(x3, add2);
-                x0 = _mm_srai_epi32(x0, log2Wd);
-                x1 = _mm_srai_epi32(x1, log2Wd);
-                x2 = _mm_srai_epi32(x2, log2Wd);
-                x3 = _mm_srai_epi32(x3, log2Wd);
-                x0 = _mm_add_epi32(x0, add);
-                x1 = _mm_add_epi32(x1, add);
-                x2 = _mm_add_epi32(x2, add);
-                x3 = _mm_add_epi32(x3, add);
-                x0 = _mm_packus_epi32(x0, x1);
-                x2 = _mm_packus_epi32(x2, x3);
-                x0 = _mm_packus_epi16(x0, x2);
-
-                _mm_storeu_si128((__m128i *) (dst + x), x0);
-
-            }
-            dst += dststride;
-            src += srcstride;
-        }
-    else
-        for (y = 0; y < height; y++) {
-            for (x = 0; x < width; x += 16) {
-
-                x0 = _mm_load_si128((__m128i *) &src[x]);
-                x2 = _mm_load_si128((__m128i *) &src[x + 8]);
-                x1 = _mm_unpackhi_epi16(_mm_mullo_epi16(x0, c0),
-                        _mm_mulhi_epi16(x0, c0));
-                x3 = _mm_unpackhi_epi16(_mm_mullo_epi16(x2, c0),
-                        _mm_mulhi_epi16(x2, c0));
-                x0 = _mm_unpacklo_epi16(_mm_mullo_epi16(x0, c0),
-                        _mm_mulhi_epi16(x0, c0));
-                x2 = _mm_unpacklo_epi16(_mm_mullo_epi16(x2, c0),
-                        _mm_mulhi_epi16(x2, c0));
-
-                x0 = _mm_add_epi32(x0, add2);
-                x1 = _mm_add_epi32(x1, add2);
-                x2 = _mm_add_epi32(x2, add2);
-                x3 = _mm_add_epi32(x3, add2);
-
-                x0 = _mm_packus_epi32(x0, x1);
-                x2 = _mm_packus_epi32(x2, x3);
-                x0 = _mm_packus_epi16(x0, x2);
+template <class pixel_t>
+static void put_weighted_bipred_sse4(pixel_t *dst, ptrdiff_t dststride,
+                                     const int16_t *src1, const int16_t *src2,
+                                     ptrdiff_t srcstride,
+                                     int width, int height,
+                                     int w1,int w2, int rnd, int shift, int bit_depth)
+{
+  const __m128i w1_w2    = _mm_set1_epi32((int)(((uint32_t)w2<<16) | (w1 & 0xFFFF)));
+  const __m128i rounding = _mm_set1_epi32(rnd);
+  const __m128i shiftv   = _mm_cvtsi32_si128(shift);
+  const __m128i maxval   = _mm_set1_epi16((1<<bit_depth)-1);
+
+  for (int y=0;y<height;y++) {
+    int x=0;
+
+    for (;x+8<=width;x+=8) {
+      __m128i v = weighted_bipred_samples(load_pred_samples(src1+x,8),
+                                          load_pred_samples(src2+x,8),
+                                          w1_w2,rounding,shiftv);
+      store_pred_samples(dst+x, v, 8, maxval);
+    }
 
-                _mm_storeu_si128((__m128i *) (dst + x), x0);
+    for (int n=4;n>=2;n>>=1) {
+      if (x+n<=width) {
+        __m128i v = weighted_bipred_samples(load_pred_samples(src1+x,n),
+                                            load_pred_samples(src2+x,n),
+                                            w1_w2,rounding,shiftv);
+        store_pred_samples(dst+x, v, n, maxval);
+        x+=n;
+      }
+    }
 
-            }
-            dst += dststride;
-            src += srcstride;
-        }
+    dst  += dststride;
+    src1 += srcstride;
+    src2 += srcstride;
+  }
 }
-#endif
-
-#if HAVE_SSE4_1
-void ff_hevc_weighted_pred_avg_8_sse4(uint8_t denom, int16_t wl0Flag,
-                                      int16_t wl1Flag, int16_t ol0Flag, int16_t ol1Flag,
-                                      uint8_t *_dst, ptrdiff_t _dststride,
-                                      const int16_t *src1, const int16_t *src2, ptrdiff_t srcstride,
-                                      int width, int height) {
-    int shift, shift2;
-    int log2Wd;
-    int o0;
-    int o1;
-    int x, y;
-    uint8_t *dst = (uint8_t*) _dst;
-    ptrdiff_t dststride = _dststride / sizeof(uint8_t);
-    __m128i x0, x1, x2, x3, r0, r1, r2, r3, c0, c1, c2;
-    shift = 14 - BIT_DEPTH;
-    log2Wd = denom + shift;
-
-    o0 = (ol0Flag) * (1 << (BIT_DEPTH - 8));
-    o1 = (ol1Flag) * (1 << (BIT_DEPTH - 8));
-    shift2 = (log2Wd + 1);
-    c0 = _mm_set1_epi16(wl0Flag);
-    c1 = _mm_set1_epi16(wl1Flag);
-    c2 = _mm_set1_epi32((o0 + o1 + 1) << log2Wd);
-
-    if(!(width & 15)){
-        for (y = 0; y < height; y++) {
-                   for (x = 0; x < width; x += 16) {
-                       x0 = _mm_load_si128((__m128i *) &src1[x]);
-                       x1 = _mm_load_si128((__m128i *) &src1[x + 8]);
-                       x2 = _mm_load_si128((__m128i *) &src2[x]);
-                       x3 = _mm_load_si128((__m128i *) &src2[x + 8]);
-
-                       r0 = _mm_unpacklo_epi16(_mm_mullo_epi16(x0, c0),
-                               _mm_mulhi_epi16(x0, c0));
-                       r1 = _mm_unpacklo_epi16(_mm_mullo_epi16(x1, c0),
-                               _mm_mulhi_epi16(x1, c0));
-                       r2 = _mm_unpacklo_epi16(_mm_mullo_epi16(x2, c1),
-                               _mm_mulhi_epi16(x2, c1));
-                       r3 = _mm_unpacklo_epi16(_mm_mullo_epi16(x3, c1),
-                               _mm_mulhi_epi16(x3, c1));
-                       x0 = _mm_unpackhi_epi16(_mm_mullo_epi16(x0, c0),
-                               _mm_mulhi_epi16(x0, c0));
-                       x1 = _mm_unpackhi_epi16(_mm_mullo_epi16(x1, c0),
-                               _mm_mulhi_epi16(x1, c0));
-                       x2 = _mm_unpackhi_epi16(_mm_mullo_epi16(x2, c1),
-                               _mm_mulhi_epi16(x2, c1));
-                       x3 = _mm_unpackhi_epi16(_mm_mullo_epi16(x3, c1),
-                               _mm_mulhi_epi16(x3, c1));
-                       r0 = _mm_add_epi32(r0, r2);
-                       r1 = _mm_add_epi32(r1, r3);
-                       r2 = _mm_add_epi32(x0, x2);
-                       r3 = _mm_add_epi32(x1, x3);
-
-                       r0 = _mm_add_epi32(r0, c2);
-                       r1 = _mm_add_epi32(r1, c2);
-                       r2 = _mm_add_epi32(r2, c2);
-                       r3 = _mm_add_epi32(r3, c2);
-
-                       r0 = _mm_srai_epi32(r0, shift2);
-                       r1 = _mm_srai_epi32(r1, shift2);
-                       r2 = _mm_srai_epi32(r2, shift2);
-                       r3 = _mm_srai_epi32(r3, shift2);
-
-                       r0 = _mm_packus_epi32(r0, r2);
-                       r1 = _mm_packus_epi32(r1, r3);
-                       r0 = _mm_packus_epi16(r0, r1);
-
-                       _mm_storeu_si128((__m128i *) (dst + x), r0);
-
-                   }
-                   dst += dststride;
-                   src1 += srcstride;
-                   src2 += srcstride;
-               }
-    }else if(!(width & 7)){
-        for (y = 0; y < height; y++) {
-            for(x=0;x<width;x+=8){
-                x0 = _mm_load_si128((__m128i *) (src1+x));
-                x2 = _mm_load_si128((__m128i *) (src2+x));
-
-                r0 = _mm_unpacklo_epi16(_mm_mullo_epi16(x0, c0),
-                        _mm_mulhi_epi16(x0, c0));
-
-                r2 = _mm_unpacklo_epi16(_mm_mullo_epi16(x2, c1),
-                        _mm_mulhi_epi16(x2, c1));
-
-                x0 = _mm_unpackhi_epi16(_mm_mullo_epi16(x0, c0),
-                        _mm_mulhi_epi16(x0, c0));
 
-                x2 = _mm_unpackhi_epi16(_mm_mullo_epi16(x2, c1),
-                        _mm_mulhi_epi16(x2, c1));
 
-                r0 = _mm_add_epi32(r0, r2);
-                r2 = _mm_add_epi32(x0, x2);
-
-
-                r0 = _mm_add_epi32(r0, c2);
-                r2 = _mm_add_epi32(r2, c2);
-
-                r0 = _mm_srai_epi32(r0, shift2);
-                r2 = _mm_srai_epi32(r2, shift2);
+void put_weighted_pred_8_sse4(uint8_t *dst, ptrdiff_t dststride,
+                              const int16_t *src, ptrdiff_t srcstride,
+                              int width, int height,
+                              int w,int o,int log2WD)
+{
+  put_weighted_pred_sse4(dst,dststride, src,srcstride, width,height, w,o,log2WD, 8);
+}
 
-                r0 = _mm_packus_epi32(r0, r2);
-                r0 = _mm_packus_epi16(r0, r0);
+void put_weighted_bipred_8_sse4(uint8_t *dst, ptrdiff_t dststride,
+                                const int16_t *src1, const int16_t *src2, ptrdiff_t srcstride,
+                                int width, int height,
+                                int w1,int o1, int w2,int o2, int log2WD)
+{
+  put_weighted_bipred_sse4(dst,dststride, src1,src2,srcstride, width,height,
+                           w1,w2, (o1+o2+1) << log2WD, log2WD+1, 8);
+}
 
-                _mm_storel_epi64((__m128i *) (dst+x), r0);
-            }
+void put_unweighted_pred_16_sse4(uint16_t *dst, ptrdiff_t dststride,
+                                 const int16_t *src, ptrdiff_t srcstride,
+                                 int width, int height, int bit_depth)
+{
+  // same as weighted prediction with w=1, o=0, log2WD=shift1
+  put_weighted_pred_sse4(dst,dststride, src,srcstride, width,height,
+                         1,0, 14-bit_depth, bit_depth);
+}
 
-            dst += dststride;
-            src1 += srcstride;
-            src2 += srcstride;
-        }
-    }else if(!(width & 3)){
-        for (y = 0; y < height; y++) {
-            for(x=0;x<width;x+=4){
-                x0 = _mm_loadl_epi64((__m128i *) (src1+x));
-                x2 = _mm_loadl_epi64((__m128i *) (src2+x));
+void put_weighted_pred_avg_16_sse4(uint16_t *dst, ptrdiff_t dststride,
+                                   const int16_t *src1, const int16_t *src2,
+                                   ptrdiff_t srcstride, int width,
+                                   int height, int bit_depth)
+{
+  int shift2 = 15-bit_depth;
 
-                r0 = _mm_unpacklo_epi16(_mm_mullo_epi16(x0, c0),
-                        _mm_mulhi_epi16(x0, c0));
+  put_weighted_bipred_sse4(dst,dststride, src1,src2,srcstride, width,height,
+                           1,1, 1<<(shift2-1), shift2, bit_depth);
+}
 
-                r2 = _mm_unpacklo_epi16(_mm_mullo_epi16(x2, c1),
-                        _mm_mulhi_epi16(x2, c1));
+void put_weighted_pred_16_sse4(uint16_t *dst, ptrdiff_t dststride,
+                               const int16_t *src, ptrdiff_t srcstride,
+                               int width, int height,
+                               int w,int o,int log2WD, int bit_depth)
+{
+  put_weighted_pred_sse4(dst,dststride, src,srcstride, width,height, w,o,log2WD, bit_depth);
+}
 
-                x0 = _mm_unpackhi_epi16(_mm_mullo_epi16(x0, c0),
-                        _mm_mulhi_epi16(x0, c0));
+void put_weighted_bipred_16_sse4(uint16_t *dst, ptrdiff_t dststride,
+                                 const int16_t *src1, const int16_t *src2, ptrdiff_t srcstride,
+                                 int width, int height,
+                                 int w1,int o1, int w2,int o2, int log2WD, int bit_depth)
+{
+  put_weighted_bipred_sse4(dst,dststride, src1,src2,srcstride, width,height,
+                           w1,w2, (o1+o2+1) << log2WD, log2WD+1, bit_depth);
+}
 
-                x2 = _mm_unpackhi_epi16(_mm_mullo_epi16(x2, c1),
-                        _mm_mulhi_epi16(x2, c1));
 
-                r0 = _mm_add_epi32(r0, r2);
-                r2 = _mm_add_epi32(x0, x2);
+/* Chroma interpolation for more than 8 bits (8.5.3.3.3.2). This covers the block sizes
+   of all chroma formats (widths that are a multiple of 2). The sums are computed in 32 bit
+   with pmaddwd on pairs of neighboring taps.
+   Since pmaddwd is signed, unsigned input pixels are flipped into the signed range by
+   subtracting 0x8000. The filter taps sum up to 64, so this is compensated by adding
+   64*0x8000 to the sum.
+ */
 
-                r0 = _mm_add_epi32(r0, c2);
-                r2 = _mm_add_epi32(r2, c2);
+static inline void store_epel_samples(int16_t* dst, __m128i v, int n)
+{
+  if (n==8)      _mm_storeu_si128((__m128i*)dst, v);
+  else if (n==4) _mm_storel_epi64((__m128i*)dst, v);
+  else           *((uint32_t*)dst) = _mm_cvtsi128_si32(v);
+}
 
-                r0 = _mm_srai_epi32(r0, shift2);
-                r2 = _mm_srai_epi32(r2, shift2);
+// apply the 4-tap filter to the samples src[-step], src[0], src[step], src[2*step]
+static inline __m128i epel_filter_samples(const int16_t* src, ptrdiff_t step, int n,
+                                          __m128i c01, __m128i c23, __m128i shift,
+                                          __m128i flip, __m128i offset)
+{
+  __m128i p0 = _mm_xor_si128(load_pred_samples(src-step,   n), flip);
+  __m128i p1 = _mm_xor_si128(load_pred_samples(src,        n), flip);
+  __m128i p2 = _mm_xor_si128(load_pred_samples(src+step,   n), flip);
+  __m128i p3 = _mm_xor_si128(load_pred_samples(src+2*step, n), flip);
+
+  __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(p0,p1), c01),
+                             _mm_madd_epi16(_mm_unpacklo_epi16(p2,p3), c23));
+  __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(p0,p1), c01),
+                             _mm_madd_epi16(_mm_unpackhi_epi16(p2,p3), c23));
+  lo = _mm_add_epi32(lo, offset);
+  hi = _mm_add_epi32(hi, offset);
+
+  return _mm_packs_epi32(_mm_sra_epi32(lo, shift), _mm_sra_epi32(hi, shift));
+}
 
-                r0 = _mm_packus_epi32(r0, r2);
-                r0 = _mm_packus_epi16(r0, r0);
+// 'step' is 1 for horizontal and the source stride for vertical filtering.
+// 'pixels' is true when the input is unsigned pixel data, false for signed intermediate values.
+static void epel_filter_block_16(int16_t* dst, ptrdiff_t dststride,
+                                 const int16_t* src, ptrdiff_t srcstride, ptrdiff_t step,
+                                 int width, int height, int frac, int shift, bool pixels)
+{
+  const int8_t* f = epel_filters[frac-1];
 
-#if MASKMOVE
-                _mm_maskmoveu_si128(r0,_mm_set_epi8(0,0,0,0,0,0,0,0,0,0,0,0,-1,-1,-1,-1),(char *) (dst+x));
-#else
-                *((uint32_t*)(dst+x)) = _mm_cvtsi128_si32(r0);
-#endif
-            }
-            dst += dststride;
-            src1 += srcstride;
-            src2 += srcstride;
-        }
-    }else{
-        for (y = 0; y < height; y++) {
-            for(x=0;x<width;x+=2){
-                x0 = _mm_loadl_epi64((__m128i *) (src1+x));
-                x2 = _mm_loadl_epi64((__m128i *) (src2+x));
+  const __m128i c01 = _mm_set1_epi32((int)(((uint32_t)f[1]<<16) | (f[0] & 0xFFFF)));
+  const __m128i c23 = _mm_set1_epi32((int)(((uint32_t)f[3]<<16) | (f[2] & 0xFFFF)));
+  const __m128i shiftv = _mm_cvtsi32_si128(shift);
+  const __m128i flip   = _mm_set1_epi16(pixels ? (int16_t)0x8000 : 0);
+  const __m128i offset = _mm_set1_epi32(pixels ? 64*0x8000 : 0);
 
-                r0 = _mm_unpacklo_epi16(_mm_mullo_epi16(x0, c0),
-                        _mm_mulhi_epi16(x0, c0));
+  for (int y=0;y<height;y++) {
+    int x=0;
 
-                r2 = _mm_unpacklo_epi16(_mm_mullo_epi16(x2, c1),
-                        _mm_mulhi_epi16(x2, c1));
+    for (;x+8<=width;x+=8) {
+      store_epel_samples(dst+x, epel_filter_samples(src+x,step,8, c01,c23,shiftv,flip,offset), 8);
+    }
 
-                x0 = _mm_unpackhi_epi16(_mm_mullo_epi16(x0, c0),
-                        _mm_mulhi_epi16(x0, c0));
+    for (int n=4;n>=2;n>>=1) {
+      if (x+n<=width) {
+        store_epel_samples(dst+x, epel_filter_samples(src+x,step,n, c01,c23,shiftv,flip,offset), n);
+        x+=n;
+      }
+    }
 
-                x2 = _mm_unpackhi_epi16(_mm_mullo_epi16(x2, c1),
-                        _mm_mulhi_epi16(x2, c1));
+    dst += dststride;
+    src += srcstride;
+  }
+}
 
-                r0 = _mm_add_epi32(r0, r2);
-                r2 = _mm_add_epi32(x0, x2);
 
-                r0 = _mm_add_epi32(r0, c2);
-                r2 = _mm_add_epi32(r2, c2);
+void put_epel_16_sse4(int16_t *dst, ptrdiff_t dststride,
+                      const uint16_t *src, ptrdiff_t srcstride, int width, int height,
+                      int /*mx*/, int /*my*/, int16_t* /*mcbuffer*/, int bit_depth)
+{
+  const __m128i shift3 = _mm_cvtsi32_si128(14-bit_depth);
 
-                r0 = _mm_srai_epi32(r0, shift2);
-                r2 = _mm_srai_epi32(r2, shift2);
+  for (int y=0;y<height;y++) {
+    int x=0;
 
-                r0 = _mm_packus_epi32(r0, r2);
-                r0 = _mm_packus_epi16(r0, r0);
+    for (;x+8<=width;x+=8) {
+      __m128i v = load_pred_samples((const int16_t*)src+x, 8);
+      store_epel_samples(dst+x, _mm_sll_epi16(v, shift3), 8);
+    }
 
-#if MASKMOVE
-                _mm_maskmoveu_si128(r0,_mm_set_epi8(0,0,0,0,0,0,0,0,0,0,0,0,0,0,-1,-1),(char *) (dst+x));
-#else
-                *((uint16_t*)(dst+x)) = _mm_cvtsi128_si32(r0);
-#endif
-            }
-            dst += dststride;
-            src1 += srcstride;
-            src2 += srcstride;
-        }
+    for (int n=4;n>=2;n>>=1) {
+      if (x+n<=width) {
+        __m128i v = load_pred_samples((const int16_t*)src+x, n);
+        store_epel_samples(dst+x, _mm_sll_epi16(v, shift3), n);
+        x+=n;
+      }
     }
-}
-#endif
 
+    dst += dststride;
+    src += srcstride;
+  }
+}
 
-#if 0
-void ff_hevc_weighted_pred_avg_sse(uint8_t denom, int16_t wl0Flag,
-        int16_t wl1Flag, int16_t ol0Flag, int16_t ol1Flag, uint8_t *_dst,
-                                   ptrdiff_t _dststride, const int16_t *src1, const int16_t *src2, ptrdiff_t srcstride,
-        int width, int height) {
-    int shift, shift2;
-    int log2Wd;
-    int o0;
-    int o1;
-    int x, y;
-    uint8_t *dst = (uint8_t*) _dst;
-    ptrdiff_t dststride = _dststride / sizeof(uint8_t);
-    __m128i x0, x1, x2, x3, r0, r1, r2, r3, c0, c1, c2;
-    shift = 14 - BIT_DEPTH;
-    log2Wd = denom + shift;
+void put_epel_h_16_sse4(int16_t *dst, ptrdiff_t dststride,
+                        const uint16_t *src, ptrdiff_t srcstride, int width, int height,
+                        int mx, int /*my*/, int16_t* /*mcbuffer*/, int bit_depth)
+{
+  epel_filter_block_16(dst,dststride, (const int16_t*)src,srcstride, 1,
+                       width,height, mx, bit_depth-8, true);
+}
 
-    o0 = (ol0Flag) * (1 << (BIT_DEPTH - 8));
-    o1 = (ol1Flag) * (1 << (BIT_DEPTH - 8));
-    shift2 = (log2Wd + 1);
-    c0 = _mm_set1_epi16(wl0Flag);
-    c1 = _mm_set1_epi16(wl1Flag);
-    c2 = _mm_set1_epi32((o0 + o1 + 1) << log2Wd);
+void put_epel_v_16_sse4(int16_t *dst, ptrdiff_t dststride,
+                        const uint16_t *src, ptrdiff_t srcstride, int width, int height,
+                        int /*mx*/, int my, int16_t* /*mcbuffer*/, int bit_depth)
+{
+  epel_filter_block_16(dst,dststride, (const int16_t*)src,srcstride, srcstride,
+                       width,height, my, bit_depth-8, true);
+}
 
-    for (y = 0; y < height; y++) {
-        for (x = 0; x < width; x += 16) {
-            x0 = _mm_load_si128((__m128i *) &src1[x]);
-            x1 = _mm_load_si128((__m128i *) &src1[x + 8]);
-            x2 = _mm_load_si128((__m128i *) &src2[x]);
-            x3 = _mm_load_si128((__m128i *) &src2[x + 8]);
-
-            r0 = _mm_unpacklo_epi16(_mm_mullo_epi16(x0, c0),
-                    _mm_mulhi_epi16(x0, c0));
-            r1 = _mm_unpacklo_epi16(_mm_mullo_epi16(x1, c0),
-                    _mm_mulhi_epi16(x1, c0));
-            r2 = _mm_unpacklo_epi16(_mm_mullo_epi16(x2, c1),
-                    _mm_mulhi_epi16(x2, c1));
-            r3 = _mm_unpacklo_epi16(_mm_mullo_epi16(x3, c1),
-                    _mm_mulhi_epi16(x3, c1));
-            x0 = _mm_unpackhi_epi16(_mm_mullo_epi16(x0, c0),
-                    _mm_mulhi_epi16(x0, c0));
-            x1 = _mm_unpackhi_epi16(_mm_mullo_epi16(x1, c0),
-                    _mm_mulhi_epi16(x1, c0));
-            x2 = _mm_unpackhi_epi16(_mm_mullo_epi16(x2, c1),
-                    _mm_mulhi_epi16(x2, c1));
-            x3 = _mm_unpackhi_epi16(_mm_mullo_epi16(x3, c1),
-                    _mm_mulhi_epi16(x3, c1));
-            r0 = _mm_add_epi32(r0, r2);
-            r1 = _mm_add_epi32(r1, r3);
-            r2 = _mm_add_epi32(x0, x2);
-            r3 = _mm_add_epi32(x1, x3);
-
-            r0 = _mm_add_epi32(r0, c2);
-            r1 = _mm_add_epi32(r1, c2);
-            r2 = _mm_add_epi32(r2, c2);
-            r3 = _mm_add_epi32(r3, c2);
-
-            r0 = _mm_srai_epi32(r0, shift2);
-            r1 = _mm_srai_epi32(r1, shift2);
-            r2 = _mm_srai_epi32(r2, shift2);
-            r3 = _mm_srai_epi32(r3, shift2);
-
-            r0 = _mm_packus_epi32(r0, r2);
-            r1 = _mm_packus_epi32(r1, r3);
-            r0 = _mm_packus_epi16(r0, r1);
+void put_epel_hv_16_sse4(int16_t *dst, ptrdiff_t dststride,
+                         const uint16_t *src, ptrdiff_t srcstride, int width, int height,
+                         int mx, int my, int16_t* mcbuffer, int bit_depth)
+{
+  // horizontal pass into mcbuffer, including one row above and two rows below the block
 
-            _mm_storeu_si128((__m128i *) (dst + x), r0);
+  epel_filter_block_16(mcbuffer,MAX_PB_SIZE, (const int16_t*)(src - epel_extra_before*srcstride),
+                       srcstride, 1, width,height+epel_extra, mx, bit_depth-8, true);
 
-        }
-        dst += dststride;
-        src1 += srcstride;
-        src2 += srcstride;
-    }
+  epel_filter_block_16(dst,dststride, mcbuffer + epel_extra_before*MAX_PB_SIZE, MAX_PB_SIZE,
+                       MAX_PB_SIZE, width,height, my, 6, false);
 }
-#endif
 
 
 void ff_hevc_put_hevc_epel_pixels_8_sse(int16_t *dst, ptrdiff_t dststride,
@@ -25,6 +25,11 @@
 #include "x86/sse.h"
 #include "x86/sse-motion.h"
 #include "x86/sse-dct.h"
+#include "x86/sse-distortion.h"
+#include "x86/avx2-distortion.h"
+#include "x86/avx2-motion.h"
+#include "x86/sse-convert.h"
+#include "x86/avx2-convert.h"
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -50,6 +55,32 @@ void init_acceleration_functions_sse(struct acceleration_functions* accel)
   uint32_t eax,ebx;
   __get_cpuid(1, &eax,&ebx,&ecx,&edx);
 #endif
+
+  // AVX2 also needs support by the OS for saving the YMM registers (OSXSAVE + XCR0)
+
+  int have_AVX2 = 0;
+
+  if ((ecx & (1<<27)) && (ecx & (1<<28))) {
+    uint32_t ebx7=0;
+    uint64_t xcr0=0;
+
+#ifdef _MSC_VER
+    __cpuidex((int *)regs, 7, 0);
+    ebx7 = regs[1];
+    xcr0 = _xgetbv(0);
+#else
+    uint32_t eax7,ecx7,edx7;
+    if (__get_cpuid_max(0, NULL) >= 7) {
+      __cpuid_count(7, 0, eax7,ebx7,ecx7,edx7);
+    }
+
+    uint32_t xcr0_lo,xcr0_hi;
+    __asm__ ("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+    xcr0 = ((uint64_t)xcr0_hi << 32) | xcr0_lo;
+#endif
+
+    have_AVX2 = (ebx7 & (1<<5)) && ((xcr0 & 6) == 6);
+  }
   
   // printf("CPUID EAX=1 -> ECX=%x EDX=%x\n", regs[2], regs[3]);
 
@@ -66,12 +97,24 @@ void init_acceleration_functions_sse(struct acceleration_functions* accel)
   if (have_SSE4_1) {
     accel->put_unweighted_pred_8   = ff_hevc_put_unweighted_pred_8_sse;
     accel->put_weighted_pred_avg_8 = ff_hevc_put_weighted_pred_avg_8_sse;
+    accel->put_weighted_pred_8     = put_weighted_pred_8_sse4;
+    accel->put_weighted_bipred_8   = put_weighted_bipred_8_sse4;
+
+    accel->put_unweighted_pred_16   = put_unweighted_pred_16_sse4;
+    accel->put_weighted_pred_avg_16 = put_weighted_pred_avg_16_sse4;
+    accel->put_weighted_pred_16     = put_weighted_pred_16_sse4;
+    accel->put_weighted_bipred_16   = put_weighted_bipred_16_sse4;
 
     accel->put_hevc_epel_8    = ff_hevc_put_hevc_epel_pixels_8_sse;
     accel->put_hevc_epel_h_8  = ff_hevc_put_hevc_epel_h_8_sse;
     accel->put_hevc_epel_v_8  = ff_hevc_put_hevc_epel_v_8_sse;
     accel->put_hevc_epel_hv_8 = ff_hevc_put_hevc_epel_hv_8_sse;
 
+    accel->put_hevc_epel_16    = put_epel_16_sse4;
+    accel->put_hevc_epel_h_16  = put_epel_h_16_sse4;
+    accel->put_hevc_epel_v_16  = put_epel_v_16_sse4;
+    accel->put_hevc_epel_hv_16 = put_epel_hv_16_sse4;
+
     accel->put_hevc_qpel_8[0][0] = ff_hevc_put_hevc_qpel_pixels_8_sse;
     accel->put_hevc_qpel_8[0][1] = ff_hevc_put_hevc_qpel_v_1_8_sse;
     accel->put_hevc_qpel_8[0][2] = ff_hevc_put_hevc_qpel_v_2_8_sse;
@@ -98,6 +141,67 @@ void init_acceleration_functions_sse(struct acceleration_functions* accel)
     accel->transform_add_8[1] = ff_hevc_transform_8x8_add_8_sse4;
     accel->transform_add_8[2] = ff_hevc_transform_16x16_add_8_sse4;
     accel->transform_add_8[3] = ff_hevc_transform_32x32_add_8_sse4;
+
+    accel->transform_dc_add_8[0] = transform_4x4_dc_add_8_sse4;
+    accel->transform_dc_add_8[1] = transform_8x8_dc_add_8_sse4;
+    accel->transform_dc_add_8[2] = transform_16x16_dc_add_8_sse4;
+    accel->transform_dc_add_8[3] = transform_32x32_dc_add_8_sse4;
+
+    // for 8x8 blocks, the sparse transform is not faster than the full transform
+    accel->transform_sparse_add_8[1][0] = ff_hevc_transform_8x8_add_8_sse4;
+    accel->transform_sparse_add_8[1][1] = ff_hevc_transform_8x8_add_8_sse4;
+    accel->transform_sparse_add_8[2][0] = transform_16x16_sparse4_add_8_sse4;
+    accel->transform_sparse_add_8[2][1] = transform_16x16_sparse8_add_8_sse4;
+    accel->transform_sparse_add_8[3][0] = transform_32x32_sparse4_add_8_sse4;
+    accel->transform_sparse_add_8[3][1] = transform_32x32_sparse8_add_8_sse4;
+
+    accel->fwd_transform_4x4_dst_8 = fdst_4x4_8_sse4;
+    accel->fwd_transform_8[0] = fdct_4x4_8_sse4;
+    accel->fwd_transform_8[1] = fdct_8x8_8_sse4;
+    accel->fwd_transform_8[2] = fdct_16x16_8_sse4;
+    accel->fwd_transform_8[3] = fdct_32x32_8_sse4;
+
+    accel->quant_coefficients = quant_coefficients_sse4;
+
+    accel->transform_skip_residual  = transform_skip_residual_sse4;
+    accel->transform_bypass         = transform_bypass_sse4;
+    accel->rdpcm_v                  = rdpcm_v_sse4;
+    accel->rdpcm_h                  = rdpcm_h_sse4;
+    accel->transform_bypass_rdpcm_v = transform_bypass_rdpcm_v_sse4;
+    accel->transform_bypass_rdpcm_h = transform_bypass_rdpcm_h_sse4;
+    accel->cross_comp_pred          = cross_comp_pred_sse4;
+    accel->add_residual_8           = add_residual_8_sse4;
+    accel->add_residual_16          = add_residual_16_sse4;
+
+    accel->sad_8 = sad_8_sse4;
+    accel->ssd_8 = ssd_8_sse4;
+    accel->satd_8[0] = satd_4x4_8_sse4;
+    accel->satd_8[1] = satd_8x8_8_sse4;
+
+    accel->reduce_bit_depth_row     = reduce_bit_depth_row_sse4;
+    accel->interleave_chroma_row_8  = interleave_chroma_row_8_sse4;
+    accel->interleave_chroma_row_16 = interleave_chroma_row_16_sse4;
+    accel->shift_row_16             = shift_row_16_sse4;
+    accel->yuv_to_rgba_row          = yuv_to_rgba_row_sse4;
+  }
+#endif
+
+#if HAVE_AVX2
+  if (have_AVX2) {
+    accel->sad_8 = sad_8_avx2;
+    accel->ssd_8 = ssd_8_avx2;
+    accel->satd_8[1] = satd_8x8_8_avx2;
+
+    accel->put_weighted_pred_8   = put_weighted_pred_8_avx2;
+    accel->put_weighted_bipred_8 = put_weighted_bipred_8_avx2;
+
+    accel->put_unweighted_pred_16   = put_unweighted_pred_16_avx2;
+    accel->put_weighted_pred_avg_16 = put_weighted_pred_avg_16_avx2;
+    accel->put_weighted_pred_16     = put_weighted_pred_16_avx2;
+    accel->put_weighted_bipred_16   = put_weighted_bipred_16_avx2;
+
+    accel->reduce_bit_depth_row = reduce_bit_depth_row_avx2;
+    accel->yuv_to_rgba_row      = yuv_to_rgba_row_avx2;
   }
 #endif
 }
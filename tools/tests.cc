@@ -22,6 +22,16 @@
 #include <iostream>
 #include <string.h>
 
+#include "libde265/threads.h"
+#include "libde265/decctx.h"
+#include "libde265/en265.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <math.h>
+
 
 class Test
 {
@@ -87,6 +97,392 @@ public:
 
 
 
+
+class CountingTask : public thread_task
+{
+public:
+  void work() { }
+};
+
+
+class TaskArenaTest : public Test
+{
+public:
+  const char* getName() const { return "task-arena"; }
+  const char* getDescription() const { return "tasks are reused after a reset of their arena"; }
+  bool work(bool quiet) {
+    task_arena<CountingTask> arena;
+
+    CountingTask* first[3];
+    for (int i=0;i<3;i++) {
+      first[i] = arena.get_task();
+      first[i]->state = thread_task::Finished;
+    }
+
+    if (arena.num_tasks_in_use() != 3) return false;
+
+    arena.reset();
+    if (arena.num_tasks_in_use() != 0) return false;
+
+    // the same objects have to be handed out again, in the same order and in queued state
+
+    for (int i=0;i<3;i++) {
+      CountingTask* task = arena.get_task();
+      if (task != first[i] || task->state != thread_task::Queued) return false;
+    }
+
+    // a fourth task is newly allocated
+
+    CountingTask* task = arena.get_task();
+    for (int i=0;i<3;i++) {
+      if (task == first[i]) return false;
+    }
+
+    return true;
+  }
+} taskarenatest;
+
+
+
+class SleepingTask : public thread_task
+{
+public:
+  SleepingTask() : running(NULL), done(NULL) { }
+
+  std::atomic<int>* running;
+  std::atomic<int>* done;
+
+  void work() {
+    (*running)++;
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    (*running)--;
+    (*done)++;
+  }
+};
+
+
+class SharedPoolTest : public Test
+{
+public:
+  const char* getName() const { return "shared-pool"; }
+  const char* getDescription() const { return "detaching a queue from a shared pool waits for its running tasks"; }
+  bool work(bool quiet) {
+    thread_pool* pool = new thread_pool;
+    if (start_thread_pool(pool, 4) != DE265_OK) return false;
+
+    thread_task_queue queue[2];
+    attach_task_queue(pool, &queue[0]);
+    attach_task_queue(pool, &queue[1]);
+
+    std::atomic<int> running[2], done[2];
+    SleepingTask tasks[2][8];
+
+    for (int q=0;q<2;q++) {
+      running[q] = 0;
+      done[q] = 0;
+      for (int i=0;i<8;i++) {
+        tasks[q][i].running = &running[q];
+        tasks[q][i].done    = &done[q];
+        add_task(&queue[q], &tasks[q][i]);
+      }
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    // detaching has to wait for the tasks that are executed right now
+
+    bool ok = true;
+
+    if (detach_task_queue(&queue[0])) ok = false;
+    if (running[0] != 0) ok = false;
+    if (queue[0].pool != NULL) ok = false;
+
+    // the pool is still used by the second queue and must not be released yet
+
+    if (release_thread_pool(pool)) ok = false;
+
+    // the other queue is processed completely
+
+    while (done[1] < 8) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // the last detach reports that the pool can be freed now
+
+    if (!detach_task_queue(&queue[1])) ok = false;
+
+    stop_thread_pool(pool);
+    delete pool;
+
+    return ok;
+  }
+} sharedpooltest;
+
+
+
+class SuspendingTask : public thread_task
+{
+public:
+  SuspendingTask() : lock(NULL), resumed(false), done(false) { }
+
+  de265_progress_lock* lock;
+  bool resumed;
+  std::atomic<bool> done;
+
+  void work() {
+    if (state != Blocked) {
+      state = Blocked;
+      if (lock->resume_task_at_progress(this, 1)) {
+        return; // the worker thread is free for other tasks now
+      }
+    }
+    else {
+      resumed = true;
+    }
+
+    state = Finished;
+    done = true;
+  }
+};
+
+
+class ProgressTask : public thread_task
+{
+public:
+  de265_progress_lock* lock;
+
+  void work() { lock->set_progress(1); }
+};
+
+
+class SuspendResumeTest : public Test
+{
+public:
+  const char* getName() const { return "suspend-resume"; }
+  const char* getDescription() const { return "a suspended task does not block the only worker thread"; }
+  bool work(bool quiet) {
+    // With a single worker thread, a blocking wait in the first task would never
+    // let the second task set the progress.
+
+    thread_pool pool;
+    if (start_thread_pool(&pool, 1) != DE265_OK) return false;
+
+    thread_task_queue queue;
+    attach_task_queue(&pool, &queue);
+
+    de265_progress_lock lock;
+
+    SuspendingTask waiter;
+    waiter.lock = &lock;
+
+    ProgressTask setter;
+    setter.lock = &lock;
+
+    add_task(&queue, &waiter);
+    add_task(&queue, &setter);
+
+    for (int i=0; i<1000 && !waiter.done; i++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    bool ok = (waiter.done && waiter.resumed);
+
+    detach_task_queue(&queue);
+    stop_thread_pool(&pool);
+
+    return ok;
+  }
+} suspendresumetest;
+
+
+
+class SubstreamStartTest : public Test
+{
+public:
+  const char* getName() const { return "substream-start"; }
+  const char* getDescription() const { return "substreams decoded in parallel start at tiles and WPP rows"; }
+  bool work(bool quiet) {
+    // 4x2 CTBs of 64x64, split into two tile columns
+
+    seq_parameter_set sps;
+    sps.set_defaults();
+    sps.set_CB_log2size_range(3,6);
+    sps.set_resolution(256,128);
+    if (sps.compute_derived_values(true) != DE265_OK) return false;
+
+    pic_parameter_set pps;
+    pps.set_defaults();
+    pps.tiles_enabled_flag = 1;
+    pps.num_tile_columns = 2;
+    pps.num_tile_rows = 1;
+    pps.uniform_spacing_flag = 1;
+
+    const int ctbW = sps.PicWidthInCtbsY;
+
+    // tiles only: one substream per tile
+
+    pps.set_derived_values(&sps);
+
+    if (get_next_substream_start(pps, ctbW, 0) != 4) return false;
+    if (get_next_substream_start(pps, ctbW, 4) != 8) return false;
+
+    // tiles and WPP: one substream per CTB row in each tile
+
+    pps.entropy_coding_sync_enabled_flag = 1;
+    pps.set_derived_values(&sps);
+
+    const int expected[] = { 2,4,6,8 };
+    int ts=0;
+    for (int i=0;i<4;i++) {
+      ts = get_next_substream_start(pps, ctbW, ts);
+      if (ts != expected[i]) {
+        if (!quiet) printf("substream %d starts at %d instead of %d\n", i+1, ts, expected[i]);
+        return false;
+      }
+    }
+
+    return true;
+  }
+} substreamstarttest;
+
+
+
+class LowDelayInterTest : public Test
+{
+public:
+  const char* getName() const { return "encode-inter"; }
+  const char* getDescription() const { return "a low-delay sequence with motion search decodes to the encoder reconstruction"; }
+
+  enum { width=128, height=64, nFrames=5 };
+
+  // textured pattern, moving by (3,1) samples per frame
+  static uint8_t sample(int x,int y,int frame, int cIdx) {
+    x += 3*frame;
+    y += frame;
+    if (cIdx>0) { x*=2; y*=2; }
+
+    return 128 + 50*sin(x*0.21) * cos(y*0.17) + ((x*7+y*13) & 15) + (cIdx ? 10 : 0);
+  }
+
+  static de265_image* create_input(int frame) {
+    de265_image* img = new de265_image;
+    img->alloc_image(width,height,de265_chroma_420, NULL, false,
+                     NULL, 0, NULL, false);
+
+    for (int c=0;c<3;c++) {
+      uint8_t* p = img->get_image_plane(c);
+      int stride = img->get_image_stride(c);
+
+      for (int y=0;y<img->get_height(c);y++)
+        for (int x=0;x<img->get_width(c);x++) {
+          p[x+y*stride] = sample(x,y,frame,c);
+        }
+    }
+
+    return img;
+  }
+
+  static std::vector<uint8_t> copy_planes(const de265_image* img) {
+    std::vector<uint8_t> data;
+
+    for (int c=0;c<3;c++) {
+      int stride;
+      const uint8_t* p = de265_get_image_plane(img,c,&stride);
+
+      for (int y=0;y<img->get_height(c);y++) {
+        data.insert(data.end(), p+y*stride, p+y*stride+img->get_width(c));
+      }
+    }
+
+    return data;
+  }
+
+  bool work(bool quiet) {
+
+    // --- encode ---
+
+    en265_encoder_context* ectx = en265_new_encoder();
+    en265_set_parameter_choice(ectx, "sop-structure", "low-delay");
+    en265_set_parameter_choice(ectx, "MEMode", "search");
+    en265_start_encoder(ectx, 0);
+
+    std::vector<std::vector<uint8_t> > nals;
+    std::vector<std::vector<uint8_t> > reconstruction(nFrames);
+
+    for (int f=0;f<=nFrames;f++) {
+      if (f<nFrames) { en265_push_image(ectx, create_input(f)); }
+      else           { en265_push_eof(ectx); }
+
+      en265_encode(ectx);
+
+      while (en265_packet* pck = en265_get_packet(ectx,0)) {
+        nals.push_back(std::vector<uint8_t>(pck->data, pck->data+pck->length));
+
+        if (pck->content_type == EN265_PACKET_SLICE) {
+          reconstruction[pck->frame_number] = copy_planes(pck->reconstruction);
+        }
+
+        en265_free_packet(ectx,pck);
+      }
+    }
+
+    en265_free_encoder(ectx);
+
+
+    // --- decode and compare to the reconstruction ---
+
+    de265_decoder_context* dctx = de265_new_decoder();
+    for (size_t i=0;i<nals.size();i++) {
+      de265_push_NAL(dctx, &nals[i][0], nals[i].size(), 0, NULL);
+    }
+    de265_flush_data(dctx);
+
+    bool ok = true;
+    int frame = 0;
+    int nInterBlocks = 0;
+
+    int more = 1;
+    while (more) {
+      de265_error err = de265_decode(dctx, &more);
+      if (err != DE265_OK && err != DE265_ERROR_WAITING_FOR_INPUT_DATA) {
+        break;
+      }
+
+      while (const de265_image* img = de265_get_next_picture(dctx)) {
+        if (frame >= nFrames || copy_planes(img) != reconstruction[frame]) {
+          if (!quiet) printf("frame %d does not match the encoder reconstruction\n", frame);
+          ok = false;
+        }
+
+        for (int y=0;y<height;y+=8)
+          for (int x=0;x<width;x+=8) {
+            if (img->get_pred_mode(x,y) == MODE_INTER) nInterBlocks++;
+          }
+
+        frame++;
+      }
+    }
+
+    de265_free_decoder(dctx);
+
+    if (frame != nFrames) {
+      if (!quiet) printf("decoded %d of %d frames\n", frame, nFrames);
+      return false;
+    }
+
+    // the moving pattern should be coded with motion vectors, not only with skip and intra
+
+    if (nInterBlocks == 0) {
+      if (!quiet) printf("no inter coded blocks\n");
+      return false;
+    }
+
+    return ok;
+  }
+} lowdelayintertest;
+
+
+
 int main(int argc,char** argv)
 {
   if (argc>=2) {